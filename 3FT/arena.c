@@ -0,0 +1,140 @@
+/*--------------------------------------------------------------------*/
+/* arena.c                                                            */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <assert.h>
+#include "arena.h"
+
+/* The size of an ordinary block */
+enum { BLOCK_SIZE = 4 * 1024 * 1024 };
+
+/* Allocations larger than this get a block of their own, so that
+   little of an ordinary block is ever left unused */
+enum { LARGE_SIZE = BLOCK_SIZE / 4 };
+
+/* The alignment of every allocation */
+enum { ALIGNMENT = sizeof(double) > sizeof(long) ? sizeof(double)
+                                                  : sizeof(long) };
+
+/* A block of memory, followed by the memory itself */
+struct block {
+   /* the block allocated before this one */
+   struct block *psPrev;
+   /* the size of the memory after the header */
+   size_t ulSize;
+   /* aligns what follows for any word */
+   double dAlign;
+};
+
+struct arena {
+   /* the block being carved up, and the rest before it */
+   struct block *psCurrent;
+   /* the next free byte of psCurrent, and how many follow */
+   char *pcNext;
+   size_t ulLeft;
+   /* the bytes of all the blocks */
+   size_t ulSize;
+   /* the number of references to the arena */
+   size_t ulRefs;
+};
+
+/*--------------------------------------------------------------------*/
+
+int Arena_new(Arena_T *poAResult) {
+   Arena_T oArena;
+
+   assert(poAResult != NULL);
+
+   oArena = malloc(sizeof(struct arena));
+   if(oArena == NULL) {
+      *poAResult = NULL;
+      return MEMORY_ERROR;
+   }
+   oArena->psCurrent = NULL;
+   oArena->pcNext = NULL;
+   oArena->ulLeft = 0;
+   oArena->ulSize = 0;
+   oArena->ulRefs = 1;
+
+   *poAResult = oArena;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void *Arena_alloc(Arena_T oArena, size_t ulSize) {
+   struct block *psBlock;
+   char *pcResult;
+   size_t ulBlock;
+
+   assert(oArena != NULL);
+
+   if(ulSize > (size_t) -1 - sizeof(struct block) - ALIGNMENT)
+      return NULL;
+   /* even an empty allocation gets an address of its own */
+   if(ulSize == 0)
+      ulSize = ALIGNMENT;
+   ulSize = (ulSize + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+   if(ulSize <= oArena->ulLeft) {
+      pcResult = oArena->pcNext;
+      oArena->pcNext += ulSize;
+      oArena->ulLeft -= ulSize;
+      return pcResult;
+   }
+
+   ulBlock = ulSize > LARGE_SIZE ? ulSize : BLOCK_SIZE;
+   psBlock = malloc(sizeof(struct block) + ulBlock);
+   if(psBlock == NULL)
+      return NULL;
+   psBlock->ulSize = ulBlock;
+   oArena->ulSize += ulBlock;
+   pcResult = (char *) (psBlock + 1);
+
+   if(ulBlock != BLOCK_SIZE && oArena->psCurrent != NULL) {
+      /* a block of its own goes behind the one being carved up */
+      psBlock->psPrev = oArena->psCurrent->psPrev;
+      oArena->psCurrent->psPrev = psBlock;
+      return pcResult;
+   }
+   psBlock->psPrev = oArena->psCurrent;
+   oArena->psCurrent = psBlock;
+   oArena->pcNext = pcResult + ulSize;
+   oArena->ulLeft = ulBlock - ulSize;
+   return pcResult;
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t Arena_getSize(Arena_T oArena) {
+   assert(oArena != NULL);
+
+   return oArena->ulSize;
+}
+
+/*--------------------------------------------------------------------*/
+
+void Arena_retain(Arena_T oArena) {
+   assert(oArena != NULL);
+
+   (void) __atomic_add_fetch(&oArena->ulRefs, 1, __ATOMIC_RELAXED);
+}
+
+/*--------------------------------------------------------------------*/
+
+void Arena_release(Arena_T oArena) {
+   struct block *psBlock;
+   struct block *psPrev;
+
+   if(oArena == NULL)
+      return;
+   if(__atomic_sub_fetch(&oArena->ulRefs, 1, __ATOMIC_ACQ_REL) != 0)
+      return;
+
+   for(psBlock = oArena->psCurrent; psBlock != NULL; psBlock = psPrev) {
+      psPrev = psBlock->psPrev;
+      free(psBlock);
+   }
+   free(oArena);
+}
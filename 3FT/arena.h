@@ -0,0 +1,46 @@
+/*--------------------------------------------------------------------*/
+/* arena.h                                                            */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef ARENA_INCLUDED
+#define ARENA_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  An Arena_T hands out memory carved from large blocks, so that many
+  small allocations cost one malloc per block rather than one each.
+  Nothing is freed on its own: every block goes at once, when the last
+  reference to the arena is dropped. Allocating is not thread-safe;
+  references may be taken and dropped from any thread.
+*/
+typedef struct arena *Arena_T;
+
+/*
+  Creates an empty arena holding a single reference. Returns SUCCESS
+  and sets *poAResult to it if successful. Otherwise, sets *poAResult
+  to NULL and returns MEMORY_ERROR.
+*/
+int Arena_new(Arena_T *poAResult);
+
+/*
+  Returns ulSize bytes of memory from oArena, aligned for any word,
+  valid until oArena is freed, or NULL if memory could not be
+  allocated. Allocations much larger than a block get a block of
+  their own.
+*/
+void *Arena_alloc(Arena_T oArena, size_t ulSize);
+
+/* Returns the number of bytes of the blocks oArena holds. */
+size_t Arena_getSize(Arena_T oArena);
+
+/* Takes another reference to oArena. */
+void Arena_retain(Arena_T oArena);
+
+/* Drops a reference to oArena, and frees it with all its memory once
+   the last one is gone. Does nothing if oArena is NULL. */
+void Arena_release(Arena_T oArena);
+
+#endif
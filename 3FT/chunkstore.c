@@ -0,0 +1,1854 @@
+/*--------------------------------------------------------------------*/
+/* chunkstore.c                                                       */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "epoch.h"
+#include "lz.h"
+#include "send.h"
+#include "ft.h"
+#include "chunkstore.h"
+
+/* The sizes chunks are cut at: never below MIN_CHUNK or above
+   MAX_CHUNK, and otherwise where the rolling hash has its top
+   CUT_BITS bits clear, about once in 2^CUT_BITS bytes */
+enum { MIN_CHUNK = 2048, MAX_CHUNK = 65536, CUT_BITS = 13 };
+
+/* The number of bytes the rolling hash depends on: each byte is
+   shifted out of its 32 bits after that many more */
+enum { WINDOW = 32 };
+
+/* The number of independently locked parts of a store's table; a
+   power of two */
+enum { STRIPES = 16 };
+
+/* The number of buckets a part of a table starts with; a power of
+   two */
+enum { MIN_BUCKETS = 64 };
+
+/* The number of sweeps in a row a chunk must go unread through to go
+   cold, which the idle interval is divided into */
+enum { IDLE_SWEEPS = 4 };
+
+/* Without a cold tier, the time between the sweeps that only track
+   reads, for a budget, in milliseconds, and the number of hot buffers
+   spilled chunks are read through */
+enum { SPILL_PERIOD = 1000, SPILL_HOT_BUFFERS = 8 };
+
+/* The most chunks ChunkList_send writes with one call, during one
+   read of their bytes */
+enum { SEND_PIECES = 64 };
+
+/* The budget of a store without one */
+#define NO_BUDGET ((size_t) -1)
+
+/* Bytes that readers copy without a lock, which follow it in the same
+   allocation: those of a chunk that is not cold, or its compressed
+   ones once it is, or a hot buffer, holding those of a cold or
+   spilled chunk, or of a list assembled in one piece, in a store with
+   a cold tier or a budget */
+struct bytes {
+   /* the number of bytes */
+   size_t ulLength;
+   /* for a hot buffer, the field of the chunk or list pointing to it,
+      which is cleared when the buffer is given up */
+   struct bytes **ppsOwner;
+   /* for a hot buffer, the buffers used more and less recently; once
+      given up, psLess links the bytes waiting to be freed */
+   struct bytes *psMore;
+   struct bytes *psLess;
+};
+
+/* A unique sequence of bytes */
+struct chunk {
+   /* the next chunk in the same bucket */
+   struct chunk *psNext;
+   /* the hash of the bytes */
+   unsigned long ulHash;
+   /* the number of bytes */
+   size_t ulLength;
+   /* the number of lists using the chunk, counting a list once for
+      each time it uses it */
+   size_t ulRefs;
+   /* the bytes, or NULL once the chunk is cold or spilled; this and
+      psPacked are only changed with the stripe's lock held */
+   struct bytes *psBytes;
+   /* once the chunk is cold, the bytes it compressed to, or NULL once
+      it is spilled */
+   struct bytes *psPacked;
+   /* once the chunk is cold or spilled, the number of bytes it is kept
+      in: compressed, or ulLength if it was spilled uncompressed */
+   size_t ulPacked;
+   /* once the chunk is spilled, where in the store's spill file */
+   size_t ulSpilled;
+   /* set by every read, without a lock, and cleared by every sweep */
+   int iRead;
+   /* the number of sweeps in a row that found iRead clear; used only
+      by the sweeping thread */
+   unsigned long ulIdle;
+   /* TRUE if the bytes did not compress, and stay as they are */
+   boolean bStaysHot;
+   /* once the chunk is cold or spilled, its hot buffer, or NULL;
+      guarded by the store's sHotLock */
+   struct bytes *psHot;
+   /* the next chunk a sweep compresses */
+   struct chunk *psSweep;
+};
+
+/* A free part of a spill file */
+struct extent {
+   size_t ulOffset;
+   size_t ulLength;
+   /* the next free part, further on in the file */
+   struct extent *psNext;
+};
+
+/* A part of a store's table, holding the chunks whose hashes agree in
+   their lowest bits */
+struct stripe {
+   /* the chains of chunks, indexed by higher bits of their hashes */
+   struct chunk **ppsBuckets;
+   size_t ulBuckets;
+   /* the number of chunks in the part */
+   size_t ulCount;
+   /* held by whoever looks up, adds or removes a chunk of the part */
+   pthread_mutex_t sLock;
+};
+
+/* A set of chunks */
+struct chunkStore {
+   /* the number of references to the store, one held by each list */
+   size_t ulRefs;
+   /* the number of bytes allocated for chunks, lists and buckets */
+   size_t ulSize;
+   struct stripe asStripes[STRIPES];
+
+   /* the rest is used only with a cold tier or a budget: the domain
+      readers of bytes enter, so that the bytes a sweep compresses or
+      spills and the hot buffers given up are freed only once no reader
+      can be copying them; NULL without either */
+   Epoch_T oEpoch;
+   /* held by a reader that could not enter oEpoch, instead, and by
+      whoever frees the bytes readers might be copying */
+   pthread_mutex_t sFreeLock;
+   /* guards the hot buffers, the bytes waiting to be freed and the
+      settings below */
+   pthread_mutex_t sHotLock;
+   /* the hot buffers, most recently used first, how many there are,
+      and how many there may be */
+   struct bytes *psMost;
+   struct bytes *psLeast;
+   size_t ulHot;
+   size_t ulHotMost;
+   /* the bytes given up and waiting to be freed, and how many */
+   struct bytes *psLimbo;
+   size_t ulLimbo;
+   /* the time between sweeps, in milliseconds, and TRUE if they
+      compress idle chunks, with a cold tier */
+   unsigned long ulPeriod;
+   boolean bFreeze;
+   /* the number of bytes ulSize may come to before chunks are spilled,
+      or NO_BUDGET */
+   size_t ulBudget;
+   /* the thread that sweeps, and how it is woken to stop, or to spill
+      at once */
+   pthread_t sSweeper;
+   pthread_cond_t sWake;
+   boolean bStop;
+   boolean bUrgent;
+   /* the number of sweeps begun, and done, which is broadcast on
+      sSwept after each, for writers waiting on one to spill */
+   unsigned long ulBegun;
+   unsigned long ulDone;
+   pthread_cond_t sSwept;
+
+   /* guards the spill file and its free parts */
+   pthread_mutex_t sSpillLock;
+   /* the spill file, unlinked once made, or -1 until one is needed */
+   int iSpillFd;
+   /* the length of the spill file, and its free parts before that, in
+      order */
+   size_t ulSpillEnd;
+   struct extent *psExtents;
+};
+
+/* How a read of a store's bytes keeps them from being freed */
+enum { READ_PLAIN, READ_EPOCH, READ_LOCKED };
+
+/* A chunk of a list, with where it ends in the contents */
+struct piece {
+   size_t ulEnd;
+   struct chunk *psChunk;
+};
+
+/* The contents of a file as a sequence of chunks, which follow it in
+   the same allocation */
+struct chunkList {
+   /* the number of references to the list */
+   size_t ulRefs;
+   /* the store the chunks are in */
+   ChunkStore_T oStore;
+   /* the number of bytes of contents, and of chunks */
+   size_t ulLength;
+   size_t ulCount;
+   /* the contents in one piece, once ChunkList_getBytes assembles
+      them, or NULL */
+   void *pvFlat;
+   /* with a cold tier, the hot buffer they are assembled in instead,
+      or NULL; guarded by the store's sHotLock */
+   struct bytes *psHot;
+};
+
+/* The value each byte adds to the rolling hash, made at first use */
+static unsigned long aulGear[256];
+static pthread_once_t sGearOnce = PTHREAD_ONCE_INIT;
+
+/*--------------------------------------------------------------------*/
+
+/* Fills aulGear with 32-bit values from a fixed pseudo-random
+   sequence, so that chunks are cut the same in every run. */
+static void ChunkStore_makeGear(void) {
+   unsigned long ulState = 2463534242UL;
+   size_t i;
+
+   for(i = 0; i < 256; i++) {
+      ulState ^= (ulState << 13) & 0xFFFFFFFFUL;
+      ulState ^= ulState >> 17;
+      ulState ^= (ulState << 5) & 0xFFFFFFFFUL;
+      aulGear[i] = ulState;
+   }
+}
+
+/*
+  Returns the length of the first chunk of the ulLength bytes
+  pucBytes: where the rolling hash over the WINDOW bytes before it
+  first has its top CUT_BITS bits clear, at MIN_CHUNK bytes or more,
+  or MAX_CHUNK bytes, or all of them if that is less.
+*/
+static size_t ChunkStore_cut(const unsigned char *pucBytes,
+                             size_t ulLength) {
+   const unsigned long ulMask =
+      (0xFFFFFFFFUL << (32 - CUT_BITS)) & 0xFFFFFFFFUL;
+   unsigned long ulHash = 0;
+   size_t ulLimit, i;
+
+   assert(pucBytes != NULL);
+
+   if(ulLength <= MIN_CHUNK)
+      return ulLength;
+   ulLimit = ulLength < MAX_CHUNK ? ulLength : MAX_CHUNK;
+   /* the hash at MIN_CHUNK depends on nothing before the window */
+   for(i = MIN_CHUNK - WINDOW; i < MIN_CHUNK; i++)
+      ulHash = ((ulHash << 1) + aulGear[pucBytes[i]]) & 0xFFFFFFFFUL;
+   for(; i < ulLimit; i++) {
+      if((ulHash & ulMask) == 0)
+         return i;
+      ulHash = ((ulHash << 1) + aulGear[pucBytes[i]]) & 0xFFFFFFFFUL;
+   }
+   return ulLimit;
+}
+
+/* Returns ulWord mixed so that every bit of it affects the low bits
+   of the result. */
+static unsigned long ChunkStore_mix(unsigned long ulWord) {
+   ulWord *= 0x9E3779B1UL;
+   return ulWord ^ (ulWord >> 15) ^ (ulWord >> 29);
+}
+
+/* Adds ulBytes, which may be negative in two's complement, to the
+   count of bytes oStore has allocated. */
+static void ChunkStore_account(ChunkStore_T oStore, size_t ulBytes) {
+   assert(oStore != NULL);
+
+   (void) __atomic_add_fetch(&oStore->ulSize, ulBytes, __ATOMIC_RELAXED);
+}
+
+/* Doubles the number of buckets of psStripe of oStore, or leaves them
+   be if memory could not be allocated. */
+static void ChunkStore_grow(ChunkStore_T oStore, struct stripe *psStripe) {
+   struct chunk **ppsBuckets;
+   struct chunk *psChunk, *psNext;
+   size_t ulBuckets, i, ulIndex;
+
+   assert(oStore != NULL);
+   assert(psStripe != NULL);
+
+   ulBuckets = 2 * psStripe->ulBuckets;
+   ppsBuckets = calloc(ulBuckets, sizeof(struct chunk *));
+   if(ppsBuckets == NULL)
+      return;
+   for(i = 0; i < psStripe->ulBuckets; i++) {
+      for(psChunk = psStripe->ppsBuckets[i]; psChunk != NULL;
+          psChunk = psNext) {
+         psNext = psChunk->psNext;
+         ulIndex = (psChunk->ulHash / STRIPES) & (ulBuckets - 1);
+         psChunk->psNext = ppsBuckets[ulIndex];
+         ppsBuckets[ulIndex] = psChunk;
+      }
+   }
+   free(psStripe->ppsBuckets);
+   psStripe->ppsBuckets = ppsBuckets;
+   ChunkStore_account(oStore,
+                      (ulBuckets - psStripe->ulBuckets) *
+                      sizeof(struct chunk *));
+   psStripe->ulBuckets = ulBuckets;
+}
+
+/*
+  Makes oStore's spill file in the directory pcDir, or if it is NULL,
+  in $TMPDIR or /tmp, and unlinks it at once, so that it goes with the
+  store, or with the process. Returns SUCCESS, MEMORY_ERROR, or
+  IO_ERROR if the file could not be made, in which case errno tells
+  why. The caller holds oStore's sSpillLock, and oStore has none.
+*/
+static int ChunkStore_makeSpill(ChunkStore_T oStore, const char *pcDir) {
+   static const char acName[] = "/ftspillXXXXXX";
+   char *pcPath;
+   int iFd;
+
+   assert(oStore != NULL);
+   assert(oStore->iSpillFd < 0);
+
+   if(pcDir == NULL)
+      pcDir = getenv("TMPDIR");
+   if(pcDir == NULL || *pcDir == '\0')
+      pcDir = "/tmp";
+   pcPath = malloc(strlen(pcDir) + sizeof(acName));
+   if(pcPath == NULL)
+      return MEMORY_ERROR;
+   strcpy(pcPath, pcDir);
+   strcat(pcPath, acName);
+   iFd = mkstemp(pcPath);
+   if(iFd >= 0)
+      (void) unlink(pcPath);
+   free(pcPath);
+   if(iFd < 0)
+      return IO_ERROR;
+   oStore->iSpillFd = iFd;
+   return SUCCESS;
+}
+
+/*
+  Finds room for ulLength bytes in oStore's spill file, in the first
+  free part they fit, or else at its end, making it first if need be.
+  Returns TRUE and sets *pulOffset to where, or FALSE if the file could
+  not be made.
+*/
+static boolean ChunkStore_allocSpill(ChunkStore_T oStore, size_t ulLength,
+                                     size_t *pulOffset) {
+   struct extent **ppsLink, *psExtent;
+   boolean bMade = TRUE;
+
+   assert(oStore != NULL);
+   assert(pulOffset != NULL);
+
+   (void) pthread_mutex_lock(&oStore->sSpillLock);
+   if(oStore->iSpillFd < 0)
+      bMade = ChunkStore_makeSpill(oStore, NULL) == SUCCESS;
+   for(ppsLink = &oStore->psExtents; bMade && *ppsLink != NULL;
+       ppsLink = &(*ppsLink)->psNext)
+      if((*ppsLink)->ulLength >= ulLength)
+         break;
+   if(bMade && *ppsLink != NULL) {
+      psExtent = *ppsLink;
+      *pulOffset = psExtent->ulOffset;
+      psExtent->ulOffset += ulLength;
+      psExtent->ulLength -= ulLength;
+      if(psExtent->ulLength == 0) {
+         *ppsLink = psExtent->psNext;
+         free(psExtent);
+      }
+   }
+   else if(bMade) {
+      *pulOffset = oStore->ulSpillEnd;
+      oStore->ulSpillEnd += ulLength;
+   }
+   (void) pthread_mutex_unlock(&oStore->sSpillLock);
+   return bMade;
+}
+
+/*
+  Gives back the ulLength bytes at ulOffset of oStore's spill file,
+  joining them with the free parts around them, and shortening the
+  file if they end it. If memory to note them runs out, they are left
+  unused.
+*/
+static void ChunkStore_freeSpill(ChunkStore_T oStore, size_t ulOffset,
+                                 size_t ulLength) {
+   struct extent **ppsLink, *psBefore = NULL, *psExtent;
+
+   assert(oStore != NULL);
+
+   (void) pthread_mutex_lock(&oStore->sSpillLock);
+   for(ppsLink = &oStore->psExtents;
+       *ppsLink != NULL && (*ppsLink)->ulOffset < ulOffset;
+       ppsLink = &(*ppsLink)->psNext)
+      psBefore = *ppsLink;
+   psExtent = *ppsLink;
+
+   if(psBefore != NULL &&
+      psBefore->ulOffset + psBefore->ulLength == ulOffset) {
+      psBefore->ulLength += ulLength;
+      if(psExtent != NULL &&
+         psBefore->ulOffset + psBefore->ulLength == psExtent->ulOffset) {
+         psBefore->ulLength += psExtent->ulLength;
+         psBefore->psNext = psExtent->psNext;
+         free(psExtent);
+      }
+      psExtent = psBefore;
+   }
+   else if(psExtent != NULL && ulOffset + ulLength == psExtent->ulOffset) {
+      psExtent->ulOffset = ulOffset;
+      psExtent->ulLength += ulLength;
+   }
+   else {
+      psExtent = malloc(sizeof(struct extent));
+      if(psExtent != NULL) {
+         psExtent->ulOffset = ulOffset;
+         psExtent->ulLength = ulLength;
+         psExtent->psNext = *ppsLink;
+         *ppsLink = psExtent;
+      }
+   }
+
+   /* a free part ending the file is the last, and goes with it */
+   if(psExtent != NULL &&
+      psExtent->ulOffset + psExtent->ulLength == oStore->ulSpillEnd) {
+      oStore->ulSpillEnd = psExtent->ulOffset;
+      for(ppsLink = &oStore->psExtents; *ppsLink != psExtent;
+          ppsLink = &(*ppsLink)->psNext)
+         ;
+      *ppsLink = NULL;
+      free(psExtent);
+      (void) ftruncate(oStore->iSpillFd, (off_t) oStore->ulSpillEnd);
+   }
+   (void) pthread_mutex_unlock(&oStore->sSpillLock);
+}
+
+/*
+  Reads ulLength bytes at ulOffset of oStore's spill file into pvDest,
+  if bWrite is FALSE, or writes them there from pvDest otherwise,
+  carrying on after partial transfers. Returns TRUE if all of them
+  were, or FALSE if the file failed or ended.
+*/
+static boolean ChunkStore_transfer(ChunkStore_T oStore, void *pvDest,
+                                   size_t ulLength, size_t ulOffset,
+                                   boolean bWrite) {
+   char *pcDest = pvDest;
+   ssize_t lDone;
+
+   assert(oStore != NULL);
+   assert(oStore->iSpillFd >= 0);
+
+   while(ulLength > 0) {
+      lDone = bWrite ?
+              pwrite(oStore->iSpillFd, pcDest, ulLength, (off_t) ulOffset) :
+              pread(oStore->iSpillFd, pcDest, ulLength, (off_t) ulOffset);
+      if(lDone < 0 && errno == EINTR)
+         continue;
+      if(lDone <= 0)
+         return FALSE;
+      pcDest += lDone;
+      ulOffset += (size_t) lDone;
+      ulLength -= (size_t) lDone;
+   }
+   return TRUE;
+}
+
+/* Returns the bytes that psBytes holds. */
+static unsigned char *ChunkStore_data(struct bytes *psBytes) {
+   assert(psBytes != NULL);
+
+   return (unsigned char *) (psBytes + 1);
+}
+
+/* Unlinks the hot buffer psBytes from oStore's list of them. The
+   caller holds oStore's sHotLock. */
+static void ChunkStore_unlinkHot(ChunkStore_T oStore,
+                                 struct bytes *psBytes) {
+   assert(oStore != NULL);
+   assert(psBytes != NULL);
+
+   if(psBytes->psMore != NULL)
+      psBytes->psMore->psLess = psBytes->psLess;
+   else
+      oStore->psMost = psBytes->psLess;
+   if(psBytes->psLess != NULL)
+      psBytes->psLess->psMore = psBytes->psMore;
+   else
+      oStore->psLeast = psBytes->psMore;
+   oStore->ulHot--;
+}
+
+/*
+  Links the hot buffer psBytes, which is not linked, to the front of
+  oStore's list of them, as the one used most recently. The caller
+  holds oStore's sHotLock.
+*/
+static void ChunkStore_linkHot(ChunkStore_T oStore,
+                               struct bytes *psBytes) {
+   assert(oStore != NULL);
+   assert(psBytes != NULL);
+
+   psBytes->psMore = NULL;
+   psBytes->psLess = oStore->psMost;
+   if(oStore->psMost != NULL)
+      oStore->psMost->psMore = psBytes;
+   else
+      oStore->psLeast = psBytes;
+   oStore->psMost = psBytes;
+   oStore->ulHot++;
+}
+
+/*
+  Frees the hot buffer *ppsHot of a chunk or list of oStore that no
+  reader holds any more, if it has one, and clears *ppsHot.
+*/
+static void ChunkStore_dropHot(ChunkStore_T oStore, struct bytes **ppsHot) {
+   struct bytes *psBytes;
+
+   assert(oStore != NULL);
+   assert(ppsHot != NULL);
+
+   if(oStore->oEpoch == NULL)
+      return;
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   psBytes = *ppsHot;
+   if(psBytes != NULL) {
+      ChunkStore_unlinkHot(oStore, psBytes);
+      *ppsHot = NULL;
+   }
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+   if(psBytes == NULL)
+      return;
+   ChunkStore_account(oStore, 0 - (sizeof(struct bytes) +
+                                   psBytes->ulLength));
+   free(psBytes);
+}
+
+/*
+  Frees the bytes given up in oStore so far, and those of the list
+  psMore, linked by psLess, once no reader can be copying them. The
+  caller must not be reading oStore's bytes itself.
+*/
+static void ChunkStore_flush(ChunkStore_T oStore, struct bytes *psMore) {
+   struct bytes *psList, *psNext;
+
+   assert(oStore != NULL);
+   assert(oStore->oEpoch != NULL);
+
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   psList = oStore->psLimbo;
+   oStore->psLimbo = NULL;
+   __atomic_store_n(&oStore->ulLimbo, 0, __ATOMIC_RELAXED);
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+   if(psList == NULL && psMore == NULL)
+      return;
+
+   Epoch_synchronize(oStore->oEpoch);
+   (void) pthread_mutex_lock(&oStore->sFreeLock);
+   for(; psList != NULL; psList = psNext) {
+      psNext = psList->psLess;
+      free(psList);
+   }
+   for(; psMore != NULL; psMore = psNext) {
+      psNext = psMore->psLess;
+      free(psMore);
+   }
+   (void) pthread_mutex_unlock(&oStore->sFreeLock);
+}
+
+/* Gives up the hot buffer of oStore used least recently, which is
+   freed once no reader can be copying it. The caller holds oStore's
+   sHotLock, and oStore has one. */
+static void ChunkStore_giveUp(ChunkStore_T oStore) {
+   struct bytes *psLeast;
+
+   assert(oStore != NULL);
+   assert(oStore->psLeast != NULL);
+
+   psLeast = oStore->psLeast;
+   ChunkStore_unlinkHot(oStore, psLeast);
+   *psLeast->ppsOwner = NULL;
+   ChunkStore_account(oStore, 0 - (sizeof(struct bytes) +
+                                   psLeast->ulLength));
+   psLeast->psLess = oStore->psLimbo;
+   oStore->psLimbo = psLeast;
+   __atomic_store_n(&oStore->ulLimbo, oStore->ulLimbo + 1,
+                    __ATOMIC_RELAXED);
+}
+
+/*
+  Makes psBytes, which holds the bytes of the chunk or list whose hot
+  buffer *ppsOwner is NULL, its hot buffer, used most recently, and
+  gives up those used least recently beyond the number oStore keeps.
+  If that passes oStore's budget, asks for a spill, without waiting
+  for it. The caller holds oStore's sHotLock.
+*/
+static void ChunkStore_addHot(ChunkStore_T oStore, struct bytes *psBytes,
+                              struct bytes **ppsOwner) {
+   assert(oStore != NULL);
+   assert(psBytes != NULL);
+   assert(ppsOwner != NULL && *ppsOwner == NULL);
+
+   psBytes->ppsOwner = ppsOwner;
+   *ppsOwner = psBytes;
+   ChunkStore_linkHot(oStore, psBytes);
+   ChunkStore_account(oStore, sizeof(struct bytes) + psBytes->ulLength);
+   while(oStore->ulHot > oStore->ulHotMost)
+      ChunkStore_giveUp(oStore);
+   if(!oStore->bUrgent &&
+      ChunkStore_getSize(oStore) >
+      __atomic_load_n(&oStore->ulBudget, __ATOMIC_RELAXED)) {
+      oStore->bUrgent = TRUE;
+      (void) pthread_cond_signal(&oStore->sWake);
+   }
+}
+
+/*
+  Begins a read of oStore's bytes, during which none is freed: enters
+  its domain if it has a cold tier, or holds its sFreeLock if that
+  fails. Returns how, for ChunkStore_endRead.
+*/
+static int ChunkStore_beginRead(ChunkStore_T oStore) {
+   assert(oStore != NULL);
+
+   if(oStore->oEpoch == NULL)
+      return READ_PLAIN;
+   if(Epoch_enter(oStore->oEpoch) == SUCCESS)
+      return READ_EPOCH;
+   (void) pthread_mutex_lock(&oStore->sFreeLock);
+   return READ_LOCKED;
+}
+
+/*
+  Ends a read of oStore's bytes begun by ChunkStore_beginRead, which
+  returned iHow, and then frees the hot buffers given up if there are
+  more of them than oStore keeps, so that readers thawing many files
+  in a row do not wait on the sweeper to free them.
+*/
+static void ChunkStore_endRead(ChunkStore_T oStore, int iHow) {
+   size_t ulLimbo;
+
+   assert(oStore != NULL);
+
+   if(iHow == READ_PLAIN)
+      return;
+   if(iHow == READ_EPOCH)
+      Epoch_leave(oStore->oEpoch);
+   else
+      (void) pthread_mutex_unlock(&oStore->sFreeLock);
+   ulLimbo = __atomic_load_n(&oStore->ulLimbo, __ATOMIC_RELAXED);
+   if(ulLimbo > __atomic_load_n(&oStore->ulHotMost, __ATOMIC_RELAXED))
+      ChunkStore_flush(oStore, NULL);
+}
+
+/*
+  Reads the bytes of psChunk of oStore, which is spilled, back from
+  the spill file into pucDest, decompressing them if they were spilled
+  compressed. Returns TRUE, or FALSE if memory ran out or the file
+  failed.
+*/
+static boolean ChunkStore_unspill(ChunkStore_T oStore,
+                                  const struct chunk *psChunk,
+                                  unsigned char *pucDest) {
+   unsigned char *pucPacked;
+   boolean bRead;
+
+   assert(oStore != NULL);
+   assert(psChunk != NULL);
+   assert(pucDest != NULL);
+
+   /* compressed bytes are always fewer */
+   if(psChunk->ulPacked == psChunk->ulLength)
+      return ChunkStore_transfer(oStore, pucDest, psChunk->ulLength,
+                                 psChunk->ulSpilled, FALSE);
+   pucPacked = malloc(psChunk->ulPacked);
+   if(pucPacked == NULL)
+      return FALSE;
+   bRead = ChunkStore_transfer(oStore, pucPacked, psChunk->ulPacked,
+                               psChunk->ulSpilled, FALSE) &&
+           Lz_decompress(pucPacked, psChunk->ulPacked, pucDest,
+                         psChunk->ulLength);
+   free(pucPacked);
+   return bRead;
+}
+
+/*
+  Returns TRUE if psChunk of oStore holds the ulLength bytes pucBytes,
+  comparing them as they decompress if it is cold, and reading them
+  back if it is spilled, in which case it returns FALSE if that fails.
+  The caller holds the lock of psChunk's stripe.
+*/
+static boolean ChunkStore_matches(ChunkStore_T oStore,
+                                  const struct chunk *psChunk,
+                                  const unsigned char *pucBytes,
+                                  size_t ulLength) {
+   unsigned char *pucStored;
+   boolean bSame;
+
+   assert(oStore != NULL);
+   assert(psChunk != NULL);
+   assert(pucBytes != NULL);
+
+   if(psChunk->ulLength != ulLength)
+      return FALSE;
+   if(psChunk->psBytes != NULL)
+      return memcmp(ChunkStore_data(psChunk->psBytes), pucBytes,
+                    ulLength) == 0;
+   if(psChunk->psPacked != NULL)
+      return Lz_equals(ChunkStore_data(psChunk->psPacked),
+                       psChunk->ulPacked, pucBytes, ulLength);
+
+   pucStored = malloc(psChunk->ulPacked);
+   if(pucStored == NULL ||
+      !ChunkStore_transfer(oStore, pucStored, psChunk->ulPacked,
+                           psChunk->ulSpilled, FALSE)) {
+      free(pucStored);
+      return FALSE;
+   }
+   bSame = psChunk->ulPacked == ulLength ?
+           memcmp(pucStored, pucBytes, ulLength) == 0 :
+           Lz_equals(pucStored, psChunk->ulPacked, pucBytes, ulLength);
+   free(pucStored);
+   return bSame;
+}
+
+/*
+  Returns the bytes of psChunk of oStore, marking it read: those it
+  holds, or once it is cold or spilled, those of its hot buffer,
+  decompressed or read back into a new one first if need be, or NULL
+  if memory for that could not be allocated or the spill file failed.
+  They stay valid until the read ends. The caller is reading oStore's
+  bytes, and holds a reference to psChunk.
+*/
+static const unsigned char *ChunkStore_open(ChunkStore_T oStore,
+                                            struct chunk *psChunk) {
+   struct bytes *psBytes, *psPacked, *psNew;
+   boolean bThawed;
+
+   assert(oStore != NULL);
+   assert(psChunk != NULL);
+
+   /* the only cost of tracking reads: a store the first time since
+      the last sweep */
+   if(!__atomic_load_n(&psChunk->iRead, __ATOMIC_RELAXED))
+      __atomic_store_n(&psChunk->iRead, 1, __ATOMIC_RELAXED);
+   psBytes = __atomic_load_n(&psChunk->psBytes, __ATOMIC_ACQUIRE);
+   if(psBytes != NULL)
+      return ChunkStore_data(psBytes);
+
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   psBytes = psChunk->psHot;
+   if(psBytes != NULL) {
+      ChunkStore_unlinkHot(oStore, psBytes);
+      ChunkStore_linkHot(oStore, psBytes);
+   }
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+   if(psBytes != NULL)
+      return ChunkStore_data(psBytes);
+
+   /* decompressed without the lock, so that other thaws go on; the
+      compressed bytes stay until the read ends even if they are
+      spilled meanwhile, and a chunk found spilled is for good */
+   psNew = malloc(sizeof(struct bytes) + psChunk->ulLength);
+   if(psNew == NULL)
+      return NULL;
+   psNew->ulLength = psChunk->ulLength;
+   psPacked = __atomic_load_n(&psChunk->psPacked, __ATOMIC_ACQUIRE);
+   if(psPacked != NULL) {
+      bThawed = Lz_decompress(ChunkStore_data(psPacked), psPacked->ulLength,
+                              ChunkStore_data(psNew), psChunk->ulLength);
+      /* only if the store itself is damaged */
+      assert(bThawed);
+   }
+   else
+      bThawed = ChunkStore_unspill(oStore, psChunk,
+                                   ChunkStore_data(psNew));
+   if(!bThawed) {
+      free(psNew);
+      return NULL;
+   }
+
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   /* another reader may have thawed the chunk meanwhile */
+   psBytes = psChunk->psHot;
+   if(psBytes == NULL)
+      ChunkStore_addHot(oStore, psNew, &psChunk->psHot);
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+   if(psBytes != NULL) {
+      free(psNew);
+      return ChunkStore_data(psBytes);
+   }
+   return ChunkStore_data(psNew);
+}
+
+/*
+  Returns a new reference to the chunk of psStripe of oStore holding
+  the ulLength bytes pucBytes, which hash to ulHash, or NULL if there
+  is none. The caller holds psStripe's lock, so that no chunk goes cold
+  or is spilled meanwhile.
+*/
+static struct chunk *ChunkStore_find(ChunkStore_T oStore,
+                                     struct stripe *psStripe,
+                                     const unsigned char *pucBytes,
+                                     size_t ulLength,
+                                     unsigned long ulHash) {
+   struct chunk *psChunk;
+
+   assert(oStore != NULL);
+   assert(psStripe != NULL);
+   assert(pucBytes != NULL);
+
+   for(psChunk = psStripe->ppsBuckets[(ulHash / STRIPES) &
+                                      (psStripe->ulBuckets - 1)];
+       psChunk != NULL; psChunk = psChunk->psNext) {
+      if(psChunk->ulHash == ulHash &&
+         ChunkStore_matches(oStore, psChunk, pucBytes, ulLength)) {
+         /* only dropped to 0 with the lock held, so it is not 0 */
+         (void) __atomic_add_fetch(&psChunk->ulRefs, 1,
+                                   __ATOMIC_RELAXED);
+         return psChunk;
+      }
+   }
+   return NULL;
+}
+
+/*
+  Returns a reference to the chunk of oStore holding the ulLength
+  bytes pucBytes, which hash to ulHash, adding one if there is none,
+  or returns NULL if memory could not be allocated.
+*/
+static struct chunk *ChunkStore_intern(ChunkStore_T oStore,
+                                       const unsigned char *pucBytes,
+                                       size_t ulLength,
+                                       unsigned long ulHash) {
+   struct stripe *psStripe;
+   struct chunk *psChunk, *psNew;
+   size_t ulIndex;
+
+   assert(oStore != NULL);
+   assert(pucBytes != NULL);
+
+   psStripe = &oStore->asStripes[ulHash & (STRIPES - 1)];
+   (void) pthread_mutex_lock(&psStripe->sLock);
+   psChunk = ChunkStore_find(oStore, psStripe, pucBytes, ulLength,
+                             ulHash);
+   (void) pthread_mutex_unlock(&psStripe->sLock);
+   if(psChunk != NULL)
+      return psChunk;
+
+   /* copied without the lock, which whole files would hold long */
+   psNew = malloc(sizeof(struct chunk));
+   if(psNew == NULL)
+      return NULL;
+   psNew->psBytes = malloc(sizeof(struct bytes) + ulLength);
+   if(psNew->psBytes == NULL) {
+      free(psNew);
+      return NULL;
+   }
+   psNew->ulHash = ulHash;
+   psNew->ulLength = ulLength;
+   psNew->ulRefs = 1;
+   psNew->psBytes->ulLength = ulLength;
+   psNew->psPacked = NULL;
+   psNew->ulPacked = 0;
+   psNew->ulSpilled = 0;
+   /* new bytes are about to be read, as if they had just been */
+   psNew->iRead = 1;
+   psNew->ulIdle = 0;
+   psNew->bStaysHot = FALSE;
+   psNew->psHot = NULL;
+   memcpy(ChunkStore_data(psNew->psBytes), pucBytes, ulLength);
+
+   (void) pthread_mutex_lock(&psStripe->sLock);
+   /* another thread may have added the same bytes meanwhile */
+   psChunk = ChunkStore_find(oStore, psStripe, pucBytes, ulLength,
+                             ulHash);
+   if(psChunk != NULL) {
+      (void) pthread_mutex_unlock(&psStripe->sLock);
+      free(psNew->psBytes);
+      free(psNew);
+      return psChunk;
+   }
+   psChunk = psNew;
+   ulIndex = (ulHash / STRIPES) & (psStripe->ulBuckets - 1);
+   psChunk->psNext = psStripe->ppsBuckets[ulIndex];
+   psStripe->ppsBuckets[ulIndex] = psChunk;
+   psStripe->ulCount++;
+   ChunkStore_account(oStore, sizeof(struct chunk) +
+                              sizeof(struct bytes) + ulLength);
+   if(psStripe->ulCount > psStripe->ulBuckets)
+      ChunkStore_grow(oStore, psStripe);
+   (void) pthread_mutex_unlock(&psStripe->sLock);
+   return psChunk;
+}
+
+/* Drops a reference to psChunk of oStore, and removes and frees it if
+   that was the last. */
+static void ChunkStore_drop(ChunkStore_T oStore, struct chunk *psChunk) {
+   struct stripe *psStripe;
+   struct chunk **ppsLink;
+   size_t ulRefs;
+
+   assert(oStore != NULL);
+   assert(psChunk != NULL);
+
+   /* references other than the last go without the lock */
+   ulRefs = __atomic_load_n(&psChunk->ulRefs, __ATOMIC_RELAXED);
+   while(ulRefs > 1) {
+      if(__atomic_compare_exchange_n(&psChunk->ulRefs, &ulRefs,
+                                     ulRefs - 1, FALSE, __ATOMIC_RELEASE,
+                                     __ATOMIC_RELAXED))
+         return;
+   }
+
+   psStripe = &oStore->asStripes[psChunk->ulHash & (STRIPES - 1)];
+   (void) pthread_mutex_lock(&psStripe->sLock);
+   /* another list may have found the chunk meanwhile */
+   if(__atomic_sub_fetch(&psChunk->ulRefs, 1, __ATOMIC_ACQ_REL) > 0) {
+      (void) pthread_mutex_unlock(&psStripe->sLock);
+      return;
+   }
+   ppsLink = &psStripe->ppsBuckets[(psChunk->ulHash / STRIPES) &
+                                   (psStripe->ulBuckets - 1)];
+   while(*ppsLink != psChunk)
+      ppsLink = &(*ppsLink)->psNext;
+   *ppsLink = psChunk->psNext;
+   psStripe->ulCount--;
+   (void) pthread_mutex_unlock(&psStripe->sLock);
+
+   /* no reader holds the chunk, so its bytes go at once */
+   if(psChunk->psBytes != NULL) {
+      ChunkStore_account(oStore, 0 - (sizeof(struct bytes) +
+                                      psChunk->ulLength));
+      free(psChunk->psBytes);
+   }
+   else {
+      ChunkStore_dropHot(oStore, &psChunk->psHot);
+      if(psChunk->psPacked != NULL) {
+         ChunkStore_account(oStore, 0 - (sizeof(struct bytes) +
+                                         psChunk->ulPacked));
+         free(psChunk->psPacked);
+      }
+      else
+         ChunkStore_freeSpill(oStore, psChunk->ulSpilled,
+                              psChunk->ulPacked);
+   }
+   ChunkStore_account(oStore, 0 - sizeof(struct chunk));
+   free(psChunk);
+}
+
+/*
+  If oStore has a budget and takes more memory than it, asks its
+  sweeping thread to spill at once, and waits for it to, so that
+  writers adding faster than it spills are held back.
+*/
+static void ChunkStore_relieve(ChunkStore_T oStore) {
+   unsigned long ulSweep;
+
+   assert(oStore != NULL);
+
+   if(oStore->oEpoch == NULL ||
+      ChunkStore_getSize(oStore) <=
+      __atomic_load_n(&oStore->ulBudget, __ATOMIC_RELAXED))
+      return;
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   oStore->bUrgent = TRUE;
+   (void) pthread_cond_signal(&oStore->sWake);
+   /* the next sweep to begin sees the request; one begun already
+      might have missed the contents that made it */
+   ulSweep = oStore->ulBegun + 1;
+   while((long) (oStore->ulDone - ulSweep) < 0 && !oStore->bStop)
+      (void) pthread_cond_wait(&oStore->sSwept, &oStore->sHotLock);
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+}
+
+/*
+  Adds the ulLength bytes pucBytes to oStore as one chunk if bWhole is
+  TRUE, or as chunks cut by ChunkStore_cut otherwise, and sets
+  *poLResult to a list of them, as ChunkStore_add.
+*/
+static int ChunkStore_build(ChunkStore_T oStore,
+                            const unsigned char *pucBytes,
+                            size_t ulLength, boolean bWhole,
+                            ChunkList_T *poLResult) {
+   ChunkList_T oList, oShrunk;
+   struct piece *psPieces;
+   struct chunk *psChunk;
+   size_t ulMost, ulOffset, ulCut, ulSize;
+
+   assert(oStore != NULL);
+   assert(pucBytes != NULL || ulLength == 0);
+   assert(poLResult != NULL);
+
+   *poLResult = NULL;
+   /* every chunk but the last has at least MIN_CHUNK bytes */
+   ulMost = bWhole ? 1 : ulLength / MIN_CHUNK + 1;
+   if(ulMost > ((size_t) -1 - sizeof(struct chunkList)) /
+      sizeof(struct piece))
+      return MEMORY_ERROR;
+   oList = malloc(sizeof(struct chunkList) +
+                  ulMost * sizeof(struct piece));
+   if(oList == NULL)
+      return MEMORY_ERROR;
+   oList->ulRefs = 1;
+   oList->oStore = oStore;
+   oList->ulLength = 0;
+   oList->ulCount = 0;
+   oList->pvFlat = NULL;
+   oList->psHot = NULL;
+   psPieces = (struct piece *) (oList + 1);
+
+   for(ulOffset = 0; ulOffset < ulLength; ulOffset += ulCut) {
+      ulCut = bWhole ? ulLength :
+              ChunkStore_cut(pucBytes + ulOffset, ulLength - ulOffset);
+      psChunk = ChunkStore_intern(oStore, pucBytes + ulOffset, ulCut,
+                                  ChunkStore_hash(pucBytes + ulOffset,
+                                                  ulCut));
+      if(psChunk == NULL) {
+         while(oList->ulCount > 0)
+            ChunkStore_drop(oStore, psPieces[--oList->ulCount].psChunk);
+         free(oList);
+         return MEMORY_ERROR;
+      }
+      psPieces[oList->ulCount].ulEnd = ulOffset + ulCut;
+      psPieces[oList->ulCount].psChunk = psChunk;
+      oList->ulCount++;
+   }
+   oList->ulLength = ulLength;
+
+   /* most chunks are longer than the least */
+   ulSize = sizeof(struct chunkList) +
+            oList->ulCount * sizeof(struct piece);
+   if(oList->ulCount < ulMost) {
+      oShrunk = realloc(oList, ulSize);
+      if(oShrunk != NULL)
+         oList = oShrunk;
+   }
+   (void) __atomic_add_fetch(&oStore->ulRefs, 1, __ATOMIC_RELAXED);
+   ChunkStore_account(oStore, ulSize);
+   ChunkStore_relieve(oStore);
+   *poLResult = oList;
+   return SUCCESS;
+}
+
+/*
+  Compresses the bytes of psChunk of oStore, to which the caller holds
+  a reference. If they shrink by an eighth or more, makes the chunk
+  cold, and adds its bytes to the list *ppsFreed, linked by psLess, to
+  be freed once no reader can be copying them; otherwise leaves it be
+  for good. Only the sweeping thread calls it.
+*/
+static void ChunkStore_freeze(ChunkStore_T oStore, struct chunk *psChunk,
+                              struct bytes **ppsFreed) {
+   struct stripe *psStripe;
+   struct bytes *psBytes, *psPacked, *psShrunk;
+   size_t ulRoom, ulPacked;
+
+   assert(oStore != NULL);
+   assert(psChunk != NULL);
+   assert(ppsFreed != NULL);
+
+   psBytes = psChunk->psBytes;
+   ulRoom = psChunk->ulLength - psChunk->ulLength / 8 - 1;
+   psPacked = malloc(sizeof(struct bytes) + ulRoom + 1);
+   if(psPacked == NULL)
+      /* tried again at the next sweep */
+      return;
+   ulPacked = Lz_compress(ChunkStore_data(psBytes), psChunk->ulLength,
+                          ChunkStore_data(psPacked), ulRoom);
+   if(ulPacked == 0) {
+      free(psPacked);
+      psChunk->bStaysHot = TRUE;
+      return;
+   }
+   psShrunk = realloc(psPacked, sizeof(struct bytes) + ulPacked);
+   if(psShrunk != NULL)
+      psPacked = psShrunk;
+   psPacked->ulLength = ulPacked;
+
+   psStripe = &oStore->asStripes[psChunk->ulHash & (STRIPES - 1)];
+   (void) pthread_mutex_lock(&psStripe->sLock);
+   psChunk->psPacked = psPacked;
+   psChunk->ulPacked = ulPacked;
+   /* a reader that finds no bytes finds the compressed ones */
+   __atomic_store_n(&psChunk->psBytes, NULL, __ATOMIC_RELEASE);
+   (void) pthread_mutex_unlock(&psStripe->sLock);
+
+   ChunkStore_account(oStore, ulPacked - psChunk->ulLength);
+   psBytes->psLess = *ppsFreed;
+   *ppsFreed = psBytes;
+}
+
+/*
+  Writes the bytes of psChunk of oStore, to which the caller holds a
+  reference, to the spill file, compressed if it is cold, and makes it
+  spilled, adding the bytes it held to the list *ppsFreed, as
+  ChunkStore_freeze. Returns TRUE, or FALSE if the file could not be
+  made or written, in which case the chunk is left be. Only the
+  sweeping thread calls it.
+*/
+static boolean ChunkStore_spillOne(ChunkStore_T oStore,
+                                   struct chunk *psChunk,
+                                   struct bytes **ppsFreed) {
+   struct stripe *psStripe;
+   struct bytes *psHeld;
+   size_t ulLength, ulOffset;
+
+   assert(oStore != NULL);
+   assert(psChunk != NULL);
+   assert(ppsFreed != NULL);
+
+   /* only this thread changes them */
+   psHeld = psChunk->psBytes != NULL ? psChunk->psBytes
+                                     : psChunk->psPacked;
+   ulLength = psHeld->ulLength;
+   if(!ChunkStore_allocSpill(oStore, ulLength, &ulOffset))
+      return FALSE;
+   if(!ChunkStore_transfer(oStore, ChunkStore_data(psHeld), ulLength,
+                           ulOffset, TRUE)) {
+      ChunkStore_freeSpill(oStore, ulOffset, ulLength);
+      return FALSE;
+   }
+
+   psStripe = &oStore->asStripes[psChunk->ulHash & (STRIPES - 1)];
+   (void) pthread_mutex_lock(&psStripe->sLock);
+   psChunk->ulSpilled = ulOffset;
+   psChunk->ulPacked = ulLength;
+   /* a reader that finds neither finds them spilled */
+   __atomic_store_n(&psChunk->psPacked, NULL, __ATOMIC_RELEASE);
+   __atomic_store_n(&psChunk->psBytes, NULL, __ATOMIC_RELEASE);
+   (void) pthread_mutex_unlock(&psStripe->sLock);
+
+   ChunkStore_account(oStore, 0 - (sizeof(struct bytes) + ulLength));
+   psHeld->psLess = *ppsFreed;
+   *ppsFreed = psHeld;
+   return TRUE;
+}
+
+/* Compares the chunks *pvA and *pvB by how long they have gone unread,
+   longest first, for qsort. */
+static int ChunkStore_compareIdle(const void *pvA, const void *pvB) {
+   const struct chunk *psA = *(struct chunk * const *) pvA;
+   const struct chunk *psB = *(struct chunk * const *) pvB;
+
+   if(psA->ulIdle != psB->ulIdle)
+      return psA->ulIdle > psB->ulIdle ? -1 : 1;
+   return 0;
+}
+
+/*
+  If oStore takes more memory than its budget, spills its chunks,
+  those gone unread longest first, and then if need be gives up its
+  hot buffers, until it takes an eighth less, adding the bytes the
+  chunks held to the list *ppsFreed, as ChunkStore_freeze. Only the
+  sweeping thread calls it.
+*/
+static void ChunkStore_spill(ChunkStore_T oStore,
+                             struct bytes **ppsFreed) {
+   struct stripe *psStripe;
+   struct chunk *psChunk;
+   struct chunk **ppsChunks;
+   size_t ulBudget, ulTarget, ulMost = 0, ulCount = 0, i, j;
+   boolean bWritten = TRUE;
+
+   assert(oStore != NULL);
+   assert(ppsFreed != NULL);
+
+   ulBudget = __atomic_load_n(&oStore->ulBudget, __ATOMIC_RELAXED);
+   if(ChunkStore_getSize(oStore) <= ulBudget)
+      return;
+   ulTarget = ulBudget - ulBudget / 8;
+   for(i = 0; i < STRIPES; i++)
+      ulMost += __atomic_load_n(&oStore->asStripes[i].ulCount,
+                                __ATOMIC_RELAXED);
+   ppsChunks = malloc((ulMost > 0 ? ulMost : 1) * sizeof(struct chunk *));
+   if(ppsChunks == NULL)
+      /* tried again at the next sweep */
+      return;
+
+   for(i = 0; i < STRIPES; i++) {
+      psStripe = &oStore->asStripes[i];
+      (void) pthread_mutex_lock(&psStripe->sLock);
+      for(j = 0; j < psStripe->ulBuckets && ulCount < ulMost; j++)
+         for(psChunk = psStripe->ppsBuckets[j];
+             psChunk != NULL && ulCount < ulMost;
+             psChunk = psChunk->psNext) {
+            if(psChunk->psBytes == NULL && psChunk->psPacked == NULL)
+               continue;
+            /* only dropped to 0 with the lock held, so it is not 0 */
+            (void) __atomic_add_fetch(&psChunk->ulRefs, 1,
+                                      __ATOMIC_RELAXED);
+            ppsChunks[ulCount++] = psChunk;
+         }
+      (void) pthread_mutex_unlock(&psStripe->sLock);
+   }
+
+   qsort(ppsChunks, ulCount, sizeof(struct chunk *),
+         ChunkStore_compareIdle);
+   for(i = 0; i < ulCount; i++) {
+      if(bWritten && ChunkStore_getSize(oStore) > ulTarget)
+         bWritten = ChunkStore_spillOne(oStore, ppsChunks[i], ppsFreed);
+      ChunkStore_drop(oStore, ppsChunks[i]);
+   }
+   free(ppsChunks);
+
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   while(ChunkStore_getSize(oStore) > ulTarget && oStore->psLeast != NULL)
+      ChunkStore_giveUp(oStore);
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+}
+
+/*
+  Clears the mark of every chunk of oStore read since the last sweep,
+  counting the sweeps the others have gone unread, if bTick is TRUE,
+  and compresses those not read through IDLE_SWEEPS sweeps in a row,
+  if bFreeze is TRUE too, outside the locks of the table; then spills
+  chunks if oStore is over its budget.
+*/
+static void ChunkStore_sweep(ChunkStore_T oStore, boolean bTick,
+                             boolean bFreeze) {
+   struct stripe *psStripe;
+   struct chunk *psChunk, *psIdle = NULL, *psNext;
+   struct bytes *psFreed = NULL;
+   size_t i, j;
+
+   assert(oStore != NULL);
+
+   for(i = 0; i < STRIPES && bTick; i++) {
+      psStripe = &oStore->asStripes[i];
+      (void) pthread_mutex_lock(&psStripe->sLock);
+      for(j = 0; j < psStripe->ulBuckets; j++)
+         for(psChunk = psStripe->ppsBuckets[j]; psChunk != NULL;
+             psChunk = psChunk->psNext) {
+            if(psChunk->psBytes == NULL && psChunk->psPacked == NULL)
+               continue;
+            if(__atomic_load_n(&psChunk->iRead, __ATOMIC_RELAXED)) {
+               __atomic_store_n(&psChunk->iRead, 0, __ATOMIC_RELAXED);
+               psChunk->ulIdle = 0;
+               continue;
+            }
+            if(psChunk->ulIdle + 1 != 0)
+               psChunk->ulIdle++;
+            if(!bFreeze || psChunk->psBytes == NULL ||
+               psChunk->bStaysHot || psChunk->ulIdle < IDLE_SWEEPS)
+               continue;
+            /* only dropped to 0 with the lock held, so it is not 0 */
+            (void) __atomic_add_fetch(&psChunk->ulRefs, 1,
+                                      __ATOMIC_RELAXED);
+            psChunk->psSweep = psIdle;
+            psIdle = psChunk;
+         }
+      (void) pthread_mutex_unlock(&psStripe->sLock);
+   }
+
+   for(psChunk = psIdle; psChunk != NULL; psChunk = psNext) {
+      psNext = psChunk->psSweep;
+      ChunkStore_freeze(oStore, psChunk, &psFreed);
+      ChunkStore_drop(oStore, psChunk);
+   }
+   ChunkStore_spill(oStore, &psFreed);
+   ChunkStore_flush(oStore, psFreed);
+}
+
+/*
+  Sweeps the store pvStore every ulPeriod milliseconds, and at once
+  when asked to spill, until told to stop. Takes and returns a void
+  pointer for pthread_create.
+*/
+static void *ChunkStore_sweeper(void *pvStore) {
+   ChunkStore_T oStore = pvStore;
+   struct timespec sDeadline;
+   int iWaited;
+   boolean bFreeze;
+
+   assert(oStore != NULL);
+
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   while(!oStore->bStop) {
+      iWaited = 0;
+      if(!oStore->bUrgent) {
+         (void) clock_gettime(CLOCK_REALTIME, &sDeadline);
+         sDeadline.tv_sec += (time_t) (oStore->ulPeriod / 1000);
+         sDeadline.tv_nsec += (long) (oStore->ulPeriod % 1000) *
+                              1000000L;
+         if(sDeadline.tv_nsec >= 1000000000L) {
+            sDeadline.tv_sec++;
+            sDeadline.tv_nsec -= 1000000000L;
+         }
+         iWaited = pthread_cond_timedwait(&oStore->sWake,
+                                          &oStore->sHotLock, &sDeadline);
+         /* woken early to stop, or with a new period to wait */
+         if(iWaited != ETIMEDOUT && !oStore->bUrgent)
+            continue;
+      }
+      /* a sweep only to spill leaves the count of sweeps unread be */
+      oStore->bUrgent = FALSE;
+      oStore->ulBegun++;
+      bFreeze = oStore->bFreeze;
+      (void) pthread_mutex_unlock(&oStore->sHotLock);
+      ChunkStore_sweep(oStore, iWaited == ETIMEDOUT, bFreeze);
+      (void) pthread_mutex_lock(&oStore->sHotLock);
+      oStore->ulDone++;
+      (void) pthread_cond_broadcast(&oStore->sSwept);
+   }
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+   return NULL;
+}
+
+/*--------------------------------------------------------------------*/
+
+unsigned long ChunkStore_hash(const void *pvBytes, size_t ulLength) {
+   enum { WORD = sizeof(unsigned long) };
+   const unsigned char *pucBytes = pvBytes;
+   unsigned long ulA, ulB, ulC, ulD;
+   unsigned long ulW0, ulW1, ulW2, ulW3;
+   size_t i;
+
+   assert(pvBytes != NULL || ulLength == 0);
+
+   /* four independent lanes, so that the multiplications overlap; a
+      lane mixes only upwards, which ChunkStore_mix undoes at the end */
+   ulA = ulLength;
+   ulB = 1;
+   ulC = 2;
+   ulD = 3;
+   for(i = 0; ulLength - i >= 4 * WORD; i += 4 * WORD) {
+      memcpy(&ulW0, pucBytes + i, WORD);
+      memcpy(&ulW1, pucBytes + i + WORD, WORD);
+      memcpy(&ulW2, pucBytes + i + 2 * WORD, WORD);
+      memcpy(&ulW3, pucBytes + i + 3 * WORD, WORD);
+      ulA = (ulA ^ ulW0) * 0x9E3779B1UL;
+      ulB = (ulB ^ ulW1) * 0x9E3779B1UL;
+      ulC = (ulC ^ ulW2) * 0x9E3779B1UL;
+      ulD = (ulD ^ ulW3) * 0x9E3779B1UL;
+   }
+   for(; ulLength - i >= WORD; i += WORD) {
+      memcpy(&ulW0, pucBytes + i, WORD);
+      ulA = ChunkStore_mix(ulA ^ ulW0);
+   }
+   if(i < ulLength) {
+      ulW0 = 0;
+      memcpy(&ulW0, pucBytes + i, ulLength - i);
+      ulB = ChunkStore_mix(ulB ^ ulW0);
+   }
+
+   ulA = ChunkStore_mix(ChunkStore_mix(ulA) ^ ulB);
+   ulA = ChunkStore_mix(ChunkStore_mix(ulA) ^ ulC);
+   ulA = ChunkStore_mix(ChunkStore_mix(ulA) ^ ulD);
+   return ulA & 0xFFFFFFFFUL;
+}
+
+int ChunkStore_new(ChunkStore_T *poSResult) {
+   ChunkStore_T oStore;
+   size_t i;
+
+   assert(poSResult != NULL);
+
+   (void) pthread_once(&sGearOnce, ChunkStore_makeGear);
+
+   *poSResult = NULL;
+   oStore = malloc(sizeof(struct chunkStore));
+   if(oStore == NULL)
+      return MEMORY_ERROR;
+   oStore->ulRefs = 1;
+   oStore->ulSize = sizeof(struct chunkStore);
+   oStore->oEpoch = NULL;
+   for(i = 0; i < STRIPES; i++) {
+      oStore->asStripes[i].ppsBuckets =
+         calloc(MIN_BUCKETS, sizeof(struct chunk *));
+      if(oStore->asStripes[i].ppsBuckets == NULL) {
+         while(i > 0) {
+            i--;
+            free(oStore->asStripes[i].ppsBuckets);
+            (void) pthread_mutex_destroy(&oStore->asStripes[i].sLock);
+         }
+         free(oStore);
+         return MEMORY_ERROR;
+      }
+      oStore->asStripes[i].ulBuckets = MIN_BUCKETS;
+      oStore->asStripes[i].ulCount = 0;
+      (void) pthread_mutex_init(&oStore->asStripes[i].sLock, NULL);
+      oStore->ulSize += MIN_BUCKETS * sizeof(struct chunk *);
+   }
+   *poSResult = oStore;
+   return SUCCESS;
+}
+
+void ChunkStore_release(ChunkStore_T oStore) {
+   struct bytes *psLimbo;
+   struct extent *psExtent;
+   size_t i;
+
+   if(oStore == NULL)
+      return;
+   if(__atomic_sub_fetch(&oStore->ulRefs, 1, __ATOMIC_ACQ_REL) > 0)
+      return;
+   if(oStore->oEpoch != NULL) {
+      (void) pthread_mutex_lock(&oStore->sHotLock);
+      oStore->bStop = TRUE;
+      (void) pthread_cond_signal(&oStore->sWake);
+      (void) pthread_mutex_unlock(&oStore->sHotLock);
+      (void) pthread_join(oStore->sSweeper, NULL);
+      /* no reader is left to wait for */
+      while(oStore->psLimbo != NULL) {
+         psLimbo = oStore->psLimbo;
+         oStore->psLimbo = psLimbo->psLess;
+         free(psLimbo);
+      }
+      assert(oStore->ulHot == 0);
+      /* every spilled chunk has given its part back, but parts there
+         was no memory to note are not joined up */
+      while(oStore->psExtents != NULL) {
+         psExtent = oStore->psExtents;
+         oStore->psExtents = psExtent->psNext;
+         free(psExtent);
+      }
+      if(oStore->iSpillFd >= 0)
+         (void) close(oStore->iSpillFd);
+      Epoch_free(oStore->oEpoch);
+      (void) pthread_cond_destroy(&oStore->sSwept);
+      (void) pthread_cond_destroy(&oStore->sWake);
+      (void) pthread_mutex_destroy(&oStore->sSpillLock);
+      (void) pthread_mutex_destroy(&oStore->sHotLock);
+      (void) pthread_mutex_destroy(&oStore->sFreeLock);
+   }
+   /* every list is gone, and every chunk with them */
+   for(i = 0; i < STRIPES; i++) {
+      assert(oStore->asStripes[i].ulCount == 0);
+      free(oStore->asStripes[i].ppsBuckets);
+      (void) pthread_mutex_destroy(&oStore->asStripes[i].sLock);
+   }
+   free(oStore);
+}
+
+int ChunkStore_add(ChunkStore_T oStore, const void *pvContents,
+                   size_t ulLength, ChunkList_T *poLResult) {
+   return ChunkStore_build(oStore, pvContents, ulLength, FALSE,
+                           poLResult);
+}
+
+int ChunkStore_addWhole(ChunkStore_T oStore, const void *pvContents,
+                        size_t ulLength, ChunkList_T *poLResult) {
+   return ChunkStore_build(oStore, pvContents, ulLength, TRUE,
+                           poLResult);
+}
+
+/*
+  Starts the sweeping thread of oStore, which has none, sweeping every
+  ulPeriod milliseconds, with ulHotBuffers hot buffers, neither
+  compressing nor spilling until told to. Returns SUCCESS, or
+  MEMORY_ERROR if it could not be started.
+*/
+static int ChunkStore_start(ChunkStore_T oStore, unsigned long ulPeriod,
+                            size_t ulHotBuffers) {
+   assert(oStore != NULL);
+   assert(oStore->oEpoch == NULL);
+
+   if(Epoch_new(&oStore->oEpoch) != SUCCESS)
+      return MEMORY_ERROR;
+   (void) pthread_mutex_init(&oStore->sFreeLock, NULL);
+   (void) pthread_mutex_init(&oStore->sHotLock, NULL);
+   (void) pthread_mutex_init(&oStore->sSpillLock, NULL);
+   (void) pthread_cond_init(&oStore->sWake, NULL);
+   (void) pthread_cond_init(&oStore->sSwept, NULL);
+   oStore->psMost = NULL;
+   oStore->psLeast = NULL;
+   oStore->ulHot = 0;
+   oStore->ulHotMost = ulHotBuffers;
+   oStore->psLimbo = NULL;
+   oStore->ulLimbo = 0;
+   oStore->ulPeriod = ulPeriod;
+   oStore->bFreeze = FALSE;
+   oStore->ulBudget = NO_BUDGET;
+   oStore->bStop = FALSE;
+   oStore->bUrgent = FALSE;
+   oStore->ulBegun = 0;
+   oStore->ulDone = 0;
+   oStore->iSpillFd = -1;
+   oStore->ulSpillEnd = 0;
+   oStore->psExtents = NULL;
+   if(pthread_create(&oStore->sSweeper, NULL, ChunkStore_sweeper,
+                     oStore) != 0) {
+      (void) pthread_cond_destroy(&oStore->sSwept);
+      (void) pthread_cond_destroy(&oStore->sWake);
+      (void) pthread_mutex_destroy(&oStore->sSpillLock);
+      (void) pthread_mutex_destroy(&oStore->sHotLock);
+      (void) pthread_mutex_destroy(&oStore->sFreeLock);
+      Epoch_free(oStore->oEpoch);
+      oStore->oEpoch = NULL;
+      return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+int ChunkStore_setCold(ChunkStore_T oStore, unsigned long ulIdleMillis,
+                       size_t ulHotBuffers) {
+   unsigned long ulPeriod;
+
+   assert(oStore != NULL);
+
+   ulPeriod = ulIdleMillis / IDLE_SWEEPS > 0 ?
+              ulIdleMillis / IDLE_SWEEPS : 1;
+   if(ulHotBuffers == 0)
+      ulHotBuffers = 1;
+   if(oStore->oEpoch == NULL &&
+      ChunkStore_start(oStore, ulPeriod, ulHotBuffers) != SUCCESS)
+      return MEMORY_ERROR;
+
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   oStore->ulPeriod = ulPeriod;
+   oStore->bFreeze = TRUE;
+   __atomic_store_n(&oStore->ulHotMost, ulHotBuffers, __ATOMIC_RELAXED);
+   (void) pthread_cond_signal(&oStore->sWake);
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+   return SUCCESS;
+}
+
+int ChunkStore_setBudget(ChunkStore_T oStore, size_t ulBudget,
+                         const char *pcDir) {
+   int iStatus = SUCCESS;
+
+   assert(oStore != NULL);
+
+   if(oStore->oEpoch == NULL &&
+      ChunkStore_start(oStore, SPILL_PERIOD, SPILL_HOT_BUFFERS) != SUCCESS)
+      return MEMORY_ERROR;
+
+   (void) pthread_mutex_lock(&oStore->sSpillLock);
+   if(pcDir != NULL && oStore->iSpillFd < 0)
+      iStatus = ChunkStore_makeSpill(oStore, pcDir);
+   (void) pthread_mutex_unlock(&oStore->sSpillLock);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   __atomic_store_n(&oStore->ulBudget, ulBudget, __ATOMIC_RELAXED);
+   /* a lower budget may be passed already */
+   oStore->bUrgent = TRUE;
+   (void) pthread_cond_signal(&oStore->sWake);
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+   return SUCCESS;
+}
+
+size_t ChunkStore_getSize(ChunkStore_T oStore) {
+   assert(oStore != NULL);
+
+   return __atomic_load_n(&oStore->ulSize, __ATOMIC_RELAXED);
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t ChunkList_getLength(ChunkList_T oList) {
+   assert(oList != NULL);
+
+   return oList->ulLength;
+}
+
+/* Returns the index of the first chunk of oList that ends past
+   ulOffset, which is within its contents. */
+static size_t ChunkList_find(ChunkList_T oList, size_t ulOffset) {
+   const struct piece *psPieces;
+   size_t ulLow, ulHigh, ulMid;
+
+   assert(oList != NULL);
+   assert(ulOffset < oList->ulLength);
+
+   psPieces = (const struct piece *) (oList + 1);
+   ulLow = 0;
+   ulHigh = oList->ulCount - 1;
+   while(ulLow < ulHigh) {
+      ulMid = ulLow + (ulHigh - ulLow) / 2;
+      if(psPieces[ulMid].ulEnd <= ulOffset)
+         ulLow = ulMid + 1;
+      else
+         ulHigh = ulMid;
+   }
+   return ulLow;
+}
+
+/*
+  Copies up to ulCount bytes of oList from offset ulOffset on to
+  pvDest, as ChunkList_read, but stops short if a cold chunk could not
+  be thawed. The caller is reading oList's store's bytes.
+*/
+static size_t ChunkList_copy(ChunkList_T oList, size_t ulOffset,
+                             void *pvDest, size_t ulCount) {
+   const struct piece *psPieces;
+   const unsigned char *pucBytes;
+   char *pcDest = pvDest;
+   size_t ulLow, ulStart, ulTake, ulDone;
+
+   assert(oList != NULL);
+   assert(pvDest != NULL || ulCount == 0);
+
+   if(ulOffset >= oList->ulLength)
+      return 0;
+   if(ulCount > oList->ulLength - ulOffset)
+      ulCount = oList->ulLength - ulOffset;
+   psPieces = (const struct piece *) (oList + 1);
+
+   for(ulDone = 0, ulLow = ChunkList_find(oList, ulOffset);
+       ulDone < ulCount; ulLow++) {
+      pucBytes = ChunkStore_open(oList->oStore, psPieces[ulLow].psChunk);
+      if(pucBytes == NULL)
+         return ulDone;
+      ulStart = psPieces[ulLow].ulEnd - psPieces[ulLow].psChunk->ulLength;
+      ulTake = psPieces[ulLow].ulEnd - (ulOffset + ulDone);
+      if(ulTake > ulCount - ulDone)
+         ulTake = ulCount - ulDone;
+      memcpy(pcDest + ulDone, pucBytes + (ulOffset + ulDone - ulStart),
+             ulTake);
+      ulDone += ulTake;
+   }
+   return ulCount;
+}
+
+size_t ChunkList_read(ChunkList_T oList, size_t ulOffset, void *pvDest,
+                      size_t ulCount) {
+   int iHow;
+   size_t ulRead;
+
+   assert(oList != NULL);
+
+   iHow = ChunkStore_beginRead(oList->oStore);
+   ulRead = ChunkList_copy(oList, ulOffset, pvDest, ulCount);
+   ChunkStore_endRead(oList->oStore, iHow);
+   return ulRead;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Returns TRUE if psChunk is spilled, as it is rather than compressed,
+   in which case it stays so while a reference to it is held. */
+static boolean ChunkStore_isSpilledWhole(struct chunk *psChunk) {
+   assert(psChunk != NULL);
+
+   /* compressed bytes are always fewer */
+   return __atomic_load_n(&psChunk->psBytes, __ATOMIC_ACQUIRE) == NULL &&
+          __atomic_load_n(&psChunk->psPacked, __ATOMIC_ACQUIRE) == NULL &&
+          psChunk->ulPacked == psChunk->ulLength;
+}
+
+int ChunkList_send(ChunkList_T oList, size_t ulOffset, size_t ulCount,
+                   int iFd, size_t *pulSent) {
+   struct iovec asVector[SEND_PIECES];
+   const struct piece *psPieces;
+   const unsigned char *pucBytes;
+   ChunkStore_T oStore;
+   struct chunk *psChunk;
+   size_t ulPiece, ulPieces, ulQueued, ulAt, ulStart, ulTake;
+   size_t ulSpilled, ulMore;
+   int iHow;
+   int iStatus = SUCCESS;
+   int iSent;
+
+   assert(oList != NULL);
+   assert(pulSent != NULL);
+
+   *pulSent = 0;
+   if(ulOffset >= oList->ulLength)
+      return SUCCESS;
+   if(ulCount > oList->ulLength - ulOffset)
+      ulCount = oList->ulLength - ulOffset;
+   oStore = oList->oStore;
+   psPieces = (const struct piece *) (oList + 1);
+   ulPiece = ChunkList_find(oList, ulOffset);
+
+   /* a batch of chunks at a time, so that frees wait on no more */
+   while(*pulSent < ulCount && iStatus == SUCCESS) {
+      iHow = ChunkStore_beginRead(oStore);
+      ulPieces = 0;
+      ulQueued = 0;
+      while(*pulSent + ulQueued < ulCount && ulPieces < SEND_PIECES) {
+         psChunk = psPieces[ulPiece].psChunk;
+         ulStart = psPieces[ulPiece].ulEnd - psChunk->ulLength;
+         ulAt = ulOffset + *pulSent + ulQueued;
+         ulTake = psPieces[ulPiece].ulEnd - ulAt;
+         if(ulTake > ulCount - *pulSent - ulQueued)
+            ulTake = ulCount - *pulSent - ulQueued;
+
+         /* chunks spilled as they are go from the file, uncopied, as
+            many at once as lie there in a row */
+         if(ChunkStore_isSpilledWhole(psChunk)) {
+            if(ulPieces > 0)
+               break;
+            ulSpilled = psChunk->ulSpilled + (ulAt - ulStart);
+            for(ulPiece++; ulTake < ulCount - *pulSent &&
+                ChunkStore_isSpilledWhole(psPieces[ulPiece].psChunk) &&
+                psPieces[ulPiece].psChunk->ulSpilled ==
+                ulSpilled + ulTake; ulPiece++) {
+               ulMore = psPieces[ulPiece].psChunk->ulLength;
+               if(ulMore > ulCount - *pulSent - ulTake)
+                  ulMore = ulCount - *pulSent - ulTake;
+               ulTake += ulMore;
+            }
+            iStatus = Send_file(iFd, oStore->iSpillFd, ulSpilled, ulTake,
+                                pulSent);
+            break;
+         }
+
+         pucBytes = ChunkStore_open(oStore, psChunk);
+         if(pucBytes == NULL) {
+            iStatus = MEMORY_ERROR;
+            break;
+         }
+         asVector[ulPieces].iov_base = (void *) (pucBytes +
+                                                 (ulAt - ulStart));
+         asVector[ulPieces].iov_len = ulTake;
+         ulPieces++;
+         ulQueued += ulTake;
+         ulPiece++;
+      }
+      /* what could be read is sent, even if the rest could not be */
+      iSent = Send_vector(iFd, asVector, ulPieces, pulSent);
+      if(iSent != SUCCESS)
+         iStatus = iSent;
+      ChunkStore_endRead(oStore, iHow);
+   }
+   return iStatus;
+}
+
+/* As ChunkList_getBytes, for a list of a store with a cold tier. */
+static void *ChunkList_getHot(ChunkList_T oList) {
+   ChunkStore_T oStore;
+   struct bytes *psBytes, *psNew;
+   void *pvBytes = NULL;
+   int iHow;
+
+   assert(oList != NULL);
+
+   oStore = oList->oStore;
+   iHow = ChunkStore_beginRead(oStore);
+   if(oList->ulCount == 1) {
+      pvBytes = (void *) ChunkStore_open(oStore,
+         ((struct piece *) (oList + 1))->psChunk);
+      ChunkStore_endRead(oStore, iHow);
+      return pvBytes;
+   }
+
+   (void) pthread_mutex_lock(&oStore->sHotLock);
+   psBytes = oList->psHot;
+   if(psBytes != NULL) {
+      ChunkStore_unlinkHot(oStore, psBytes);
+      ChunkStore_linkHot(oStore, psBytes);
+   }
+   (void) pthread_mutex_unlock(&oStore->sHotLock);
+
+   if(psBytes == NULL) {
+      psNew = malloc(sizeof(struct bytes) + oList->ulLength);
+      if(psNew != NULL &&
+         ChunkList_copy(oList, 0, ChunkStore_data(psNew),
+                        oList->ulLength) == oList->ulLength) {
+         psNew->ulLength = oList->ulLength;
+         (void) pthread_mutex_lock(&oStore->sHotLock);
+         /* another reader may have assembled the list meanwhile */
+         psBytes = oList->psHot;
+         if(psBytes == NULL) {
+            ChunkStore_addHot(oStore, psNew, &oList->psHot);
+            psBytes = psNew;
+            psNew = NULL;
+         }
+         (void) pthread_mutex_unlock(&oStore->sHotLock);
+      }
+      free(psNew);
+   }
+   if(psBytes != NULL)
+      pvBytes = ChunkStore_data(psBytes);
+   ChunkStore_endRead(oStore, iHow);
+   return pvBytes;
+}
+
+void *ChunkList_getBytes(ChunkList_T oList) {
+   void *pvFlat;
+   void *pvExpected = NULL;
+
+   assert(oList != NULL);
+
+   if(oList->oStore->oEpoch != NULL)
+      return ChunkList_getHot(oList);
+   /* a single chunk is in one piece already */
+   if(oList->ulCount == 1)
+      return ChunkStore_data(((struct piece *) (oList + 1))->psChunk->
+                             psBytes);
+   pvFlat = __atomic_load_n(&oList->pvFlat, __ATOMIC_ACQUIRE);
+   if(pvFlat != NULL)
+      return pvFlat;
+   pvFlat = malloc(oList->ulLength > 0 ? oList->ulLength : 1);
+   if(pvFlat == NULL)
+      return NULL;
+   (void) ChunkList_read(oList, 0, pvFlat, oList->ulLength);
+   /* readers racing to assemble keep the first copy published */
+   if(!__atomic_compare_exchange_n(&oList->pvFlat, &pvExpected, pvFlat,
+                                   FALSE, __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+      free(pvFlat);
+      return pvExpected;
+   }
+   ChunkStore_account(oList->oStore, oList->ulLength);
+   return pvFlat;
+}
+
+size_t ChunkList_getStored(ChunkList_T oList) {
+   const struct piece *psPieces;
+   const struct chunk *psChunk;
+   size_t ulStored = 0;
+   size_t i;
+
+   assert(oList != NULL);
+
+   psPieces = (const struct piece *) (oList + 1);
+   for(i = 0; i < oList->ulCount; i++) {
+      psChunk = psPieces[i].psChunk;
+      if(__atomic_load_n(&psChunk->psBytes, __ATOMIC_ACQUIRE) != NULL)
+         ulStored += psChunk->ulLength /
+                     __atomic_load_n(&psChunk->ulRefs, __ATOMIC_RELAXED);
+      /* spilled chunks take no memory */
+      else if(__atomic_load_n(&psChunk->psPacked, __ATOMIC_ACQUIRE) !=
+              NULL)
+         ulStored += psChunk->ulPacked /
+                     __atomic_load_n(&psChunk->ulRefs, __ATOMIC_RELAXED);
+   }
+   return ulStored / __atomic_load_n(&oList->ulRefs, __ATOMIC_RELAXED);
+}
+
+void ChunkList_retain(ChunkList_T oList) {
+   assert(oList != NULL);
+
+   (void) __atomic_add_fetch(&oList->ulRefs, 1, __ATOMIC_RELAXED);
+}
+
+void ChunkList_release(ChunkList_T oList) {
+   ChunkStore_T oStore;
+   const struct piece *psPieces;
+   size_t i;
+
+   if(oList == NULL)
+      return;
+   if(__atomic_sub_fetch(&oList->ulRefs, 1, __ATOMIC_ACQ_REL) > 0)
+      return;
+   oStore = oList->oStore;
+   psPieces = (const struct piece *) (oList + 1);
+   ChunkStore_dropHot(oStore, &oList->psHot);
+   for(i = 0; i < oList->ulCount; i++)
+      ChunkStore_drop(oStore, psPieces[i].psChunk);
+   if(oList->pvFlat != NULL) {
+      ChunkStore_account(oStore, 0 - oList->ulLength);
+      free(oList->pvFlat);
+   }
+   ChunkStore_account(oStore, 0 - (sizeof(struct chunkList) +
+                                   oList->ulCount *
+                                   sizeof(struct piece)));
+   free(oList);
+   ChunkStore_release(oStore);
+}
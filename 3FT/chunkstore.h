@@ -0,0 +1,181 @@
+/*--------------------------------------------------------------------*/
+/* chunkstore.h                                                       */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef CHUNKSTORE_INCLUDED
+#define CHUNKSTORE_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A ChunkStore_T keeps the contents of files as chunks, each unique
+  sequence of bytes once, so that files that are largely the same
+  share most of their memory. Contents are cut where a rolling hash of
+  the last few bytes matches a pattern, rather than at fixed offsets,
+  so that bytes inserted or removed in one copy only change the chunks
+  around them, and the rest still match. Chunks are 2 KiB to 64 KiB,
+  about 10 KiB on average.
+
+  With a cold tier (see ChunkStore_setCold), chunks no one reads for a
+  while are compressed, and read through a few hot buffers. With a
+  budget (see ChunkStore_setBudget), those read least recently are
+  written out to a spill file once the store outgrows it, and read
+  back the same way.
+
+  The functions may be called concurrently from multiple threads, and
+  references to stores, lists and chunks taken and dropped from any.
+*/
+typedef struct chunkStore *ChunkStore_T;
+
+/*
+  A ChunkList_T is the contents of one file as a sequence of chunks of
+  a store, which never changes once made, and which holds a reference
+  to each chunk and to the store.
+*/
+typedef struct chunkList *ChunkList_T;
+
+/*
+  Creates an empty store holding a single reference. Returns SUCCESS
+  and sets *poSResult to it if successful. Otherwise, sets *poSResult
+  to NULL and returns MEMORY_ERROR.
+*/
+int ChunkStore_new(ChunkStore_T *poSResult);
+
+/* Drops a reference to oStore, and frees it once the last one is
+   gone. Does nothing if oStore is NULL. */
+void ChunkStore_release(ChunkStore_T oStore);
+
+/*
+  Cuts the ulLength bytes pvContents, which stay the caller's, into
+  chunks, adds those oStore lacks and references the rest. Returns
+  SUCCESS and sets *poLResult to a list of them holding a single
+  reference, or sets it to NULL and returns MEMORY_ERROR.
+*/
+int ChunkStore_add(ChunkStore_T oStore, const void *pvContents,
+                   size_t ulLength, ChunkList_T *poLResult);
+
+/*
+  As ChunkStore_add, but keeps the contents as a single chunk, so that
+  only files the same throughout share them, at the cost of one pass
+  of ChunkStore_hash over them.
+*/
+int ChunkStore_addWhole(ChunkStore_T oStore, const void *pvContents,
+                        size_t ulLength, ChunkList_T *poLResult);
+
+/*
+  Returns the hash a store files the ulLength bytes pvBytes under: a
+  fast one, reading a word at a time, of no use against an adversary,
+  so that matching chunks are always compared byte for byte.
+*/
+unsigned long ChunkStore_hash(const void *pvBytes, size_t ulLength);
+
+/*
+  Returns the number of bytes of memory the contents oList holds take,
+  compressed for cold chunks and none for spilled ones, divided among
+  the lists that use the same chunks and the holders of the references
+  to oList, so that the sum over every holder of every list of a store
+  comes to about the size of its chunks. Read while other threads
+  change the store, it is an estimate.
+*/
+size_t ChunkList_getStored(ChunkList_T oList);
+
+/*
+  Gives oStore a cold tier, or retunes the one it has. A thread of the
+  store's own sweeps it every quarter of ulIdleMillis milliseconds,
+  and compresses, with the codec of lz.h, the chunks that no read has
+  touched through four sweeps in a row, those that shrink by an eighth
+  or more; the others are left be for good. Reads of a cold chunk
+  decompress it into a hot buffer, kept for the reads that follow
+  until ulHotBuffers (at least 1) others have been used since, the
+  least recently used being given up first, so that a cold chunk only
+  ever takes the memory of its compressed bytes and perhaps one
+  buffer. Tracking reads costs each at most one relaxed atomic store
+  per chunk, the first time since a sweep. The first call must come
+  before any contents are added to oStore, unless
+  ChunkStore_setBudget came first. Returns SUCCESS, or MEMORY_ERROR if
+  the tier could not be started.
+*/
+int ChunkStore_setCold(ChunkStore_T oStore, unsigned long ulIdleMillis,
+                       size_t ulHotBuffers);
+
+/*
+  Gives oStore a budget of ulBudget bytes, or changes the one it has,
+  starting the thread ChunkStore_setCold does if it has none, which
+  then sweeps every second. Whenever the store's size passes the
+  budget, the thread writes chunks out to a spill file, those through
+  the most sweeps unread first, compressed if they are cold and as
+  they are otherwise, until the size is an eighth below it, keeping
+  only where they lie; adding contents that pass it waits for that.
+  Spilled chunks are read back into hot buffers, as cold ones are
+  decompressed, and stay spilled until they are dropped, which gives
+  their part of the file back to later spills. The file is made in
+  the directory pcDir, now, if it is not NULL and the store has none
+  yet, and otherwise at the first spill, in $TMPDIR or /tmp; it is
+  unlinked at once, and never outlives the store or the process. The
+  store's size counts only memory, and chunks that fail to spill stay
+  in it. The first call must come before any contents are added to
+  oStore, unless ChunkStore_setCold came first. Returns SUCCESS,
+  MEMORY_ERROR if the thread could not be started, or IO_ERROR (from
+  ft.h) if the file could not be made in pcDir, in which case errno
+  tells why and the budget is left as it was.
+*/
+int ChunkStore_setBudget(ChunkStore_T oStore, size_t ulBudget,
+                         const char *pcDir);
+
+/*
+  Returns the number of bytes oStore has allocated for its chunks,
+  compressed or not, but not spilled, their lists, its hot buffers and
+  its table of chunks.
+*/
+size_t ChunkStore_getSize(ChunkStore_T oStore);
+
+/* Returns the number of bytes of contents oList holds. */
+size_t ChunkList_getLength(ChunkList_T oList);
+
+/*
+  Copies up to ulCount bytes of oList from offset ulOffset on to
+  pvDest, chunk by chunk, and returns how many were copied, fewer than
+  ulCount only at the end of the contents, or if memory to decompress
+  a cold chunk could not be allocated, or a spilled one could not be
+  read back.
+*/
+size_t ChunkList_read(ChunkList_T oList, size_t ulOffset, void *pvDest,
+                      size_t ulCount);
+
+/*
+  Writes up to ulCount bytes of oList from offset ulOffset on to the
+  file descriptor iFd, as Send_vector of send.h does, gathering the
+  chunks in memory rather than assembling them, and sending those
+  spilled as they are straight from the spill file, as Send_file
+  does, and sets *pulSent to how many were written, fewer than ulCount
+  only at the end of the contents or on failure. Returns SUCCESS,
+  IO_ERROR if a write failed, in which case errno tells why, or
+  MEMORY_ERROR if a cold chunk could not be decompressed or a spilled
+  one read back. Frees of the store's bytes wait on the writes of at
+  most a few chunks at a time.
+*/
+int ChunkList_send(ChunkList_T oList, size_t ulOffset, size_t ulCount,
+                   int iFd, size_t *pulSent);
+
+/*
+  Returns the bytes of oList in one piece: those of its chunk if it
+  has only one, or else assembled the first time, after which they are
+  kept with the list until it is freed, or NULL if memory could not be
+  allocated. They are shared, and must not be changed. With a cold
+  tier or a budget, they are assembled in a hot buffer instead, as are
+  those of a cold or spilled chunk, which is also NULL if it could not
+  be read back, and stay valid only until the buffer is given up, or
+  for a chunk in memory, until it goes cold or is spilled.
+*/
+void *ChunkList_getBytes(ChunkList_T oList);
+
+/* Takes another reference to oList. */
+void ChunkList_retain(ChunkList_T oList);
+
+/* Drops a reference to oList, and frees it once the last one is gone,
+   dropping its chunks. Does nothing if oList is NULL. */
+void ChunkList_release(ChunkList_T oList);
+
+#endif
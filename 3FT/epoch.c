@@ -0,0 +1,301 @@
+/*--------------------------------------------------------------------*/
+/* epoch.c                                                            */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <assert.h>
+#include <sched.h>
+#include <pthread.h>
+#include "epoch.h"
+
+/* Number of pending objects that triggers an attempt to reclaim */
+enum { RECLAIM_BATCH = 64 };
+
+/* A thread's participation in a domain */
+struct record {
+   /* the global epoch the thread saw when its section began */
+   unsigned long ulEpoch;
+   /* nonzero while the thread is inside a read-side section */
+   int iActive;
+   /* depth of the thread's nested sections */
+   size_t ulNesting;
+   /* nonzero while a live thread owns this record */
+   int iInUse;
+   /* the next record of the domain */
+   struct record *psNext;
+};
+
+/* An object waiting to be freed */
+struct retired {
+   /* the function that frees it */
+   void (*pfFree)(void *);
+   /* the object */
+   void *pvObject;
+   /* the global epoch when it was retired */
+   unsigned long ulEpoch;
+   /* the object retired after this one */
+   struct retired *psNext;
+};
+
+/* An epoch-based reclamation domain */
+struct epoch {
+   /* the global epoch, which only moves forward */
+   unsigned long ulGlobal;
+   /* every record ever registered; the list only grows */
+   struct record *psRecords;
+   /* maps each registered thread to its record */
+   pthread_key_t sKey;
+   /* guards registration and the pending list */
+   pthread_mutex_t sMutex;
+   /* the pending objects, oldest first */
+   struct retired *psOldest;
+   struct retired *psNewest;
+   /* the number of pending objects since the last reclamation */
+   size_t ulPending;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Releases the record pvRecord of an exiting thread for reuse. */
+static void Epoch_releaseRecord(void *pvRecord) {
+   struct record *psRecord = pvRecord;
+
+   assert(psRecord != NULL);
+
+   __atomic_store_n(&psRecord->iActive, 0, __ATOMIC_RELEASE);
+   __atomic_store_n(&psRecord->iInUse, 0, __ATOMIC_RELEASE);
+}
+
+/*
+  Advances oEpoch's global epoch if every thread inside a section has
+  seen its current value. Returns TRUE if it advanced. The caller
+  holds oEpoch's mutex.
+*/
+static boolean Epoch_tryAdvance(Epoch_T oEpoch) {
+   struct record *psRecord;
+   unsigned long ulGlobal;
+
+   assert(oEpoch != NULL);
+
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   ulGlobal = __atomic_load_n(&oEpoch->ulGlobal, __ATOMIC_RELAXED);
+   for(psRecord = oEpoch->psRecords; psRecord != NULL;
+       psRecord = psRecord->psNext)
+      if(__atomic_load_n(&psRecord->iActive, __ATOMIC_ACQUIRE) &&
+         __atomic_load_n(&psRecord->ulEpoch, __ATOMIC_ACQUIRE) !=
+         ulGlobal)
+         return FALSE;
+
+   __atomic_store_n(&oEpoch->ulGlobal, ulGlobal + 1, __ATOMIC_SEQ_CST);
+   return TRUE;
+}
+
+/*
+  Detaches and returns the oldest pending objects of oEpoch that are
+  safe to free: those retired at least two epochs ago. The caller
+  holds oEpoch's mutex.
+*/
+static struct retired *Epoch_takeReclaimable(Epoch_T oEpoch) {
+   struct retired *psFirst = oEpoch->psOldest;
+   struct retired *psLast = NULL;
+   struct retired *psCurr;
+
+   assert(oEpoch != NULL);
+
+   for(psCurr = oEpoch->psOldest; psCurr != NULL &&
+       psCurr->ulEpoch + 2 <= oEpoch->ulGlobal; psCurr = psCurr->psNext)
+      psLast = psCurr;
+
+   if(psLast == NULL)
+      return NULL;
+
+   oEpoch->psOldest = psLast->psNext;
+   if(oEpoch->psOldest == NULL)
+      oEpoch->psNewest = NULL;
+   psLast->psNext = NULL;
+   return psFirst;
+}
+
+/* Frees every object in the list psList, and the list itself. */
+static void Epoch_freeList(struct retired *psList) {
+   struct retired *psNext;
+
+   while(psList != NULL) {
+      psNext = psList->psNext;
+      (*psList->pfFree)(psList->pvObject);
+      free(psList);
+      psList = psNext;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+void Epoch_synchronize(Epoch_T oEpoch) {
+   unsigned long ulTarget;
+
+   assert(oEpoch != NULL);
+
+   (void) pthread_mutex_lock(&oEpoch->sMutex);
+   ulTarget = oEpoch->ulGlobal + 2;
+   while(oEpoch->ulGlobal < ulTarget) {
+      if(!Epoch_tryAdvance(oEpoch)) {
+         (void) pthread_mutex_unlock(&oEpoch->sMutex);
+         (void) sched_yield();
+         (void) pthread_mutex_lock(&oEpoch->sMutex);
+      }
+   }
+   (void) pthread_mutex_unlock(&oEpoch->sMutex);
+}
+
+/*--------------------------------------------------------------------*/
+
+int Epoch_new(Epoch_T *poEResult) {
+   Epoch_T oEpoch;
+
+   assert(poEResult != NULL);
+
+   oEpoch = calloc(1, sizeof(struct epoch));
+   if(oEpoch == NULL) {
+      *poEResult = NULL;
+      return MEMORY_ERROR;
+   }
+   if(pthread_key_create(&oEpoch->sKey, Epoch_releaseRecord) != 0) {
+      free(oEpoch);
+      *poEResult = NULL;
+      return MEMORY_ERROR;
+   }
+   if(pthread_mutex_init(&oEpoch->sMutex, NULL) != 0) {
+      (void) pthread_key_delete(oEpoch->sKey);
+      free(oEpoch);
+      *poEResult = NULL;
+      return MEMORY_ERROR;
+   }
+
+   *poEResult = oEpoch;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void Epoch_free(Epoch_T oEpoch) {
+   struct record *psRecord;
+   struct record *psNext;
+
+   if(oEpoch == NULL)
+      return;
+
+   Epoch_freeList(oEpoch->psOldest);
+   for(psRecord = oEpoch->psRecords; psRecord != NULL;
+       psRecord = psNext) {
+      psNext = psRecord->psNext;
+      free(psRecord);
+   }
+   (void) pthread_key_delete(oEpoch->sKey);
+   (void) pthread_mutex_destroy(&oEpoch->sMutex);
+   free(oEpoch);
+}
+
+/*--------------------------------------------------------------------*/
+
+int Epoch_enter(Epoch_T oEpoch) {
+   struct record *psRecord;
+
+   assert(oEpoch != NULL);
+
+   psRecord = pthread_getspecific(oEpoch->sKey);
+   if(psRecord == NULL) {
+      /* first section of this thread: reuse the record of an exited
+         thread if there is one */
+      (void) pthread_mutex_lock(&oEpoch->sMutex);
+      for(psRecord = oEpoch->psRecords; psRecord != NULL;
+          psRecord = psRecord->psNext)
+         if(!__atomic_load_n(&psRecord->iInUse, __ATOMIC_ACQUIRE))
+            break;
+      if(psRecord == NULL) {
+         psRecord = calloc(1, sizeof(struct record));
+         if(psRecord == NULL) {
+            (void) pthread_mutex_unlock(&oEpoch->sMutex);
+            return MEMORY_ERROR;
+         }
+         psRecord->psNext = oEpoch->psRecords;
+         __atomic_store_n(&oEpoch->psRecords, psRecord,
+                          __ATOMIC_RELEASE);
+      }
+      psRecord->iInUse = 1;
+      psRecord->ulNesting = 0;
+      (void) pthread_mutex_unlock(&oEpoch->sMutex);
+      if(pthread_setspecific(oEpoch->sKey, psRecord) != 0) {
+         Epoch_releaseRecord(psRecord);
+         return MEMORY_ERROR;
+      }
+   }
+
+   if(psRecord->ulNesting++ > 0)
+      return SUCCESS;
+
+   __atomic_store_n(&psRecord->ulEpoch,
+                    __atomic_load_n(&oEpoch->ulGlobal, __ATOMIC_RELAXED),
+                    __ATOMIC_RELAXED);
+   __atomic_store_n(&psRecord->iActive, 1, __ATOMIC_RELAXED);
+   /* the reads of the section must not be reordered before the
+      announcement that it is running */
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void Epoch_leave(Epoch_T oEpoch) {
+   struct record *psRecord;
+
+   assert(oEpoch != NULL);
+
+   psRecord = pthread_getspecific(oEpoch->sKey);
+   assert(psRecord != NULL);
+   assert(psRecord->ulNesting > 0);
+
+   if(--psRecord->ulNesting == 0)
+      __atomic_store_n(&psRecord->iActive, 0, __ATOMIC_RELEASE);
+}
+
+/*--------------------------------------------------------------------*/
+
+void Epoch_retire(Epoch_T oEpoch, void (*pfFree)(void *pvObject),
+                  void *pvObject) {
+   struct retired *psRetired;
+   struct retired *psReclaimable = NULL;
+
+   assert(oEpoch != NULL);
+   assert(pfFree != NULL);
+
+   psRetired = malloc(sizeof(struct retired));
+   if(psRetired == NULL) {
+      /* no room to defer it, so wait out the readers instead */
+      Epoch_synchronize(oEpoch);
+      (*pfFree)(pvObject);
+      return;
+   }
+   psRetired->pfFree = pfFree;
+   psRetired->pvObject = pvObject;
+   psRetired->psNext = NULL;
+
+   (void) pthread_mutex_lock(&oEpoch->sMutex);
+   psRetired->ulEpoch = oEpoch->ulGlobal;
+   if(oEpoch->psNewest == NULL)
+      oEpoch->psOldest = psRetired;
+   else
+      oEpoch->psNewest->psNext = psRetired;
+   oEpoch->psNewest = psRetired;
+
+   if(++oEpoch->ulPending >= RECLAIM_BATCH) {
+      (void) Epoch_tryAdvance(oEpoch);
+      psReclaimable = Epoch_takeReclaimable(oEpoch);
+      oEpoch->ulPending = 0;
+   }
+   (void) pthread_mutex_unlock(&oEpoch->sMutex);
+
+   Epoch_freeList(psReclaimable);
+}
@@ -0,0 +1,63 @@
+/*--------------------------------------------------------------------*/
+/* epoch.h                                                            */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef EPOCH_INCLUDED
+#define EPOCH_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  An Epoch_T is an epoch-based reclamation domain. Readers bracket
+  their lock-free accesses to shared objects with Epoch_enter and
+  Epoch_leave; writers unlink an object so no new reader can reach it
+  and then hand it to Epoch_retire, which frees it only once every
+  reader that might still hold a reference has left.
+*/
+typedef struct epoch *Epoch_T;
+
+/*
+  Creates a new reclamation domain. Returns SUCCESS and sets
+  *poEResult to the new domain if successful. Otherwise, sets
+  *poEResult to NULL and returns MEMORY_ERROR.
+*/
+int Epoch_new(Epoch_T *poEResult);
+
+/*
+  Frees every object still waiting in oEpoch, then oEpoch itself.
+  No thread may be inside a read-side section of oEpoch or use it
+  afterwards. Does nothing if oEpoch is NULL.
+*/
+void Epoch_free(Epoch_T oEpoch);
+
+/*
+  Begins a read-side section of the calling thread in oEpoch, during
+  which objects it reaches are not freed. Sections may nest. Returns
+  SUCCESS, or MEMORY_ERROR if the thread could not be registered, in
+  which case the section was not begun.
+*/
+int Epoch_enter(Epoch_T oEpoch);
+
+/* Ends the innermost read-side section of the calling thread. */
+void Epoch_leave(Epoch_T oEpoch);
+
+/*
+  Arranges for (*pfFree)(pvObject) to be called once no read-side
+  section that began before this call is still running. pvObject must
+  already be unreachable for readers beginning a section from now on.
+  The caller must not be inside a read-side section of oEpoch.
+*/
+void Epoch_retire(Epoch_T oEpoch, void (*pfFree)(void *pvObject),
+                  void *pvObject);
+
+/*
+  Waits until every read-side section of oEpoch that was running when
+  called has ended, for a writer that frees objects itself rather
+  than retiring them one by one. The caller must not be inside one
+  itself.
+*/
+void Epoch_synchronize(Epoch_T oEpoch);
+
+#endif
@@ -3,118 +3,426 @@
 /* Author: Isaac Gyamfi and Ndongo Njie                               */
 /*--------------------------------------------------------------------*/
 
+#define _GNU_SOURCE
+
 #include <stddef.h>
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "dynarray.h"
 #include "path.h"
+#include "epoch.h"
+#include "pattern.h"
+#include "nameindex.h"
+#include "sizeindex.h"
+#include "image.h"
+#include "wal.h"
+#include "import.h"
+#include "tar.h"
+#include "arena.h"
+#include "chunkstore.h"
 #include "nodeFT.h"
 #include "ft.h"
 
 
 /*
   A File Tree is a representation of a hierarchy of directories and Files,
-  represented as an AO with 3 state variables:
+  represented as an object holding its root node along with the options
+  it was created with and the structures those options keep beside it.
+*/
+struct ft {
+    /* a flag for being in an initialized state (TRUE) or not (FALSE) */
+    boolean bIsInitialized;
+    /* a pointer to the root node in the hierarchy */
+    Node_T oNRoot;
+
+    /* TRUE if the tree was created with FT_THREADSAFE or
+       FT_FINEGRAINED */
+    boolean bThreadSafe;
+    /* TRUE if the tree was created with FT_FINEGRAINED or
+       FT_LOCKFREEREADS */
+    boolean bFineGrained;
+    /* TRUE if the tree was created with FT_LOCKFREEREADS */
+    boolean bLockFreeReads;
+    /* TRUE if the tree is a snapshot, which never changes */
+    boolean bReadOnly;
+    /* TRUE once a snapshot has been taken of the tree, after which its
+       nodes may be shared with the snapshot: a mutation whose path
+       crosses a shared node then holds the lock exclusively and copies
+       the shared nodes on its path before changing anything */
+    boolean bShared;
+    /* the number of mutations holding the lock shared, which found
+       nothing shared on their paths and so copy nothing; 0 whenever
+       the lock is held exclusively */
+    size_t ulLatchedUpdates;
+    /* with bLockFreeReads, the domain that defers freeing unlinked
+       nodes and child arrays until no reader can hold them; NULL
+       otherwise */
+    Epoch_T oEpoch;
+    /* with FT_NAMEINDEX, the path of every node indexed by its name,
+       changed along with the nodes while the latch or lock that
+       orders the change is held; NULL otherwise */
+    NameIndex_T oNameIndex;
+    /* with FT_SIZEINDEX, the path of every file in order of size,
+       kept up to date the same way; NULL otherwise */
+    SizeIndex_T oSizeIndex;
+    /* with FT_openLogged, the log each change is appended to while the
+       latch or lock that orders it is held, and made durable before
+       the call that made it returns; NULL otherwise */
+    Wal_T oWal;
+    /* with oWal, the path the files of the log and its checkpoint
+       image are named after, and the generation of the log */
+    char *pcBase;
+    unsigned long ulGeneration;
+    /* the arena that FT_importTar with FT_TARARENA keeps the contents
+       it reads in, shared with every snapshot of the tree, or NULL
+       until one needs it */
+    Arena_T oArena;
+    /* with FT_CHUNKED, FT_DEDUP, FT_COLD or FT_SPILL, the store the
+       contents of files are kept in; NULL otherwise */
+    ChunkStore_T oChunkStore;
+    /* with FT_DEDUP, FT_COLD or FT_SPILL but not FT_CHUNKED, TRUE:
+       files are kept whole in oChunkStore rather than cut into
+       chunks */
+    boolean bWholeFiles;
+    /* with FT_COLD, TRUE: oChunkStore has a cold tier */
+    boolean bColdTier;
+    /* with FT_SPILL, TRUE: oChunkStore has a budget */
+    boolean bSpill;
+    /* with oWal, held by whoever is checkpointing the tree */
+    pthread_mutex_t sCheckpointLock;
+    /* when bThreadSafe is TRUE, held shared by readers and exclusively
+       by mutators; with bFineGrained, mutators also hold it shared
+       unless they create or remove the root, and the node latches
+       order everything else. With bLockFreeReads, lookups take neither
+       the lock nor any latch. Unused otherwise */
+    pthread_rwlock_t sLock;
+};
+
+/* How long contents must go unread to go cold in a tree made with
+   FT_COLD, in milliseconds, and how many hot buffers the tree keeps
+   them in while they are read, until FT_setColdIn says otherwise */
+enum { COLD_IDLE_MILLIS = 60000, COLD_HOT_BUFFERS = 8 };
+
+/* The tree operated on by the FT_ functions that take no FT_T */
+static struct ft sDefaultTree;
+
+/*--------------------------------------------------------------------*/
+
+/* Acquires oFTree's lock for reading if oFTree is thread-safe. */
+static void FT_lockShared(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    if(oFTree->bThreadSafe)
+        (void) pthread_rwlock_rdlock(&oFTree->sLock);
+}
+
+/* Acquires oFTree's lock for writing if oFTree is thread-safe. */
+static void FT_lockExclusive(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    if(oFTree->bThreadSafe)
+        (void) pthread_rwlock_wrlock(&oFTree->sLock);
+}
+
+/* Releases oFTree's lock if oFTree is thread-safe. */
+static void FT_unlock(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    if(oFTree->bThreadSafe)
+        (void) pthread_rwlock_unlock(&oFTree->sLock);
+}
+
+static boolean FT_isPathShared(FT_T oFTree, const char *pcPath);
+
+/*
+  Acquires oFTree's lock for an operation that changes the tree at
+  pcPath: exclusively, unless oFTree is fine-grained, bStructural is
+  FALSE, no snapshot shares the nodes on the way to pcPath and oFTree
+  is not logged, in which case the node latches take over and the lock
+  is shared. The caller releases it with FT_unlockForUpdate.
+  bStructural must be TRUE if the operation may create or remove the
+  root.
+  A logged tree orders all its changes by the lock, since changes
+  latched apart, such as an insertion below a directory being
+  removed, could reach the log in another order than they took
+  effect; the wait for the log to be synced, which is what costs,
+  happens after the lock is released.
+*/
+static void FT_lockForUpdate(FT_T oFTree, boolean bStructural,
+                             const char *pcPath) {
+    assert(oFTree != NULL);
+
+    if(oFTree->bFineGrained && !bStructural && oFTree->oWal == NULL) {
+        FT_lockShared(oFTree);
+        /* only set, and nodes only shared, with the lock held
+           exclusively, so neither changes until it is released */
+        if(!oFTree->bShared || !FT_isPathShared(oFTree, pcPath)) {
+            (void) __atomic_add_fetch(&oFTree->ulLatchedUpdates, 1,
+                                      __ATOMIC_RELAXED);
+            return;
+        }
+        FT_unlock(oFTree);
+    }
+    FT_lockExclusive(oFTree);
+}
+
+/* Releases oFTree's lock, acquired by FT_lockForUpdate. */
+static void FT_unlockForUpdate(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    /* the count is 0 if the lock is held exclusively, and counts the
+       caller otherwise */
+    if(__atomic_load_n(&oFTree->ulLatchedUpdates, __ATOMIC_RELAXED) != 0)
+        (void) __atomic_sub_fetch(&oFTree->ulLatchedUpdates, 1,
+                                  __ATOMIC_RELAXED);
+    FT_unlock(oFTree);
+}
+
+/*
+  Returns TRUE if a mutation of oFTree must copy the nodes a snapshot
+  shares on its path before changing anything: unless it holds the
+  lock shared, having found none there.
+*/
+static boolean FT_mustUnshare(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    return oFTree->bShared &&
+           __atomic_load_n(&oFTree->ulLatchedUpdates,
+                           __ATOMIC_RELAXED) == 0;
+}
+
+/*
+  Returns TRUE if an operation on oFTree that changes the tree (if
+  bForUpdate is TRUE) or only looks at it (otherwise) uses node
+  latches: in a fine-grained tree, unless it is a lookup and lookups
+  are lock-free.
+*/
+static boolean FT_latches(FT_T oFTree, boolean bForUpdate) {
+    assert(oFTree != NULL);
+
+    return oFTree->bFineGrained && (bForUpdate || !oFTree->bLockFreeReads);
+}
+
+/* Latches oNNode for reading if the operation uses latches. */
+static void FT_latchShared(FT_T oFTree, boolean bForUpdate,
+                           Node_T oNNode) {
+    assert(oFTree != NULL);
+
+    if(FT_latches(oFTree, bForUpdate) && oNNode != NULL)
+        Node_latchShared(oNNode);
+}
+
+/* Latches oNNode for writing if the operation uses latches. */
+static void FT_latchExclusive(FT_T oFTree, boolean bForUpdate,
+                              Node_T oNNode) {
+    assert(oFTree != NULL);
+
+    if(FT_latches(oFTree, bForUpdate) && oNNode != NULL)
+        Node_latchExclusive(oNNode);
+}
+
+/* Releases oNNode's latch if the operation uses latches. */
+static void FT_unlatch(FT_T oFTree, boolean bForUpdate, Node_T oNNode) {
+    assert(oFTree != NULL);
+
+    if(FT_latches(oFTree, bForUpdate) && oNNode != NULL)
+        Node_unlatch(oNNode);
+}
+
+/* Returns oFTree's root, which lock-free lookups may read while a
+   writer replaces it. */
+static Node_T FT_getRoot(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    return __atomic_load_n(&oFTree->oNRoot, __ATOMIC_ACQUIRE);
+}
+
+/* Makes oNRoot oFTree's root, complete with everything below it. */
+static void FT_setRoot(FT_T oFTree, Node_T oNRoot) {
+    assert(oFTree != NULL);
+
+    __atomic_store_n(&oFTree->oNRoot, oNRoot, __ATOMIC_RELEASE);
+}
+
+/*
+  Makes the nodes of oFTree on the way to absolute path oPPath, down
+  to depth ulDepth or the deepest one that exists, safe to change by
+  copying those that a snapshot shares, starting with the root.
+  Returns SUCCESS, or MEMORY_ERROR, in which case the tree is
+  unchanged but some of the nodes may have been copied already. The
+  caller holds oFTree's lock exclusively.
+*/
+static int FT_unsharePath(FT_T oFTree, Path_T oPPath, size_t ulDepth) {
+    int iStatus;
+    Node_T oNCurr;
+    Node_T oNChild = NULL;
+    size_t i;
+
+    assert(oFTree != NULL);
+    assert(oPPath != NULL);
+
+    oNCurr = FT_getRoot(oFTree);
+    if(oNCurr == NULL || ulDepth == 0)
+        return SUCCESS;
+
+    if(Node_isShared(oNCurr)) {
+        iStatus = Node_copy(oNCurr, NULL, &oNChild);
+        if(iStatus != SUCCESS)
+            return iStatus;
+        FT_setRoot(oFTree, oNChild);
+        Node_release(oNCurr, oFTree->oEpoch);
+        oNCurr = oNChild;
+    }
+
+    for(i = 1; i < ulDepth; i++) {
+        iStatus = Node_lookupChild(oNCurr, Path_getComponent(oPPath, i),
+                                   &oNChild);
+        if(iStatus != SUCCESS)
+            /* everything further down will be new */
+            return SUCCESS;
+        iStatus = Node_unshareChild(oNCurr, oNChild, oFTree->oEpoch,
+                                    &oNCurr);
+        if(iStatus != SUCCESS)
+            return iStatus;
+    }
+    return SUCCESS;
+}
+
+/*
+  Returns TRUE if FT_unsharePath would copy anything on the way to
+  absolute path pcPath in oFTree, walking it hand-over-hand with
+  shared latches, or if pcPath could not be parsed, which errs on the
+  side of locking. The caller holds oFTree's lock shared.
 */
+static boolean FT_isPathShared(FT_T oFTree, const char *pcPath) {
+    Path_T oPPath;
+    Node_T oNCurr;
+    Node_T oNChild = NULL;
+    boolean bShared;
+    size_t i;
+
+    assert(oFTree != NULL);
+
+    if(pcPath == NULL || Path_new(pcPath, &oPPath) != SUCCESS)
+        return TRUE;
+    oNCurr = FT_getRoot(oFTree);
+    if(oNCurr == NULL) {
+        Path_free(oPPath);
+        return FALSE;
+    }
 
-/* 1. a flag for being in an initialized state (TRUE) or not (FALSE) */
-static boolean bIsInitialized;
-/* 2. a pointer to the root node in the hierarchy */
-static Node_T oNRoot;
-/* 3. a counter of the number of nodes in the hierarchy */
-static size_t ulCount;
+    Node_latchShared(oNCurr);
+    bShared = Node_isShared(oNCurr);
+    for(i = 1; i < Path_getDepth(oPPath) && !bShared; i++) {
+        if(Node_lookupChild(oNCurr, Path_getComponent(oPPath, i),
+                            &oNChild) != SUCCESS)
+            break;
+        bShared = Node_isChildShared(oNCurr, oNChild);
+        Node_latchShared(oNChild);
+        Node_unlatch(oNCurr);
+        oNCurr = oNChild;
+    }
+    Node_unlatch(oNCurr);
+    Path_free(oPPath);
+    return bShared;
+}
 
 /*
   Traverses the FT starting at the root as far as possible towards
   absolute path oPPath. If able to traverse, returns an int SUCCESS
   status and sets *poNFurthest to the furthest node reached (which may
-  be only a prefix of oPPath, or even NULL if the root is NULL).
-  Otherwise, sets *poNFurthest to NULL and returns with status:
+  be only a prefix of oPPath, or even NULL if the root is NULL) and
+  *pulDepth to its depth. Otherwise, sets *poNFurthest to NULL and
+  returns with status:
   * CONFLICTING_PATH if the root's path is not a prefix of oPPath
-  * MEMORY_ERROR if memory could not be allocated to complete request
+
+  In a fine-grained tree the walk is hand-over-hand: a node's latch is
+  taken before its parent's is dropped, so no node on the way can be
+  removed underneath it. On SUCCESS the furthest node is left latched,
+  exclusively if bForUpdate is TRUE and shared otherwise, and the
+  caller must FT_unlatch it. Its parent stays latched while an
+  exclusive latch replaces the shared one, so it cannot be removed in
+  between; the children are then checked again, since another writer
+  may have extended the path meanwhile. A lock-free lookup latches
+  nothing; the caller's epoch section keeps the nodes it passes alive.
 */
-static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
+static int FT_traversePath(FT_T oFTree, Path_T oPPath,
+                           boolean bForUpdate, Node_T *poNFurthest,
+                           size_t *pulDepth) {
     int iStatus;
-    Path_T oPPrefix = NULL;
+    Node_T oNParent = NULL;
     Node_T oNCurr;
     Node_T oNChild = NULL;
+    boolean bCurrExclusive = FALSE;
     size_t ulDepth;
     size_t i;
-    size_t ulChildID;
 
+    assert(oFTree != NULL);
     assert(oPPath != NULL);
     assert(poNFurthest != NULL);
+    assert(pulDepth != NULL);
 
+    *pulDepth = 0;
+    oNCurr = FT_getRoot(oFTree);
     /* root is NULL -> won't find anything */
-    if(oNRoot == NULL) {
+    if(oNCurr == NULL) {
         *poNFurthest = NULL;
         return SUCCESS; /*just changed this*/
     }
 
-    iStatus = Path_prefix(oPPath, 1, &oPPrefix);
-    if(iStatus != SUCCESS) {
-        *poNFurthest = NULL;
-        return iStatus;
-    }
-
-    if(Path_comparePath(Node_getPath(oNRoot), oPPrefix)) {
-        Path_free(oPPrefix);
+    if(strcmp(Node_getName(oNCurr), Path_getComponent(oPPath, 0))) {
         *poNFurthest = NULL;
         return CONFLICTING_PATH;
     }
-    Path_free(oPPrefix);
-    oPPrefix = NULL;
 
-    oNCurr = oNRoot;
+    /* the tree lock keeps the root itself from being removed */
+    FT_latchShared(oFTree, bForUpdate, oNCurr);
     ulDepth = Path_getDepth(oPPath);
-    for(i = 2; i <= ulDepth; i++) {
-        iStatus = Path_prefix(oPPath, i, &oPPrefix);
-        if(iStatus != SUCCESS) {
-            *poNFurthest = NULL;
-            return iStatus;
-        }
-        if(Node_hasDirChild(oNCurr, oPPrefix, &ulChildID)) {
-            /* go to that child and continue with next prefix */
-            Path_free(oPPrefix);
-            oPPrefix = NULL;
-            iStatus = Node_getChild(oNCurr, ulChildID, FALSE, &oNChild);
-            if (iStatus == SUCCESS) {
-                 oNCurr = oNChild;
-            }
-            /*Not found as a directory, check if it is a file*/
-            else{
-                *poNFurthest = NULL;
-                return iStatus;
-            }  
+    i = 1;
+    while(i < ulDepth) {
+        iStatus = Node_lookupChild(oNCurr, Path_getComponent(oPPath, i),
+                                   &oNChild);
+        if(iStatus != SUCCESS &&
+           bForUpdate && oFTree->bFineGrained && !bCurrExclusive) {
+            /* this is as far as we can go, but it has to be latched
+               exclusively for the caller and then checked again */
+            FT_unlatch(oFTree, bForUpdate, oNCurr);
+            FT_latchExclusive(oFTree, bForUpdate, oNCurr);
+            bCurrExclusive = TRUE;
+            continue;
         }
-
-        else if(Node_hasFileChild(oNCurr, oPPrefix, &ulChildID)) {
-            /* go to that child and continue with next prefix */
-            Path_free(oPPrefix);
-            oPPrefix = NULL;
-            iStatus = Node_getChild(oNCurr, ulChildID, TRUE, &oNChild);
-            if (iStatus == SUCCESS) {
-                 oNCurr = oNChild;
-            }
-            /*If it was not success */
-            else{
-                *poNFurthest = NULL;
-                return iStatus;
-            }  
-        }
-        
-        else {
-            /* oNCurr doesn't have child with path oPPrefix:
+        else if(iStatus != SUCCESS) {
+            /* oNCurr doesn't have a child with that name:
             this is as far as we can go */
             break;
         }
+
+        /* go to that child and continue with next component */
+        FT_latchShared(oFTree, bForUpdate, oNChild);
+        FT_unlatch(oFTree, bForUpdate, oNParent);
+        oNParent = oNCurr;
+        oNCurr = oNChild;
+        bCurrExclusive = FALSE;
+        i++;
+    }
+
+    if(bForUpdate && oFTree->bFineGrained && !bCurrExclusive) {
+        FT_unlatch(oFTree, bForUpdate, oNCurr);
+        FT_latchExclusive(oFTree, bForUpdate, oNCurr);
     }
+    FT_unlatch(oFTree, bForUpdate, oNParent);
 
-    Path_free(oPPrefix);
     *poNFurthest = oNCurr;
+    *pulDepth = i;
     return SUCCESS;
 }
 
@@ -127,17 +435,22 @@ static int FT_traversePath(Path_T oPPath, Node_T *poNFurthest) {
   * CONFLICTING_PATH if the root's path is not a prefix of pcPath
   * NO_SUCH_PATH if no node with pcPath exists in the hierarchy
   * MEMORY_ERROR if memory could not be allocated to complete request
+  On SUCCESS the node is latched as by FT_traversePath with
+  bForUpdate, and the caller must FT_unlatch it.
  */
 
-static int FT_findNode(const char *pcPath, Node_T *poNResult) {
+static int FT_findNode(FT_T oFTree, const char *pcPath,
+                       boolean bForUpdate, Node_T *poNResult) {
     Path_T oPPath = NULL;
     Node_T oNFound = NULL;
+    size_t ulFoundDepth;
     int iStatus;
 
+    assert(oFTree != NULL);
     assert(pcPath != NULL);
     assert(poNResult != NULL);
 
-    if(!bIsInitialized) {
+    if(!oFTree->bIsInitialized) {
         *poNResult = NULL;
         return INITIALIZATION_ERROR;
     }
@@ -150,7 +463,8 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult) {
         return iStatus;
     }
 
-    iStatus = FT_traversePath(oPPath, &oNFound);
+    iStatus = FT_traversePath(oFTree, oPPath, bForUpdate, &oNFound,
+                              &ulFoundDepth);
     if(iStatus != SUCCESS)
     {
         Path_free(oPPath);
@@ -164,7 +478,8 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult) {
         return NO_SUCH_PATH;
     }
 
-    if(Path_comparePath(Node_getPath(oNFound), oPPath) != 0) {
+    if(ulFoundDepth != Path_getDepth(oPPath)) {
+        FT_unlatch(oFTree, bForUpdate, oNFound);
         Path_free(oPPath);
         *poNResult = NULL;
         return NO_SUCH_PATH;
@@ -174,372 +489,922 @@ static int FT_findNode(const char *pcPath, Node_T *poNResult) {
     *poNResult = oNFound;
     return SUCCESS;
 }
-/*--------------------------------------------------------------------*/
 
-int FT_insertDir(const char *pcPath){
-    int iStatus;
-   Path_T oPPath = NULL;
-   Node_T oNFirstNew = NULL;
-   Node_T oNCurr = NULL;
-   size_t ulDepth, ulIndex;
-   size_t ulNewNodes = 0;
+/*
+  A path written out one component at a time during a walk of a
+  tree. Nodes only know their own names, so the path of each node
+  visited is that of its parent followed by the name.
+*/
+struct pathBuffer {
+    /* the path of the node visited last, NUL-terminated */
+    char *pcPath;
+    /* the number of characters in pcPath */
+    size_t ulLength;
+    /* the number of characters pcPath has room for */
+    size_t ulCapacity;
+};
 
-   assert(pcPath != NULL);
+/*
+  Starts psBuffer with the first ulLength characters of pcStart.
+  Returns TRUE, or FALSE if memory could not be allocated. The caller
+  frees psBuffer->pcPath.
+*/
+static boolean FT_pathStart(struct pathBuffer *psBuffer,
+                            const char *pcStart, size_t ulLength) {
+   assert(psBuffer != NULL);
+   assert(pcStart != NULL);
 
-   /* validate pcPath and generate a Path_T for it */
-   if(!bIsInitialized)
-      return INITIALIZATION_ERROR;
+   psBuffer->ulCapacity = 2 * ulLength + 64;
+   psBuffer->pcPath = malloc(psBuffer->ulCapacity);
+   if(psBuffer->pcPath == NULL)
+      return FALSE;
+   memcpy(psBuffer->pcPath, pcStart, ulLength);
+   psBuffer->pcPath[ulLength] = '\0';
+   psBuffer->ulLength = ulLength;
+   return TRUE;
+}
 
-   iStatus = Path_new(pcPath, &oPPath);
-   if(iStatus != SUCCESS)
-      return iStatus;
+/*
+  Appends the component pcName to the path in psBuffer, which may be
+  empty. Returns TRUE, or FALSE if memory could not be allocated, in
+  which case the path is unchanged.
+*/
+static boolean FT_pathAppend(struct pathBuffer *psBuffer,
+                             const char *pcName) {
+   size_t ulNameLength;
+   size_t ulNewCapacity;
+   char *pcNew;
 
-   /* find the closest ancestor of oPPath already in the tree */
-   iStatus= FT_traversePath(oPPath, &oNCurr);
-   if(iStatus != SUCCESS)
-   {
-      Path_free(oPPath);
-      return iStatus;
-   }
+   assert(psBuffer != NULL);
+   assert(pcName != NULL);
 
-   /* no ancestor node found, so if root is not NULL,
-      pcPath isn't underneath root. */
-   if(oNCurr == NULL && oNRoot != NULL) {
-      Path_free(oPPath);
-      return CONFLICTING_PATH;
+   /* room for the separator, the name and the terminator */
+   ulNameLength = strlen(pcName);
+   if(psBuffer->ulLength + ulNameLength + 2 > psBuffer->ulCapacity) {
+      ulNewCapacity = 2 * psBuffer->ulCapacity + ulNameLength + 2;
+      pcNew = realloc(psBuffer->pcPath, ulNewCapacity);
+      if(pcNew == NULL)
+         return FALSE;
+      psBuffer->pcPath = pcNew;
+      psBuffer->ulCapacity = ulNewCapacity;
    }
+   if(psBuffer->ulLength != 0)
+      psBuffer->pcPath[psBuffer->ulLength++] = '/';
+   memcpy(psBuffer->pcPath + psBuffer->ulLength, pcName,
+          ulNameLength + 1);
+   psBuffer->ulLength += ulNameLength;
+   return TRUE;
+}
 
-   /* Make sure ancestor is not a file */
-   if (oNCurr != NULL && Node_isFileNode(oNCurr)) {
-        Path_free(oPPath);
-        return NOT_A_DIRECTORY;
-   }
+/* Cuts the path in psBuffer back to its first ulLength characters. */
+static void FT_pathTruncate(struct pathBuffer *psBuffer, size_t ulLength) {
+   assert(psBuffer != NULL);
+   assert(ulLength <= psBuffer->ulLength);
 
-   ulDepth = Path_getDepth(oPPath);
-   if(oNCurr == NULL) /* new root! */
-      ulIndex = 1;
-   else {
-      ulIndex = Path_getDepth(Node_getPath(oNCurr))+1;
+   psBuffer->ulLength = ulLength;
+   psBuffer->pcPath[ulLength] = '\0';
+}
 
-      /* oNCurr is the node we're trying to insert */
-      if(ulIndex == ulDepth+1 && !Path_comparePath(oPPath,
-                                       Node_getPath(oNCurr))) {
-         Path_free(oPPath);
-         return ALREADY_IN_TREE;
-      }
+/*
+  The state of a walk that calls a function with the path of every
+  node of a subtree, parents before their children.
+*/
+struct pathWalk {
+    /* the path of the node visited last */
+    struct pathBuffer sPath;
+    /* TRUE once a path could not be written */
+    boolean bFailed;
+    /* the function to call and its last argument */
+    void (*pfVisit)(const char *pcPath, Node_T oNNode, void *pvExtra);
+    void *pvExtra;
+};
+
+/* Visits n, a child of the directory whose path is recorded in the
+   path walk pvWalk, and then everything below n. */
+static void FT_pathVisit(Node_T n, void *pvWalk) {
+   struct pathWalk *psWalk = pvWalk;
+   size_t ulParentLength;
+
+   assert(psWalk != NULL);
+
+   if(psWalk->bFailed)
+      return;
+   ulParentLength = psWalk->sPath.ulLength;
+   if(!FT_pathAppend(&psWalk->sPath, Node_getName(n))) {
+      psWalk->bFailed = TRUE;
+      return;
    }
+   (*psWalk->pfVisit)(psWalk->sPath.pcPath, n, psWalk->pvExtra);
+   if(!Node_isFileNode(n)) {
+      Node_mapChildren(n, TRUE, FT_pathVisit, pvWalk);
+      Node_mapChildren(n, FALSE, FT_pathVisit, pvWalk);
+   }
+   FT_pathTruncate(&psWalk->sPath, ulParentLength);
+}
 
-   /* starting at oNCurr, build rest of the path one level at a time */
-   while(ulIndex <= ulDepth) {
-      Path_T oPPrefix = NULL;
-      Node_T oNNewNode = NULL;
+/*
+  Calls (*pfVisit)(pcPath, oNVisited, pvExtra) for oNNode, whose
+  parent's path is the first ulParentLength characters of pcParent,
+  and every node below it. Returns SUCCESS, or MEMORY_ERROR if some
+  path could not be written, in which case the walk stopped there.
+*/
+static int FT_walkPaths(Node_T oNNode, const char *pcParent,
+                        size_t ulParentLength,
+                        void (*pfVisit)(const char *pcPath,
+                                        Node_T oNVisited,
+                                        void *pvExtra),
+                        void *pvExtra) {
+   struct pathWalk sWalk;
 
-      /* generate a Path_T for this level */
-      iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
-      if(iStatus != SUCCESS) {
-         Path_free(oPPath);
-         if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew);
-         return iStatus;
-      }
+   assert(oNNode != NULL);
+   assert(pcParent != NULL);
+   assert(pfVisit != NULL);
 
-      /* insert the new node for this level */
-      iStatus = Node_new(oPPrefix, oNCurr, FALSE, NULL, 0, &oNNewNode);
-      if(iStatus != SUCCESS) {
-         Path_free(oPPath);
-         Path_free(oPPrefix);
-         if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew);
-         return iStatus;
-      }
+   if(!FT_pathStart(&sWalk.sPath, pcParent, ulParentLength))
+      return MEMORY_ERROR;
+   sWalk.bFailed = FALSE;
+   sWalk.pfVisit = pfVisit;
+   sWalk.pvExtra = pvExtra;
+   FT_pathVisit(oNNode, &sWalk);
+   free(sWalk.sPath.pcPath);
 
-      /* set up for next level */
-      Path_free(oPPrefix);
-      oNCurr = oNNewNode;
-      ulNewNodes++;
-      if(oNFirstNew == NULL)
-         oNFirstNew = oNCurr;
-      ulIndex++;
-   }
-   Path_free(oPPath);
-   /* update DT state variables to reflect insertion */
-   if(oNRoot == NULL)
-      oNRoot = oNFirstNew;
-   ulCount += ulNewNodes;
+   if(sWalk.bFailed)
+      return MEMORY_ERROR;
    return SUCCESS;
 }
 
-/*--------------------------------------------------------------------*/
+/* Returns TRUE if oFTree keeps a name or size index. */
+static boolean FT_hasIndex(FT_T oFTree) {
+   assert(oFTree != NULL);
 
-boolean FT_containsDir(const char *pcPath){
-    Node_T oNFound = NULL;
-    int iStatus;
+   return oFTree->oNameIndex != NULL || oFTree->oSizeIndex != NULL;
+}
 
-    assert(pcPath != NULL);
+/* Gives up on every index of oFTree. */
+static void FT_abandonIndexes(FT_T oFTree) {
+   assert(oFTree != NULL);
 
-    if (!bIsInitialized || pcPath == NULL) {
-        return FALSE;
-    }
+   if(oFTree->oNameIndex != NULL)
+      NameIndex_abandon(oFTree->oNameIndex);
+   if(oFTree->oSizeIndex != NULL)
+      SizeIndex_abandon(oFTree->oSizeIndex);
+}
 
-    iStatus = FT_findNode(pcPath, &oNFound);
-    if (iStatus != SUCCESS){
-        return FALSE;
-    }
-    if (Node_isFileNode(oNFound) == FALSE) {
-        return TRUE;
-    }
-    else return FALSE;
+/* Adds pcPath, the path of oNNode, to the indexes of the tree
+   pvTree. */
+static void FT_indexAdd(const char *pcPath, Node_T oNNode,
+                        void *pvTree) {
+   FT_T oFTree = pvTree;
 
+   assert(oFTree != NULL);
+
+   if(oFTree->oNameIndex != NULL)
+      NameIndex_add(oFTree->oNameIndex, pcPath, Node_isFileNode(oNNode));
+   if(oFTree->oSizeIndex != NULL && Node_isFileNode(oNNode))
+      SizeIndex_add(oFTree->oSizeIndex, pcPath, Node_getFileSize(oNNode));
 }
 
-/*--------------------------------------------------------------------*/
+/* Removes pcPath, the path of oNNode, from the indexes of the tree
+   pvTree. */
+static void FT_indexRemove(const char *pcPath, Node_T oNNode,
+                           void *pvTree) {
+   FT_T oFTree = pvTree;
 
-int FT_rmDir(const char *pcPath){
-    int iStatus;
-    Node_T oNFound = NULL;
+   assert(oFTree != NULL);
 
-   assert(pcPath != NULL);
+   if(oFTree->oNameIndex != NULL)
+      NameIndex_remove(oFTree->oNameIndex, pcPath);
+   if(oFTree->oSizeIndex != NULL && Node_isFileNode(oNNode))
+      SizeIndex_remove(oFTree->oSizeIndex, pcPath,
+                       Node_getFileSize(oNNode));
+}
+
+/*
+  Adds the subtree rooted at oNNode, whose absolute path is oPPath, to
+  oFTree's indexes if bAdd is TRUE, or removes it otherwise. Does
+  nothing if oFTree has no index. The caller holds whatever orders
+  changes to the subtree's paths.
+*/
+static void FT_indexSubtree(FT_T oFTree, Node_T oNNode, Path_T oPPath,
+                            boolean bAdd) {
+   const char *pcPath;
+   size_t ulParentLength;
+
+   assert(oFTree != NULL);
+   assert(oNNode != NULL);
+   assert(oPPath != NULL);
+
+   if(!FT_hasIndex(oFTree))
+      return;
+   pcPath = Path_getPathname(oPPath);
+   ulParentLength = Path_getStrLength(oPPath) -
+                    strlen(Path_getComponent(oPPath,
+                                             Path_getDepth(oPPath) - 1));
+   /* without the separator, if there is a parent */
+   if(ulParentLength != 0)
+      ulParentLength--;
+   if(FT_walkPaths(oNNode, pcPath, ulParentLength,
+                   bAdd ? FT_indexAdd : FT_indexRemove,
+                   oFTree) != SUCCESS)
+      FT_abandonIndexes(oFTree);
+}
+
+/*
+  Adds to oFTree's indexes the paths of the nodes an insertion of
+  oPPath created, those at depth ulFirst and below; the deepest is a
+  file of size ulLength if bIsFile is TRUE. Does nothing if oFTree has
+  no index.
+*/
+static void FT_indexInsertion(FT_T oFTree, Path_T oPPath, size_t ulFirst,
+                              boolean bIsFile, size_t ulLength) {
+   char *pcPath;
+   size_t ulDepth;
+   size_t ulPrefixLength = 0;
+   size_t i;
+   char c;
 
-   iStatus = FT_findNode(pcPath, &oNFound);
+   assert(oFTree != NULL);
+   assert(oPPath != NULL);
 
-   if(!bIsInitialized){
-    return INITIALIZATION_ERROR;
+   if(oFTree->oSizeIndex != NULL && bIsFile)
+      SizeIndex_add(oFTree->oSizeIndex, Path_getPathname(oPPath),
+                    ulLength);
+   if(oFTree->oNameIndex == NULL)
+      return;
+   pcPath = malloc(Path_getStrLength(oPPath) + 1);
+   if(pcPath == NULL) {
+      NameIndex_abandon(oFTree->oNameIndex);
+      return;
    }
-    
-   if(iStatus != SUCCESS) {
-        return iStatus;
-    }
-   
-    if (Node_isFileNode(oNFound)) {
-        return NOT_A_DIRECTORY;
-    }
+   strcpy(pcPath, Path_getPathname(oPPath));
 
-   ulCount -= Node_free(oNFound);
-   if(ulCount == 0)
-      oNRoot = NULL;
+   /* cut the path short after each new component in turn */
+   ulDepth = Path_getDepth(oPPath);
+   for(i = 1; i <= ulDepth; i++) {
+      if(i > 1)
+         ulPrefixLength++;
+      ulPrefixLength += strlen(Path_getComponent(oPPath, i - 1));
+      if(i < ulFirst)
+         continue;
+      c = pcPath[ulPrefixLength];
+      pcPath[ulPrefixLength] = '\0';
+      NameIndex_add(oFTree->oNameIndex, pcPath, bIsFile && i == ulDepth);
+      pcPath[ulPrefixLength] = c;
+   }
+   free(pcPath);
+}
 
-   return SUCCESS;
+/*
+  Frees the nodes that an insertion into oFTree below oNAncestor (NULL
+  for a new root) created, starting with oNFirstNew, after it failed
+  part way. Does nothing if oNFirstNew is NULL.
+*/
+static void FT_discardInsertion(FT_T oFTree, Node_T oNAncestor,
+                                Node_T oNFirstNew) {
+   assert(oFTree != NULL);
+
+   if(oNFirstNew == NULL)
+      return;
+   /* with lock-free lookups, oNFirstNew is not published yet */
+   if(oNAncestor != NULL && !oFTree->bLockFreeReads)
+      (void) Node_remove(oNAncestor, oNFirstNew, NULL);
+   else
+      Node_release(oNFirstNew, NULL);
 }
 
-/*--------------------------------------------------------------------*/
+/*
+  Appends the record of a change of kind eOp to oFTree's log, if it
+  has one: to pcPath and, for a move or copy, pcOther, or for a file
+  with contents pvContents of ulLength bytes. The caller holds the
+  latch or lock that orders the change, so that the log has the
+  changes in the order they took effect. A failure is remembered by
+  the log and reported by FT_commit.
+*/
+static void FT_log(FT_T oFTree, enum Wal_op eOp, const char *pcPath,
+                   const char *pcOther, void *pvContents,
+                   size_t ulLength) {
+   struct Wal_record sRecord;
 
-int FT_insertFile(const char *pcPath, void *pvContents, size_t ulLength){
-    int iStatus;
+   assert(oFTree != NULL);
+   assert(pcPath != NULL);
+
+   if(oFTree->oWal == NULL)
+      return;
+   sRecord.eOp = eOp;
+   sRecord.pcPath = pcPath;
+   sRecord.pcOther = pcOther;
+   sRecord.pvContents = pvContents;
+   sRecord.ulLength = ulLength;
+   sRecord.ulOffset = 0;
+   (void) Wal_append(oFTree->oWal, &sRecord);
+}
+
+/* Appends the record of a write of the ulCount bytes pvBytes at
+   ulOffset in the file pcPath to oFTree's log, as FT_log does. */
+static void FT_logWrite(FT_T oFTree, const char *pcPath, size_t ulOffset,
+                        const void *pvBytes, size_t ulCount) {
+   struct Wal_record sRecord;
+
+   assert(oFTree != NULL);
+   assert(pcPath != NULL);
+
+   if(oFTree->oWal == NULL)
+      return;
+   sRecord.eOp = WAL_WRITE;
+   sRecord.pcPath = pcPath;
+   sRecord.pcOther = NULL;
+   sRecord.pvContents = (void *) pvBytes;
+   sRecord.ulLength = ulCount;
+   sRecord.ulOffset = ulOffset;
+   (void) Wal_append(oFTree->oWal, &sRecord);
+}
+
+/*
+  Sets *poLResult to chunks of oFTree's store holding the ulLength
+  bytes pvContents, or to NULL if oFTree has no store or pvContents is
+  NULL, and returns SUCCESS, or sets it to NULL and returns
+  MEMORY_ERROR. Takes no lock, since the store has its own.
+*/
+static int FT_chunk(FT_T oFTree, const void *pvContents, size_t ulLength,
+                    ChunkList_T *poLResult){
+   assert(oFTree != NULL);
+   assert(poLResult != NULL);
+
+   *poLResult = NULL;
+   if(oFTree->oChunkStore == NULL || pvContents == NULL)
+      return SUCCESS;
+   if(oFTree->bWholeFiles)
+      return ChunkStore_addWhole(oFTree->oChunkStore, pvContents,
+                                 ulLength, poLResult);
+   return ChunkStore_add(oFTree->oChunkStore, pvContents, ulLength,
+                         poLResult);
+}
+
+/*
+  Inserts a new directory (if bIsFile is FALSE) or file (if bIsFile is
+  TRUE, with contents pvContents of size ulLength, held by oChunks
+  instead if it is not NULL, or lying within the read-only mapping
+  pvMap of ulMapLength bytes, which the file then owns, if that is not
+  NULL) into oFTree with
+  absolute path pcPath, creating any missing ancestor directories.
+  Returns the status documented for FT_insertDir and FT_insertFile.
+  With lock-free lookups, the new nodes are built out of sight of
+  readers and then published all at once.
+*/
+static int FT_insertNode(FT_T oFTree, const char *pcPath, boolean bIsFile,
+                         void *pvContents, size_t ulLength,
+                         ChunkList_T oChunks, void *pvMap,
+                         size_t ulMapLength){
+   int iStatus;
    Path_T oPPath = NULL;
    Node_T oNFirstNew = NULL;
    Node_T oNCurr = NULL;
-   size_t ulDepth, ulIndex;
-   size_t ulNewNodes = 0;
+   Node_T oNAncestor;
+   size_t ulDepth, ulIndex, ulFirst;
 
+   assert(oFTree != NULL);
    assert(pcPath != NULL);
 
    /* validate pcPath and generate a Path_T for it */
-   if(!bIsInitialized)
+   if(!oFTree->bIsInitialized || oFTree->bReadOnly)
       return INITIALIZATION_ERROR;
 
    iStatus = Path_new(pcPath, &oPPath);
    if(iStatus != SUCCESS)
       return iStatus;
 
+   /* the closest ancestor is the only node that changes */
+   if(FT_mustUnshare(oFTree)) {
+      iStatus = FT_unsharePath(oFTree, oPPath, Path_getDepth(oPPath) - 1);
+      if(iStatus != SUCCESS) {
+         Path_free(oPPath);
+         return iStatus;
+      }
+   }
+
    /* find the closest ancestor of oPPath already in the tree */
-   iStatus= FT_traversePath(oPPath, &oNCurr);
+   iStatus= FT_traversePath(oFTree, oPPath, TRUE, &oNCurr, &ulIndex);
    if(iStatus != SUCCESS)
    {
       Path_free(oPPath);
       return iStatus;
    }
+   /* new nodes are only reachable through the latched ancestor */
+   oNAncestor = oNCurr;
 
    /* no ancestor node found, so if root is not NULL,
       pcPath isn't underneath root. */
-   if(oNCurr == NULL && oNRoot != NULL) {
+   if(oNCurr == NULL && FT_getRoot(oFTree) != NULL) {
       Path_free(oPPath);
       return CONFLICTING_PATH;
    }
 
    /* Make sure ancestor is not a file */
    if (oNCurr != NULL && Node_isFileNode(oNCurr)) {
+        FT_unlatch(oFTree, TRUE, oNAncestor);
         Path_free(oPPath);
         return NOT_A_DIRECTORY;
    }
 
    ulDepth = Path_getDepth(oPPath);
-   if(oNCurr == NULL) /* new root! */
-      ulIndex = 1;
-   else {
-      ulIndex = Path_getDepth(Node_getPath(oNCurr))+1;
-
-      /* oNCurr is the node we're trying to insert */
-      if(ulIndex == ulDepth+1 && !Path_comparePath(oPPath,
-                                       Node_getPath(oNCurr))) {
-         Path_free(oPPath);
-         return ALREADY_IN_TREE;
-      }
+   /* oNCurr is the node we're trying to insert */
+   if(ulIndex == ulDepth) {
+      FT_unlatch(oFTree, TRUE, oNAncestor);
+      Path_free(oPPath);
+      return ALREADY_IN_TREE;
    }
+   /* the depth of the first node to create, which is 1 for a new
+      root */
+   ulIndex++;
+   ulFirst = ulIndex;
 
    /* starting at oNCurr, build rest of the path one level at a time */
    while(ulIndex <= ulDepth) {
-      Path_T oPPrefix = NULL;
+      const char *pcName = Path_getComponent(oPPath, ulIndex - 1);
       Node_T oNNewNode = NULL;
 
-      /* generate a Path_T for this level */
-      iStatus = Path_prefix(oPPath, ulIndex, &oPPrefix);
+      /* insert the new node for this level */
+      if(oFTree->bLockFreeReads && oNFirstNew == NULL && oNCurr != NULL)
+         iStatus = Node_newUnpublished(pcName, oNCurr,
+                                       bIsFile && ulIndex == ulDepth,
+                                       pvContents, ulLength, &oNNewNode);
+      else if(bIsFile && ulIndex == ulDepth)
+         iStatus = Node_new(pcName, oNCurr, TRUE, pvContents, ulLength,
+                            &oNNewNode);
+      else
+         iStatus = Node_new(pcName, oNCurr, FALSE, NULL, 0, &oNNewNode);
       if(iStatus != SUCCESS) {
          Path_free(oPPath);
-         if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew);
+         FT_discardInsertion(oFTree, oNAncestor, oNFirstNew);
+         FT_unlatch(oFTree, TRUE, oNAncestor);
          return iStatus;
       }
-
-      /* insert the new node for this level */
-      if(ulIndex < ulDepth) {
-        iStatus = Node_new(oPPrefix, oNCurr, FALSE, NULL, 0, &oNNewNode);
-      }
-      else{
-        iStatus = Node_new(oPPrefix, oNCurr, TRUE, pvContents, ulLength, &oNNewNode);
-      }
-      if(iStatus != SUCCESS) {
+      /* no reader can reach the new file yet */
+      if(oChunks != NULL && bIsFile && ulIndex == ulDepth)
+         (void) Node_replaceChunks(oNNewNode, oChunks, NULL);
+      else if(pvMap != NULL && bIsFile && ulIndex == ulDepth &&
+              Node_adoptMapping(oNNewNode, pvMap,
+                                ulMapLength) != SUCCESS) {
+         if(oNFirstNew == NULL)
+            oNFirstNew = oNNewNode;
          Path_free(oPPath);
-         Path_free(oPPrefix);
-         if(oNFirstNew != NULL)
-            (void) Node_free(oNFirstNew);
-         return iStatus;
+         FT_discardInsertion(oFTree, oNAncestor, oNFirstNew);
+         FT_unlatch(oFTree, TRUE, oNAncestor);
+         return MEMORY_ERROR;
       }
 
       /* set up for next level */
-      Path_free(oPPrefix);
       oNCurr = oNNewNode;
-      ulNewNodes++;
       if(oNFirstNew == NULL)
          oNFirstNew = oNCurr;
       ulIndex++;
    }
-   Path_free(oPPath);
-   /* update DT state variables to reflect insertion */
-   if(oNRoot == NULL)
-      oNRoot = oNFirstNew;
-   ulCount += ulNewNodes;
+   if(oFTree->bLockFreeReads && oNAncestor != NULL) {
+      iStatus = Node_publish(oNAncestor, oNFirstNew, oFTree->oEpoch);
+      if(iStatus != SUCCESS) {
+         Path_free(oPPath);
+         FT_discardInsertion(oFTree, oNAncestor, oNFirstNew);
+         FT_unlatch(oFTree, TRUE, oNAncestor);
+         return iStatus;
+      }
+   }
+   /* update DT state variables to reflect insertion */
+   if(oNAncestor == NULL)
+      FT_setRoot(oFTree, oNFirstNew);
+   /* before anyone else can change the new nodes */
+   FT_indexInsertion(oFTree, oPPath, ulFirst, bIsFile, ulLength);
+   FT_log(oFTree, bIsFile ? WAL_INSERTFILE : WAL_INSERTDIR, pcPath, NULL,
+          pvContents, ulLength);
+   Path_free(oPPath);
+   FT_unlatch(oFTree, TRUE, oNAncestor);
    return SUCCESS;
 }
 
+/*
+  Removes the directory (if bIsFile is FALSE) or file (if bIsFile is
+  TRUE) with absolute path pcPath from oFTree, along with everything
+  below it. Returns the status documented for FT_rmDir and FT_rmFile.
+  Only the parent of the removed node is latched, exclusively; the
+  root can only be removed with oFTree's lock held exclusively. With
+  lock-free lookups, the nodes are freed only once no reader can be
+  looking at them; nodes a snapshot shares are not freed at all.
+*/
+static int FT_removeNode(FT_T oFTree, const char *pcPath,
+                         boolean bIsFile){
+    int iStatus;
+    Path_T oPPath = NULL;
+    Path_T oPParentPath = NULL;
+    Node_T oNParent = NULL;
+    Node_T oNFound = NULL;
+    Node_T oNRoot;
+    const char *pcName;
+    size_t ulDepth;
+    size_t ulParentDepth;
+    size_t ulChildID;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+
+    if(!oFTree->bIsInitialized || oFTree->bReadOnly)
+        return INITIALIZATION_ERROR;
+
+    iStatus = Path_new(pcPath, &oPPath);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    ulDepth = Path_getDepth(oPPath);
+    /* the parent is the only node that changes */
+    if(FT_mustUnshare(oFTree)) {
+        iStatus = FT_unsharePath(oFTree, oPPath, ulDepth - 1);
+        if(iStatus != SUCCESS) {
+            Path_free(oPPath);
+            return iStatus;
+        }
+    }
+    if(ulDepth == 1) {
+        /* the only node at depth 1 is the root */
+        oNRoot = FT_getRoot(oFTree);
+        if(oNRoot == NULL)
+            iStatus = NO_SUCH_PATH;
+        else if(strcmp(Node_getName(oNRoot), Path_getComponent(oPPath, 0)))
+            iStatus = CONFLICTING_PATH;
+        else if(bIsFile)
+            iStatus = NOT_A_FILE;
+        else {
+            FT_setRoot(oFTree, NULL);
+            FT_indexSubtree(oFTree, oNRoot, oPPath, FALSE);
+            (void) Node_remove(NULL, oNRoot, oFTree->oEpoch);
+            FT_log(oFTree, WAL_RMDIR, pcPath, NULL, NULL, 0);
+        }
+        Path_free(oPPath);
+        return iStatus;
+    }
+
+    iStatus = Path_prefix(oPPath, ulDepth - 1, &oPParentPath);
+    if(iStatus != SUCCESS) {
+        Path_free(oPPath);
+        return iStatus;
+    }
+    iStatus = FT_traversePath(oFTree, oPParentPath, TRUE, &oNParent,
+                              &ulParentDepth);
+    if(iStatus != SUCCESS) {
+        Path_free(oPParentPath);
+        Path_free(oPPath);
+        return iStatus;
+    }
+
+    pcName = Path_getComponent(oPPath, ulDepth - 1);
+    if(oNParent == NULL || ulParentDepth != ulDepth - 1)
+        iStatus = NO_SUCH_PATH;
+    else if(Node_hasDirChild(oNParent, pcName, &ulChildID)) {
+        if(bIsFile)
+            iStatus = NOT_A_FILE;
+        else
+            iStatus = Node_getChild(oNParent, ulChildID, FALSE, &oNFound);
+    }
+    else if(Node_hasFileChild(oNParent, pcName, &ulChildID)) {
+        if(!bIsFile)
+            iStatus = NOT_A_DIRECTORY;
+        else
+            iStatus = Node_getChild(oNParent, ulChildID, TRUE, &oNFound);
+    }
+    else
+        iStatus = NO_SUCH_PATH;
+
+    if(iStatus == SUCCESS && FT_hasIndex(oFTree)) {
+        /* kept alive to be unindexed once no writer is inside it */
+        Node_retain(oNFound);
+        iStatus = Node_remove(oNParent, oNFound, oFTree->oEpoch);
+        if(iStatus == SUCCESS)
+            FT_indexSubtree(oFTree, oNFound, oPPath, FALSE);
+        Node_release(oNFound, oFTree->oEpoch);
+    }
+    else if(iStatus == SUCCESS)
+        iStatus = Node_remove(oNParent, oNFound, oFTree->oEpoch);
+    if(iStatus == SUCCESS)
+        FT_log(oFTree, bIsFile ? WAL_RMFILE : WAL_RMDIR, pcPath, NULL,
+               NULL, 0);
+
+    FT_unlatch(oFTree, TRUE, oNParent);
+    Path_free(oPParentPath);
+    Path_free(oPPath);
+    return iStatus;
+}
+/*--------------------------------------------------------------------*/
+
+/* Performs FT_insertDirIn. The caller holds oFTree's lock as needed. */
+static int FT_insertDirLocked(FT_T oFTree, const char *pcPath){
+   return FT_insertNode(oFTree, pcPath, FALSE, NULL, 0, NULL, NULL, 0);
+}
+
 /*--------------------------------------------------------------------*/
 
-boolean FT_containsFile(const char *pcPath){
-     /* If FT contains a file with path pcPath */
-    int iStatus;
+/* Performs FT_containsDirIn. The caller holds oFTree's lock as needed. */
+static boolean FT_containsDirLocked(FT_T oFTree, const char *pcPath){
     Node_T oNFound = NULL;
+    int iStatus;
+    boolean bIsDir;
 
+    assert(oFTree != NULL);
     assert(pcPath != NULL);
 
-    if (!bIsInitialized) {
+    if (!oFTree->bIsInitialized || pcPath == NULL) {
         return FALSE;
     }
 
-    iStatus = FT_findNode(pcPath, &oNFound);
+    iStatus = FT_findNode(oFTree, pcPath, FALSE, &oNFound);
     if (iStatus != SUCCESS){
         return FALSE;
     }
-    if (Node_isFileNode(oNFound) == TRUE) {
-        return TRUE;
-    }
-    else{
-        return FALSE;
-    }
+    bIsDir = !Node_isFileNode(oNFound);
+    FT_unlatch(oFTree, FALSE, oNFound);
+    return bIsDir;
 }
 
 /*--------------------------------------------------------------------*/
 
-int FT_rmFile(const char *pcPath){
+/* Performs FT_rmDirIn. The caller holds oFTree's lock as needed. */
+static int FT_rmDirLocked(FT_T oFTree, const char *pcPath){
+   return FT_removeNode(oFTree, pcPath, FALSE);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Performs FT_insertFileIn, with the contents held by oChunks if it is
+   not NULL. The caller holds oFTree's lock as needed. */
+static int FT_insertFileLocked(FT_T oFTree, const char *pcPath,
+                              void *pvContents, size_t ulLength,
+                              ChunkList_T oChunks){
+   return FT_insertNode(oFTree, pcPath, TRUE, pvContents, ulLength,
+                        oChunks, NULL, 0);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Performs FT_containsFileIn. The caller holds oFTree's lock as needed. */
+static boolean FT_containsFileLocked(FT_T oFTree, const char *pcPath){
+     /* If FT contains a file with path pcPath */
     int iStatus;
     Node_T oNFound = NULL;
+    boolean bIsFile;
 
-   assert(pcPath != NULL);
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
 
-   iStatus = FT_findNode(pcPath, &oNFound);
+    if (!oFTree->bIsInitialized) {
+        return FALSE;
+    }
 
-   if(iStatus != SUCCESS) {
-        return iStatus;
-        }
-    else if (!Node_isFileNode(oNFound)) {
-        return NOT_A_FILE;
+    iStatus = FT_findNode(oFTree, pcPath, FALSE, &oNFound);
+    if (iStatus != SUCCESS){
+        return FALSE;
     }
+    bIsFile = Node_isFileNode(oNFound);
+    FT_unlatch(oFTree, FALSE, oNFound);
+    return bIsFile;
+}
 
-   ulCount -= Node_free(oNFound);
-   if(ulCount == 0)
-      oNRoot = NULL;
+/*--------------------------------------------------------------------*/
 
-   return SUCCESS;
+/* Performs FT_rmFileIn. The caller holds oFTree's lock as needed. */
+static int FT_rmFileLocked(FT_T oFTree, const char *pcPath){
+   return FT_removeNode(oFTree, pcPath, TRUE);
 }
 
 /*--------------------------------------------------------------------*/
 
-void *FT_getFileContents(const char *pcPath){
+/* Performs FT_getFileContentsIn. The caller holds oFTree's lock as
+   needed. */
+static void *FT_getFileContentsLocked(FT_T oFTree, const char *pcPath){
     
     Node_T oNFound = NULL;
     void *pvContent = NULL;
 
+    assert(oFTree != NULL);
     assert(pcPath != NULL); 
 
-    if (!bIsInitialized || pcPath == NULL) {
+    if (!oFTree->bIsInitialized || pcPath == NULL) {
         return NULL;
     }
 
-    if (FT_findNode(pcPath, &oNFound) != SUCCESS || 
-    !Node_isFileNode(oNFound)) {
+    if (FT_findNode(oFTree, pcPath, FALSE, &oNFound) != SUCCESS)
         return NULL;
-    }
-    pvContent = Node_getFileContent(oNFound);
+    if (Node_isFileNode(oNFound))
+        pvContent = Node_getFileContent(oNFound);
+    FT_unlatch(oFTree, FALSE, oNFound);
     return pvContent;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Performs FT_replaceFileContentsIn, with the new contents held by
+   oChunks if it is not NULL, and sets *piStatus to SUCCESS if the
+   contents were replaced, and logged, or to why not otherwise. The
+   caller holds oFTree's lock as needed. */
+static void *FT_replaceFileContentsLocked(FT_T oFTree,
+        const char *pcPath, void *pvNewContents, size_t ulNewLength,
+        ChunkList_T oChunks, int *piStatus){
+    Node_T oNTarget = NULL;
+    Path_T oPPath = NULL;
+    void *pvOldContents = NULL;
+    size_t ulOldLength;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+    assert(piStatus != NULL);
 
-    /* Node_T oNFound = NULL;
-    // assert(pcPath != NULL); 
-    // void *pvContent;
+    *piStatus = INITIALIZATION_ERROR;
+    if (!oFTree->bIsInitialized || oFTree->bReadOnly || pcPath == NULL) {
+        return NULL;
+    }
+
+    if (FT_mustUnshare(oFTree)) {
+        iStatus = Path_new(pcPath, &oPPath);
+        if (iStatus != SUCCESS) {
+            *piStatus = iStatus;
+            return NULL;
+        }
+        iStatus = FT_unsharePath(oFTree, oPPath, Path_getDepth(oPPath));
+        Path_free(oPPath);
+        if (iStatus != SUCCESS) {
+            *piStatus = iStatus;
+            return NULL;
+        }
+    }
+
+    *piStatus = FT_findNode(oFTree, pcPath, TRUE, &oNTarget);
+    if (*piStatus != SUCCESS)
+        return NULL;
+    *piStatus = NOT_A_FILE;
+    if (Node_isFileNode(oNTarget)) {
+        *piStatus = SUCCESS;
+        ulOldLength = Node_getFileSize(oNTarget);
+        if (oChunks != NULL)
+            pvOldContents = Node_replaceChunks(oNTarget, oChunks,
+                                               oFTree->oEpoch);
+        else
+            pvOldContents = Node_replaceOldContent(oNTarget,
+                                                   pvNewContents,
+                                                   ulNewLength,
+                                                   oFTree->oEpoch);
+        /* the file's latch orders this against other changes to it */
+        if (oFTree->oSizeIndex != NULL && ulOldLength != ulNewLength) {
+            SizeIndex_remove(oFTree->oSizeIndex, pcPath, ulOldLength);
+            SizeIndex_add(oFTree->oSizeIndex, pcPath, ulNewLength);
+        }
+        FT_log(oFTree, WAL_REPLACE, pcPath, NULL, pvNewContents,
+               ulNewLength);
+    }
+    FT_unlatch(oFTree, TRUE, oNTarget);
+    return pvOldContents;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Performs FT_readAtIn. The caller holds oFTree's lock as needed. */
+static int FT_readAtLocked(FT_T oFTree, const char *pcPath,
+                           size_t ulOffset, void *pvDest, size_t ulCount,
+                           size_t *pulRead){
+    Node_T oNFound = NULL;
+    int iStatus;
+    size_t ulSize;
 
-    // if (!bIsInitialized || pcPath == NULL) {
-    //     return NULL;
-    // }
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+    assert(pulRead != NULL);
 
-    // if (FT_findNode(pcPath, &oNFound) == NULL);
-    // pvContent = oNFound->content;
-    // return pvContent; */ 
+    if (!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
 
+    iStatus = FT_findNode(oFTree, pcPath, FALSE, &oNFound);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (!Node_isFileNode(oNFound)) {
+        FT_unlatch(oFTree, FALSE, oNFound);
+        return NOT_A_FILE;
+    }
+    /* a writer may be changing the bytes in place */
+    if (oFTree->bLockFreeReads)
+        Node_latchShared(oNFound);
+    ulSize = Node_getFileSize(oNFound);
+    *pulRead = Node_readContent(oNFound, ulOffset, pvDest, ulCount);
+    /* short of the end only if a cold chunk could not be thawed */
+    if (ulOffset < ulSize && *pulRead < ulSize - ulOffset &&
+        *pulRead < ulCount)
+        iStatus = MEMORY_ERROR;
+    if (oFTree->bLockFreeReads)
+        Node_unlatch(oNFound);
+    FT_unlatch(oFTree, FALSE, oNFound);
+    return iStatus;
 }
 
 /*--------------------------------------------------------------------*/
 
-void *FT_replaceFileContents(const char *pcPath, void *pvNewContents, 
-        size_t ulNewLength){
+/* Performs FT_sendFileIn. The caller holds oFTree's lock as needed. */
+static int FT_sendFileLocked(FT_T oFTree, const char *pcPath, int iFd,
+                             size_t ulOffset, size_t ulCount,
+                             size_t *pulSent){
+    Node_T oNFound = NULL;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcPath != NULL);
+    assert(pulSent != NULL);
+
+    if (!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    iStatus = FT_findNode(oFTree, pcPath, FALSE, &oNFound);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (!Node_isFileNode(oNFound)) {
+        FT_unlatch(oFTree, FALSE, oNFound);
+        return NOT_A_FILE;
+    }
+    /* a writer may be changing the bytes in place */
+    if (oFTree->bLockFreeReads)
+        Node_latchShared(oNFound);
+    iStatus = Node_sendContent(oNFound, ulOffset, ulCount, iFd, pulSent);
+    if (oFTree->bLockFreeReads)
+        Node_unlatch(oNFound);
+    FT_unlatch(oFTree, FALSE, oNFound);
+    return iStatus;
+}
+
+/*
+  Performs FT_writeAtIn, or FT_appendIn if bAppend is TRUE, in which
+  case ulOffset is ignored. The caller holds oFTree's lock as needed.
+*/
+static int FT_writeLocked(FT_T oFTree, const char *pcPath,
+                          size_t ulOffset, const void *pvBytes,
+                          size_t ulCount, boolean bAppend){
     Node_T oNTarget = NULL;
+    Path_T oPPath = NULL;
+    size_t ulOldLength, ulNewLength;
     int iStatus;
 
+    assert(oFTree != NULL);
     assert(pcPath != NULL);
 
-    if (!bIsInitialized || pcPath == NULL) {
-        return NULL;
+    if (!oFTree->bIsInitialized || oFTree->bReadOnly)
+        return INITIALIZATION_ERROR;
+
+    if (FT_mustUnshare(oFTree)) {
+        iStatus = Path_new(pcPath, &oPPath);
+        if (iStatus != SUCCESS)
+            return iStatus;
+        iStatus = FT_unsharePath(oFTree, oPPath, Path_getDepth(oPPath));
+        Path_free(oPPath);
+        if (iStatus != SUCCESS)
+            return iStatus;
     }
 
-    iStatus = FT_findNode(pcPath, &oNTarget);
-    if (iStatus != SUCCESS || !Node_isFileNode(oNTarget)) {
-        return NULL;
+    iStatus = FT_findNode(oFTree, pcPath, TRUE, &oNTarget);
+    if (iStatus != SUCCESS)
+        return iStatus;
+    if (!Node_isFileNode(oNTarget)) {
+        FT_unlatch(oFTree, TRUE, oNTarget);
+        return NOT_A_FILE;
     }
 
-    return Node_replaceOldContent(oNTarget, pvNewContents, ulNewLength);
+    ulOldLength = Node_getFileSize(oNTarget);
+    if (bAppend)
+        ulOffset = ulOldLength;
+    iStatus = Node_writeContent(oNTarget, ulOffset, pvBytes, ulCount,
+                                oFTree->oEpoch);
+    if (iStatus == SUCCESS) {
+        ulNewLength = Node_getFileSize(oNTarget);
+        /* the file's latch orders this against other changes to it */
+        if (oFTree->oSizeIndex != NULL && ulOldLength != ulNewLength) {
+            SizeIndex_remove(oFTree->oSizeIndex, pcPath, ulOldLength);
+            SizeIndex_add(oFTree->oSizeIndex, pcPath, ulNewLength);
+        }
+        /* an append is logged where it went, to replay the same */
+        FT_logWrite(oFTree, pcPath, ulOffset, pvBytes, ulCount);
+    }
+    FT_unlatch(oFTree, TRUE, oNTarget);
+    return iStatus;
 }
 
 /*--------------------------------------------------------------------*/
 
-int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize){
+/* Performs FT_statIn. The caller holds oFTree's lock as needed. */
+static int FT_statLocked(FT_T oFTree, const char *pcPath,
+                         boolean *pbIsFile, size_t *pulSize){
     Node_T oNFound = NULL;
     int iStatus;
 
+    assert(oFTree != NULL);
     assert(pcPath != NULL);
     assert(pbIsFile != NULL);
     assert(pulSize != NULL);
 
-    if (!bIsInitialized || pcPath == NULL) {
+    if (!oFTree->bIsInitialized || pcPath == NULL) {
         return INITIALIZATION_ERROR;
     }
 
-    iStatus = FT_findNode(pcPath, &oNFound);
+    iStatus = FT_findNode(oFTree, pcPath, FALSE, &oNFound);
     if (iStatus != SUCCESS) {
         return iStatus;
     }
@@ -548,136 +1413,3247 @@ int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize){
     if (*pbIsFile) {
         *pulSize = Node_getFileSize(oNFound);
     }
+    FT_unlatch(oFTree, FALSE, oNFound);
     return SUCCESS;
 }
 
 /*--------------------------------------------------------------------*/
 
-int FT_init(void){
+/*
+  Sets *poNParent to the node of oFTree that is the parent of absolute
+  path oPPath, of depth greater than 1, and returns SUCCESS, or sets
+  it to NULL and returns:
+  * CONFLICTING_PATH if the root's path is not a prefix of oPPath
+  * NO_SUCH_PATH if there is no such node
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  The caller holds oFTree's lock exclusively, which keeps the node in
+  place, so it is not left latched.
+*/
+static int FT_findParent(FT_T oFTree, Path_T oPPath, Node_T *poNParent) {
+    Path_T oPParentPath = NULL;
+    size_t ulParentDepth;
+    int iStatus;
 
-    if(bIsInitialized)
-        return INITIALIZATION_ERROR;
-    bIsInitialized = TRUE;
-    oNRoot = NULL;
-    ulCount = 0;
+    assert(oFTree != NULL);
+    assert(oPPath != NULL);
+    assert(poNParent != NULL);
+    assert(Path_getDepth(oPPath) > 1);
 
+    *poNParent = NULL;
+    iStatus = Path_prefix(oPPath, Path_getDepth(oPPath) - 1,
+                          &oPParentPath);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_traversePath(oFTree, oPParentPath, TRUE, poNParent,
+                              &ulParentDepth);
+    Path_free(oPParentPath);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    FT_unlatch(oFTree, TRUE, *poNParent);
+    if(*poNParent == NULL || ulParentDepth != Path_getDepth(oPPath) - 1) {
+        *poNParent = NULL;
+        return NO_SUCH_PATH;
+    }
     return SUCCESS;
-
 }
 
-int FT_destroy(void){
+/* Performs FT_moveIn. The caller holds oFTree's lock exclusively. */
+static int FT_moveLocked(FT_T oFTree, const char *pcSrc,
+                         const char *pcDst){
+    Path_T oPSrc = NULL;
+    Path_T oPDst = NULL;
+    Node_T oNSrcParent = NULL;
+    Node_T oNDstParent = NULL;
+    Node_T oNSrc = NULL;
+    Node_T oNCopy;
+    const char *pcDstName;
+    size_t ulSrcDepth, ulDstDepth;
+    size_t ulChildID;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcSrc != NULL);
+    assert(pcDst != NULL);
 
-    if(!bIsInitialized)
+    if(!oFTree->bIsInitialized || oFTree->bReadOnly)
         return INITIALIZATION_ERROR;
 
-    if(oNRoot) {
-        ulCount -= Node_free(oNRoot);
-        oNRoot = NULL;
+    iStatus = Path_new(pcSrc, &oPSrc);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = Path_new(pcDst, &oPDst);
+    if(iStatus != SUCCESS) {
+        Path_free(oPSrc);
+        return iStatus;
+    }
+    ulSrcDepth = Path_getDepth(oPSrc);
+    ulDstDepth = Path_getDepth(oPDst);
+    pcDstName = Path_getComponent(oPDst, ulDstDepth - 1);
+
+    /* a subtree cannot be moved into itself */
+    if(ulDstDepth > ulSrcDepth &&
+       Path_getSharedPrefixDepth(oPSrc, oPDst) == ulSrcDepth)
+        iStatus = CONFLICTING_PATH;
+    /* both parents change */
+    else if(oFTree->bShared) {
+        iStatus = FT_unsharePath(oFTree, oPSrc, ulSrcDepth - 1);
+        if(iStatus == SUCCESS)
+            iStatus = FT_unsharePath(oFTree, oPDst, ulDstDepth - 1);
+    }
+
+    /* find what to move */
+    if(iStatus == SUCCESS && ulSrcDepth == 1) {
+        oNSrc = FT_getRoot(oFTree);
+        if(oNSrc == NULL)
+            iStatus = NO_SUCH_PATH;
+        else if(strcmp(Node_getName(oNSrc), Path_getComponent(oPSrc, 0)))
+            iStatus = CONFLICTING_PATH;
+    }
+    else if(iStatus == SUCCESS) {
+        iStatus = FT_findParent(oFTree, oPSrc, &oNSrcParent);
+        if(iStatus == SUCCESS)
+            iStatus = Node_lookupChild(oNSrcParent,
+                                       Path_getComponent(oPSrc,
+                                                         ulSrcDepth - 1),
+                                       &oNSrc);
     }
 
-    bIsInitialized = FALSE;
+    /* and where to */
+    if(iStatus == SUCCESS && ulDstDepth == 1) {
+        /* only the root can be renamed to another root */
+        if(!strcmp(Node_getName(FT_getRoot(oFTree)), pcDstName))
+            iStatus = ALREADY_IN_TREE;
+        else if(ulSrcDepth != 1)
+            iStatus = CONFLICTING_PATH;
+    }
+    else if(iStatus == SUCCESS) {
+        iStatus = FT_findParent(oFTree, oPDst, &oNDstParent);
+        if(iStatus == SUCCESS && Node_isFileNode(oNDstParent))
+            iStatus = NOT_A_DIRECTORY;
+        else if(iStatus == SUCCESS &&
+                (Node_hasDirChild(oNDstParent, pcDstName, &ulChildID) ||
+                 Node_hasFileChild(oNDstParent, pcDstName, &ulChildID)))
+            iStatus = ALREADY_IN_TREE;
+    }
 
-    return SUCCESS;
+    if(iStatus == SUCCESS && ulSrcDepth == 1) {
+        iStatus = Node_copy(oNSrc, pcDstName, &oNCopy);
+        if(iStatus == SUCCESS)
+            FT_setRoot(oFTree, oNCopy);
+    }
+    else if(iStatus == SUCCESS) {
+        /* the old subtree stays alive until it is unindexed */
+        Node_retain(oNSrc);
+        iStatus = Node_relink(oNSrcParent, oNSrc, oNDstParent, pcDstName,
+                              oFTree->oEpoch);
+        if(iStatus == SUCCESS)
+            iStatus = Node_lookupChild(oNDstParent, pcDstName, &oNCopy);
+        else
+            Node_release(oNSrc, NULL);
+    }
+    if(iStatus == SUCCESS) {
+        /* new paths first, so that FT_findByNameIn never misses the
+           subtree, like a lookup racing the move */
+        FT_indexSubtree(oFTree, oNCopy, oPDst, TRUE);
+        FT_indexSubtree(oFTree, oNSrc, oPSrc, FALSE);
+        Node_release(oNSrc, oFTree->oEpoch);
+        FT_log(oFTree, WAL_MOVE, pcSrc, pcDst, NULL, 0);
+    }
 
+    Path_free(oPSrc);
+    Path_free(oPDst);
+    return iStatus;
 }
 
+/* Performs FT_copyIn. The caller holds oFTree's lock exclusively. */
+static int FT_copyLocked(FT_T oFTree, const char *pcSrc,
+                         const char *pcDst){
+    Path_T oPSrc = NULL;
+    Path_T oPDst = NULL;
+    Node_T oNSrcParent = NULL;
+    Node_T oNDstParent = NULL;
+    Node_T oNSrc = NULL;
+    Node_T oNCopy = NULL;
+    const char *pcDstName;
+    size_t ulSrcDepth, ulDstDepth;
+    size_t ulChildID;
+    int iStatus;
 
-/* --------------------------------------------------------------------
+    assert(oFTree != NULL);
+    assert(pcSrc != NULL);
+    assert(pcDst != NULL);
 
-  The following auxiliary functions are used for generating the
-  string representation of the FT.
-*/
+    if(!oFTree->bIsInitialized || oFTree->bReadOnly)
+        return INITIALIZATION_ERROR;
 
-/*
-  Performs a pre-order traversal of the tree rooted at n,
-  inserting each payload to DynArray_T d beginning at index i.
-  Returns the next unused index in d after the insertion(s).
-*/
-static size_t FT_preOrderTraversal(Node_T n, DynArray_T d, size_t i) {
-   size_t c;
+    iStatus = Path_new(pcSrc, &oPSrc);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = Path_new(pcDst, &oPDst);
+    if(iStatus != SUCCESS) {
+        Path_free(oPSrc);
+        return iStatus;
+    }
+    ulSrcDepth = Path_getDepth(oPSrc);
+    ulDstDepth = Path_getDepth(oPDst);
+    pcDstName = Path_getComponent(oPDst, ulDstDepth - 1);
 
-   assert(d != NULL);
+    /* the copy would end up inside what it shares */
+    if(ulDstDepth > ulSrcDepth &&
+       Path_getSharedPrefixDepth(oPSrc, oPDst) == ulSrcDepth)
+        iStatus = CONFLICTING_PATH;
+    /* only the destination's parent changes */
+    else if(oFTree->bShared)
+        iStatus = FT_unsharePath(oFTree, oPDst, ulDstDepth - 1);
 
-    if(n != NULL) {
-        (void) DynArray_set(d, i, n);     
-        i++;
-        
-        for(c = 0; c < Node_getNumFileChildren(n); c++) {
-            int iStatus;
-            Node_T oNChild = NULL;
-            /* Getting File Nodes First*/
-            iStatus = Node_getChild(n,c,TRUE,&oNChild);
-            assert(iStatus == SUCCESS);
-            (void) DynArray_set(d, i, oNChild);
-            i++;
-        }
+    /* find what to copy */
+    if(iStatus == SUCCESS && ulSrcDepth == 1) {
+        oNSrc = FT_getRoot(oFTree);
+        if(oNSrc == NULL)
+            iStatus = NO_SUCH_PATH;
+        else if(strcmp(Node_getName(oNSrc), Path_getComponent(oPSrc, 0)))
+            iStatus = CONFLICTING_PATH;
+    }
+    else if(iStatus == SUCCESS) {
+        iStatus = FT_findParent(oFTree, oPSrc, &oNSrcParent);
+        if(iStatus == SUCCESS)
+            iStatus = Node_lookupChild(oNSrcParent,
+                                       Path_getComponent(oPSrc,
+                                                         ulSrcDepth - 1),
+                                       &oNSrc);
+    }
 
-        for (c = 0; c < Node_getNumDirChildren(n); c++){
-            int iStatus;
-            Node_T oNChild = NULL;
-            /* Getting Directory Nodes Second*/
-            iStatus = Node_getChild(n,c, FALSE,&oNChild);
-            assert(iStatus == SUCCESS);
-            i = FT_preOrderTraversal(oNChild, d, i);
-        }
+    /* and where to: there is only ever one root */
+    if(iStatus == SUCCESS && ulDstDepth == 1) {
+        if(!strcmp(Node_getName(FT_getRoot(oFTree)), pcDstName))
+            iStatus = ALREADY_IN_TREE;
+        else
+            iStatus = CONFLICTING_PATH;
+    }
+    else if(iStatus == SUCCESS) {
+        iStatus = FT_findParent(oFTree, oPDst, &oNDstParent);
+        if(iStatus == SUCCESS && Node_isFileNode(oNDstParent))
+            iStatus = NOT_A_DIRECTORY;
+        else if(iStatus == SUCCESS &&
+                (Node_hasDirChild(oNDstParent, pcDstName, &ulChildID) ||
+                 Node_hasFileChild(oNDstParent, pcDstName, &ulChildID)))
+            iStatus = ALREADY_IN_TREE;
     }
-    return i;
+
+    if(iStatus == SUCCESS)
+        iStatus = Node_copy(oNSrc, pcDstName, &oNCopy);
+    if(iStatus == SUCCESS) {
+        iStatus = Node_publish(oNDstParent, oNCopy, oFTree->oEpoch);
+        if(iStatus != SUCCESS)
+            Node_release(oNCopy, NULL);
+    }
+    if(iStatus == SUCCESS)
+        FT_indexSubtree(oFTree, oNCopy, oPDst, TRUE);
+    /* from now on the nodes below both are shared, as with a
+       snapshot */
+    if(iStatus == SUCCESS) {
+        oFTree->bShared = TRUE;
+        FT_log(oFTree, WAL_COPY, pcSrc, pcDst, NULL, 0);
+    }
+
+    Path_free(oPSrc);
+    Path_free(oPDst);
+    return iStatus;
 }
 
-/*--------------------------------------------------------------------*/
-/*
-  Alternate version of strlen that uses pulAcc as an in-out parameter
-  to accumulate a string length, rather than returning the length of
-  oNNode's path, and also always adds one addition byte to the sum.
-*/
-static void FT_strlenAccumulate(Node_T oNNode, size_t *pulAcc) {
-   assert(pulAcc != NULL);
+/* Logs the insertion of pcPath, the path of oNNode, into the tree
+   pvTree. */
+static void FT_logInsertion(const char *pcPath, Node_T oNNode,
+                            void *pvTree) {
+   FT_T oFTree = pvTree;
+
+   assert(oFTree != NULL);
 
-   if(oNNode != NULL)
-      *pulAcc += (Path_getStrLength(Node_getPath(oNNode)) + 1);
+   if(Node_isFileNode(oNNode))
+      FT_log(oFTree, WAL_INSERTFILE, pcPath, NULL,
+             Node_getFileContent(oNNode), Node_getFileSize(oNNode));
+   else
+      FT_log(oFTree, WAL_INSERTDIR, pcPath, NULL, NULL, 0);
 }
+
 /*
-  Alternate version of strcat that inverts the typical argument
-  order, appending oNNode's path onto pcAcc, and also always adds one
-  newline at the end of the concatenated string.
+  Links oNFragment, a directory linked nowhere and named as the last
+  component of absolute path pcPath, into oFTree at pcPath, creating
+  any missing ancestors first. Returns the status documented for
+  FT_importDirIn; unless it is SUCCESS, oNFragment is still linked
+  nowhere. The caller holds oFTree's lock exclusively.
 */
-static void FT_strcatAccumulate(Node_T oNNode, char *pcAcc) {
-   assert(pcAcc != NULL);
+static int FT_graftLocked(FT_T oFTree, const char *pcPath,
+                          Node_T oNFragment){
+   Path_T oPPath = NULL;
+   Path_T oPParentPath = NULL;
+   Node_T oNParent = NULL;
+   Node_T oNRoot;
+   size_t ulDepth, ulParentLength;
+   size_t ulChildID;
+   int iStatus;
+
+   assert(oFTree != NULL);
+   assert(pcPath != NULL);
+   assert(oNFragment != NULL);
+
+   if(!oFTree->bIsInitialized || oFTree->bReadOnly)
+      return INITIALIZATION_ERROR;
+
+   iStatus = Path_new(pcPath, &oPPath);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   ulDepth = Path_getDepth(oPPath);
+
+   if(ulDepth == 1) {
+      oNRoot = FT_getRoot(oFTree);
+      if(oNRoot == NULL)
+         FT_setRoot(oFTree, oNFragment);
+      else if(!strcmp(Node_getName(oNRoot), pcPath))
+         iStatus = ALREADY_IN_TREE;
+      else
+         iStatus = CONFLICTING_PATH;
+      ulParentLength = 0;
+   }
+   else {
+      /* the ancestors, as FT_insertDir would make them */
+      iStatus = Path_prefix(oPPath, ulDepth - 1, &oPParentPath);
+      if(iStatus == SUCCESS) {
+         iStatus = FT_insertNode(oFTree, Path_getPathname(oPParentPath),
+                                 FALSE, NULL, 0, NULL, NULL, 0);
+         if(iStatus == ALREADY_IN_TREE)
+            iStatus = SUCCESS;
+      }
+      /* the parent changes too */
+      if(iStatus == SUCCESS && oFTree->bShared)
+         iStatus = FT_unsharePath(oFTree, oPPath, ulDepth - 1);
+      if(iStatus == SUCCESS)
+         iStatus = FT_findParent(oFTree, oPPath, &oNParent);
+      if(iStatus == SUCCESS && Node_isFileNode(oNParent))
+         iStatus = NOT_A_DIRECTORY;
+      else if(iStatus == SUCCESS &&
+              (Node_hasDirChild(oNParent, Node_getName(oNFragment),
+                                &ulChildID) ||
+               Node_hasFileChild(oNParent, Node_getName(oNFragment),
+                                 &ulChildID)))
+         iStatus = ALREADY_IN_TREE;
+      if(iStatus == SUCCESS)
+         iStatus = Node_publish(oNParent, oNFragment, oFTree->oEpoch);
+      ulParentLength = oPParentPath == NULL ?
+                       0 : Path_getStrLength(oPParentPath);
+   }
 
-   if(oNNode != NULL) {
-      strcat(pcAcc, Path_getPathname(Node_getPath(oNNode)));
-      strcat(pcAcc, "\n");
+   if(iStatus == SUCCESS) {
+      FT_indexSubtree(oFTree, oNFragment, oPPath, TRUE);
+      if(oFTree->oWal != NULL &&
+         FT_walkPaths(oNFragment, pcPath, ulParentLength,
+                      FT_logInsertion, oFTree) != SUCCESS)
+         Wal_fail(oFTree->oWal, MEMORY_ERROR);
    }
+
+   Path_free(oPParentPath);
+   Path_free(oPPath);
+   return iStatus;
+}
+
+/* Returns the budget of a tree made with FT_SPILL until FT_setSpillIn
+   says otherwise: half the machine's memory, or as much as a size_t
+   holds if that is unknown. */
+static size_t FT_defaultBudget(void) {
+   long lPages, lPageSize;
+
+   lPages = sysconf(_SC_PHYS_PAGES);
+   lPageSize = sysconf(_SC_PAGESIZE);
+   if(lPages <= 0 || lPageSize <= 0 ||
+      (size_t) lPages / 2 > (size_t) -1 / (size_t) lPageSize)
+      return (size_t) -1;
+   return (size_t) lPages / 2 * (size_t) lPageSize;
 }
+
 /*--------------------------------------------------------------------*/
 
-char *FT_toString(void){
-    DynArray_T nodes;
-    size_t totalStrlen = 1;
-    char *result = NULL;
+int FT_new(FT_T *poFResult){
+    return FT_newWithFlags(0, poFResult);
+}
 
-    if(!bIsInitialized)
-        return NULL;
+/*--------------------------------------------------------------------*/
 
-    nodes = DynArray_new(ulCount);
-    (void) FT_preOrderTraversal(oNRoot, nodes, 0);
+int FT_newWithFlags(unsigned int uFlags, FT_T *poFResult){
+    FT_T oFTree;
+    pthread_rwlockattr_t sAttr;
 
-    DynArray_map(nodes, (void (*)(void *, void*)) FT_strlenAccumulate,
-                (void*) &totalStrlen);
+    assert(poFResult != NULL);
 
-    result = malloc(totalStrlen);
-    if(result == NULL) {
-        DynArray_free(nodes);
-        return NULL;
+    oFTree = malloc(sizeof(struct ft));
+    if(oFTree == NULL) {
+        *poFResult = NULL;
+        return MEMORY_ERROR;
+    }
+    oFTree->bIsInitialized = TRUE;
+    oFTree->oNRoot = NULL;
+    oFTree->bThreadSafe = FALSE;
+    oFTree->bFineGrained = FALSE;
+    oFTree->bLockFreeReads = FALSE;
+    oFTree->bReadOnly = FALSE;
+    oFTree->bShared = FALSE;
+    oFTree->ulLatchedUpdates = 0;
+    oFTree->oEpoch = NULL;
+    oFTree->oNameIndex = NULL;
+    oFTree->oSizeIndex = NULL;
+    oFTree->oWal = NULL;
+    oFTree->pcBase = NULL;
+    oFTree->ulGeneration = 0;
+    oFTree->oArena = NULL;
+    oFTree->oChunkStore = NULL;
+    oFTree->bWholeFiles = (uFlags & FT_CHUNKED) == 0;
+    oFTree->bColdTier = (uFlags & FT_COLD) != 0;
+    oFTree->bSpill = (uFlags & FT_SPILL) != 0;
+
+    if(uFlags & FT_LOCKFREEREADS) {
+        if(Epoch_new(&oFTree->oEpoch) != SUCCESS) {
+            free(oFTree);
+            *poFResult = NULL;
+            return MEMORY_ERROR;
+        }
+        oFTree->bLockFreeReads = TRUE;
+    }
+
+    if(uFlags & (FT_THREADSAFE | FT_FINEGRAINED | FT_LOCKFREEREADS)) {
+        if(pthread_rwlockattr_init(&sAttr) != 0) {
+            Epoch_free(oFTree->oEpoch);
+            free(oFTree);
+            *poFResult = NULL;
+            return MEMORY_ERROR;
+        }
+#ifdef __GLIBC__
+        /* glibc prefers readers by default, which would starve the
+           occasional writer under a read-heavy load */
+        (void) pthread_rwlockattr_setkind_np(&sAttr,
+                PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+        if(pthread_rwlock_init(&oFTree->sLock, &sAttr) != 0) {
+            (void) pthread_rwlockattr_destroy(&sAttr);
+            Epoch_free(oFTree->oEpoch);
+            free(oFTree);
+            *poFResult = NULL;
+            return MEMORY_ERROR;
+        }
+        (void) pthread_rwlockattr_destroy(&sAttr);
+        oFTree->bThreadSafe = TRUE;
+        oFTree->bFineGrained =
+            (uFlags & (FT_FINEGRAINED | FT_LOCKFREEREADS)) != 0;
+    }
+
+    if(((uFlags & FT_NAMEINDEX) &&
+        NameIndex_new(&oFTree->oNameIndex) != SUCCESS) ||
+       ((uFlags & FT_SIZEINDEX) &&
+        SizeIndex_new(&oFTree->oSizeIndex) != SUCCESS) ||
+       ((uFlags & (FT_CHUNKED | FT_DEDUP | FT_COLD | FT_SPILL)) &&
+        ChunkStore_new(&oFTree->oChunkStore) != SUCCESS) ||
+       ((uFlags & FT_COLD) &&
+        ChunkStore_setCold(oFTree->oChunkStore, COLD_IDLE_MILLIS,
+                           COLD_HOT_BUFFERS) != SUCCESS) ||
+       ((uFlags & FT_SPILL) &&
+        ChunkStore_setBudget(oFTree->oChunkStore, FT_defaultBudget(),
+                             NULL) != SUCCESS)) {
+        FT_free(oFTree);
+        *poFResult = NULL;
+        return MEMORY_ERROR;
     }
-    *result = '\0';
 
-    DynArray_map(nodes, (void (*)(void *, void*)) FT_strcatAccumulate,
-                (void *) result);
+    *poFResult = oFTree;
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void FT_free(FT_T oFTree){
 
-    DynArray_free(nodes);
+    if(oFTree == NULL)
+        return;
 
-    return result;
+    /* what was appended to the log is synced, or lost with a failure
+       reported before */
+    (void) Wal_close(oFTree->oWal);
+    if(oFTree->pcBase != NULL) {
+        (void) pthread_mutex_destroy(&oFTree->sCheckpointLock);
+        free(oFTree->pcBase);
+    }
+    /* nodes still shared with a snapshot or its origin are kept */
+    if(oFTree->oNRoot != NULL)
+        Node_release(oFTree->oNRoot, NULL);
+    if(oFTree->bThreadSafe)
+        (void) pthread_rwlock_destroy(&oFTree->sLock);
+    /* frees whatever is still waiting for readers to leave */
+    Epoch_free(oFTree->oEpoch);
+    NameIndex_free(oFTree->oNameIndex);
+    SizeIndex_free(oFTree->oSizeIndex);
+    /* the contents in it go with the last tree that uses them */
+    Arena_release(oFTree->oArena);
+    /* the store goes with the last list of chunks, which a snapshot
+       may hold */
+    ChunkStore_release(oFTree->oChunkStore);
+    free(oFTree);
 }
 
+/*--------------------------------------------------------------------*/
+
+/*
+  Makes oFSnapshot, a new tree, a snapshot of oFTree. The caller holds
+  oFTree's lock exclusively, so that no mutation is half done and
+  later ones see bShared.
+*/
+static void FT_shareRoot(FT_T oFTree, FT_T oFSnapshot){
+    Node_T oNRoot;
 
+    assert(oFTree != NULL);
+    assert(oFSnapshot != NULL);
+
+    oNRoot = FT_getRoot(oFTree);
+    if(oNRoot != NULL)
+        Node_retain(oNRoot);
+    oFSnapshot->oNRoot = oNRoot;
+    if(oFTree->oArena != NULL)
+        Arena_retain(oFTree->oArena);
+    oFSnapshot->oArena = oFTree->oArena;
+    oFSnapshot->bReadOnly = TRUE;
+    oFTree->bShared = TRUE;
+}
+
+int FT_snapshotIn(FT_T oFTree, FT_T *poFResult){
+    FT_T oFSnapshot;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(poFResult != NULL);
+
+    if(!oFTree->bIsInitialized) {
+        *poFResult = NULL;
+        return INITIALIZATION_ERROR;
+    }
+    iStatus = FT_newWithFlags(0, &oFSnapshot);
+    if(iStatus != SUCCESS) {
+        *poFResult = NULL;
+        return iStatus;
+    }
+
+    FT_lockExclusive(oFTree);
+    FT_shareRoot(oFTree, oFSnapshot);
+    FT_unlock(oFTree);
+
+    *poFResult = oFSnapshot;
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int FT_init(void){
+    FT_T oFTree = &sDefaultTree;
+
+    if(oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+    oFTree->bIsInitialized = TRUE;
+    oFTree->oNRoot = NULL;
+    oFTree->bShared = FALSE;
+    oFTree->ulLatchedUpdates = 0;
+    oFTree->oNameIndex = NULL;
+    oFTree->oSizeIndex = NULL;
+    oFTree->oArena = NULL;
+    oFTree->oChunkStore = NULL;
+    oFTree->bWholeFiles = FALSE;
+    oFTree->bColdTier = FALSE;
+    oFTree->bSpill = FALSE;
+
+    return SUCCESS;
+
+}
+
+int FT_destroy(void){
+    FT_T oFTree = &sDefaultTree;
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+
+    if(oFTree->oNRoot) {
+        Node_release(oFTree->oNRoot, NULL);
+        oFTree->oNRoot = NULL;
+    }
+    Arena_release(oFTree->oArena);
+    oFTree->oArena = NULL;
+
+    oFTree->bIsInitialized = FALSE;
+
+    return SUCCESS;
+
+}
+
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions are used for generating the
+  string representation of the FT.
+*/
+
+/*
+  The state of a pre-order traversal that writes out the path of each
+  node it visits. Nodes only know their own names, so each path is the
+  line already written for the node's parent followed by the name.
+*/
+struct preOrder {
+    /* the listing so far, not terminated */
+    char *pcResult;
+    /* the number of characters in pcResult */
+    size_t ulLength;
+    /* the number of characters pcResult has room for */
+    size_t ulCapacity;
+    /* where the line of the directory whose children are being
+       visited starts in pcResult, and its length without the newline;
+       0 for both while visiting the root */
+    size_t ulParentStart;
+    size_t ulParentLength;
+    /* the same for the line written last */
+    size_t ulLastStart;
+    size_t ulLastLength;
+    /* TRUE once a line could not be added */
+    boolean bFailed;
+};
+
+/* Appends the line for n, a child of the directory whose line is
+   recorded in the traversal state pvState, to the listing. */
+static void FT_preOrderAdd(Node_T n, void *pvState) {
+    struct preOrder *psState = pvState;
+    const char *pcName;
+    size_t ulLineLength;
+    size_t ulNewCapacity;
+    char *pcNew;
+
+    assert(psState != NULL);
+
+    if(psState->bFailed)
+        return;
+    pcName = Node_getName(n);
+    ulLineLength = strlen(pcName);
+    if(psState->ulParentLength != 0)
+        ulLineLength += psState->ulParentLength + 1;
+
+    /* room for the line, its newline, and the final terminator */
+    if(psState->ulLength + ulLineLength + 2 > psState->ulCapacity) {
+        ulNewCapacity = 2 * psState->ulCapacity + ulLineLength + 2;
+        pcNew = realloc(psState->pcResult, ulNewCapacity);
+        if(pcNew == NULL) {
+            psState->bFailed = TRUE;
+            return;
+        }
+        psState->pcResult = pcNew;
+        psState->ulCapacity = ulNewCapacity;
+    }
+
+    psState->ulLastStart = psState->ulLength;
+    if(psState->ulParentLength != 0) {
+        memcpy(psState->pcResult + psState->ulLength,
+               psState->pcResult + psState->ulParentStart,
+               psState->ulParentLength);
+        psState->ulLength += psState->ulParentLength;
+        psState->pcResult[psState->ulLength++] = '/';
+    }
+    strcpy(psState->pcResult + psState->ulLength, pcName);
+    psState->ulLength += strlen(pcName);
+    psState->pcResult[psState->ulLength++] = '\n';
+    psState->ulLastLength = ulLineLength;
+}
+
+/*
+  Performs a pre-order traversal of the tree rooted at n, appending
+  each payload to the traversal state pvState: n itself, then its file
+  children, then the subtrees of its directory children.
+*/
+static void FT_preOrderTraversal(Node_T n, void *pvState) {
+    struct preOrder *psState = pvState;
+    size_t ulParentStart;
+    size_t ulParentLength;
+
+    assert(psState != NULL);
+
+    if(n != NULL) {
+        FT_preOrderAdd(n, pvState);
+        /* n's line is the prefix of its children's */
+        ulParentStart = psState->ulParentStart;
+        ulParentLength = psState->ulParentLength;
+        psState->ulParentStart = psState->ulLastStart;
+        psState->ulParentLength = psState->ulLastLength;
+        /* Getting File Nodes First*/
+        Node_mapChildren(n, TRUE, FT_preOrderAdd, pvState);
+        /* Getting Directory Nodes Second*/
+        Node_mapChildren(n, FALSE, FT_preOrderTraversal, pvState);
+        psState->ulParentStart = ulParentStart;
+        psState->ulParentLength = ulParentLength;
+    }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Performs FT_toStringIn. The caller holds oFTree's lock as needed. */
+static char *FT_toStringLocked(FT_T oFTree){
+    struct preOrder sState;
+
+    if(!oFTree->bIsInitialized)
+        return NULL;
+
+    /* lock-free writers may change the number of nodes meanwhile, so
+       the listing grows as it goes rather than being sized up front */
+    sState.ulCapacity = 1;
+    sState.pcResult = malloc(sState.ulCapacity);
+    if(sState.pcResult == NULL)
+        return NULL;
+    sState.ulLength = 0;
+    sState.ulParentStart = 0;
+    sState.ulParentLength = 0;
+    sState.ulLastStart = 0;
+    sState.ulLastLength = 0;
+    sState.bFailed = FALSE;
+    FT_preOrderTraversal(FT_getRoot(oFTree), &sState);
+    if(sState.bFailed) {
+        free(sState.pcResult);
+        return NULL;
+    }
+
+    sState.pcResult[sState.ulLength] = '\0';
+    return sState.pcResult;
+}
+
+/*
+  The state of a walk for FT_globIn, which visits only the nodes whose
+  paths could still lead to a match and writes out the path of each
+  as it goes.
+*/
+struct globWalk {
+    /* the pattern to match */
+    Pattern_T oPattern;
+    /* the state of the match at the directory whose children are
+       being visited */
+    Pattern_State sParent;
+    /* the path of the node visited last */
+    struct pathBuffer sPath;
+    /* TRUE once a path could not be written */
+    boolean bFailed;
+    /* the client's callback and its argument */
+    void (*pfApply)(const char *pcPath, boolean bIsFile, void *pvExtra);
+    void *pvExtra;
+};
+
+static void FT_globVisit(Node_T n, void *pvWalk);
+
+/* Visits those children of n, a directory, that the glob walk pvWalk
+   could match: files first, then directories. */
+static void FT_globChildren(Node_T n, void *pvWalk) {
+    struct globWalk *psWalk = pvWalk;
+    const char *pcPrefix;
+
+    assert(psWalk != NULL);
+
+    /* a literal start narrows the children to a range */
+    pcPrefix = Pattern_getPrefix(psWalk->oPattern, psWalk->sParent);
+    if(pcPrefix != NULL) {
+        Node_mapChildRange(n, TRUE, pcPrefix, FT_globVisit, pvWalk);
+        Node_mapChildRange(n, FALSE, pcPrefix, FT_globVisit, pvWalk);
+    }
+    else {
+        Node_mapChildren(n, TRUE, FT_globVisit, pvWalk);
+        Node_mapChildren(n, FALSE, FT_globVisit, pvWalk);
+    }
+}
+
+/*
+  Visits n, a child of the directory whose path and match state are
+  recorded in the glob walk pvWalk (or the root, with an empty path):
+  reports n if its path matches, and goes on to its children unless
+  nothing below n can match.
+*/
+static void FT_globVisit(Node_T n, void *pvWalk) {
+    struct globWalk *psWalk = pvWalk;
+    Pattern_State sState;
+    Pattern_State sParent;
+    const char *pcName;
+    size_t ulParentLength;
+
+    assert(psWalk != NULL);
+
+    if(psWalk->bFailed)
+        return;
+    pcName = Node_getName(n);
+    sState = Pattern_step(psWalk->oPattern, psWalk->sParent, pcName);
+    if(sState == 0)
+        return;
+
+    ulParentLength = psWalk->sPath.ulLength;
+    if(!FT_pathAppend(&psWalk->sPath, pcName)) {
+        psWalk->bFailed = TRUE;
+        return;
+    }
+
+    if(Pattern_isMatch(psWalk->oPattern, sState))
+        (*psWalk->pfApply)(psWalk->sPath.pcPath, Node_isFileNode(n),
+                           psWalk->pvExtra);
+    if(!Node_isFileNode(n) &&
+       Pattern_canExtend(psWalk->oPattern, sState)) {
+        sParent = psWalk->sParent;
+        psWalk->sParent = sState;
+        FT_globChildren(n, pvWalk);
+        psWalk->sParent = sParent;
+    }
+
+    FT_pathTruncate(&psWalk->sPath, ulParentLength);
+}
+
+/* Performs FT_globIn. The caller holds oFTree's lock as needed. */
+static int FT_globLocked(FT_T oFTree, Pattern_T oPattern,
+                         void (*pfApply)(const char *pcPath,
+                                         boolean bIsFile, void *pvExtra),
+                         void *pvExtra){
+    struct globWalk sWalk;
+    Node_T oNRoot;
+
+    assert(oFTree != NULL);
+    assert(oPattern != NULL);
+    assert(pfApply != NULL);
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+    oNRoot = FT_getRoot(oFTree);
+    if(oNRoot == NULL)
+        return SUCCESS;
+
+    if(!FT_pathStart(&sWalk.sPath, "", 0))
+        return MEMORY_ERROR;
+    sWalk.oPattern = oPattern;
+    sWalk.sParent = Pattern_start(oPattern);
+    sWalk.bFailed = FALSE;
+    sWalk.pfApply = pfApply;
+    sWalk.pvExtra = pvExtra;
+    FT_globVisit(oNRoot, &sWalk);
+    free(sWalk.sPath.pcPath);
+
+    if(sWalk.bFailed)
+        return MEMORY_ERROR;
+    return SUCCESS;
+}
+
+/* What FT_findByNameIn looks for when it has no index to use */
+struct nameSearch {
+    /* the last component of the paths sought */
+    const char *pcName;
+    /* the client's callback and its argument */
+    void (*pfApply)(const char *pcPath, boolean bIsFile, void *pvExtra);
+    void *pvExtra;
+};
+
+/* Reports pcPath, the path of oNNode, to the client of the name
+   search pvSearch if oNNode has the name sought. */
+static void FT_nameVisit(const char *pcPath, Node_T oNNode,
+                         void *pvSearch) {
+    struct nameSearch *psSearch = pvSearch;
+
+    assert(psSearch != NULL);
+
+    if(!strcmp(Node_getName(oNNode), psSearch->pcName))
+        (*psSearch->pfApply)(pcPath, Node_isFileNode(oNNode),
+                             psSearch->pvExtra);
+}
+
+/* Performs FT_findByNameIn by walking all of oFTree. The caller holds
+   oFTree's lock as needed. */
+static int FT_findByNameLocked(FT_T oFTree, const char *pcName,
+                               void (*pfApply)(const char *pcPath,
+                                               boolean bIsFile,
+                                               void *pvExtra),
+                               void *pvExtra){
+    struct nameSearch sSearch;
+    Node_T oNRoot;
+
+    assert(oFTree != NULL);
+    assert(pcName != NULL);
+    assert(pfApply != NULL);
+
+    if(!oFTree->bIsInitialized)
+        return INITIALIZATION_ERROR;
+    oNRoot = FT_getRoot(oFTree);
+    if(oNRoot == NULL)
+        return SUCCESS;
+
+    sSearch.pcName = pcName;
+    sSearch.pfApply = pfApply;
+    sSearch.pvExtra = pvExtra;
+    return FT_walkPaths(oNRoot, "", 0, FT_nameVisit, &sSearch);
+}
+
+/* What FT_topKIn and FT_sizeRangeIn look for */
+struct sizeQuery {
+    /* the directory the files must be below, and its length */
+    const char *pcDir;
+    size_t ulDirLength;
+    /* the smallest size wanted */
+    size_t ulLow;
+    /* the number of files still wanted */
+    size_t ulLeft;
+    /* the client's callback and its argument */
+    void (*pfApply)(const char *pcPath, size_t ulSize, void *pvExtra);
+    void *pvExtra;
+};
+
+/*
+  Offers the file pcPath of size ulSize, the next in order of size, to
+  the size query pvQuery, which reports it if it is wanted. Returns
+  FALSE once no later file can be.
+*/
+static boolean FT_sizeTake(const char *pcPath, size_t ulSize,
+                           void *pvQuery) {
+    struct sizeQuery *psQuery = pvQuery;
+
+    assert(pcPath != NULL);
+    assert(psQuery != NULL);
+
+    if(psQuery->ulLeft == 0 || ulSize < psQuery->ulLow)
+        return FALSE;
+    if(strncmp(pcPath, psQuery->pcDir, psQuery->ulDirLength) ||
+       pcPath[psQuery->ulDirLength] != '/')
+        return TRUE;
+    (*psQuery->pfApply)(pcPath, ulSize, psQuery->pvExtra);
+    return --psQuery->ulLeft > 0;
+}
+
+/* A file found by a walk for FT_topKIn or FT_sizeRangeIn */
+struct sizedPath {
+    /* its absolute path */
+    char *pcPath;
+    /* its size */
+    size_t ulSize;
+};
+
+/* The files found so far by a walk for FT_topKIn or FT_sizeRangeIn */
+struct sizeWalk {
+    /* the files, in the order found */
+    struct sizedPath *psFiles;
+    /* the number of files, and of files psFiles has room for */
+    size_t ulCount;
+    size_t ulCapacity;
+    /* the range of sizes wanted */
+    size_t ulLow;
+    size_t ulHigh;
+    /* TRUE once a file could not be recorded */
+    boolean bFailed;
+};
+
+/* Records pcPath, the path of oNNode, in the size walk pvWalk if
+   oNNode is a file of a size wanted. */
+static void FT_sizeVisit(const char *pcPath, Node_T oNNode,
+                         void *pvWalk) {
+    struct sizeWalk *psWalk = pvWalk;
+    struct sizedPath *psNew;
+    size_t ulNewCapacity;
+    size_t ulSize;
+
+    assert(psWalk != NULL);
+
+    if(psWalk->bFailed || !Node_isFileNode(oNNode))
+        return;
+    ulSize = Node_getFileSize(oNNode);
+    if(ulSize < psWalk->ulLow || ulSize > psWalk->ulHigh)
+        return;
+
+    if(psWalk->ulCount == psWalk->ulCapacity) {
+        ulNewCapacity = 2 * psWalk->ulCapacity + 16;
+        psNew = realloc(psWalk->psFiles,
+                        ulNewCapacity * sizeof(struct sizedPath));
+        if(psNew == NULL) {
+            psWalk->bFailed = TRUE;
+            return;
+        }
+        psWalk->psFiles = psNew;
+        psWalk->ulCapacity = ulNewCapacity;
+    }
+    psNew = &psWalk->psFiles[psWalk->ulCount];
+    psNew->pcPath = malloc(strlen(pcPath) + 1);
+    if(psNew->pcPath == NULL) {
+        psWalk->bFailed = TRUE;
+        return;
+    }
+    strcpy(psNew->pcPath, pcPath);
+    psNew->ulSize = ulSize;
+    psWalk->ulCount++;
+}
+
+/* Compares the files pvFirst and pvSecond in the order of a
+   SizeIndex_T: by decreasing size, then by path. */
+static int FT_compareSized(const void *pvFirst, const void *pvSecond) {
+    const struct sizedPath *psFirst = pvFirst;
+    const struct sizedPath *psSecond = pvSecond;
+
+    assert(psFirst != NULL);
+    assert(psSecond != NULL);
+
+    if(psFirst->ulSize != psSecond->ulSize)
+        return (psFirst->ulSize > psSecond->ulSize) ? -1 : 1;
+    return strcmp(psFirst->pcPath, psSecond->pcPath);
+}
+
+/*
+  Performs the size query psQuery by walking the files below its
+  directory, up to ulHigh bytes in size, and sorting them. The caller
+  holds oFTree's lock as needed.
+*/
+static int FT_sizeQueryLocked(FT_T oFTree, struct sizeQuery *psQuery,
+                              size_t ulHigh){
+    struct sizeWalk sWalk;
+    Node_T oNDir = NULL;
+    const char *pcSlash;
+    size_t i;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(psQuery != NULL);
+
+    iStatus = FT_findNode(oFTree, psQuery->pcDir, FALSE, &oNDir);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    if(Node_isFileNode(oNDir)) {
+        FT_unlatch(oFTree, FALSE, oNDir);
+        return NOT_A_DIRECTORY;
+    }
+
+    sWalk.psFiles = NULL;
+    sWalk.ulCount = 0;
+    sWalk.ulCapacity = 0;
+    sWalk.ulLow = psQuery->ulLow;
+    sWalk.ulHigh = ulHigh;
+    sWalk.bFailed = FALSE;
+    pcSlash = strrchr(psQuery->pcDir, '/');
+    iStatus = FT_walkPaths(oNDir, psQuery->pcDir,
+                           (pcSlash == NULL) ? 0 :
+                           (size_t) (pcSlash - psQuery->pcDir),
+                           FT_sizeVisit, &sWalk);
+    FT_unlatch(oFTree, FALSE, oNDir);
+    if(iStatus == SUCCESS && sWalk.bFailed)
+        iStatus = MEMORY_ERROR;
+
+    if(iStatus == SUCCESS && sWalk.ulCount > 0) {
+        qsort(sWalk.psFiles, sWalk.ulCount, sizeof(struct sizedPath),
+              FT_compareSized);
+        for(i = 0; i < sWalk.ulCount; i++)
+            if(!FT_sizeTake(sWalk.psFiles[i].pcPath,
+                            sWalk.psFiles[i].ulSize, psQuery))
+                break;
+    }
+    for(i = 0; i < sWalk.ulCount; i++)
+        free(sWalk.psFiles[i].pcPath);
+    free(sWalk.psFiles);
+    return iStatus;
+}
+
+/*
+  The state of a scan through one kind of children of a directory for
+  FT_listRangeIn, which takes them in order while they are in range.
+*/
+struct listScan {
+    /* names must be less than this, unless it is NULL */
+    const char *pcHigh;
+    /* and start with this, unless it is NULL */
+    const char *pcPrefix;
+    /* the entries taken so far, their number, and the most to take */
+    struct FT_entry *psEntries;
+    size_t ulCount;
+    size_t ulLimit;
+    /* TRUE once a name could not be copied */
+    boolean bFailed;
+};
+
+/* Takes the child n into the scan pvScan if it is in range and there
+   is room, and returns TRUE if the scan should go on. */
+static boolean FT_listTake(Node_T n, void *pvScan) {
+    struct listScan *psScan = pvScan;
+    struct FT_entry *psEntry;
+    const char *pcName;
+
+    assert(psScan != NULL);
+
+    pcName = Node_getName(n);
+    if(psScan->ulCount == psScan->ulLimit ||
+       (psScan->pcHigh != NULL && strcmp(pcName, psScan->pcHigh) >= 0) ||
+       (psScan->pcPrefix != NULL &&
+        strncmp(pcName, psScan->pcPrefix, strlen(psScan->pcPrefix))))
+        return FALSE;
+
+    psEntry = &psScan->psEntries[psScan->ulCount];
+    psEntry->pcName = malloc(strlen(pcName) + 1);
+    if(psEntry->pcName == NULL) {
+        psScan->bFailed = TRUE;
+        return FALSE;
+    }
+    strcpy(psEntry->pcName, pcName);
+    psEntry->bIsFile = Node_isFileNode(n);
+    psEntry->ulSize = Node_getFileSize(n);
+    psScan->ulCount++;
+    return TRUE;
+}
+
+/*
+  Performs FT_listRangeIn and FT_listPrefixIn: lists the children of
+  pcDir whose names are not less than pcLow, less than pcHigh, start
+  with pcPrefix and are greater than pcCursor, ignoring whichever of
+  these is NULL. The caller holds oFTree's lock as needed.
+*/
+static int FT_listLocked(FT_T oFTree, const char *pcDir,
+                         const char *pcLow, const char *pcHigh,
+                         const char *pcPrefix, size_t ulLimit,
+                         const char *pcCursor, struct FT_entry *psEntries,
+                         size_t *pulCount){
+    struct listScan sFiles;
+    struct listScan sDirs;
+    Node_T oNDir = NULL;
+    const char *pcFrom;
+    boolean bInclusive = TRUE;
+    size_t ulFiles, ulDirs;
+    size_t i;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcDir != NULL);
+    assert(psEntries != NULL || ulLimit == 0);
+    assert(pulCount != NULL);
+
+    *pulCount = 0;
+    iStatus = FT_findNode(oFTree, pcDir, FALSE, &oNDir);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    if(Node_isFileNode(oNDir)) {
+        FT_unlatch(oFTree, FALSE, oNDir);
+        return NOT_A_DIRECTORY;
+    }
+    if(ulLimit == 0) {
+        FT_unlatch(oFTree, FALSE, oNDir);
+        return SUCCESS;
+    }
+
+    /* start at the greatest of the lower bounds */
+    pcFrom = pcLow;
+    if(pcPrefix != NULL && (pcFrom == NULL || strcmp(pcPrefix, pcFrom) > 0))
+        pcFrom = pcPrefix;
+    if(pcCursor != NULL && (pcFrom == NULL || strcmp(pcCursor, pcFrom) >= 0)) {
+        pcFrom = pcCursor;
+        bInclusive = FALSE;
+    }
+
+    /* each kind is in order of its own, so take up to a page of both */
+    sFiles.pcHigh = pcHigh;
+    sFiles.pcPrefix = pcPrefix;
+    sFiles.psEntries = psEntries;
+    sFiles.ulCount = 0;
+    sFiles.ulLimit = ulLimit;
+    sFiles.bFailed = FALSE;
+    sDirs = sFiles;
+    sDirs.psEntries = malloc(ulLimit * sizeof(struct FT_entry));
+    if(sDirs.psEntries == NULL) {
+        FT_unlatch(oFTree, FALSE, oNDir);
+        return MEMORY_ERROR;
+    }
+    Node_mapChildrenFrom(oNDir, TRUE, pcFrom, bInclusive, FT_listTake,
+                         &sFiles);
+    if(!sFiles.bFailed)
+        Node_mapChildrenFrom(oNDir, FALSE, pcFrom, bInclusive,
+                             FT_listTake, &sDirs);
+    FT_unlatch(oFTree, FALSE, oNDir);
+    if(sFiles.bFailed || sDirs.bFailed) {
+        FT_freeEntries(sFiles.psEntries, sFiles.ulCount);
+        FT_freeEntries(sDirs.psEntries, sDirs.ulCount);
+        free(sDirs.psEntries);
+        return MEMORY_ERROR;
+    }
+
+    /* find how many of each make up the page... */
+    ulFiles = 0;
+    ulDirs = 0;
+    while(ulFiles + ulDirs < ulLimit &&
+          ulFiles + ulDirs < sFiles.ulCount + sDirs.ulCount) {
+        if(ulDirs == sDirs.ulCount ||
+           (ulFiles < sFiles.ulCount &&
+            strcmp(sFiles.psEntries[ulFiles].pcName,
+                   sDirs.psEntries[ulDirs].pcName) < 0))
+            ulFiles++;
+        else
+            ulDirs++;
+    }
+    FT_freeEntries(sFiles.psEntries + ulFiles, sFiles.ulCount - ulFiles);
+    FT_freeEntries(sDirs.psEntries + ulDirs, sDirs.ulCount - ulDirs);
+    *pulCount = ulFiles + ulDirs;
+
+    /* ...and merge them from the back, where psEntries has room */
+    while(ulDirs > 0) {
+        i = ulFiles + ulDirs - 1;
+        if(ulFiles > 0 && strcmp(psEntries[ulFiles - 1].pcName,
+                                 sDirs.psEntries[ulDirs - 1].pcName) > 0)
+            psEntries[i] = psEntries[--ulFiles];
+        else
+            psEntries[i] = sDirs.psEntries[--ulDirs];
+    }
+    free(sDirs.psEntries);
+    return SUCCESS;
+}
+
+/* Performs FT_listDirIn. The caller holds oFTree's lock as needed. */
+static int FT_listDirLocked(FT_T oFTree, const char *pcDir,
+                            size_t ulOffset,
+                            const struct FT_entry *psAfter,
+                            size_t ulLimit, struct FT_entry *psEntries,
+                            size_t *pulCount){
+    struct listScan sScan;
+    Node_T oNDir = NULL;
+    size_t ulFiles;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcDir != NULL);
+    assert(psEntries != NULL || ulLimit == 0);
+    assert(pulCount != NULL);
+
+    *pulCount = 0;
+    iStatus = FT_findNode(oFTree, pcDir, FALSE, &oNDir);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    if(Node_isFileNode(oNDir)) {
+        FT_unlatch(oFTree, FALSE, oNDir);
+        return NOT_A_DIRECTORY;
+    }
+
+    sScan.pcHigh = NULL;
+    sScan.pcPrefix = NULL;
+    sScan.psEntries = psEntries;
+    sScan.ulCount = 0;
+    sScan.ulLimit = ulLimit;
+    sScan.bFailed = FALSE;
+
+    /* the files, unless the page starts among the directories */
+    if(psAfter != NULL && psAfter->bIsFile)
+        Node_mapChildrenFrom(oNDir, TRUE, psAfter->pcName, FALSE,
+                             FT_listTake, &sScan);
+    else if(psAfter == NULL) {
+        ulFiles = Node_getNumFileChildren(oNDir);
+        if(ulOffset < ulFiles)
+            Node_mapChildrenAt(oNDir, TRUE, ulOffset, FT_listTake,
+                               &sScan);
+        ulOffset = (ulOffset < ulFiles) ? 0 : ulOffset - ulFiles;
+    }
+
+    /* then the directories */
+    if(!sScan.bFailed && sScan.ulCount < ulLimit) {
+        if(psAfter != NULL && !psAfter->bIsFile)
+            Node_mapChildrenFrom(oNDir, FALSE, psAfter->pcName, FALSE,
+                                 FT_listTake, &sScan);
+        else
+            Node_mapChildrenAt(oNDir, FALSE,
+                               (psAfter == NULL) ? ulOffset : 0,
+                               FT_listTake, &sScan);
+    }
+    FT_unlatch(oFTree, FALSE, oNDir);
+
+    if(sScan.bFailed) {
+        FT_freeEntries(psEntries, sScan.ulCount);
+        return MEMORY_ERROR;
+    }
+    *pulCount = sScan.ulCount;
+    return SUCCESS;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions take oFTree's lock around the work done by
+  the corresponding *Locked function: shared for lookups, exclusive
+  for anything that changes the tree. In a fine-grained tree, changes
+  share the lock as well and rely on node latches, except when they
+  may create or remove the root. With lock-free lookups, lookups run
+  inside an epoch section instead of taking the lock.
+*/
+
+/*
+  Begins a lookup in oFTree: takes its lock shared, or enters its
+  epoch if lookups are lock-free. Returns SUCCESS, or MEMORY_ERROR if
+  the lookup cannot begin.
+*/
+static int FT_beginLookup(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    if(oFTree->bLockFreeReads)
+        return Epoch_enter(oFTree->oEpoch);
+    FT_lockShared(oFTree);
+    return SUCCESS;
+}
+
+/* Ends a lookup in oFTree begun by FT_beginLookup. */
+static void FT_endLookup(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    if(oFTree->bLockFreeReads)
+        Epoch_leave(oFTree->oEpoch);
+    else
+        FT_unlock(oFTree);
+}
+
+/*
+  Begins a walk over oFTree, which latches nothing: takes its lock
+  shared, or exclusively if oFTree is fine-grained, unless its child
+  arrays are published atomically for lock-free lookups, in which case
+  the walk is a lookup. Returns SUCCESS, or MEMORY_ERROR if the walk
+  cannot begin.
+*/
+static int FT_beginWalk(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    if(oFTree->bLockFreeReads)
+        return FT_beginLookup(oFTree);
+    if(oFTree->bFineGrained)
+        FT_lockExclusive(oFTree);
+    else
+        FT_lockShared(oFTree);
+    return SUCCESS;
+}
+
+/* Ends a walk over oFTree begun by FT_beginWalk. */
+static void FT_endWalk(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    if(oFTree->bLockFreeReads)
+        FT_endLookup(oFTree);
+    else
+        FT_unlock(oFTree);
+}
+
+/*
+  Returns TRUE if pcPath names the root, i.e. has a single component.
+  Malformed paths count as well, which errs on the side of locking.
+*/
+static boolean FT_isRootPath(const char *pcPath) {
+    assert(pcPath != NULL);
+
+    return strchr(pcPath, '/') == NULL;
+}
+
+/*
+  Acquires oFTree's lock for an insertion at pcPath, exclusively if
+  the insertion might create the root.
+*/
+static void FT_lockForInsert(FT_T oFTree, const char *pcPath) {
+    assert(oFTree != NULL);
+
+    FT_lockForUpdate(oFTree, FALSE, pcPath);
+    if(oFTree->bFineGrained && FT_getRoot(oFTree) == NULL) {
+        /* the root cannot disappear while the lock is held shared, but
+           it can appear, so decide whether to create it exclusively */
+        FT_unlockForUpdate(oFTree);
+        FT_lockExclusive(oFTree);
+    }
+}
+
+/* The size past which a logged tree checkpoints itself */
+enum { CHECKPOINT_SIZE = 64 * 1024 * 1024 };
+
+static int FT_checkpoint(FT_T oFTree);
+
+/*
+  Returns SUCCESS if oFTree may be changed, or the status with which
+  its log failed, after which the log no longer matches the tree and
+  nothing more may be changed.
+*/
+static int FT_logStatus(FT_T oFTree) {
+    assert(oFTree != NULL);
+
+    if(oFTree->oWal == NULL)
+        return SUCCESS;
+    return Wal_getStatus(oFTree->oWal);
+}
+
+/*
+  Commits the change to oFTree, made with its lock released since,
+  that returned iStatus: if it succeeded and oFTree is logged, waits
+  until the change is durable, syncing it along with those of any
+  other threads waiting too, and then checkpoints oFTree if its log
+  has grown past CHECKPOINT_SIZE and no other thread is checkpointing
+  it. Returns iStatus, or the status with which the log failed.
+*/
+static int FT_commit(FT_T oFTree, int iStatus) {
+    assert(oFTree != NULL);
+
+    if(oFTree->oWal == NULL || iStatus != SUCCESS)
+        return iStatus;
+    iStatus = Wal_sync(oFTree->oWal);
+    if(iStatus == SUCCESS &&
+       Wal_getSize(oFTree->oWal) > CHECKPOINT_SIZE &&
+       pthread_mutex_trylock(&oFTree->sCheckpointLock) == 0) {
+        /* a failed checkpoint leaves the log to be replayed, or fails
+           it for later changes to report */
+        if(Wal_getSize(oFTree->oWal) > CHECKPOINT_SIZE)
+            (void) FT_checkpoint(oFTree);
+        (void) pthread_mutex_unlock(&oFTree->sCheckpointLock);
+    }
+    return iStatus;
+}
+
+int FT_insertDirIn(FT_T oFTree, const char *pcPath){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_logStatus(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    FT_lockForInsert(oFTree, pcPath);
+    iStatus = FT_insertDirLocked(oFTree, pcPath);
+    FT_unlockForUpdate(oFTree);
+    return FT_commit(oFTree, iStatus);
+}
+
+boolean FT_containsDirIn(FT_T oFTree, const char *pcPath){
+    boolean bFound;
+
+    assert(oFTree != NULL);
+
+    if(FT_beginLookup(oFTree) != SUCCESS)
+        return FALSE;
+    bFound = FT_containsDirLocked(oFTree, pcPath);
+    FT_endLookup(oFTree);
+    return bFound;
+}
+
+int FT_rmDirIn(FT_T oFTree, const char *pcPath){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_logStatus(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    FT_lockForUpdate(oFTree, FT_isRootPath(pcPath), pcPath);
+    iStatus = FT_rmDirLocked(oFTree, pcPath);
+    FT_unlockForUpdate(oFTree);
+    return FT_commit(oFTree, iStatus);
+}
+
+int FT_insertFileIn(FT_T oFTree, const char *pcPath, void *pvContents,
+                    size_t ulLength){
+    ChunkList_T oChunks;
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_logStatus(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    /* the expensive part, done before any lock is taken */
+    iStatus = FT_chunk(oFTree, pvContents, ulLength, &oChunks);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    FT_lockForInsert(oFTree, pcPath);
+    iStatus = FT_insertFileLocked(oFTree, pcPath, pvContents, ulLength,
+                                  oChunks);
+    FT_unlockForUpdate(oFTree);
+    ChunkList_release(oChunks);
+    return FT_commit(oFTree, iStatus);
+}
+
+/*
+  Maps the ulLength bytes of the file iFd from offset ulOffset on
+  read-only, and sets *ppvMap and *pulMapLength to the mapping, which
+  starts at the page ulOffset lies in, and *ppvContents to where the
+  bytes begin within it, or to NULL, 0 and NULL if ulLength is 0.
+  Returns SUCCESS, or IO_ERROR if they could not be mapped or do not
+  all lie within the file, in which case errno tells why.
+*/
+static int FT_mapContents(int iFd, size_t ulOffset, size_t ulLength,
+                          void **ppvMap, size_t *pulMapLength,
+                          void **ppvContents){
+    struct stat sStat;
+    size_t ulSkip;
+    void *pvMap;
+
+    assert(ppvMap != NULL);
+    assert(pulMapLength != NULL);
+    assert(ppvContents != NULL);
+
+    *ppvMap = NULL;
+    *pulMapLength = 0;
+    *ppvContents = NULL;
+    if(fstat(iFd, &sStat) != 0)
+        return IO_ERROR;
+    /* touching a page past the end of the file raises SIGBUS */
+    if(ulOffset > (size_t) -1 - ulLength || sStat.st_size < 0 ||
+       ulOffset + ulLength > (size_t) sStat.st_size) {
+        errno = EINVAL;
+        return IO_ERROR;
+    }
+    if(ulLength == 0)
+        return SUCCESS;
+    ulSkip = ulOffset % (size_t) sysconf(_SC_PAGESIZE);
+    pvMap = mmap(NULL, ulSkip + ulLength, PROT_READ, MAP_SHARED, iFd,
+                 (off_t) (ulOffset - ulSkip));
+    if(pvMap == MAP_FAILED)
+        return IO_ERROR;
+    *ppvMap = pvMap;
+    *pulMapLength = ulSkip + ulLength;
+    *ppvContents = (char *) pvMap + ulSkip;
+    return SUCCESS;
+}
+
+int FT_insertFileMappedIn(FT_T oFTree, const char *pcPath, int iFd,
+                          size_t ulOffset, size_t ulLength){
+    ChunkList_T oChunks;
+    void *pvMap;
+    void *pvContents;
+    size_t ulMapLength;
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_logStatus(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_mapContents(iFd, ulOffset, ulLength, &pvMap,
+                             &ulMapLength, &pvContents);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    /* a store copies the contents straight from the mapping */
+    iStatus = FT_chunk(oFTree, pvContents, ulLength, &oChunks);
+    if(iStatus == SUCCESS) {
+        FT_lockForInsert(oFTree, pcPath);
+        iStatus = FT_insertNode(oFTree, pcPath, TRUE, pvContents,
+                                ulLength, oChunks,
+                                oChunks == NULL ? pvMap : NULL,
+                                ulMapLength);
+        FT_unlockForUpdate(oFTree);
+    }
+    ChunkList_release(oChunks);
+    /* otherwise the new file owns the mapping */
+    if(pvMap != NULL && (oChunks != NULL || iStatus != SUCCESS))
+        (void) munmap(pvMap, ulMapLength);
+    return FT_commit(oFTree, iStatus);
+}
+
+boolean FT_containsFileIn(FT_T oFTree, const char *pcPath){
+    boolean bFound;
+
+    assert(oFTree != NULL);
+
+    if(FT_beginLookup(oFTree) != SUCCESS)
+        return FALSE;
+    bFound = FT_containsFileLocked(oFTree, pcPath);
+    FT_endLookup(oFTree);
+    return bFound;
+}
+
+int FT_rmFileIn(FT_T oFTree, const char *pcPath){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_logStatus(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    FT_lockForUpdate(oFTree, FALSE, pcPath);
+    iStatus = FT_rmFileLocked(oFTree, pcPath);
+    FT_unlockForUpdate(oFTree);
+    return FT_commit(oFTree, iStatus);
+}
+
+void *FT_getFileContentsIn(FT_T oFTree, const char *pcPath){
+    void *pvContents;
+
+    assert(oFTree != NULL);
+
+    if(FT_beginLookup(oFTree) != SUCCESS)
+        return NULL;
+    pvContents = FT_getFileContentsLocked(oFTree, pcPath);
+    FT_endLookup(oFTree);
+    return pvContents;
+}
+
+void *FT_replaceFileContentsIn(FT_T oFTree, const char *pcPath,
+                               void *pvNewContents, size_t ulNewLength){
+    void *pvOldContents;
+    ChunkList_T oChunks;
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    if(FT_logStatus(oFTree) != SUCCESS)
+        return NULL;
+    if(FT_chunk(oFTree, pvNewContents, ulNewLength, &oChunks) != SUCCESS)
+        return NULL;
+    FT_lockForUpdate(oFTree, FALSE, pcPath);
+    pvOldContents = FT_replaceFileContentsLocked(oFTree, pcPath,
+                                                 pvNewContents,
+                                                 ulNewLength, oChunks,
+                                                 &iStatus);
+    FT_unlockForUpdate(oFTree);
+    ChunkList_release(oChunks);
+    /* only a replace that was logged waits for the log */
+    (void) FT_commit(oFTree, iStatus);
+    return pvOldContents;
+}
+
+int FT_readAtIn(FT_T oFTree, const char *pcPath, size_t ulOffset,
+                void *pvDest, size_t ulCount, size_t *pulRead){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_beginLookup(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_readAtLocked(oFTree, pcPath, ulOffset, pvDest, ulCount,
+                              pulRead);
+    FT_endLookup(oFTree);
+    return iStatus;
+}
+
+int FT_sendFileIn(FT_T oFTree, const char *pcPath, int iFd,
+                  size_t ulOffset, size_t ulCount, size_t *pulSent){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_beginLookup(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_sendFileLocked(oFTree, pcPath, iFd, ulOffset, ulCount,
+                                pulSent);
+    FT_endLookup(oFTree);
+    return iStatus;
+}
+
+int FT_writeAtIn(FT_T oFTree, const char *pcPath, size_t ulOffset,
+                 const void *pvBytes, size_t ulCount){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_logStatus(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    FT_lockForUpdate(oFTree, FALSE, pcPath);
+    iStatus = FT_writeLocked(oFTree, pcPath, ulOffset, pvBytes, ulCount,
+                             FALSE);
+    FT_unlockForUpdate(oFTree);
+    return FT_commit(oFTree, iStatus);
+}
+
+int FT_appendIn(FT_T oFTree, const char *pcPath, const void *pvBytes,
+                size_t ulCount){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_logStatus(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    FT_lockForUpdate(oFTree, FALSE, pcPath);
+    iStatus = FT_writeLocked(oFTree, pcPath, 0, pvBytes, ulCount, TRUE);
+    FT_unlockForUpdate(oFTree);
+    return FT_commit(oFTree, iStatus);
+}
+
+int FT_statIn(FT_T oFTree, const char *pcPath, boolean *pbIsFile,
+              size_t *pulSize){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_beginLookup(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_statLocked(oFTree, pcPath, pbIsFile, pulSize);
+    FT_endLookup(oFTree);
+    return iStatus;
+}
+
+/* The sums FT_statStoredIn adds up over a subtree */
+struct storedSum {
+   /* the sizes of the files */
+   size_t ulSize;
+   /* the memory their contents take */
+   size_t ulStored;
+   /* TRUE if each file must be latched to be looked at */
+   boolean bLatch;
+};
+
+/* Adds the files of the subtree rooted at oNNode to the storedSum
+   pvSum. */
+static void FT_storedVisit(Node_T oNNode, void *pvSum) {
+   struct storedSum *psSum = pvSum;
+
+   assert(oNNode != NULL);
+   assert(psSum != NULL);
+
+   if(!Node_isFileNode(oNNode)) {
+      Node_mapChildren(oNNode, TRUE, FT_storedVisit, psSum);
+      Node_mapChildren(oNNode, FALSE, FT_storedVisit, psSum);
+      return;
+   }
+   /* a writer may be giving the file a buffer of its own */
+   if(psSum->bLatch)
+      Node_latchShared(oNNode);
+   psSum->ulSize += Node_getFileSize(oNNode);
+   psSum->ulStored += Node_getStoredSize(oNNode);
+   if(psSum->bLatch)
+      Node_unlatch(oNNode);
+}
+
+int FT_statStoredIn(FT_T oFTree, const char *pcPath, boolean *pbIsFile,
+                    size_t *pulSize, size_t *pulStored){
+   struct storedSum sSum;
+   Node_T oNFound = NULL;
+   int iStatus;
+
+   assert(oFTree != NULL);
+   assert(pcPath != NULL);
+   assert(pbIsFile != NULL);
+   assert(pulSize != NULL);
+   assert(pulStored != NULL);
+
+   if(!oFTree->bIsInitialized)
+      return INITIALIZATION_ERROR;
+   iStatus = FT_beginWalk(oFTree);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   iStatus = FT_findNode(oFTree, pcPath, FALSE, &oNFound);
+   if(iStatus == SUCCESS) {
+      sSum.ulSize = 0;
+      sSum.ulStored = 0;
+      sSum.bLatch = oFTree->bLockFreeReads;
+      FT_storedVisit(oNFound, &sSum);
+      *pbIsFile = Node_isFileNode(oNFound);
+      *pulSize = sSum.ulSize;
+      *pulStored = sSum.ulStored;
+      FT_unlatch(oFTree, FALSE, oNFound);
+   }
+   FT_endWalk(oFTree);
+   return iStatus;
+}
+
+int FT_moveIn(FT_T oFTree, const char *pcSrc, const char *pcDst){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_logStatus(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    /* two parents change, so no latch order would do */
+    FT_lockExclusive(oFTree);
+    iStatus = FT_moveLocked(oFTree, pcSrc, pcDst);
+    FT_unlock(oFTree);
+    return FT_commit(oFTree, iStatus);
+}
+
+int FT_copyIn(FT_T oFTree, const char *pcSrc, const char *pcDst){
+    int iStatus;
+
+    assert(oFTree != NULL);
+
+    iStatus = FT_logStatus(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    /* every later mutation must see bShared */
+    FT_lockExclusive(oFTree);
+    iStatus = FT_copyLocked(oFTree, pcSrc, pcDst);
+    FT_unlock(oFTree);
+    return FT_commit(oFTree, iStatus);
+}
+
+int FT_importDirIn(FT_T oFTree, const char *pcFsPath,
+                   const char *pcTreePath, size_t ulThreads,
+                   unsigned int uFlags){
+   Path_T oPPath;
+   Node_T oNFragment;
+   int iStatus;
+   int iErrno;
+
+   assert(oFTree != NULL);
+   assert(pcFsPath != NULL);
+   assert(pcTreePath != NULL);
+
+   if(!oFTree->bIsInitialized || oFTree->bReadOnly)
+      return INITIALIZATION_ERROR;
+   iStatus = FT_logStatus(oFTree);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   /* a bad path fails before anything is read */
+   iStatus = Path_new(pcTreePath, &oPPath);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   /* the scan runs unlocked; only linking its result needs the lock */
+   iStatus = Import_scan(pcFsPath,
+                         Path_getComponent(oPPath,
+                                           Path_getDepth(oPPath) - 1),
+                         ulThreads, (uFlags & FT_IMPORTCONTENTS) != 0,
+                         &oNFragment);
+   Path_free(oPPath);
+   if(iStatus == SUCCESS) {
+      FT_lockExclusive(oFTree);
+      iStatus = FT_graftLocked(oFTree, pcTreePath, oNFragment);
+      FT_unlock(oFTree);
+   }
+   if(iStatus != SUCCESS) {
+      iErrno = errno;
+      Import_free(oNFragment);
+      errno = iErrno;
+   }
+   return FT_commit(oFTree, iStatus);
+}
+
+char *FT_toStringIn(FT_T oFTree){
+    char *pcResult;
+
+    assert(oFTree != NULL);
+
+    if(FT_beginWalk(oFTree) != SUCCESS)
+        return NULL;
+    pcResult = FT_toStringLocked(oFTree);
+    FT_endWalk(oFTree);
+    return pcResult;
+}
+
+int FT_listRangeIn(FT_T oFTree, const char *pcDir, const char *pcLow,
+                   const char *pcHigh, size_t ulLimit,
+                   const char *pcCursor, struct FT_entry *psEntries,
+                   size_t *pulCount){
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pulCount != NULL);
+
+    *pulCount = 0;
+    iStatus = FT_beginLookup(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_listLocked(oFTree, pcDir, pcLow, pcHigh, NULL, ulLimit,
+                            pcCursor, psEntries, pulCount);
+    FT_endLookup(oFTree);
+    return iStatus;
+}
+
+int FT_listPrefixIn(FT_T oFTree, const char *pcDir, const char *pcPrefix,
+                    size_t ulLimit, const char *pcCursor,
+                    struct FT_entry *psEntries, size_t *pulCount){
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcPrefix != NULL);
+    assert(pulCount != NULL);
+
+    *pulCount = 0;
+    iStatus = FT_beginLookup(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_listLocked(oFTree, pcDir, NULL, NULL, pcPrefix, ulLimit,
+                            pcCursor, psEntries, pulCount);
+    FT_endLookup(oFTree);
+    return iStatus;
+}
+
+int FT_listDirIn(FT_T oFTree, const char *pcDir, size_t ulOffset,
+                 const struct FT_entry *psAfter, size_t ulLimit,
+                 struct FT_entry *psEntries, size_t *pulCount){
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pulCount != NULL);
+
+    *pulCount = 0;
+    iStatus = FT_beginLookup(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_listDirLocked(oFTree, pcDir, ulOffset, psAfter, ulLimit,
+                               psEntries, pulCount);
+    FT_endLookup(oFTree);
+    return iStatus;
+}
+
+int FT_globIn(FT_T oFTree, const char *pcPattern,
+              void (*pfApply)(const char *pcPath, boolean bIsFile,
+                              void *pvExtra),
+              void *pvExtra){
+    Pattern_T oPattern;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcPattern != NULL);
+    assert(pfApply != NULL);
+
+    iStatus = Pattern_new(pcPattern, &oPattern);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_beginWalk(oFTree);
+    if(iStatus == SUCCESS) {
+        iStatus = FT_globLocked(oFTree, oPattern, pfApply, pvExtra);
+        FT_endWalk(oFTree);
+    }
+    Pattern_free(oPattern);
+    return iStatus;
+}
+
+int FT_findByNameIn(FT_T oFTree, const char *pcName,
+                    void (*pfApply)(const char *pcPath, boolean bIsFile,
+                                    void *pvExtra),
+                    void *pvExtra){
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(pcName != NULL);
+    assert(pfApply != NULL);
+
+    if(*pcName == '\0' || strchr(pcName, '/') != NULL)
+        return BAD_PATH;
+    /* only trees from FT_newWithFlags have an index, and those are
+       always initialized */
+    if(oFTree->oNameIndex != NULL &&
+       NameIndex_map(oFTree->oNameIndex, pcName, pfApply, pvExtra))
+        return SUCCESS;
+
+    iStatus = FT_beginWalk(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_findByNameLocked(oFTree, pcName, pfApply, pvExtra);
+    FT_endWalk(oFTree);
+    return iStatus;
+}
+
+/*
+  Returns TRUE if there are no more than *pulBudget nodes below the
+  directory oNDir, counting it, and spends the budget on them, giving
+  up once it runs out. The caller holds oFTree's lock for a walk.
+*/
+static boolean FT_isSmall(Node_T oNDir, size_t *pulBudget){
+    Node_T oNChild = NULL;
+    size_t ulDirs;
+    size_t i;
+    int iStatus;
+
+    assert(oNDir != NULL);
+    assert(pulBudget != NULL);
+
+    if(Node_getNumFileChildren(oNDir) >= *pulBudget)
+        return FALSE;
+    *pulBudget -= Node_getNumFileChildren(oNDir) + 1;
+    ulDirs = Node_getNumDirChildren(oNDir);
+    for(i = 0; i < ulDirs; i++) {
+        iStatus = Node_getChild(oNDir, i, FALSE, &oNChild);
+        assert(iStatus == SUCCESS);
+        if(!FT_isSmall(oNChild, pulBudget))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+  Returns the number of nodes below a directory small enough that
+  walking it for the size query psQuery beats scanning oFTree's size
+  index, which passes over the entries of files outside the directory
+  as well: about the square root of the number of files in the index
+  times the number wanted, or one for FT_sizeRangeIn, which may want
+  them all.
+*/
+static size_t FT_sizeBudget(FT_T oFTree, struct sizeQuery *psQuery){
+    size_t ulFiles, ulWanted, ulBudget;
+
+    assert(oFTree != NULL);
+    assert(psQuery != NULL);
+
+    ulFiles = SizeIndex_getCount(oFTree->oSizeIndex);
+    if(ulFiles == 0)
+        return 0;
+    ulWanted = psQuery->ulLeft;
+    if(ulWanted == (size_t) -1)
+        ulWanted = 1;
+    if(ulWanted > ulFiles)
+        ulWanted = ulFiles;
+    /* the least power of two whose square is at least their product */
+    for(ulBudget = 1; ulBudget < ulFiles / ulBudget * ulWanted; )
+        ulBudget *= 2;
+    return ulBudget;
+}
+
+/*
+  Performs the size query psQuery on oFTree for files up to ulHigh
+  bytes in size: by walking the directory if it has no complete size
+  index or the directory is small (see FT_sizeBudget), or with the
+  index otherwise. Locks oFTree as needed.
+*/
+static int FT_sizeQuery(FT_T oFTree, struct sizeQuery *psQuery,
+                        size_t ulHigh){
+    Node_T oNDir = NULL;
+    size_t ulBudget;
+    boolean bSmall = FALSE;
+    int iStatus;
+
+    assert(oFTree != NULL);
+    assert(psQuery != NULL);
+
+    if(oFTree->oSizeIndex != NULL) {
+        /* the index knows nothing of directories */
+        iStatus = FT_beginWalk(oFTree);
+        if(iStatus != SUCCESS)
+            return iStatus;
+        iStatus = FT_findNode(oFTree, psQuery->pcDir, FALSE, &oNDir);
+        if(iStatus == SUCCESS) {
+            ulBudget = FT_sizeBudget(oFTree, psQuery);
+            if(Node_isFileNode(oNDir))
+                iStatus = NOT_A_DIRECTORY;
+            else
+                bSmall = FT_isSmall(oNDir, &ulBudget);
+            FT_unlatch(oFTree, FALSE, oNDir);
+        }
+        if(iStatus == SUCCESS && bSmall)
+            iStatus = FT_sizeQueryLocked(oFTree, psQuery, ulHigh);
+        FT_endWalk(oFTree);
+        if(iStatus != SUCCESS || bSmall)
+            return iStatus;
+        if(SizeIndex_map(oFTree->oSizeIndex, ulHigh, FT_sizeTake,
+                         psQuery))
+            return SUCCESS;
+    }
+
+    iStatus = FT_beginWalk(oFTree);
+    if(iStatus != SUCCESS)
+        return iStatus;
+    iStatus = FT_sizeQueryLocked(oFTree, psQuery, ulHigh);
+    FT_endWalk(oFTree);
+    return iStatus;
+}
+
+int FT_topKIn(FT_T oFTree, const char *pcDir, size_t ulK,
+              void (*pfApply)(const char *pcPath, size_t ulSize,
+                              void *pvExtra),
+              void *pvExtra){
+    struct sizeQuery sQuery;
+
+    assert(oFTree != NULL);
+    assert(pcDir != NULL);
+    assert(pfApply != NULL);
+
+    sQuery.pcDir = pcDir;
+    sQuery.ulDirLength = strlen(pcDir);
+    sQuery.ulLow = 0;
+    sQuery.ulLeft = ulK;
+    sQuery.pfApply = pfApply;
+    sQuery.pvExtra = pvExtra;
+    return FT_sizeQuery(oFTree, &sQuery, (size_t) -1);
+}
+
+int FT_sizeRangeIn(FT_T oFTree, const char *pcDir, size_t ulLow,
+                   size_t ulHigh,
+                   void (*pfApply)(const char *pcPath, size_t ulSize,
+                                   void *pvExtra),
+                   void *pvExtra){
+    struct sizeQuery sQuery;
+
+    assert(oFTree != NULL);
+    assert(pcDir != NULL);
+    assert(pfApply != NULL);
+
+    sQuery.pcDir = pcDir;
+    sQuery.ulDirLength = strlen(pcDir);
+    sQuery.ulLow = ulLow;
+    sQuery.ulLeft = (size_t) -1;
+    sQuery.pfApply = pfApply;
+    sQuery.pvExtra = pvExtra;
+    return FT_sizeQuery(oFTree, &sQuery, ulHigh);
+}
+
+size_t FT_getSizeIndexSizeIn(FT_T oFTree){
+    assert(oFTree != NULL);
+
+    if(oFTree->oSizeIndex == NULL)
+        return 0;
+    return SizeIndex_getSize(oFTree->oSizeIndex);
+}
+
+void FT_setColdIn(FT_T oFTree, unsigned long ulIdleMillis,
+                  size_t ulHotBuffers){
+    assert(oFTree != NULL);
+
+    if(oFTree->bColdTier)
+        (void) ChunkStore_setCold(oFTree->oChunkStore, ulIdleMillis,
+                                  ulHotBuffers);
+}
+
+int FT_setSpillIn(FT_T oFTree, size_t ulBudget, const char *pcDir){
+    assert(oFTree != NULL);
+
+    if(!oFTree->bSpill)
+        return SUCCESS;
+    return ChunkStore_setBudget(oFTree->oChunkStore, ulBudget, pcDir);
+}
+
+size_t FT_getChunkStoreSizeIn(FT_T oFTree){
+    assert(oFTree != NULL);
+
+    if(oFTree->oChunkStore == NULL)
+        return 0;
+    return ChunkStore_getSize(oFTree->oChunkStore);
+}
+
+size_t FT_getNameIndexSizeIn(FT_T oFTree){
+    assert(oFTree != NULL);
+
+    if(oFTree->oNameIndex == NULL)
+        return 0;
+    return NameIndex_getSize(oFTree->oNameIndex);
+}
+
+/* The state of FT_saveIn */
+struct saveState {
+   /* the writer of the image */
+   ImageWriter_T oWriter;
+   /* a stack of the records written for the children of the
+      directories being saved, the innermost last */
+   Image_Offset *pulStack;
+   size_t ulDepth;
+   size_t ulCapacity;
+   /* TRUE once saving has failed */
+   boolean bFailed;
+};
+
+/* Pushes ulRecord onto psState's stack. */
+static void FT_savePush(struct saveState *psState, Image_Offset ulRecord) {
+   Image_Offset *pulGrown;
+   size_t ulCapacity;
+
+   assert(psState != NULL);
+
+   if(psState->ulDepth == psState->ulCapacity) {
+      ulCapacity = psState->ulCapacity == 0 ? 64 : 2 * psState->ulCapacity;
+      pulGrown = realloc(psState->pulStack,
+                         ulCapacity * sizeof(Image_Offset));
+      if(pulGrown == NULL) {
+         ImageWriter_fail(psState->oWriter, MEMORY_ERROR);
+         psState->bFailed = TRUE;
+         return;
+      }
+      psState->pulStack = pulGrown;
+      psState->ulCapacity = ulCapacity;
+   }
+   psState->pulStack[psState->ulDepth++] = ulRecord;
+}
+
+/* Copies up to ulCount bytes of the contents of the file pvNode from
+   offset ulOffset on to pvDest, as Node_readContent does. */
+static size_t FT_readNode(void *pvNode, size_t ulOffset, void *pvDest,
+                          size_t ulCount) {
+   return Node_readContent(pvNode, ulOffset, pvDest, ulCount);
+}
+
+/*
+  Writes the subtree rooted at oNNode through the saveState pvState,
+  children first, and pushes the record of oNNode onto its stack.
+*/
+static void FT_saveNode(Node_T oNNode, void *pvState) {
+   struct saveState *psState = pvState;
+   Image_Offset ulRecord;
+   size_t ulBase;
+   size_t ulFiles;
+
+   assert(oNNode != NULL);
+   assert(psState != NULL);
+
+   if(psState->bFailed)
+      return;
+   if(Node_isFileNode(oNNode) && Node_hasChunks(oNNode)) {
+      /* hot buffers can be given up by the next read, so chunks are
+         copied a piece at a time instead */
+      ulRecord = ImageWriter_addFileRead(psState->oWriter,
+                                         Node_getName(oNNode),
+                                         Node_getFileSize(oNNode),
+                                         FT_readNode, oNNode);
+   }
+   else if(Node_isFileNode(oNNode)) {
+      ulRecord = ImageWriter_addFile(psState->oWriter,
+                                     Node_getName(oNNode),
+                                     Node_getFileContent(oNNode),
+                                     Node_getFileSize(oNNode));
+   }
+   else {
+      ulBase = psState->ulDepth;
+      Node_mapChildren(oNNode, TRUE, FT_saveNode, psState);
+      ulFiles = psState->ulDepth - ulBase;
+      Node_mapChildren(oNNode, FALSE, FT_saveNode, psState);
+      if(psState->bFailed)
+         return;
+      ulRecord = ImageWriter_addDir(psState->oWriter,
+                                    Node_getName(oNNode),
+                                    psState->pulStack + ulBase, ulFiles,
+                                    psState->pulStack + ulBase + ulFiles,
+                                    psState->ulDepth - ulBase - ulFiles);
+      psState->ulDepth = ulBase;
+   }
+   if(ulRecord == IMAGE_NONE)
+      psState->bFailed = TRUE;
+   else
+      FT_savePush(psState, ulRecord);
+}
+
+/* Performs FT_saveIn, tagging the image with ulTag. */
+static int FT_saveTagged(FT_T oFTree, int iFd, unsigned long ulTag){
+   struct saveState sState;
+   Node_T oNRoot;
+   Image_Offset ulRoot = IMAGE_NONE;
+   int iStatus;
+
+   assert(oFTree != NULL);
+
+   if(!oFTree->bIsInitialized)
+      return INITIALIZATION_ERROR;
+   iStatus = ImageWriter_new(iFd, &sState.oWriter);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   ImageWriter_setTag(sState.oWriter, ulTag);
+   sState.pulStack = NULL;
+   sState.ulDepth = 0;
+   sState.ulCapacity = 0;
+   sState.bFailed = FALSE;
+
+   iStatus = FT_beginWalk(oFTree);
+   if(iStatus != SUCCESS) {
+      ImageWriter_fail(sState.oWriter, iStatus);
+      return ImageWriter_finish(sState.oWriter, IMAGE_NONE);
+   }
+   oNRoot = FT_getRoot(oFTree);
+   if(oNRoot != NULL) {
+      FT_saveNode(oNRoot, &sState);
+      if(!sState.bFailed)
+         ulRoot = sState.pulStack[0];
+   }
+   /* the names written must outlive the writer */
+   iStatus = ImageWriter_finish(sState.oWriter, ulRoot);
+   FT_endWalk(oFTree);
+
+   free(sState.pulStack);
+   return iStatus;
+}
+
+int FT_saveIn(FT_T oFTree, int iFd){
+   return FT_saveTagged(oFTree, iFd, 0);
+}
+
+/* Performs FT_loadMapped, and sets *pulTag to the image's tag. */
+static int FT_loadTagged(const char *pcPath, unsigned int uFlags,
+                         FT_T *poFResult, unsigned long *pulTag){
+   FT_T oFTree;
+   Image_T oImage;
+   Node_T oNRoot;
+   int iStatus;
+
+   assert(pcPath != NULL);
+   assert(poFResult != NULL);
+   assert(pulTag != NULL);
+
+   *poFResult = NULL;
+   iStatus = Image_map(pcPath, &oImage);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   iStatus = FT_newWithFlags(uFlags, &oFTree);
+   if(iStatus != SUCCESS) {
+      Image_release(oImage);
+      return iStatus;
+   }
+
+   /* the nodes read from the image hold it from now on */
+   if(Image_getRoot(oImage) != IMAGE_NONE) {
+      iStatus = Node_newFromImage(oImage, Image_getRoot(oImage), &oNRoot);
+      if(iStatus != SUCCESS) {
+         Image_release(oImage);
+         FT_free(oFTree);
+         return iStatus;
+      }
+      oFTree->oNRoot = oNRoot;
+      if(FT_hasIndex(oFTree) &&
+         FT_walkPaths(oNRoot, Node_getName(oNRoot), 0, FT_indexAdd,
+                      oFTree) != SUCCESS)
+         FT_abandonIndexes(oFTree);
+   }
+   *pulTag = Image_getTag(oImage);
+   Image_release(oImage);
+
+   *poFResult = oFTree;
+   return SUCCESS;
+}
+
+int FT_loadMapped(const char *pcPath, unsigned int uFlags,
+                  FT_T *poFResult){
+   unsigned long ulTag;
+
+   return FT_loadTagged(pcPath, uFlags, poFResult, &ulTag);
+}
+
+/* Writes the contents of the file pvNode to iFd, as Node_sendContent
+   does. */
+static int FT_tarSend(void *pvNode, int iFd, size_t *pulSent) {
+   return Node_sendContent(pvNode, 0, Node_getFileSize(pvNode), iFd,
+                           pulSent);
+}
+
+/* Adds pcPath, the path of oNNode, to the archive of the tar writer
+   pvWriter. */
+static void FT_tarVisit(const char *pcPath, Node_T oNNode,
+                        void *pvWriter) {
+   TarWriter_T oWriter = pvWriter;
+
+   assert(oWriter != NULL);
+
+   /* chunks are sent before the next file can give up the hot
+      buffers they are read through */
+   if(Node_isFileNode(oNNode) && Node_hasChunks(oNNode))
+      TarWriter_sendFile(oWriter, pcPath, Node_getFileSize(oNNode),
+                         FT_tarSend, oNNode);
+   else if(Node_isFileNode(oNNode))
+      TarWriter_addFile(oWriter, pcPath, Node_getFileContent(oNNode),
+                        Node_getFileSize(oNNode));
+   else
+      TarWriter_addDir(oWriter, pcPath);
+}
+
+int FT_exportTarIn(FT_T oFTree, const char *pcDir, int iFd){
+   TarWriter_T oWriter;
+   Node_T oNDir = NULL;
+   const char *pcSlash;
+   int iStatus;
+
+   assert(oFTree != NULL);
+   assert(pcDir != NULL);
+
+   iStatus = TarWriter_new(iFd, &oWriter);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = FT_beginWalk(oFTree);
+   if(iStatus != SUCCESS) {
+      TarWriter_fail(oWriter, iStatus);
+      return TarWriter_finish(oWriter);
+   }
+   iStatus = FT_findNode(oFTree, pcDir, FALSE, &oNDir);
+   if(iStatus == SUCCESS) {
+      pcSlash = strrchr(pcDir, '/');
+      iStatus = FT_walkPaths(oNDir, pcDir,
+                             (pcSlash == NULL) ? 0 :
+                             (size_t) (pcSlash - pcDir),
+                             FT_tarVisit, oWriter);
+      FT_unlatch(oFTree, FALSE, oNDir);
+   }
+   if(iStatus != SUCCESS)
+      TarWriter_fail(oWriter, iStatus);
+   /* the contents written must stay put until the writer is done */
+   iStatus = TarWriter_finish(oWriter);
+   FT_endWalk(oFTree);
+   return iStatus;
+}
+
+/*
+  The directories from the root down to the last member a tar import
+  placed, which the next member, likely a neighbour, starts from
+  instead of the root. A new directory whose parent readers can reach
+  is kept out of their sight until the import moves past it, when it
+  is linked and indexed with everything placed below it meanwhile;
+  there is at most one such directory on the chain, since those below
+  it are out of sight already.
+*/
+struct tarChain {
+   /* the tree imported into */
+   FT_T oFTree;
+   /* the directories, with the lengths of their paths in pcPath */
+   Node_T *aoNNodes;
+   size_t *aulEnds;
+   size_t ulDepth;
+   size_t ulCapacity;
+   /* one more than the depth of the directory kept out of sight, or 0
+      if there is none */
+   size_t ulHidden;
+   /* the path of the last member */
+   char *pcPath;
+   size_t ulPathCapacity;
+};
+
+/* Publishes the deepest directory of psChain if it is out of sight,
+   and then drops it from the chain. Returns SUCCESS, or
+   MEMORY_ERROR. */
+static int FT_tarPop(struct tarChain *psChain) {
+   FT_T oFTree = psChain->oFTree;
+   Node_T oNNode;
+   size_t ulParentLength;
+   int iStatus = SUCCESS;
+
+   assert(psChain != NULL);
+   assert(psChain->ulDepth > 0);
+
+   psChain->ulDepth--;
+   if(psChain->ulHidden != psChain->ulDepth + 1)
+      return SUCCESS;
+   psChain->ulHidden = 0;
+   oNNode = psChain->aoNNodes[psChain->ulDepth];
+   if(psChain->ulDepth == 0) {
+      FT_setRoot(oFTree, oNNode);
+      ulParentLength = 0;
+   }
+   else {
+      iStatus = Node_publish(psChain->aoNNodes[psChain->ulDepth - 1],
+                             oNNode, oFTree->oEpoch);
+      ulParentLength = psChain->aulEnds[psChain->ulDepth - 1];
+   }
+   if(iStatus != SUCCESS) {
+      /* the log holds the lost nodes already */
+      Node_release(oNNode, NULL);
+      if(oFTree->oWal != NULL)
+         Wal_fail(oFTree->oWal, MEMORY_ERROR);
+      return iStatus;
+   }
+   if(FT_hasIndex(oFTree) &&
+      FT_walkPaths(oNNode, psChain->pcPath, ulParentLength, FT_indexAdd,
+                   oFTree) != SUCCESS)
+      FT_abandonIndexes(oFTree);
+   return SUCCESS;
+}
+
+/*
+  Adds oNNode, the directory whose path is the first ulEnd characters
+  of psChain's pcPath, to the end of psChain, out of sight if bHidden
+  is TRUE. Returns SUCCESS, or MEMORY_ERROR.
+*/
+static int FT_tarPush(struct tarChain *psChain, Node_T oNNode,
+                      size_t ulEnd, boolean bHidden) {
+   Node_T *aoNGrown;
+   size_t *aulGrown;
+   size_t ulCapacity;
+
+   assert(psChain != NULL);
+   assert(oNNode != NULL);
+
+   if(psChain->ulDepth == psChain->ulCapacity) {
+      ulCapacity = 2 * psChain->ulCapacity + 8;
+      aoNGrown = realloc(psChain->aoNNodes, ulCapacity * sizeof(Node_T));
+      if(aoNGrown == NULL)
+         return MEMORY_ERROR;
+      psChain->aoNNodes = aoNGrown;
+      aulGrown = realloc(psChain->aulEnds, ulCapacity * sizeof(size_t));
+      if(aulGrown == NULL)
+         return MEMORY_ERROR;
+      psChain->aulEnds = aulGrown;
+      psChain->ulCapacity = ulCapacity;
+   }
+   psChain->aoNNodes[psChain->ulDepth] = oNNode;
+   psChain->aulEnds[psChain->ulDepth] = ulEnd;
+   psChain->ulDepth++;
+   if(bHidden)
+      psChain->ulHidden = psChain->ulDepth;
+   return SUCCESS;
+}
+
+/*
+  Makes the directory named pcName, whose path is pcPath, the next one
+  on psChain: the one there already, copied first if a snapshot shares
+  it, or a new one, which is logged and, unless it is out of sight,
+  indexed. Returns SUCCESS, or CONFLICTING_PATH if it would be a root
+  other than oFTree's, or NOT_A_DIRECTORY if a file has its path, or
+  MEMORY_ERROR.
+*/
+static int FT_tarDescend(struct tarChain *psChain, const char *pcPath,
+                         const char *pcName) {
+   FT_T oFTree = psChain->oFTree;
+   Node_T oNParent = NULL;
+   Node_T oNNode = NULL;
+   Node_T oNCopy;
+   boolean bHidden = FALSE;
+   int iStatus;
+
+   assert(psChain != NULL);
+   assert(pcPath != NULL);
+   assert(pcName != NULL);
+
+   if(psChain->ulDepth == 0) {
+      oNNode = FT_getRoot(oFTree);
+      if(oNNode != NULL && strcmp(Node_getName(oNNode), pcName))
+         return CONFLICTING_PATH;
+      if(oNNode != NULL && oFTree->bShared && Node_isShared(oNNode)) {
+         iStatus = Node_copy(oNNode, NULL, &oNCopy);
+         if(iStatus != SUCCESS)
+            return iStatus;
+         FT_setRoot(oFTree, oNCopy);
+         Node_release(oNNode, oFTree->oEpoch);
+         oNNode = oNCopy;
+      }
+      if(oNNode == NULL) {
+         iStatus = Node_new(pcName, NULL, FALSE, NULL, 0, &oNNode);
+         if(iStatus != SUCCESS)
+            return iStatus;
+         /* a lock-free reader may look for the root at any time */
+         bHidden = oFTree->bLockFreeReads;
+         if(!bHidden)
+            FT_setRoot(oFTree, oNNode);
+         FT_log(oFTree, WAL_INSERTDIR, pcPath, NULL, NULL, 0);
+         if(!bHidden)
+            FT_indexAdd(pcPath, oNNode, oFTree);
+      }
+   }
+   else {
+      oNParent = psChain->aoNNodes[psChain->ulDepth - 1];
+      iStatus = Node_lookupChild(oNParent, pcName, &oNNode);
+      if(iStatus == SUCCESS) {
+         if(Node_isFileNode(oNNode))
+            return NOT_A_DIRECTORY;
+         if(oFTree->bShared) {
+            iStatus = Node_unshareChild(oNParent, oNNode, oFTree->oEpoch,
+                                        &oNNode);
+            if(iStatus != SUCCESS)
+               return iStatus;
+         }
+      }
+      else {
+         bHidden = oFTree->bLockFreeReads && psChain->ulHidden == 0;
+         if(bHidden)
+            iStatus = Node_newUnpublished(pcName, oNParent, FALSE, NULL,
+                                          0, &oNNode);
+         else
+            iStatus = Node_new(pcName, oNParent, FALSE, NULL, 0, &oNNode);
+         if(iStatus != SUCCESS)
+            return iStatus;
+         FT_log(oFTree, WAL_INSERTDIR, pcPath, NULL, NULL, 0);
+         if(!bHidden && psChain->ulHidden == 0)
+            FT_indexAdd(pcPath, oNNode, oFTree);
+      }
+   }
+
+   iStatus = FT_tarPush(psChain, oNNode, strlen(pcPath), bHidden);
+   if(iStatus != SUCCESS && bHidden) {
+      /* it was linked nowhere */
+      Node_release(oNNode, NULL);
+      if(oFTree->oWal != NULL)
+         Wal_fail(oFTree->oWal, MEMORY_ERROR);
+   }
+   return iStatus;
+}
+
+/*
+  Adds the file the member psMember of oReader's archive describes
+  below the deepest directory of psChain, named pcName, with its
+  contents read into oFTree's arena if bArena is TRUE or else into
+  memory of their own. Returns SUCCESS, or ALREADY_IN_TREE if the
+  directory has a child named pcName, or IO_ERROR, or MEMORY_ERROR.
+*/
+static int FT_tarAddFile(struct tarChain *psChain, TarReader_T oReader,
+                         const struct Tar_member *psMember,
+                         const char *pcName, boolean bArena) {
+   FT_T oFTree = psChain->oFTree;
+   Node_T oNParent;
+   Node_T oNFile = NULL;
+   void *pvContents = NULL;
+   int iStatus;
+
+   assert(psChain != NULL);
+   assert(psChain->ulDepth > 0);
+   assert(oReader != NULL);
+   assert(psMember != NULL);
+   assert(pcName != NULL);
+
+   oNParent = psChain->aoNNodes[psChain->ulDepth - 1];
+   if(Node_lookupChild(oNParent, pcName, &oNFile) == SUCCESS)
+      return ALREADY_IN_TREE;
+
+   if(psMember->bHasContents) {
+      if(bArena) {
+         if(oFTree->oArena == NULL &&
+            Arena_new(&oFTree->oArena) != SUCCESS)
+            return MEMORY_ERROR;
+         pvContents = Arena_alloc(oFTree->oArena, psMember->ulLength);
+      }
+      else
+         pvContents = malloc(psMember->ulLength > 0 ?
+                             psMember->ulLength : 1);
+      if(pvContents == NULL)
+         return MEMORY_ERROR;
+      iStatus = TarReader_read(oReader, pvContents);
+      if(iStatus != SUCCESS) {
+         if(!bArena)
+            free(pvContents);
+         return iStatus;
+      }
+   }
+
+   /* a file readers can reach is published whole */
+   if(oFTree->bLockFreeReads && psChain->ulHidden == 0) {
+      iStatus = Node_newUnpublished(pcName, oNParent, TRUE, pvContents,
+                                    psMember->ulLength, &oNFile);
+      if(iStatus == SUCCESS) {
+         iStatus = Node_publish(oNParent, oNFile, oFTree->oEpoch);
+         if(iStatus != SUCCESS)
+            Node_release(oNFile, NULL);
+      }
+   }
+   else
+      iStatus = Node_new(pcName, oNParent, TRUE, pvContents,
+                         psMember->ulLength, &oNFile);
+   if(iStatus != SUCCESS) {
+      if(!bArena)
+         free(pvContents);
+      return iStatus;
+   }
+
+   FT_log(oFTree, WAL_INSERTFILE, psChain->pcPath, NULL, pvContents,
+          psMember->ulLength);
+   if(psChain->ulHidden == 0)
+      FT_indexAdd(psChain->pcPath, oNFile, oFTree);
+   return SUCCESS;
+}
+
+/*
+  Places the member psMember of oReader's archive in oFTree along
+  psChain, moving the chain to it first. Returns the status documented
+  for FT_importTarIn.
+*/
+static int FT_tarPlace(struct tarChain *psChain, TarReader_T oReader,
+                       const struct Tar_member *psMember,
+                       boolean bArena) {
+   const char *pcPath = psMember->pcPath;
+   size_t ulLength, ulStart, ulEnd, ulDirs, i;
+   char *pcName;
+   char cSaved;
+   int iStatus;
+
+   assert(psChain != NULL);
+   assert(oReader != NULL);
+   assert(psMember != NULL);
+
+   ulLength = strlen(pcPath);
+   /* the directories the member is in, and itself if one */
+   ulDirs = psMember->bIsDir ? 1 : 0;
+   for(i = 0; i < ulLength; i++) {
+      if(pcPath[i] == '/') {
+         if(i == 0 || pcPath[i - 1] == '/')
+            return BAD_PATH;
+         ulDirs++;
+      }
+   }
+
+   /* keep the directories the last member shared with this one */
+   ulStart = 0;
+   for(i = 0; i < psChain->ulDepth && i < ulDirs; i++) {
+      ulEnd = psChain->aulEnds[i];
+      if(ulEnd > ulLength ||
+         (pcPath[ulEnd] != '/' && pcPath[ulEnd] != '\0') ||
+         memcmp(psChain->pcPath + ulStart, pcPath + ulStart,
+                ulEnd - ulStart))
+         break;
+      ulStart = ulEnd + 1;
+   }
+   while(psChain->ulDepth > i) {
+      iStatus = FT_tarPop(psChain);
+      if(iStatus != SUCCESS)
+         return iStatus;
+   }
+
+   if(ulLength + 1 > psChain->ulPathCapacity) {
+      pcName = realloc(psChain->pcPath, 2 * ulLength + 1);
+      if(pcName == NULL)
+         return MEMORY_ERROR;
+      psChain->pcPath = pcName;
+      psChain->ulPathCapacity = 2 * ulLength + 1;
+   }
+   memcpy(psChain->pcPath, pcPath, ulLength + 1);
+
+   /* each directory is named by the path up to it, cut off there */
+   for(; i < ulDirs; i++) {
+      for(ulEnd = ulStart; ulEnd < ulLength && pcPath[ulEnd] != '/';
+          ulEnd++)
+         ;
+      cSaved = psChain->pcPath[ulEnd];
+      psChain->pcPath[ulEnd] = '\0';
+      iStatus = FT_tarDescend(psChain, psChain->pcPath,
+                              psChain->pcPath + ulStart);
+      psChain->pcPath[ulEnd] = cSaved;
+      if(iStatus != SUCCESS)
+         return iStatus;
+      ulStart = ulEnd + 1;
+   }
+
+   if(psMember->bIsDir)
+      return SUCCESS;
+   /* a file cannot be the root */
+   if(ulDirs == 0)
+      return CONFLICTING_PATH;
+   return FT_tarAddFile(psChain, oReader, psMember,
+                        psChain->pcPath + ulStart, bArena);
+}
+
+int FT_importTarIn(FT_T oFTree, int iFd, unsigned int uFlags){
+   TarReader_T oReader;
+   struct Tar_member sMember;
+   struct tarChain sChain;
+   int iStatus;
+   int iErrno;
+
+   assert(oFTree != NULL);
+
+   if(!oFTree->bIsInitialized || oFTree->bReadOnly)
+      return INITIALIZATION_ERROR;
+   iStatus = FT_logStatus(oFTree);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   iStatus = TarReader_new(iFd, &oReader);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   sChain.oFTree = oFTree;
+   sChain.aoNNodes = NULL;
+   sChain.aulEnds = NULL;
+   sChain.ulDepth = 0;
+   sChain.ulCapacity = 0;
+   sChain.ulHidden = 0;
+   sChain.pcPath = NULL;
+   sChain.ulPathCapacity = 0;
+
+   /* members are placed as they are read, so the lock is held
+      throughout, however slowly the archive arrives */
+   FT_lockExclusive(oFTree);
+   for(;;) {
+      iStatus = TarReader_next(oReader, &sMember);
+      if(iStatus != SUCCESS || sMember.pcPath == NULL)
+         break;
+      iStatus = FT_tarPlace(&sChain, oReader, &sMember,
+                            (uFlags & FT_TARARENA) != 0);
+      if(iStatus != SUCCESS)
+         break;
+   }
+   /* what was placed before a failure stays */
+   iErrno = errno;
+   while(sChain.ulDepth > 0)
+      if(FT_tarPop(&sChain) != SUCCESS && iStatus == SUCCESS)
+         iStatus = MEMORY_ERROR;
+   FT_unlock(oFTree);
+   errno = iErrno;
+
+   TarReader_free(oReader);
+   free(sChain.aoNNodes);
+   free(sChain.aulEnds);
+   free(sChain.pcPath);
+   return FT_commit(oFTree, iStatus);
+}
+
+/* --------------------------------------------------------------------
+
+  A logged tree keeps three files named after its base path: the image
+  of its last checkpoint, tagged with a generation; the log of the
+  changes since, whose header holds the same generation; and, while a
+  checkpoint is being written, the log of the changes since that
+  checkpoint began, one generation on, which replaces the old log once
+  the image is in place. Recovery replays each log that is not older
+  than the image, in order.
+*/
+
+/* The suffixes of the files of a logged tree */
+static const char pcImageSuffix[] = ".img";
+static const char pcTempSuffix[] = ".img.tmp";
+static const char pcLogSuffix[] = ".log";
+static const char pcNextSuffix[] = ".log.next";
+
+/* Returns pcBase followed by pcSuffix in a new string, or NULL if
+   memory could not be allocated. */
+static char *FT_logFile(const char *pcBase, const char *pcSuffix){
+   char *pcFile;
+
+   assert(pcBase != NULL);
+   assert(pcSuffix != NULL);
+
+   pcFile = malloc(strlen(pcBase) + strlen(pcSuffix) + 1);
+   if(pcFile == NULL)
+      return NULL;
+   strcpy(pcFile, pcBase);
+   strcat(pcFile, pcSuffix);
+   return pcFile;
+}
+
+/*
+  Writes oFTree as the image of the logged tree with base path pcBase,
+  tagged with generation ulGeneration: to a temporary file first,
+  which is made durable and then renamed over the old image, so that
+  a crash leaves one image or the other. Returns SUCCESS, or IO_ERROR
+  or MEMORY_ERROR.
+*/
+static int FT_writeImage(FT_T oFTree, const char *pcBase,
+                         unsigned long ulGeneration){
+   char *pcTemp;
+   char *pcImage;
+   int iFd;
+   int iStatus;
+
+   assert(oFTree != NULL);
+   assert(pcBase != NULL);
+
+   pcTemp = FT_logFile(pcBase, pcTempSuffix);
+   pcImage = FT_logFile(pcBase, pcImageSuffix);
+   if(pcTemp == NULL || pcImage == NULL) {
+      free(pcTemp);
+      free(pcImage);
+      return MEMORY_ERROR;
+   }
+
+   iFd = open(pcTemp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if(iFd < 0)
+      iStatus = IO_ERROR;
+   else {
+      iStatus = FT_saveTagged(oFTree, iFd, ulGeneration);
+      if(iStatus == SUCCESS && fsync(iFd) != 0)
+         iStatus = IO_ERROR;
+      if(close(iFd) != 0 && iStatus == SUCCESS)
+         iStatus = IO_ERROR;
+      if(iStatus == SUCCESS)
+         iStatus = Wal_rename(pcTemp, pcImage);
+      else
+         (void) unlink(pcTemp);
+   }
+
+   free(pcTemp);
+   free(pcImage);
+   return iStatus;
+}
+
+/*
+  Checkpoints the logged tree oFTree: starts the next generation of
+  its log while its lock is held exclusively, along with a snapshot,
+  then writes the snapshot as the new image and makes the new log
+  replace the old. Changes go on meanwhile, into the new log. Returns
+  SUCCESS, or IO_ERROR or MEMORY_ERROR. If the new log was started
+  but could not replace the old, the log is failed, since the next
+  checkpoint would overwrite it. The caller holds sCheckpointLock.
+*/
+static int FT_checkpoint(FT_T oFTree){
+   FT_T oFSnapshot;
+   char *pcLog;
+   char *pcNext;
+   unsigned long ulGeneration;
+   int iStatus;
+
+   assert(oFTree != NULL);
+   assert(oFTree->oWal != NULL);
+
+   pcLog = FT_logFile(oFTree->pcBase, pcLogSuffix);
+   pcNext = FT_logFile(oFTree->pcBase, pcNextSuffix);
+   if(pcLog == NULL || pcNext == NULL) {
+      free(pcLog);
+      free(pcNext);
+      return MEMORY_ERROR;
+   }
+   iStatus = FT_newWithFlags(0, &oFSnapshot);
+   if(iStatus != SUCCESS) {
+      free(pcLog);
+      free(pcNext);
+      return iStatus;
+   }
+
+   /* the snapshot holds every change in the old log and none in the
+      new one */
+   FT_lockExclusive(oFTree);
+   ulGeneration = oFTree->ulGeneration + 1;
+   iStatus = Wal_rotate(oFTree->oWal, pcNext, ulGeneration);
+   if(iStatus == SUCCESS) {
+      FT_shareRoot(oFTree, oFSnapshot);
+      oFTree->ulGeneration = ulGeneration;
+   }
+   FT_unlock(oFTree);
+
+   if(iStatus == SUCCESS) {
+      iStatus = FT_writeImage(oFSnapshot, oFTree->pcBase, ulGeneration);
+      if(iStatus == SUCCESS)
+         iStatus = Wal_rename(pcNext, pcLog);
+      if(iStatus != SUCCESS)
+         Wal_fail(oFTree->oWal, iStatus);
+   }
+
+   FT_free(oFSnapshot);
+   free(pcLog);
+   free(pcNext);
+   return iStatus;
+}
+
+int FT_checkpointIn(FT_T oFTree){
+   int iStatus;
+
+   assert(oFTree != NULL);
+
+   if(!oFTree->bIsInitialized || oFTree->oWal == NULL)
+      return INITIALIZATION_ERROR;
+   iStatus = FT_logStatus(oFTree);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   (void) pthread_mutex_lock(&oFTree->sCheckpointLock);
+   iStatus = FT_checkpoint(oFTree);
+   (void) pthread_mutex_unlock(&oFTree->sCheckpointLock);
+   return iStatus;
+}
+
+/*
+  Maps the log pcLog and, unless its generation is older than
+  ulGeneration, that of the image oFTree was loaded from, replays its
+  changes onto oFTree, setting *pbReplayed to TRUE if there were any.
+  Sets *poRResult to the reader of the log, which holds the contents
+  of the files replayed, or to NULL if there is no log or it has no
+  whole header. Returns SUCCESS, or IO_ERROR or MEMORY_ERROR.
+*/
+static int FT_replay(FT_T oFTree, const char *pcLog,
+                     unsigned long ulGeneration, boolean *pbReplayed,
+                     WalReader_T *poRResult){
+   WalReader_T oReader;
+   struct Wal_record sRecord;
+   ChunkList_T oChunks;
+   int iStatus = SUCCESS;
+   int iReplaced;
+
+   assert(oFTree != NULL);
+   assert(pcLog != NULL);
+   assert(pbReplayed != NULL);
+   assert(poRResult != NULL);
+
+   *poRResult = NULL;
+   if(WalReader_open(pcLog, &oReader) != SUCCESS)
+      /* a crash may have cut a new log short of its header */
+      return errno == ENOENT || errno == EINVAL ? SUCCESS : IO_ERROR;
+   if(WalReader_getGeneration(oReader) < ulGeneration) {
+      *poRResult = oReader;
+      return SUCCESS;
+   }
+
+   /* the changes succeeded once, on the same tree, so they succeed
+      again, unless memory runs out */
+   while(iStatus != MEMORY_ERROR && WalReader_next(oReader, &sRecord)) {
+      *pbReplayed = TRUE;
+      switch(sRecord.eOp) {
+         case WAL_INSERTDIR:
+            iStatus = FT_insertDirLocked(oFTree, sRecord.pcPath);
+            break;
+         case WAL_INSERTFILE:
+            iStatus = FT_chunk(oFTree, sRecord.pvContents,
+                               sRecord.ulLength, &oChunks);
+            if(iStatus == SUCCESS)
+               iStatus = FT_insertFileLocked(oFTree, sRecord.pcPath,
+                                             sRecord.pvContents,
+                                             sRecord.ulLength, oChunks);
+            ChunkList_release(oChunks);
+            break;
+         case WAL_RMDIR:
+            iStatus = FT_rmDirLocked(oFTree, sRecord.pcPath);
+            break;
+         case WAL_RMFILE:
+            iStatus = FT_rmFileLocked(oFTree, sRecord.pcPath);
+            break;
+         case WAL_REPLACE:
+            iStatus = FT_chunk(oFTree, sRecord.pvContents,
+                               sRecord.ulLength, &oChunks);
+            /* the replace succeeded when it was logged */
+            if(iStatus == SUCCESS)
+               (void) FT_replaceFileContentsLocked(oFTree, sRecord.pcPath,
+                                                   sRecord.pvContents,
+                                                   sRecord.ulLength,
+                                                   oChunks, &iReplaced);
+            ChunkList_release(oChunks);
+            break;
+         case WAL_MOVE:
+            iStatus = FT_moveLocked(oFTree, sRecord.pcPath,
+                                    sRecord.pcOther);
+            break;
+         case WAL_COPY:
+            iStatus = FT_copyLocked(oFTree, sRecord.pcPath,
+                                    sRecord.pcOther);
+            break;
+         case WAL_WRITE:
+            iStatus = FT_writeLocked(oFTree, sRecord.pcPath,
+                                     sRecord.ulOffset, sRecord.pvContents,
+                                     sRecord.ulLength, FALSE);
+            break;
+      }
+   }
+
+   *poRResult = oReader;
+   return iStatus == MEMORY_ERROR ? MEMORY_ERROR : SUCCESS;
+}
+
+/*
+  Makes the loaded tree oFTree log its changes to oWal, a log of
+  generation ulGeneration, with the files named after pcBase. Returns
+  SUCCESS, or MEMORY_ERROR, in which case oWal is closed.
+*/
+static int FT_startLogging(FT_T oFTree, const char *pcBase, Wal_T oWal,
+                           unsigned long ulGeneration){
+   char *pcCopy;
+
+   assert(oFTree != NULL);
+   assert(pcBase != NULL);
+   assert(oWal != NULL);
+
+   pcCopy = malloc(strlen(pcBase) + 1);
+   if(pcCopy == NULL) {
+      (void) Wal_close(oWal);
+      return MEMORY_ERROR;
+   }
+   if(pthread_mutex_init(&oFTree->sCheckpointLock, NULL) != 0) {
+      free(pcCopy);
+      (void) Wal_close(oWal);
+      return MEMORY_ERROR;
+   }
+   strcpy(pcCopy, pcBase);
+   oFTree->pcBase = pcCopy;
+   oFTree->oWal = oWal;
+   oFTree->ulGeneration = ulGeneration;
+   return SUCCESS;
+}
+
+int FT_openLogged(const char *pcBase, unsigned int uFlags,
+                  FT_T *poFResult){
+   FT_T oFTree = NULL;
+   Wal_T oWal;
+   WalReader_T oLog = NULL;
+   WalReader_T oNext = NULL;
+   char *pcImage;
+   char *pcLog;
+   char *pcNext;
+   unsigned long ulGeneration = 0;
+   unsigned long ulLast;
+   boolean bReplayed = FALSE;
+   boolean bReload = FALSE;
+   int iStatus;
+
+   assert(pcBase != NULL);
+   assert(poFResult != NULL);
+
+   *poFResult = NULL;
+   pcImage = FT_logFile(pcBase, pcImageSuffix);
+   pcLog = FT_logFile(pcBase, pcLogSuffix);
+   pcNext = FT_logFile(pcBase, pcNextSuffix);
+   if(pcImage == NULL || pcLog == NULL || pcNext == NULL)
+      iStatus = MEMORY_ERROR;
+   else {
+      iStatus = FT_loadTagged(pcImage, uFlags, &oFTree, &ulGeneration);
+      if(iStatus == IO_ERROR && errno == ENOENT)
+         iStatus = FT_newWithFlags(uFlags, &oFTree);
+   }
+   /* the old log first, then that of a checkpoint a crash cut short */
+   if(iStatus == SUCCESS)
+      iStatus = FT_replay(oFTree, pcLog, ulGeneration, &bReplayed, &oLog);
+   if(iStatus == SUCCESS)
+      iStatus = FT_replay(oFTree, pcNext, ulGeneration, &bReplayed,
+                          &oNext);
+
+   if(iStatus == SUCCESS && oLog != NULL && oNext == NULL &&
+      !bReplayed && WalReader_getGeneration(oLog) == ulGeneration) {
+      /* a clean shutdown: append after the last whole record */
+      iStatus = Wal_openAt(pcLog, WalReader_getValidLength(oLog), &oWal);
+      if(iStatus == SUCCESS)
+         iStatus = FT_startLogging(oFTree, pcBase, oWal, ulGeneration);
+      if(iStatus == SUCCESS) {
+         *poFResult = oFTree;
+         oFTree = NULL;
+      }
+   }
+   else if(iStatus == SUCCESS) {
+      /* checkpoint what was replayed, whose contents lie in the logs'
+         mappings, into a new image, with a new log; the old logs are
+         then older than the image, and ignored until overwritten */
+      ulLast = ulGeneration;
+      if(oLog != NULL && WalReader_getGeneration(oLog) > ulLast)
+         ulLast = WalReader_getGeneration(oLog);
+      if(oNext != NULL && WalReader_getGeneration(oNext) > ulLast)
+         ulLast = WalReader_getGeneration(oNext);
+      ulLast++;
+      iStatus = FT_writeImage(oFTree, pcBase, ulLast);
+      if(iStatus == SUCCESS)
+         iStatus = Wal_create(pcLog, ulLast, &oWal);
+      if(iStatus == SUCCESS)
+         iStatus = Wal_close(oWal);
+      if(iStatus == SUCCESS && unlink(pcNext) != 0 && errno != ENOENT)
+         iStatus = IO_ERROR;
+      /* the tree is loaded again, from the image */
+      bReload = iStatus == SUCCESS;
+   }
+
+   FT_free(oFTree);
+   WalReader_close(oLog);
+   WalReader_close(oNext);
+   free(pcImage);
+   free(pcLog);
+   free(pcNext);
+   if(bReload)
+      return FT_openLogged(pcBase, uFlags, poFResult);
+   return iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following functions keep the original single-tree interface by
+  forwarding to the default tree, which FT_init and FT_destroy manage.
+*/
+
+int FT_insertDir(const char *pcPath){
+    return FT_insertDirIn(&sDefaultTree, pcPath);
+}
+
+boolean FT_containsDir(const char *pcPath){
+    return FT_containsDirIn(&sDefaultTree, pcPath);
+}
+
+int FT_rmDir(const char *pcPath){
+    return FT_rmDirIn(&sDefaultTree, pcPath);
+}
+
+int FT_insertFile(const char *pcPath, void *pvContents, size_t ulLength){
+    return FT_insertFileIn(&sDefaultTree, pcPath, pvContents, ulLength);
+}
+
+int FT_insertFileMapped(const char *pcPath, int iFd, size_t ulOffset,
+                        size_t ulLength){
+    return FT_insertFileMappedIn(&sDefaultTree, pcPath, iFd, ulOffset,
+                                 ulLength);
+}
+
+boolean FT_containsFile(const char *pcPath){
+    return FT_containsFileIn(&sDefaultTree, pcPath);
+}
+
+int FT_rmFile(const char *pcPath){
+    return FT_rmFileIn(&sDefaultTree, pcPath);
+}
+
+void *FT_getFileContents(const char *pcPath){
+    return FT_getFileContentsIn(&sDefaultTree, pcPath);
+}
+
+void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
+                             size_t ulNewLength){
+    return FT_replaceFileContentsIn(&sDefaultTree, pcPath, pvNewContents,
+                                    ulNewLength);
+}
+
+int FT_readAt(const char *pcPath, size_t ulOffset, void *pvDest,
+              size_t ulCount, size_t *pulRead){
+    return FT_readAtIn(&sDefaultTree, pcPath, ulOffset, pvDest, ulCount,
+                       pulRead);
+}
+
+int FT_sendFile(const char *pcPath, int iFd, size_t ulOffset,
+                size_t ulCount, size_t *pulSent){
+    return FT_sendFileIn(&sDefaultTree, pcPath, iFd, ulOffset, ulCount,
+                         pulSent);
+}
+
+int FT_writeAt(const char *pcPath, size_t ulOffset, const void *pvBytes,
+               size_t ulCount){
+    return FT_writeAtIn(&sDefaultTree, pcPath, ulOffset, pvBytes, ulCount);
+}
+
+int FT_append(const char *pcPath, const void *pvBytes, size_t ulCount){
+    return FT_appendIn(&sDefaultTree, pcPath, pvBytes, ulCount);
+}
+
+int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize){
+    return FT_statIn(&sDefaultTree, pcPath, pbIsFile, pulSize);
+}
+
+int FT_statStored(const char *pcPath, boolean *pbIsFile, size_t *pulSize,
+                  size_t *pulStored){
+   return FT_statStoredIn(&sDefaultTree, pcPath, pbIsFile, pulSize,
+                          pulStored);
+}
+
+char *FT_toString(void){
+    return FT_toStringIn(&sDefaultTree);
+}
+
+int FT_glob(const char *pcPattern,
+            void (*pfApply)(const char *pcPath, boolean bIsFile,
+                            void *pvExtra),
+            void *pvExtra){
+    return FT_globIn(&sDefaultTree, pcPattern, pfApply, pvExtra);
+}
+
+int FT_findByName(const char *pcName,
+                  void (*pfApply)(const char *pcPath, boolean bIsFile,
+                                  void *pvExtra),
+                  void *pvExtra){
+    return FT_findByNameIn(&sDefaultTree, pcName, pfApply, pvExtra);
+}
+
+int FT_topK(const char *pcDir, size_t ulK,
+            void (*pfApply)(const char *pcPath, size_t ulSize,
+                            void *pvExtra),
+            void *pvExtra){
+    return FT_topKIn(&sDefaultTree, pcDir, ulK, pfApply, pvExtra);
+}
+
+int FT_sizeRange(const char *pcDir, size_t ulLow, size_t ulHigh,
+                 void (*pfApply)(const char *pcPath, size_t ulSize,
+                                 void *pvExtra),
+                 void *pvExtra){
+    return FT_sizeRangeIn(&sDefaultTree, pcDir, ulLow, ulHigh, pfApply,
+                          pvExtra);
+}
+
+int FT_listRange(const char *pcDir, const char *pcLow, const char *pcHigh,
+                 size_t ulLimit, const char *pcCursor,
+                 struct FT_entry *psEntries, size_t *pulCount){
+    return FT_listRangeIn(&sDefaultTree, pcDir, pcLow, pcHigh, ulLimit,
+                          pcCursor, psEntries, pulCount);
+}
+
+int FT_listPrefix(const char *pcDir, const char *pcPrefix,
+                  size_t ulLimit, const char *pcCursor,
+                  struct FT_entry *psEntries, size_t *pulCount){
+    return FT_listPrefixIn(&sDefaultTree, pcDir, pcPrefix, ulLimit,
+                           pcCursor, psEntries, pulCount);
+}
+
+int FT_listDir(const char *pcDir, size_t ulOffset,
+               const struct FT_entry *psAfter, size_t ulLimit,
+               struct FT_entry *psEntries, size_t *pulCount){
+    return FT_listDirIn(&sDefaultTree, pcDir, ulOffset, psAfter, ulLimit,
+                        psEntries, pulCount);
+}
+
+void FT_freeEntries(struct FT_entry *psEntries, size_t ulCount){
+    size_t i;
+
+    assert(psEntries != NULL || ulCount == 0);
+
+    for(i = 0; i < ulCount; i++)
+        free(psEntries[i].pcName);
+}
+
+int FT_move(const char *pcSrc, const char *pcDst){
+    return FT_moveIn(&sDefaultTree, pcSrc, pcDst);
+}
+
+int FT_copy(const char *pcSrc, const char *pcDst){
+    return FT_copyIn(&sDefaultTree, pcSrc, pcDst);
+}
+
+int FT_snapshot(FT_T *poFResult){
+    return FT_snapshotIn(&sDefaultTree, poFResult);
+}
+
+int FT_save(int iFd){
+    return FT_saveIn(&sDefaultTree, iFd);
+}
+
+int FT_importDir(const char *pcFsPath, const char *pcTreePath,
+                 size_t ulThreads, unsigned int uFlags){
+   return FT_importDirIn(&sDefaultTree, pcFsPath, pcTreePath, ulThreads,
+                         uFlags);
+}
+
+int FT_exportTar(const char *pcDir, int iFd){
+   return FT_exportTarIn(&sDefaultTree, pcDir, iFd);
+}
+
+int FT_importTar(int iFd, unsigned int uFlags){
+   return FT_importTarIn(&sDefaultTree, iFd, uFlags);
+}
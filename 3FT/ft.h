@@ -15,6 +15,22 @@
 #include <stddef.h>
 #include "a4def.h"
 
+/*
+  The functions below operate on a single default File Tree that is
+  set up with FT_init and torn down with FT_destroy. Independent trees
+  can be created with FT_new; every operation has a counterpart with
+  an "In" suffix that takes the tree to operate on as its first
+  argument. Trees share no state, so distinct trees may be used from
+  distinct threads without synchronization.
+*/
+
+/* The status, besides those of a4def.h, of an operation that failed
+   to read or write a file, in which case errno tells why */
+enum { IO_ERROR = MEMORY_ERROR + 1 };
+
+/* A FT_T is an independent File Tree instance */
+typedef struct ft *FT_T;
+
 /*
    Inserts a new directory into the FT with absolute path pcPath.
    Returns SUCCESS if the new directory is inserted successfully.
@@ -64,6 +80,29 @@ int FT_rmDir(const char *pcPath);
 int FT_insertFile(const char *pcPath, void *pvContents,
                   size_t ulLength);
 
+/*
+  Inserts a new file into the FT with absolute path pcPath, as
+  FT_insertFile does, with the ulLength bytes of the file open for
+  reading as iFd from byte ulOffset on as its contents, without
+  reading or copying them: they are mapped read-only and shared
+  (MAP_SHARED), and the operating system reads each page as it is
+  first touched. The contents belong to the FT, as after FT_writeAt:
+  FT_getFileContents returns a pointer into the mapping, which must
+  not be written or freed, valid until the file next changes, and the
+  mapping goes once neither the file nor any copy or snapshot of it
+  uses it. iFd may be closed once the call returns. Changes made to
+  the file iFd show through; it must not be truncated meanwhile, as
+  touching a page past its end raises SIGBUS. A ulLength of 0 maps
+  nothing, and the new file has NULL contents. In a tree with a store
+  (see FT_CHUNKED), the store copies the contents straight from the
+  mapping instead, which is then unmapped.
+  Returns SUCCESS, or the status documented for FT_insertFile, or:
+  * IO_ERROR if the bytes could not be mapped or do not all lie within
+             the file, in which case errno tells why
+*/
+int FT_insertFileMapped(const char *pcPath, int iFd, size_t ulOffset,
+                        size_t ulLength);
+
 /*
   Returns TRUE if the FT contains a file with absolute path
   pcPath and FALSE if not or if there is an error while checking.
@@ -96,11 +135,126 @@ void *FT_getFileContents(const char *pcPath);
   Replaces current contents of the file with absolute path pcPath with
   the parameter pvNewContents of size ulNewLength bytes.
   Returns the old contents if successful. (Note: contents may be NULL.)
-  Returns NULL if unable to complete the request for any reason.
+  Returns NULL if unable to complete the request for any reason, and
+  also if the old contents belonged to the FT (see FT_writeAt and
+  FT_CHUNKED), which frees them.
 */
 void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
                              size_t ulNewLength);
 
+/*
+  Copies up to ulCount bytes of the contents of the file with absolute
+  path pcPath, from byte ulOffset on, to pvDest, and sets *pulRead to
+  how many were copied: fewer than ulCount only at the end of the
+  file, and none from ulOffset on. A file with NULL contents reads as
+  zeros.
+  Returns SUCCESS, or the status documented for FT_stat, or:
+  * NOT_A_FILE if pcPath is in the FT as a directory not a file
+  in which case *pulRead is unchanged. If memory to decompress cold
+  contents (see FT_COLD) runs out, or spilled ones (see FT_SPILL)
+  cannot be read back, returns MEMORY_ERROR with *pulRead set to how
+  many bytes were copied before.
+*/
+int FT_readAt(const char *pcPath, size_t ulOffset, void *pvDest,
+              size_t ulCount, size_t *pulRead);
+
+/*
+  Writes up to ulCount bytes of the contents of the file with absolute
+  path pcPath, from byte ulOffset on, to the file descriptor iFd, such
+  as a socket, and sets *pulSent to how many were written: fewer than
+  ulCount only at the end of the file, and none from ulOffset on. The
+  bytes are copied as few times as where they lie allows: those in a
+  mapping of a file (see FT_insertFileMapped and FT_loadMapped) are
+  spliced into iFd by reference, with vmsplice and splice; spilled
+  contents kept as they are (see FT_SPILL) go from the spill file with
+  sendfile; and others are written from where they lie, the chunks of
+  a file (see FT_CHUNKED) gathered by writev rather than assembled.
+  Each falls back on plain writes where iFd takes nothing better.
+  Bytes passed by reference are read when iFd's reader consumes them,
+  so changes made to a mapped file meanwhile may show through.
+
+  The call holds what a lookup does, the tree's lock or the file's
+  latch, while it writes, so a blocking iFd that fills up holds up
+  changes; a non-blocking one makes the call return IO_ERROR with
+  errno set to EAGAIN instead, and *pulSent tells where to go on from
+  once it can take more.
+  Returns SUCCESS, or the status documented for FT_readAt, with
+  *pulSent set as *pulRead would be, or:
+  * IO_ERROR if a write to iFd failed, in which case errno tells why
+             and *pulSent is set to how many bytes were written before
+*/
+int FT_sendFile(const char *pcPath, int iFd, size_t ulOffset,
+                size_t ulCount, size_t *pulSent);
+
+/*
+  Writes the ulCount bytes pvBytes into the contents of the file with
+  absolute path pcPath, from byte ulOffset on, extending the file if
+  they end past it, with zeros filling any gap.
+
+  The first write to a file moves its contents into a buffer of the
+  FT's own, after which they belong to the FT, not the client: the
+  client's old contents are no longer used and are the client's to
+  free, and FT_getFileContents returns the new ones to be read but not
+  freed, valid only until the file next changes. Later writes change
+  the buffer in place when they fit, taking time in proportion to
+  what they write; a copy of the file made by FT_copy or a snapshot
+  gets its own buffer when either side is first written to.
+  Returns SUCCESS, or the status documented for FT_stat, or:
+  * NOT_A_FILE if pcPath is in the FT as a directory not a file
+  * MEMORY_ERROR if the contents could not grow (also if ulOffset +
+                 ulCount overflows)
+  in which case the contents are unchanged.
+*/
+int FT_writeAt(const char *pcPath, size_t ulOffset, const void *pvBytes,
+               size_t ulCount);
+
+/*
+  Writes the ulCount bytes pvBytes at the end of the contents of the
+  file with absolute path pcPath, as FT_writeAt does. The buffer grows
+  geometrically, so that a run of appends takes time in proportion to
+  what is appended. Returns as FT_writeAt does.
+*/
+int FT_append(const char *pcPath, const void *pvBytes, size_t ulCount);
+
+/*
+  Moves the file or the directory hierarchy (subtree) with absolute
+  path pcSrc to absolute path pcDst, whose parent directory must
+  already exist, renaming everything below it accordingly. Takes the
+  same time however large the subtree is. The root may be renamed,
+  but not moved below another directory.
+  Returns SUCCESS if moved. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcSrc or pcDst does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcSrc or
+                     pcDst, or if pcDst lies below pcSrc
+  * NO_SUCH_PATH if pcSrc or the parent of pcDst does not exist
+  * NOT_A_DIRECTORY if the parent of pcDst is a file
+  * ALREADY_IN_TREE if pcDst is already in the FT (as dir or file)
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_move(const char *pcSrc, const char *pcDst);
+
+/*
+  Copies the file or the directory hierarchy (subtree) with absolute
+  path pcSrc to absolute path pcDst, whose parent directory must
+  already exist. The copy shares its nodes with the original until
+  either side changes, so making it takes the same time and memory
+  however large the subtree is; a later change to either side first
+  copies the shared nodes on the path to what it changes. File
+  contents are shared, not copied: replacing them on one side does
+  not affect the other, and returns contents the other may still use.
+  Returns SUCCESS if copied. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcSrc or pcDst does not represent a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcSrc or
+                     pcDst, or if pcDst lies below pcSrc
+  * NO_SUCH_PATH if pcSrc or the parent of pcDst does not exist
+  * NOT_A_DIRECTORY if the parent of pcDst is a file
+  * ALREADY_IN_TREE if pcDst is already in the FT (as dir or file)
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_copy(const char *pcSrc, const char *pcDst);
+
 /*
   Returns SUCCESS if pcPath exists in the hierarchy,
   Otherwise, returns:
@@ -119,6 +273,21 @@ void *FT_replaceFileContents(const char *pcPath, void *pvNewContents,
 */
 int FT_stat(const char *pcPath, boolean *pbIsFile, size_t *pulSize);
 
+/*
+  As FT_stat, but also sets *pulStored to the number of bytes of memory
+  the contents of the file pcPath take, and sets *pulSize for a
+  directory too: to the sum of the sizes of the files below it, and
+  *pulStored to the sum of what they take. *pulSize / *pulStored is
+  then the shared-storage ratio, how many times over sharing stretches
+  memory. Contents the FT shares among files (see FT_DEDUP) count
+  divided evenly among them, those of the client in full, and NULL
+  contents and those mapped by FT_insertFileMapped not at all.
+  Versions of contents replaced but not yet freed (see
+  FT_LOCKFREEREADS) still count among those sharing them.
+*/
+int FT_statStored(const char *pcPath, boolean *pbIsFile, size_t *pulSize,
+                  size_t *pulStored);
+
 /*
   Sets the FT data structure to an initialized state.
   The data structure is initially empty.
@@ -149,4 +318,683 @@ int FT_destroy(void);
 */
 char *FT_toString(void);
 
+/*
+  Calls (*pfApply)(pcPath, bIsFile, pvExtra) for each file and
+  directory whose absolute path pcPath matches the glob pattern
+  pcPattern, where bIsFile tells which it is, in the order of
+  FT_toString. The pattern is a path whose components may use '*',
+  '?' and "[...]" as in the shell, such as "*.o" or "lib[a-m]?", and
+  may be "**" to match any number of directories, including none.
+  Only directories whose paths could lead to a match are visited, and
+  a component that starts with literal characters narrows the
+  children visited by binary search.
+  pcPath is only valid during the call, and pfApply must not use the
+  FT. Returns SUCCESS, even if nothing matches. Otherwise,
+  returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcPattern is not a well-formatted pattern
+  * MEMORY_ERROR if memory could not be allocated to complete request,
+                 in which case some matches may have been reported
+*/
+int FT_glob(const char *pcPattern,
+            void (*pfApply)(const char *pcPath, boolean bIsFile,
+                            void *pvExtra),
+            void *pvExtra);
+
+/*
+  Calls (*pfApply)(pcPath, bIsFile, pvExtra) for each file and
+  directory whose name, the last component of its absolute path
+  pcPath, is pcName, where bIsFile tells which it is, in no particular
+  order. A tree made with FT_NAMEINDEX finds them in its name index
+  without visiting anything else; otherwise, every node is visited.
+  pcPath is only valid during the call, and pfApply must not use the
+  FT. Returns SUCCESS, even if nothing has the name. Otherwise,
+  returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcName is empty or contains '/'
+  * MEMORY_ERROR if memory could not be allocated to complete request,
+                 in which case some paths may have been reported
+*/
+int FT_findByName(const char *pcName,
+                  void (*pfApply)(const char *pcPath, boolean bIsFile,
+                                  void *pvExtra),
+                  void *pvExtra);
+
+/*
+  Calls (*pfApply)(pcPath, ulSize, pvExtra) for the ulK largest files
+  below the directory with absolute path pcDir, or all of them if
+  there are fewer, where pcPath is the file's absolute path and ulSize
+  its size, largest first and files of the same size in order of
+  path. Every file below pcDir is visited and sorted, unless the tree
+  was made with FT_SIZEINDEX and more nodes than about the square root
+  of the number of files in the tree times ulK lie below pcDir, in
+  which case they are read off its size index instead. That skips
+  larger files elsewhere in the tree, and so takes up to a pass over
+  all of them when pcDir holds only small ones.
+  pcPath is only valid during the call, and pfApply must not use the
+  FT. Returns SUCCESS, even if nothing is reported. Otherwise,
+  returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcDir is not a well-formatted path
+  * CONFLICTING_PATH if the root exists but is not a prefix of pcDir
+  * NO_SUCH_PATH if no directory with pcDir exists in the hierarchy
+  * NOT_A_DIRECTORY if pcDir is in the FT as a file not a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request,
+                 in which case nothing has been reported
+*/
+int FT_topK(const char *pcDir, size_t ulK,
+            void (*pfApply)(const char *pcPath, size_t ulSize,
+                            void *pvExtra),
+            void *pvExtra);
+
+/*
+  As FT_topK, but reports every file below the directory pcDir whose
+  size is from ulLow to ulHigh bytes, both included, in the same
+  order. With FT_SIZEINDEX, only the files of the tree in that range
+  are looked at, wherever they are, unless fewer nodes than about the
+  square root of the number of files in the tree lie below pcDir.
+*/
+int FT_sizeRange(const char *pcDir, size_t ulLow, size_t ulHigh,
+                 void (*pfApply)(const char *pcPath, size_t ulSize,
+                                 void *pvExtra),
+                 void *pvExtra);
+
+/*
+  Writes the FT to the file descriptor iFd, from its current position
+  on, as an image (see image.h) that FT_loadMapped can map back in.
+  Each record is written once, children before their parents, so iFd
+  may be a pipe or socket; nothing is written to iFd but the image,
+  and iFd is left open. File contents are written as they are, so
+  they must not be changed by the client during the call.
+  Returns SUCCESS if the whole image was written. Otherwise, returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * IO_ERROR if writing to iFd failed, in which case errno tells why
+  * MEMORY_ERROR if memory could not be allocated to complete request,
+                 cold contents (see FT_COLD) decompressed, or spilled
+                 ones (see FT_SPILL) read back
+  and whatever was written is not an image.
+*/
+int FT_save(int iFd);
+
+/* Options that may be combined in the uFlags of FT_importDir */
+enum {
+   /* read the contents of each file into memory, rather than record
+      only its size */
+   FT_IMPORTCONTENTS = 0x1
+};
+
+/*
+  Inserts the directory pcFsPath of the local file system, and
+  everything below it, into the FT as a new directory with absolute
+  path pcTreePath, creating any missing ancestor directories as
+  FT_insertDir does. Regular files become files: with FT_IMPORTCONTENTS
+  in uFlags, their contents are read into memory allocated for each,
+  which belongs to the client like any other contents; otherwise they
+  have NULL contents and the size of the file on disk, for FT_stat.
+  Symbolic links and other special files are skipped.
+
+  ulThreads threads, counting the caller's, scan directories at once
+  with no lock held, each building the nodes for the directories it
+  reads on its own. The result is then linked into the FT all at once,
+  so other threads see either none of it or all of it.
+  Returns SUCCESS if the hierarchy was inserted. Otherwise, returns
+  the status documented for FT_insertDir, or:
+  * IO_ERROR if a directory or file could not be read, in which case
+             errno tells why
+  and nothing read from pcFsPath is inserted.
+*/
+int FT_importDir(const char *pcFsPath, const char *pcTreePath,
+                 size_t ulThreads, unsigned int uFlags);
+
+/*
+  Writes the directory with absolute path pcDir and everything below
+  it, or the file there, to the file descriptor iFd, from its current
+  position on, as a tar archive (see tar.h) that any tar program can
+  extract. Members are named by their paths in the FT and come parents
+  first, each directory's files before its directories. File contents
+  are written with writev straight from where they lie, without being
+  copied, so they must not be changed by the client during the call.
+  Those of a tree made with FT_CHUNKED, FT_COLD or FT_SPILL are not
+  kept where the client left them, and are written chunk by chunk
+  instead, as by FT_sendFile, before the next file is added, cold
+  chunks decompressed and spilled ones read back through the tree's
+  hot buffers as they go. A file with no contents but a nonzero size
+  is written empty, with its size in an extended header. iFd is left
+  open.
+  Returns SUCCESS if the whole archive was written. Otherwise, returns
+  the status documented for FT_stat, or:
+  * IO_ERROR if writing to iFd failed, in which case errno tells why
+  * MEMORY_ERROR if cold contents (see FT_COLD) could not be
+                 decompressed, or spilled ones (see FT_SPILL) read back
+  and whatever was written is not a whole archive. Nothing is written
+  if pcDir is not in the FT.
+*/
+int FT_exportTar(const char *pcDir, int iFd);
+
+/* Options that may be combined in the uFlags of FT_importTar */
+enum {
+   /* keep the contents of files in large blocks of memory that belong
+      to the FT, freed with it and every snapshot of it, rather than in
+      memory allocated for each that belongs to the client */
+   FT_TARARENA = 0x1
+};
+
+/*
+  Reads a tar archive from the file descriptor iFd, from its current
+  position to its end, and inserts its directories and regular files
+  into the FT in the order they come, each under its path in the
+  archive with any leading "/" or "./" dropped: the first component of
+  every path must be the root's name, or becomes it if the FT is
+  empty. Archives written by FT_exportTar and by the common tar
+  programs are read, long paths and sizes included; links and other
+  members are skipped. Directories already in the FT are kept, and
+  missing ancestors are created as FT_insertDir does. The archive is
+  read in large blocks, and each member's directories are found from
+  those of the one before rather than from the root.
+
+  With FT_TARARENA in uFlags, file contents are read into memory that
+  belongs to the FT and must never be freed or changed by the client;
+  otherwise each file's contents are read into memory allocated for
+  it, which belongs to the client like any other contents. A file
+  written with no contents by FT_exportTar gets none again. iFd is
+  left open.
+  Returns SUCCESS if the whole archive was inserted. Otherwise, returns
+  the status documented for FT_insertFile, or:
+  * IO_ERROR if reading from iFd failed, in which case errno tells why
+             (EINVAL if the archive is damaged or cut short)
+  and the members before the one that failed stay inserted.
+*/
+int FT_importTar(int iFd, unsigned int uFlags);
+
+/* A child of a directory, as listed by FT_listRange and FT_listDir */
+struct FT_entry {
+   /* the child's name, which belongs to the client */
+   char *pcName;
+   /* TRUE if the child is a file, FALSE if it is a directory */
+   boolean bIsFile;
+   /* the size of the file's contents, or 0 for a directory */
+   size_t ulSize;
+};
+
+/*
+  Lists the children of the directory with absolute path pcDir whose
+  names are not less than pcLow and less than pcHigh, either of which
+  may be NULL for no bound, in order of name, files and directories
+  alike. Stores at most ulLimit of them in psEntries, which must have
+  room for as many, and their number in *pulCount. If pcCursor is not
+  NULL, only names greater than it are listed, so passing the name of
+  the last entry of one page gives the next. Each page costs a binary
+  search per kind of child plus time proportional to its length,
+  however many children pcDir has.
+  Returns SUCCESS if the entries were stored, after which the client
+  frees their names with FT_freeEntries. Otherwise, stores 0 in
+  *pulCount and returns:
+  * INITIALIZATION_ERROR if the FT is not in an initialized state
+  * BAD_PATH if pcDir is not a well-formatted path
+  * CONFLICTING_PATH if the root's path is not a prefix of pcDir
+  * NO_SUCH_PATH if no directory exists at pcDir
+  * NOT_A_DIRECTORY if pcDir is in the FT as a file not a directory
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_listRange(const char *pcDir, const char *pcLow, const char *pcHigh,
+                 size_t ulLimit, const char *pcCursor,
+                 struct FT_entry *psEntries, size_t *pulCount);
+
+/*
+  As FT_listRange, but lists the children whose names start with
+  pcPrefix.
+*/
+int FT_listPrefix(const char *pcDir, const char *pcPrefix,
+                  size_t ulLimit, const char *pcCursor,
+                  struct FT_entry *psEntries, size_t *pulCount);
+
+/*
+  Lists the children of the directory with absolute path pcDir, files
+  first and then directories, each in order of name, as FT_toString
+  does. Stores at most ulLimit of them in psEntries, which must have
+  room for as many, and their number in *pulCount. If psAfter is not
+  NULL, the listing resumes right after that entry, the last of an
+  earlier page, wherever it has moved since; otherwise it starts with
+  the child at offset ulOffset in that order. A page costs one lookup
+  of pcDir plus a binary search for psAfter, and time proportional to
+  its length, however many children pcDir has.
+  Returns SUCCESS if the entries were stored, after which the client
+  frees their names with FT_freeEntries. Otherwise, stores 0 in
+  *pulCount and returns the status documented for FT_listRange.
+*/
+int FT_listDir(const char *pcDir, size_t ulOffset,
+               const struct FT_entry *psAfter, size_t ulLimit,
+               struct FT_entry *psEntries, size_t *pulCount);
+
+/* Frees the names of the ulCount entries psEntries. */
+void FT_freeEntries(struct FT_entry *psEntries, size_t ulCount);
+
+/*--------------------------------------------------------------------*/
+
+/* Options that may be combined in the uFlags of FT_newWithFlags */
+enum {
+   /* every operation on the tree may be called concurrently from
+      multiple threads: lookups (contains*, getFileContents, stat,
+      toString) share a reader-writer lock, while insert*, rm* and
+      replaceFileContents take it exclusively */
+   FT_THREADSAFE = 0x1,
+   /* as FT_THREADSAFE, but with a latch in every node instead of one
+      lock per tree: lookups and mutations walk down hand-over-hand,
+      and a mutation only latches exclusively the directory whose
+      children it changes, so writers in disjoint subtrees proceed in
+      parallel. Creating or removing the root and FT_toStringIn still
+      lock the whole tree, as does a mutation whose path crosses a
+      node shared by FT_snapshotIn or FT_copyIn, until it is copied;
+      once either has been called, every mutation first walks its path
+      with shared latches to tell */
+   FT_FINEGRAINED = 0x2,
+   /* as FT_FINEGRAINED for mutations, but lookups and FT_toStringIn
+      take no lock or latch at all: children are published atomically
+      and removed nodes are freed only once no lookup can still be
+      reading them. Lookups never wait for writers. A lookup racing
+      FT_replaceFileContentsIn may see the new contents with the old
+      size in FT_statIn. Contents returned by a lookup remain the
+      client's to keep alive */
+   FT_LOCKFREEREADS = 0x4,
+   /* keep an index from each name to the paths of the nodes that have
+      it, for FT_findByNameIn. The index holds a copy of every path,
+      which FT_getNameIndexSizeIn reports, and FT_moveIn, FT_copyIn
+      and removals take time proportional to the size of the subtree
+      to keep it up to date. If memory for the index runs out, the
+      tree carries on without it. Snapshots have no index. A tree
+      loaded by FT_loadMapped or FT_openLogged is indexed whole as it
+      is loaded, which takes time proportional to its size */
+   FT_NAMEINDEX = 0x8,
+   /* as FT_NAMEINDEX, but keep the path of every file in order of
+      size, for FT_topKIn and FT_sizeRangeIn, which
+      FT_replaceFileContentsIn also updates. FT_getSizeIndexSizeIn
+      reports its size, and loading a tree costs what it does with
+      FT_NAMEINDEX */
+   FT_SIZEINDEX = 0x10,
+   /* keep the contents given to FT_insertFileIn and
+      FT_replaceFileContentsIn in a store of chunks instead, cut where
+      the bytes themselves say, each unique chunk kept once however
+      many files hold it, so that files that are largely the same
+      share most of their memory. The contents are copied into the
+      store, outside any lock, and stay the client's. FT_readAtIn
+      reads the chunks where they lie; FT_getFileContentsIn assembles
+      the file in one piece the first time, kept with the file until it
+      changes, and returns NULL if memory for that runs out. Writing
+      to a file with FT_writeAtIn or FT_appendIn gives it contents of
+      its own again. FT_getChunkStoreSizeIn reports the store's size */
+   FT_CHUNKED = 0x20,
+   /* as FT_CHUNKED, but keep each file whole, for the common case of
+      the same contents inserted under many paths: the contents are
+      hashed, and a file the same as one stored already shares its
+      memory, until either is written to. Contents stored once are
+      returned as they are by FT_getFileContentsIn, and must not be
+      changed. FT_statStoredIn reports how much is shared. With
+      FT_CHUNKED, chunks are shared instead */
+   FT_DEDUP = 0x40,
+   /* as FT_DEDUP, or with FT_CHUNKED as it, but contents no lookup
+      has read for a while, a minute unless FT_setColdIn says
+      otherwise, are compressed by a thread of the tree's store, with
+      a fast LZ codec, and those they shrink by an eighth or more are
+      kept that way. Reading cold contents decompresses them into one
+      of a few hot buffers, 8 unless FT_setColdIn says otherwise, which
+      the reads that follow share until it is reused for other cold
+      contents, least recently used first. A read costs the tracking
+      at most one relaxed atomic store. A pointer FT_getFileContentsIn
+      returns is then only valid until its contents go cold, or its hot
+      buffer is reused; FT_readAtIn copies out what is needed instead.
+      FT_getChunkStoreSizeIn and FT_statStoredIn report the memory
+      saved */
+   FT_COLD = 0x80,
+   /* as FT_DEDUP, or with FT_CHUNKED as it, but keep the memory the
+      contents take within a budget, half the machine's memory unless
+      FT_setSpillIn says otherwise: once the store passes it, a thread
+      of its own writes the contents read least recently out to a
+      spill file, compressed if FT_COLD has made them cold, keeping
+      only where they lie, until it is an eighth below; an insert that
+      passes it waits for that. The nodes of the tree stay in memory.
+      Spilled contents are read back into the hot buffers of FT_COLD,
+      with the same limits on pointers FT_getFileContentsIn returns.
+      The file is unlinked as soon as it is made, in $TMPDIR or /tmp
+      unless FT_setSpillIn names a directory, as it should where /tmp
+      is held in memory, and goes with the tree */
+   FT_SPILL = 0x100
+};
+
+/*
+  Creates a new, empty File Tree that is already in an initialized
+  state. Returns SUCCESS and sets *poFResult to the new tree if
+  successful. Otherwise, sets *poFResult to NULL and returns
+  MEMORY_ERROR.
+*/
+int FT_new(FT_T *poFResult);
+
+/*
+  As FT_new, but with the options in uFlags, a bitwise OR of the
+  FT_ option constants above (0 for none).
+*/
+int FT_newWithFlags(unsigned int uFlags, FT_T *poFResult);
+
+/*
+  Removes all contents of oFTree and frees it. Does nothing if oFTree
+  is NULL. File contents passed in by the client are not freed, but
+  those the FT owns are: those written by FT_writeAt and FT_append,
+  those of a chunk store or shared among files (see FT_CHUNKED and
+  FT_DEDUP), the arenas of FT_importTar, and the mappings of
+  FT_loadMapped and FT_insertFileMapped, which are unmapped. No other
+  thread may be using oFTree, even if it is thread-safe.
+*/
+void FT_free(FT_T oFTree);
+
+/* As FT_insertDir, but on the tree oFTree. */
+int FT_insertDirIn(FT_T oFTree, const char *pcPath);
+
+/* As FT_containsDir, but on the tree oFTree. */
+boolean FT_containsDirIn(FT_T oFTree, const char *pcPath);
+
+/* As FT_rmDir, but on the tree oFTree. */
+int FT_rmDirIn(FT_T oFTree, const char *pcPath);
+
+/* As FT_insertFile, but on the tree oFTree. */
+int FT_insertFileIn(FT_T oFTree, const char *pcPath, void *pvContents,
+                    size_t ulLength);
+
+/* As FT_insertFileMapped, but on the tree oFTree. */
+int FT_insertFileMappedIn(FT_T oFTree, const char *pcPath, int iFd,
+                          size_t ulOffset, size_t ulLength);
+
+/* As FT_containsFile, but on the tree oFTree. */
+boolean FT_containsFileIn(FT_T oFTree, const char *pcPath);
+
+/* As FT_rmFile, but on the tree oFTree. */
+int FT_rmFileIn(FT_T oFTree, const char *pcPath);
+
+/* As FT_getFileContents, but on the tree oFTree. */
+void *FT_getFileContentsIn(FT_T oFTree, const char *pcPath);
+
+/* As FT_replaceFileContents, but on the tree oFTree. */
+void *FT_replaceFileContentsIn(FT_T oFTree, const char *pcPath,
+                               void *pvNewContents, size_t ulNewLength);
+
+/*
+  As FT_readAt, but on the tree oFTree. A lock-free lookup latches the
+  file while copying, so that it sees no write half done.
+*/
+int FT_readAtIn(FT_T oFTree, const char *pcPath, size_t ulOffset,
+                void *pvDest, size_t ulCount, size_t *pulRead);
+
+/* As FT_sendFile, but on the tree oFTree. */
+int FT_sendFileIn(FT_T oFTree, const char *pcPath, int iFd,
+                  size_t ulOffset, size_t ulCount, size_t *pulSent);
+
+/* As FT_writeAt, but on the tree oFTree. */
+int FT_writeAtIn(FT_T oFTree, const char *pcPath, size_t ulOffset,
+                 const void *pvBytes, size_t ulCount);
+
+/* As FT_append, but on the tree oFTree. */
+int FT_appendIn(FT_T oFTree, const char *pcPath, const void *pvBytes,
+                size_t ulCount);
+
+/* As FT_stat, but on the tree oFTree. */
+int FT_statIn(FT_T oFTree, const char *pcPath, boolean *pbIsFile,
+              size_t *pulSize);
+
+/* As FT_statStored, but on the tree oFTree, locked for a walk as by
+   FT_toStringIn. */
+int FT_statStoredIn(FT_T oFTree, const char *pcPath, boolean *pbIsFile,
+                    size_t *pulSize, size_t *pulStored);
+
+/*
+  As FT_move, but on the tree oFTree. Always locks a thread-safe tree
+  exclusively. A lock-free lookup racing the move may find the subtree
+  at both paths, but never at neither.
+*/
+int FT_moveIn(FT_T oFTree, const char *pcSrc, const char *pcDst);
+
+/*
+  As FT_copy, but on the tree oFTree. Always locks a thread-safe tree
+  exclusively; in a fine-grained tree, so does a later change whose
+  path crosses a node the copy shares, as after FT_snapshotIn.
+*/
+int FT_copyIn(FT_T oFTree, const char *pcSrc, const char *pcDst);
+
+/* As FT_toString, but on the tree oFTree. */
+char *FT_toStringIn(FT_T oFTree);
+
+/*
+  As FT_glob, but on the tree oFTree. Locks oFTree as FT_toStringIn
+  does for the whole walk, so pfApply must not use oFTree either,
+  except for lookups if oFTree has lock-free lookups.
+*/
+int FT_globIn(FT_T oFTree, const char *pcPattern,
+              void (*pfApply)(const char *pcPath, boolean bIsFile,
+                              void *pvExtra),
+              void *pvExtra);
+
+/*
+  As FT_findByName, but on the tree oFTree. Without an index, locks
+  oFTree as FT_globIn does.
+*/
+int FT_findByNameIn(FT_T oFTree, const char *pcName,
+                    void (*pfApply)(const char *pcPath, boolean bIsFile,
+                                    void *pvExtra),
+                    void *pvExtra);
+
+/*
+  Returns the number of bytes allocated for oFTree's name index, or 0
+  if oFTree has none, to be weighed against the time FT_findByNameIn
+  saves with it.
+*/
+size_t FT_getNameIndexSizeIn(FT_T oFTree);
+
+/*
+  As FT_topK, but on the tree oFTree. Locks oFTree as FT_globIn does,
+  with a size index only while counting the nodes below pcDir, and
+  walking them if there are few enough.
+*/
+int FT_topKIn(FT_T oFTree, const char *pcDir, size_t ulK,
+              void (*pfApply)(const char *pcPath, size_t ulSize,
+                              void *pvExtra),
+              void *pvExtra);
+
+/* As FT_sizeRange, but on the tree oFTree, locked as by FT_topKIn. */
+int FT_sizeRangeIn(FT_T oFTree, const char *pcDir, size_t ulLow,
+                   size_t ulHigh,
+                   void (*pfApply)(const char *pcPath, size_t ulSize,
+                                   void *pvExtra),
+                   void *pvExtra);
+
+/* Returns the number of bytes allocated for oFTree's size index, or 0
+   if oFTree has none. */
+size_t FT_getSizeIndexSizeIn(FT_T oFTree);
+
+/*
+  Returns the number of bytes allocated for oFTree's store of chunks,
+  counting the files assembled in one piece, or 0 if oFTree has none,
+  to be weighed against the sum of the sizes of its files.
+*/
+size_t FT_getChunkStoreSizeIn(FT_T oFTree);
+
+/*
+  Sets how long the contents of oFTree, made with FT_COLD, must go
+  unread before they are compressed, to ulIdleMillis milliseconds, and
+  how many hot buffers cold contents are read through, to ulHotBuffers
+  (at least 1), from the next time each is needed on. Does nothing if
+  oFTree was made without FT_COLD.
+*/
+void FT_setColdIn(FT_T oFTree, unsigned long ulIdleMillis,
+                  size_t ulHotBuffers);
+
+/*
+  Sets the budget of oFTree, made with FT_SPILL, to ulBudget bytes of
+  contents, spilling at once any over it, and if pcDir is not NULL and
+  nothing has been spilled yet, makes the spill file in the directory
+  pcDir now. Returns:
+  * SUCCESS if oFTree was made without FT_SPILL, in which case it does
+    nothing, or if successful
+  * MEMORY_ERROR if memory for the path of the file could not be
+    allocated
+  * IO_ERROR if the file could not be made in pcDir, in which case
+    errno tells why, and the budget is left as it was
+*/
+int FT_setSpillIn(FT_T oFTree, size_t ulBudget, const char *pcDir);
+
+/* As FT_listRange, but on the tree oFTree. */
+int FT_listRangeIn(FT_T oFTree, const char *pcDir, const char *pcLow,
+                   const char *pcHigh, size_t ulLimit,
+                   const char *pcCursor, struct FT_entry *psEntries,
+                   size_t *pulCount);
+
+/* As FT_listPrefix, but on the tree oFTree. */
+int FT_listPrefixIn(FT_T oFTree, const char *pcDir, const char *pcPrefix,
+                    size_t ulLimit, const char *pcCursor,
+                    struct FT_entry *psEntries, size_t *pulCount);
+
+/* As FT_listDir, but on the tree oFTree. */
+int FT_listDirIn(FT_T oFTree, const char *pcDir, size_t ulOffset,
+                 const struct FT_entry *psAfter, size_t ulLimit,
+                 struct FT_entry *psEntries, size_t *pulCount);
+
+/*
+  Takes a snapshot of oFTree: a read-only tree holding exactly what
+  oFTree holds now, which later changes to oFTree do not affect.
+  Returns SUCCESS and sets *poFResult to the snapshot if successful.
+  Otherwise, sets *poFResult to NULL and returns:
+  * INITIALIZATION_ERROR if oFTree is not in an initialized state
+  * MEMORY_ERROR if memory could not be allocated to complete request
+
+  The snapshot shares all of its nodes with oFTree, so taking it costs
+  the same however large the tree is. A change to oFTree afterwards
+  first copies the shared nodes on the path to what it changes, so
+  memory grows with the changes made since. In a fine-grained tree, a
+  change holds the lock exclusively while its path crosses a shared
+  node, so the first ones after a snapshot, which copy the root, wait
+  for each other; changes below nodes already copied latch as before.
+
+  The snapshot is an FT_T of its own, freed with FT_free, and may
+  outlive oFTree. Lookups and FT_toStringIn on it need no locking and
+  may run in any number of threads; insert*, rm* and
+  replaceFileContents fail on it as if it were not initialized. File
+  contents are shared, not copied.
+*/
+int FT_snapshotIn(FT_T oFTree, FT_T *poFResult);
+
+/* As FT_snapshotIn, but of the default tree. */
+int FT_snapshot(FT_T *poFResult);
+
+/*
+  As FT_save, but of the tree oFTree, locked as by FT_toStringIn for
+  the whole write. Saving a snapshot instead leaves oFTree free to
+  change meanwhile, and still writes a consistent image.
+*/
+int FT_saveIn(FT_T oFTree, int iFd);
+
+/*
+  Creates a new File Tree, with the options in uFlags as for
+  FT_newWithFlags, holding the image written by FT_save to the file
+  pcPath. The file is mapped read-only rather than read, so loading
+  takes the same time however large the tree is: each directory's
+  children are read from the mapping the first time the directory is
+  looked at, and the operating system reads the pages that takes as
+  they are first touched. Lookups on a part of the tree already read
+  cost what they do on any other tree. FT_NAMEINDEX and FT_SIZEINDEX
+  give up this laziness: their indexes are built as the tree is
+  loaded, which reads in every directory of the image and touches
+  every page of its records, so that loading then takes time
+  proportional to the size of the tree, as building it would.
+
+  The tree is an overlay on the image: insert*, rm*, move, copy and
+  replaceFileContents work as on any tree and only ever change memory,
+  never the file. File contents are not copied: those of files from
+  the image point into the read-only mapping, must not be written or
+  freed by the client, and remain valid as long as the file is in
+  oFTree or any snapshot or copy of it, even after being replaced.
+  The file must not be changed while the tree is in use.
+
+  Returns SUCCESS and sets *poFResult to the new tree if successful.
+  Otherwise, sets *poFResult to NULL and returns:
+  * IO_ERROR if pcPath could not be opened or mapped, or is not an
+             image, in which case errno tells why
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int FT_loadMapped(const char *pcPath, unsigned int uFlags,
+                  FT_T *poFResult);
+
+/*
+  Opens the durable File Tree whose files are named after pcBase,
+  creating it empty if there are none, with the options in uFlags as
+  for FT_newWithFlags. Every change made to it by insertDir,
+  insertFile, rmDir, rmFile, replaceFileContents, move and copy is
+  appended to a write-ahead log, pcBase followed by ".log", and is
+  durable once the call that made it returns, so that the tree can be
+  opened again as it was after a crash. Concurrent changes share one
+  fdatasync for all of them, so throughput grows with the number of
+  threads changing the tree; in a fine-grained tree changes hold the
+  lock exclusively, but only while they change memory, not while they
+  wait for the disk. The log holds only what happened since the last
+  checkpoint, an image (see FT_loadMapped) named pcBase followed by
+  ".img": once the log passes 64 MB, the change that took it there
+  checkpoints the tree before returning, while other changes go on.
+  Opening a tree maps its image and replays its log, and checkpoints
+  it again if the log held any changes; files named pcBase followed
+  by ".img.tmp" and ".log.next" are used meanwhile. The client must
+  not open the same files twice at once.
+
+  File contents passed to the tree are not copied, as for any tree,
+  but are written to the log; those of files read back on opening
+  point into the read-only mapping of the image, as for FT_loadMapped.
+
+  Returns SUCCESS and sets *poFResult to the tree if successful.
+  Otherwise, sets *poFResult to NULL and returns:
+  * IO_ERROR if the files could not be read or written, in which case
+             errno tells why
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  A change to the tree returns IO_ERROR if it took effect but could
+  not be made durable, or MEMORY_ERROR if it could not be logged.
+  After that, or after a checkpoint fails to replace the log, every
+  change fails with the same status without taking effect (a
+  replaceFileContents returns NULL), until the tree is opened again.
+*/
+int FT_openLogged(const char *pcBase, unsigned int uFlags,
+                  FT_T *poFResult);
+
+/*
+  Checkpoints the durable tree oFTree, so that its log starts over and
+  opening it replays nothing: writes a snapshot of it as its image, to
+  a temporary file renamed into place, then removes the changes the
+  image holds from the log. Changes made meanwhile, by other threads,
+  go on and are logged as usual. Returns SUCCESS if successful.
+  Otherwise, returns:
+  * INITIALIZATION_ERROR if oFTree was not opened by FT_openLogged
+  * IO_ERROR if the files could not be written, in which case errno
+             tells why
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  A failed checkpoint loses nothing, but may fail the log as described
+  for FT_openLogged.
+*/
+int FT_checkpointIn(FT_T oFTree);
+
+/*
+  As FT_importDir, but into the tree oFTree. The scan holds no lock;
+  linking the result holds oFTree's lock exclusively, and in a durable
+  tree logs every node imported as an insertion.
+*/
+int FT_importDirIn(FT_T oFTree, const char *pcFsPath,
+                   const char *pcTreePath, size_t ulThreads,
+                   unsigned int uFlags);
+
+/*
+  As FT_exportTar, but of the tree oFTree, locked as by FT_toStringIn
+  for the whole write.
+*/
+int FT_exportTarIn(FT_T oFTree, const char *pcDir, int iFd);
+
+/*
+  As FT_importTar, but into the tree oFTree. oFTree's lock is held
+  exclusively while the archive is read, however slowly it arrives.
+  With lock-free lookups, each directory created is linked once the
+  archive has moved past it, along with everything under it; in a
+  durable tree every member inserted is logged as an insertion.
+*/
+int FT_importTarIn(FT_T oFTree, int iFd, unsigned int uFlags);
+
 #endif
@@ -0,0 +1,2227 @@
+/*--------------------------------------------------------------------*/
+/* ft_bench.c                                                         */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "ft.h"
+#include "shardft.h"
+#include "wal.h"
+#include "chunkstore.h"
+
+/* Shape of the tree every scenario starts from */
+enum { NUM_DIRS = 64, FILES_PER_DIR = 64,
+       NUM_FILES = NUM_DIRS * FILES_PER_DIR };
+/* Number of distinct contents the writers cycle through */
+enum { NUM_VERSIONS = 4 };
+/* Longest path generated by the benchmark */
+enum { MAX_PATH = 64 };
+
+/* The contents writers store; readers only ever see one of these */
+static char *apcVersions[NUM_VERSIONS] = {
+   "alpha", "bravo!", "charlie", "delta!!!"
+};
+
+/* Pathnames of all the files in the tree */
+static char acPaths[NUM_FILES][MAX_PATH];
+
+/* The ways the benchmark can protect a tree shared by all threads */
+enum Mode { MODE_MUTEX, MODE_RWLOCK, MODE_FINEGRAINED, MODE_LOCKFREE,
+            MODE_SHARDED };
+
+/* Number of files each writer cycles through in its own subtree */
+enum { FILES_PER_WRITER = 256 };
+
+/* Number of records in the log the wal scenario replays */
+enum { WAL_RECORDS = 1 << 20 };
+
+/* Size of each file the tar scenario exports */
+enum { TAR_FILE = 64 * 1024 };
+
+/* The size of each file the untar scenario imports */
+enum { UNTAR_FILE = 1024 };
+
+/* The size of the file the edit scenario changes, of each edit made
+   to it, and the number of edits */
+enum { EDIT_FILE = 50 * 1024 * 1024, EDIT_SIZE = 100, EDITS = 1000 };
+
+/* The size of the file the dedup scenario starts from, the number of
+   copies of it stored, and the number of runs of bytes inserted into
+   each, of DEDUP_RUN bytes */
+enum { DEDUP_FILE = 1024 * 1024, DEDUP_COPIES = 64, DEDUP_EDITS = 8,
+       DEDUP_RUN = 16 };
+
+/* The number and size of the files the cold scenario stores, and the
+   number of hot buffers it leaves them */
+enum { COLD_FILES = 64, COLD_FILE = 256 * 1024, COLD_BUFFERS = 4 };
+
+/* The budget of the spill scenario's tree, and the number and size of
+   the files it stores, ten times as much */
+enum { SPILL_BUDGET = 16 * 1024 * 1024, SPILL_FILES = 640,
+       SPILL_FILE = 256 * 1024 };
+
+/* The number and size of the files the mapped scenario inserts, all
+   parts of one file on disk */
+enum { MAPPED_FILES = 32, MAPPED_FILE = 4 * 1024 * 1024 };
+
+/* The number of times the send scenario sends each of its files, the
+   MAPPED_FILES of the mapped scenario */
+enum { SEND_ROUNDS = 8 };
+
+/* Latencies are counted in buckets of powers of two nanoseconds */
+enum { LATENCY_BUCKETS = 40 };
+
+/* State shared by the threads of one run */
+struct run {
+   /* the tree under test, unless the run is MODE_SHARDED */
+   FT_T oFTree;
+   /* the tree under test in MODE_SHARDED */
+   ShardFT_T oSTree;
+   /* the protection used around it */
+   enum Mode eMode;
+   /* the single big lock used in MODE_MUTEX */
+   pthread_mutex_t sMutex;
+   /* nonzero once the threads should stop */
+   int iStop;
+   /* percentage of operations that replace contents */
+   unsigned int uWritePct;
+   /* in Bench_readUnderWrites, TRUE if thread 0 writes meanwhile */
+   boolean bWriter;
+   /* lookup latencies of the last run: aulLatency[i] counts those
+      that took between 2^i and 2^(i+1) nanoseconds */
+   unsigned long aulLatency[LATENCY_BUCKETS];
+};
+
+/* Per-thread arguments and results of one run */
+struct worker {
+   /* the run the thread belongs to */
+   struct run *psRun;
+   /* seed for the thread's private random number generator */
+   unsigned long ulSeed;
+   /* index of the thread within its run */
+   size_t ulIndex;
+   /* number of operations completed */
+   unsigned long ulOps;
+   /* lookup latencies, as in struct run */
+   unsigned long aulLatency[LATENCY_BUCKETS];
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the next value of the xorshift generator with state
+   *pulState. */
+static unsigned long Bench_random(unsigned long *pulState) {
+   unsigned long ulX = *pulState;
+
+   ulX ^= ulX << 13;
+   ulX ^= ulX >> 7;
+   ulX ^= ulX << 17;
+   *pulState = ulX;
+   return ulX;
+}
+
+/* Returns the current monotonic time in seconds. */
+static double Bench_now(void) {
+   struct timespec sNow;
+
+   (void) clock_gettime(CLOCK_MONOTONIC, &sNow);
+   return (double) sNow.tv_sec + (double) sNow.tv_nsec / 1e9;
+}
+
+/* Returns TRUE if pvContents is one of the contents writers store. */
+static boolean Bench_isVersion(void *pvContents) {
+   size_t i;
+
+   for(i = 0; i < NUM_VERSIONS; i++)
+      if(pvContents == apcVersions[i])
+         return TRUE;
+   return FALSE;
+}
+
+/* Populates oFTree with the benchmark's files, all holding the first
+   version of the contents, and fills in acPaths. */
+static void Bench_populate(FT_T oFTree) {
+   size_t ulDir, ulFile, i = 0;
+   int iStatus;
+
+   for(ulDir = 0; ulDir < NUM_DIRS; ulDir++)
+      for(ulFile = 0; ulFile < FILES_PER_DIR; ulFile++) {
+         sprintf(acPaths[i], "bench/d%lu/f%lu",
+                 (unsigned long) ulDir, (unsigned long) ulFile);
+         iStatus = FT_insertFileIn(oFTree, acPaths[i], apcVersions[0],
+                                   strlen(apcVersions[0]) + 1);
+         assert(iStatus == SUCCESS);
+         i++;
+      }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Runs a read-mostly mix of operations against the tree of the run in
+   pvWorker (a struct worker) until told to stop, checking every
+   result for consistency. Returns pvWorker. */
+static void *Bench_readMostly(void *pvWorker) {
+   struct worker *psWorker = pvWorker;
+   struct run *psRun = psWorker->psRun;
+   unsigned long ulState = psWorker->ulSeed;
+   unsigned long ulOps = 0;
+   unsigned long ulR;
+   const char *pcPath;
+   void *pvContents;
+   boolean bIsFile;
+   size_t ulSize;
+   char *pcNew;
+   int iStatus;
+
+   while(!__atomic_load_n(&psRun->iStop, __ATOMIC_RELAXED)) {
+      ulR = Bench_random(&ulState);
+      pcPath = acPaths[ulR % NUM_FILES];
+      ulR /= NUM_FILES;
+
+      if(psRun->eMode == MODE_MUTEX)
+         (void) pthread_mutex_lock(&psRun->sMutex);
+
+      if(ulR % 100 < psRun->uWritePct) {
+         pcNew = apcVersions[(ulR / 100) % NUM_VERSIONS];
+         pvContents = FT_replaceFileContentsIn(psRun->oFTree, pcPath,
+                                               pcNew, strlen(pcNew) + 1);
+         assert(Bench_isVersion(pvContents));
+      }
+      else if(ulR % 2 == 0) {
+         pvContents = FT_getFileContentsIn(psRun->oFTree, pcPath);
+         assert(Bench_isVersion(pvContents));
+      }
+      else {
+         iStatus = FT_statIn(psRun->oFTree, pcPath, &bIsFile, &ulSize);
+         assert(iStatus == SUCCESS);
+         assert(bIsFile == TRUE);
+         assert(ulSize >= strlen(apcVersions[0]) + 1);
+      }
+
+      if(psRun->eMode == MODE_MUTEX)
+         (void) pthread_mutex_unlock(&psRun->sMutex);
+      ulOps++;
+   }
+
+   psWorker->ulOps = ulOps;
+   return pvWorker;
+}
+
+/* Repeatedly inserts and removes files in a subtree of the tree of
+   the run in pvWorker (a struct worker) that no other thread touches,
+   until told to stop, checking that every status is the expected
+   one. Returns pvWorker. */
+static void *Bench_writeDisjoint(void *pvWorker) {
+   struct worker *psWorker = pvWorker;
+   struct run *psRun = psWorker->psRun;
+   unsigned long ulState = psWorker->ulSeed;
+   unsigned long ulOps = 0;
+   boolean abExists[FILES_PER_WRITER];
+   char acPath[MAX_PATH];
+   size_t ulFile;
+   int iStatus;
+
+   for(ulFile = 0; ulFile < FILES_PER_WRITER; ulFile++)
+      abExists[ulFile] = FALSE;
+
+   while(!__atomic_load_n(&psRun->iStop, __ATOMIC_RELAXED)) {
+      ulFile = Bench_random(&ulState) % FILES_PER_WRITER;
+      sprintf(acPath, "bench/w%lu/d%lu/f%lu",
+              (unsigned long) psWorker->ulIndex,
+              (unsigned long) (ulFile % 16), (unsigned long) ulFile);
+
+      if(psRun->eMode == MODE_MUTEX)
+         (void) pthread_mutex_lock(&psRun->sMutex);
+
+      if(abExists[ulFile])
+         iStatus = FT_rmFileIn(psRun->oFTree, acPath);
+      else
+         iStatus = FT_insertFileIn(psRun->oFTree, acPath,
+                                   apcVersions[0],
+                                   strlen(apcVersions[0]) + 1);
+      assert(iStatus == SUCCESS);
+      abExists[ulFile] = !abExists[ulFile];
+
+      if(psRun->eMode == MODE_MUTEX)
+         (void) pthread_mutex_unlock(&psRun->sMutex);
+      ulOps++;
+   }
+
+   /* leave the subtree empty for the next run */
+   for(ulFile = 0; ulFile < FILES_PER_WRITER; ulFile++)
+      if(abExists[ulFile]) {
+         sprintf(acPath, "bench/w%lu/d%lu/f%lu",
+                 (unsigned long) psWorker->ulIndex,
+                 (unsigned long) (ulFile % 16), (unsigned long) ulFile);
+         iStatus = FT_rmFileIn(psRun->oFTree, acPath);
+         assert(iStatus == SUCCESS);
+      }
+
+   psWorker->ulOps = ulOps;
+   return pvWorker;
+}
+
+/* Times lookups of random files in the tree of the run in pvWorker (a
+   struct worker) until told to stop, counting their latencies, while
+   thread 0 runs Bench_writeDisjoint instead if the run has a writer.
+   Returns pvWorker. */
+static void *Bench_readUnderWrites(void *pvWorker) {
+   struct worker *psWorker = pvWorker;
+   struct run *psRun = psWorker->psRun;
+   unsigned long ulState = psWorker->ulSeed;
+   unsigned long ulOps = 0;
+   unsigned long ulR, ulNanos;
+   const char *pcPath;
+   void *pvContents;
+   boolean bIsFile;
+   size_t ulSize, ulBucket;
+   double dStart;
+   int iStatus;
+
+   if(psRun->bWriter && psWorker->ulIndex == 0)
+      return Bench_writeDisjoint(pvWorker);
+
+   while(!__atomic_load_n(&psRun->iStop, __ATOMIC_RELAXED)) {
+      ulR = Bench_random(&ulState);
+      pcPath = acPaths[ulR % NUM_FILES];
+
+      dStart = Bench_now();
+      if((ulR / NUM_FILES) % 2 == 0) {
+         pvContents = FT_getFileContentsIn(psRun->oFTree, pcPath);
+         assert(Bench_isVersion(pvContents));
+      }
+      else {
+         iStatus = FT_statIn(psRun->oFTree, pcPath, &bIsFile, &ulSize);
+         assert(iStatus == SUCCESS);
+         assert(bIsFile == TRUE);
+      }
+      ulNanos = (unsigned long) ((Bench_now() - dStart) * 1e9);
+
+      for(ulBucket = 0; ulNanos > 1 && ulBucket < LATENCY_BUCKETS - 1;
+          ulBucket++)
+         ulNanos >>= 1;
+      psWorker->aulLatency[ulBucket]++;
+      ulOps++;
+   }
+
+   psWorker->ulOps = ulOps;
+   return pvWorker;
+}
+
+/* Inserts, looks up and removes files of its own in many subtrees of
+   the tree of the run in pvWorker (a struct worker), a ShardFT_T if
+   the run is MODE_SHARDED, until told to stop, checking every result.
+   Returns pvWorker. */
+static void *Bench_insertLookup(void *pvWorker) {
+   struct worker *psWorker = pvWorker;
+   struct run *psRun = psWorker->psRun;
+   unsigned long ulState = psWorker->ulSeed;
+   unsigned long ulOps = 0;
+   boolean abExists[FILES_PER_WRITER];
+   char acPath[MAX_PATH];
+   size_t ulFile;
+   boolean bSharded = psRun->eMode == MODE_SHARDED;
+   boolean bFound;
+   int iStatus;
+
+   for(ulFile = 0; ulFile < FILES_PER_WRITER; ulFile++)
+      abExists[ulFile] = FALSE;
+
+   while(!__atomic_load_n(&psRun->iStop, __ATOMIC_RELAXED)) {
+      ulFile = Bench_random(&ulState) % FILES_PER_WRITER;
+      /* the second component varies, to spread over the shards */
+      sprintf(acPath, "bench/t%lux%lu/f%lu",
+              (unsigned long) psWorker->ulIndex,
+              (unsigned long) (ulFile % 16), (unsigned long) ulFile);
+
+      if(bSharded)
+         bFound = ShardFT_containsFile(psRun->oSTree, acPath);
+      else
+         bFound = FT_containsFileIn(psRun->oFTree, acPath);
+      assert(bFound == abExists[ulFile]);
+
+      if(abExists[ulFile])
+         iStatus = bSharded ? ShardFT_rmFile(psRun->oSTree, acPath)
+                            : FT_rmFileIn(psRun->oFTree, acPath);
+      else if(bSharded)
+         iStatus = ShardFT_insertFile(psRun->oSTree, acPath,
+                                      apcVersions[0],
+                                      strlen(apcVersions[0]) + 1);
+      else
+         iStatus = FT_insertFileIn(psRun->oFTree, acPath, apcVersions[0],
+                                   strlen(apcVersions[0]) + 1);
+      assert(iStatus == SUCCESS);
+      abExists[ulFile] = !abExists[ulFile];
+      ulOps += 2;
+   }
+
+   for(ulFile = 0; ulFile < FILES_PER_WRITER; ulFile++)
+      if(abExists[ulFile]) {
+         sprintf(acPath, "bench/t%lux%lu/f%lu",
+                 (unsigned long) psWorker->ulIndex,
+                 (unsigned long) (ulFile % 16), (unsigned long) ulFile);
+         iStatus = bSharded ? ShardFT_rmFile(psRun->oSTree, acPath)
+                            : FT_rmFileIn(psRun->oFTree, acPath);
+         assert(iStatus == SUCCESS);
+      }
+
+   psWorker->ulOps = ulOps;
+   return pvWorker;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Runs pfWorker on ulThreads threads against the tree of psRun for
+   ulMillis milliseconds, and returns the throughput in operations per
+   second. Leaves the latencies the workers counted in psRun. */
+static double Bench_run(struct run *psRun, void *(*pfWorker)(void *),
+                        size_t ulThreads, unsigned long ulMillis) {
+   pthread_t *psThreads;
+   struct worker *psWorkers;
+   struct timespec sSleep;
+   double dStart, dElapsed;
+   unsigned long ulTotal = 0;
+   size_t i, j;
+
+   psThreads = calloc(ulThreads, sizeof(pthread_t));
+   psWorkers = calloc(ulThreads, sizeof(struct worker));
+   assert(psThreads != NULL && psWorkers != NULL);
+
+   psRun->iStop = 0;
+   for(i = 0; i < LATENCY_BUCKETS; i++)
+      psRun->aulLatency[i] = 0;
+   dStart = Bench_now();
+   for(i = 0; i < ulThreads; i++) {
+      psWorkers[i].psRun = psRun;
+      psWorkers[i].ulIndex = i;
+      psWorkers[i].ulSeed = 0x9E3779B9UL * (i + 1);
+      (void) pthread_create(&psThreads[i], NULL, pfWorker,
+                            &psWorkers[i]);
+   }
+
+   sSleep.tv_sec = (time_t) (ulMillis / 1000);
+   sSleep.tv_nsec = (long) (ulMillis % 1000) * 1000000L;
+   (void) nanosleep(&sSleep, NULL);
+   __atomic_store_n(&psRun->iStop, 1, __ATOMIC_RELAXED);
+
+   for(i = 0; i < ulThreads; i++) {
+      (void) pthread_join(psThreads[i], NULL);
+      ulTotal += psWorkers[i].ulOps;
+      for(j = 0; j < LATENCY_BUCKETS; j++)
+         psRun->aulLatency[j] += psWorkers[i].aulLatency[j];
+   }
+   dElapsed = Bench_now() - dStart;
+
+   free(psWorkers);
+   free(psThreads);
+   return (double) ulTotal / dElapsed;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Sets up psRun to use protection eMode around a fresh, populated
+   tree, with uWritePct percent of the read-mostly mix being writes. */
+static void Bench_newRun(struct run *psRun, enum Mode eMode,
+                         unsigned int uWritePct) {
+   unsigned int uFlags = 0;
+   int iStatus;
+
+   if(eMode == MODE_RWLOCK)
+      uFlags = FT_THREADSAFE;
+   else if(eMode == MODE_FINEGRAINED)
+      uFlags = FT_FINEGRAINED;
+   else if(eMode == MODE_LOCKFREE)
+      uFlags = FT_LOCKFREEREADS;
+
+   psRun->eMode = eMode;
+   psRun->uWritePct = uWritePct;
+   psRun->bWriter = FALSE;
+   psRun->oFTree = NULL;
+   psRun->oSTree = NULL;
+   (void) pthread_mutex_init(&psRun->sMutex, NULL);
+   iStatus = FT_newWithFlags(uFlags, &psRun->oFTree);
+   assert(iStatus == SUCCESS);
+   Bench_populate(psRun->oFTree);
+}
+
+/* Sets up psRun to use a fresh, empty ShardFT_T with ulShards
+   shards. */
+static void Bench_newShardedRun(struct run *psRun, size_t ulShards) {
+   int iStatus;
+
+   psRun->eMode = MODE_SHARDED;
+   psRun->uWritePct = 0;
+   psRun->bWriter = FALSE;
+   psRun->oFTree = NULL;
+   (void) pthread_mutex_init(&psRun->sMutex, NULL);
+   iStatus = ShardFT_new(ulShards, &psRun->oSTree);
+   assert(iStatus == SUCCESS);
+}
+
+/* Frees the tree and lock of psRun. */
+static void Bench_freeRun(struct run *psRun) {
+   FT_free(psRun->oFTree);
+   ShardFT_free(psRun->oSTree);
+   (void) pthread_mutex_destroy(&psRun->sMutex);
+}
+
+/* Returns the upper bound in nanoseconds of the bucket of psRun's
+   latencies that holds the dFraction quantile. */
+static unsigned long Bench_quantile(struct run *psRun, double dFraction) {
+   unsigned long ulTotal = 0, ulSeen = 0;
+   size_t i;
+
+   for(i = 0; i < LATENCY_BUCKETS; i++)
+      ulTotal += psRun->aulLatency[i];
+   for(i = 0; i < LATENCY_BUCKETS; i++) {
+      ulSeen += psRun->aulLatency[i];
+      if(ulSeen > 0 && (double) ulSeen >= dFraction * (double) ulTotal)
+         break;
+   }
+   return 2UL << i;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Measures the read-mostly mix with 1, 2, 4, ... up to ulMaxThreads
+   threads, with one big mutex around a plain tree, with an
+   FT_THREADSAFE tree, with an FT_FINEGRAINED tree and with an
+   FT_LOCKFREEREADS tree, and prints the throughputs. */
+static void Bench_scenarioRead(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   struct run sMutexRun, sRwRun, sFineRun, sFreeRun;
+   size_t ulThreads;
+   double dMutex, dRw, dFine, dFree;
+
+   Bench_newRun(&sMutexRun, MODE_MUTEX, 5);
+   Bench_newRun(&sRwRun, MODE_RWLOCK, 5);
+   Bench_newRun(&sFineRun, MODE_FINEGRAINED, 5);
+   Bench_newRun(&sFreeRun, MODE_LOCKFREE, 5);
+
+   printf("read: 95%% getFileContents/stat, 5%% replaceFileContents "
+          "over %d files\n", NUM_FILES);
+   printf("%8s %16s %16s %16s %16s\n", "threads", "mutex ops/s",
+          "rwlock ops/s", "latched ops/s", "lock-free ops/s");
+   for(ulThreads = 1; ulThreads <= ulMaxThreads; ulThreads *= 2) {
+      dMutex = Bench_run(&sMutexRun, Bench_readMostly, ulThreads,
+                         ulMillis);
+      dRw = Bench_run(&sRwRun, Bench_readMostly, ulThreads, ulMillis);
+      dFine = Bench_run(&sFineRun, Bench_readMostly, ulThreads,
+                        ulMillis);
+      dFree = Bench_run(&sFreeRun, Bench_readMostly, ulThreads,
+                        ulMillis);
+      printf("%8lu %16.0f %16.0f %16.0f %16.0f\n",
+             (unsigned long) ulThreads, dMutex, dRw, dFine, dFree);
+   }
+
+   Bench_freeRun(&sMutexRun);
+   Bench_freeRun(&sRwRun);
+   Bench_freeRun(&sFineRun);
+   Bench_freeRun(&sFreeRun);
+}
+
+/* Measures writers that each insert and remove files in their own
+   subtree with 1, 2, 4, ... up to ulMaxThreads threads, with an
+   FT_THREADSAFE tree and with an FT_FINEGRAINED tree, and prints the
+   throughputs. */
+static void Bench_scenarioWrite(size_t ulMaxThreads,
+                                unsigned long ulMillis) {
+   struct run sRwRun, sFineRun;
+   size_t ulThreads;
+   double dRw, dFine;
+
+   Bench_newRun(&sRwRun, MODE_RWLOCK, 0);
+   Bench_newRun(&sFineRun, MODE_FINEGRAINED, 0);
+
+   printf("write: insertFile/rmFile, one subtree per thread\n");
+   printf("%8s %16s %16s %8s\n", "threads", "rwlock ops/s",
+          "latched ops/s", "speedup");
+   for(ulThreads = 1; ulThreads <= ulMaxThreads; ulThreads *= 2) {
+      dRw = Bench_run(&sRwRun, Bench_writeDisjoint, ulThreads,
+                      ulMillis);
+      dFine = Bench_run(&sFineRun, Bench_writeDisjoint, ulThreads,
+                        ulMillis);
+      printf("%8lu %16.0f %16.0f %7.2fx\n", (unsigned long) ulThreads,
+             dRw, dFine, dFine / dRw);
+   }
+
+   Bench_freeRun(&sRwRun);
+   Bench_freeRun(&sFineRun);
+}
+
+/* Measures the latency of lookups by ulMaxThreads readers, first
+   alone and then alongside one more thread inserting and removing
+   files, with an FT_THREADSAFE, an FT_FINEGRAINED and an
+   FT_LOCKFREEREADS tree, and prints the median and 99th percentile. */
+static void Bench_scenarioLatency(size_t ulMaxThreads,
+                                  unsigned long ulMillis) {
+   static const enum Mode aeModes[] = {
+      MODE_RWLOCK, MODE_FINEGRAINED, MODE_LOCKFREE
+   };
+   static const char *apcNames[] = { "rwlock", "latched", "lock-free" };
+   struct run sRun;
+   unsigned long ulIdle50, ulIdle99;
+   size_t i;
+
+   printf("latency: %lu threads of getFileContents/stat, alone and "
+          "with one insertFile/rmFile writer\n",
+          (unsigned long) ulMaxThreads);
+   printf("%10s %12s %12s %12s %12s\n", "tree", "idle p50 ns",
+          "idle p99 ns", "busy p50 ns", "busy p99 ns");
+   for(i = 0; i < sizeof(aeModes) / sizeof(aeModes[0]); i++) {
+      Bench_newRun(&sRun, aeModes[i], 0);
+      (void) Bench_run(&sRun, Bench_readUnderWrites, ulMaxThreads,
+                       ulMillis);
+      ulIdle50 = Bench_quantile(&sRun, 0.5);
+      ulIdle99 = Bench_quantile(&sRun, 0.99);
+      sRun.bWriter = TRUE;
+      (void) Bench_run(&sRun, Bench_readUnderWrites, ulMaxThreads + 1,
+                       ulMillis);
+      printf("%10s %12lu %12lu %12lu %12lu\n", apcNames[i], ulIdle50,
+             ulIdle99, Bench_quantile(&sRun, 0.5),
+             Bench_quantile(&sRun, 0.99));
+      Bench_freeRun(&sRun);
+   }
+}
+
+/* Measures clients that each insert, look up and remove files in
+   subtrees of their own with 1, 2, 4, ... up to ulMaxThreads threads,
+   with an FT_LOCKFREEREADS tree and with a ShardFT_T of ulMaxThreads
+   shards, and prints the throughputs. */
+static void Bench_scenarioShard(size_t ulMaxThreads,
+                                unsigned long ulMillis) {
+   struct run sFreeRun, sShardRun;
+   size_t ulThreads;
+   double dFree, dShard;
+
+   Bench_newRun(&sFreeRun, MODE_LOCKFREE, 0);
+   Bench_newShardedRun(&sShardRun, ulMaxThreads);
+
+   printf("shard: containsFile then insertFile/rmFile, %lu shards\n",
+          (unsigned long) ulMaxThreads);
+   printf("%8s %16s %16s %8s\n", "threads", "lock-free ops/s",
+          "sharded ops/s", "speedup");
+   for(ulThreads = 1; ulThreads <= ulMaxThreads; ulThreads *= 2) {
+      dFree = Bench_run(&sFreeRun, Bench_insertLookup, ulThreads,
+                        ulMillis);
+      dShard = Bench_run(&sShardRun, Bench_insertLookup, ulThreads,
+                         ulMillis);
+      printf("%8lu %16.0f %16.0f %7.2fx\n", (unsigned long) ulThreads,
+             dFree, dShard, dShard / dFree);
+   }
+
+   Bench_freeRun(&sFreeRun);
+   Bench_freeRun(&sShardRun);
+}
+
+/* Measures, for trees of growing size, how long FT_snapshotIn takes
+   and how long replacing one file's contents takes right after a
+   snapshot, when the path to it must be copied, and once it has been,
+   and prints the times. Runs in one thread; ulMaxThreads and ulMillis
+   are unused. */
+static void Bench_scenarioSnapshot(size_t ulMaxThreads,
+                                   unsigned long ulMillis) {
+   enum { SNAPSHOTS = 1000 };
+   FT_T oFTree;
+   FT_T aoSnapshots[SNAPSHOTS];
+   char acPath[MAX_PATH];
+   unsigned long ulFiles, ulFile;
+   double dStart, dSnapshot, dFirst, dSteady;
+   size_t i;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+
+   printf("snapshot: FT_snapshotIn, then replaceFileContents on a path "
+          "it shares\n");
+   printf("%10s %14s %14s %14s\n", "files", "snapshot ns",
+          "1st write ns", "2nd write ns");
+   for(ulFiles = 1024; ulFiles <= 1024UL * 256; ulFiles *= 16) {
+      iStatus = FT_new(&oFTree);
+      assert(iStatus == SUCCESS);
+      for(ulFile = 0; ulFile < ulFiles; ulFile++) {
+         sprintf(acPath, "bench/d%lu/f%lu", ulFile / FILES_PER_DIR,
+                 ulFile % FILES_PER_DIR);
+         iStatus = FT_insertFileIn(oFTree, acPath, apcVersions[0],
+                                   strlen(apcVersions[0]) + 1);
+         assert(iStatus == SUCCESS);
+      }
+
+      dStart = Bench_now();
+      for(i = 0; i < SNAPSHOTS; i++) {
+         iStatus = FT_snapshotIn(oFTree, &aoSnapshots[i]);
+         assert(iStatus == SUCCESS);
+      }
+      dSnapshot = (Bench_now() - dStart) / SNAPSHOTS;
+
+      dStart = Bench_now();
+      (void) FT_replaceFileContentsIn(oFTree, "bench/d0/f0",
+                                      apcVersions[1],
+                                      strlen(apcVersions[1]) + 1);
+      dFirst = Bench_now() - dStart;
+      dStart = Bench_now();
+      (void) FT_replaceFileContentsIn(oFTree, "bench/d0/f0",
+                                      apcVersions[2],
+                                      strlen(apcVersions[2]) + 1);
+      dSteady = Bench_now() - dStart;
+
+      /* the snapshots still hold what the tree held before */
+      assert(FT_getFileContentsIn(aoSnapshots[0], "bench/d0/f0") ==
+             apcVersions[0]);
+      for(i = 0; i < SNAPSHOTS; i++)
+         FT_free(aoSnapshots[i]);
+      FT_free(oFTree);
+
+      printf("%10lu %14.0f %14.0f %14.0f\n", ulFiles, dSnapshot * 1e9,
+             dFirst * 1e9, dSteady * 1e9);
+   }
+}
+
+/* Measures, for subtrees of growing size, up to a million files, how
+   long building one took per file and how long FT_moveIn takes to
+   rename it back and forth, and prints the times. Runs in one thread;
+   ulMaxThreads and ulMillis are unused. */
+static void Bench_scenarioMove(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   enum { MOVES = 1000 };
+   FT_T oFTree;
+   char acPath[MAX_PATH];
+   unsigned long ulFiles, ulFile;
+   double dStart, dBuild, dMove;
+   size_t i;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+
+   printf("move: FT_moveIn of a subtree back and forth\n");
+   printf("%10s %14s %14s\n", "files", "build ns/file", "move ns");
+   for(ulFiles = 1024; ulFiles <= 1024UL * 1024; ulFiles *= 32) {
+      iStatus = FT_new(&oFTree);
+      assert(iStatus == SUCCESS);
+      dStart = Bench_now();
+      for(ulFile = 0; ulFile < ulFiles; ulFile++) {
+         sprintf(acPath, "bench/src/d%lu/f%lu", ulFile / FILES_PER_DIR,
+                 ulFile % FILES_PER_DIR);
+         iStatus = FT_insertFileIn(oFTree, acPath, apcVersions[0],
+                                   strlen(apcVersions[0]) + 1);
+         assert(iStatus == SUCCESS);
+      }
+      dBuild = (Bench_now() - dStart) / ulFiles;
+
+      dStart = Bench_now();
+      for(i = 0; i < MOVES; i++) {
+         iStatus = FT_moveIn(oFTree, i % 2 ? "bench/dst" : "bench/src",
+                             i % 2 ? "bench/src" : "bench/dst");
+         assert(iStatus == SUCCESS);
+      }
+      dMove = (Bench_now() - dStart) / MOVES;
+
+      /* an even number of moves leaves everything where it was */
+      assert(FT_containsFileIn(oFTree, "bench/src/d0/f0"));
+      assert(!FT_containsDirIn(oFTree, "bench/dst"));
+      FT_free(oFTree);
+
+      printf("%10lu %14.0f %14.0f\n", ulFiles, dBuild * 1e9,
+             dMove * 1e9);
+   }
+}
+
+/* Measures, for skeletons of growing size, how long FT_copyIn takes to
+   clone one against how long building it entry by entry took, and how
+   long the first write to the clone takes, and prints the times. Runs
+   in one thread; ulMaxThreads and ulMillis are unused. */
+static void Bench_scenarioCopy(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   enum { COPIES = 1000 };
+   FT_T oFTree;
+   char acPath[MAX_PATH];
+   unsigned long ulFiles, ulFile;
+   double dStart, dBuild, dCopy, dFirst;
+   size_t i;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+
+   printf("copy: FT_copyIn of a skeleton, then replaceFileContents in "
+          "the clone\n");
+   printf("%10s %14s %14s %14s\n", "files", "build ns", "copy ns",
+          "1st write ns");
+   for(ulFiles = 1024; ulFiles <= 1024UL * 256; ulFiles *= 16) {
+      iStatus = FT_new(&oFTree);
+      assert(iStatus == SUCCESS);
+      dStart = Bench_now();
+      for(ulFile = 0; ulFile < ulFiles; ulFile++) {
+         sprintf(acPath, "bench/skel/d%lu/f%lu", ulFile / FILES_PER_DIR,
+                 ulFile % FILES_PER_DIR);
+         iStatus = FT_insertFileIn(oFTree, acPath, apcVersions[0],
+                                   strlen(apcVersions[0]) + 1);
+         assert(iStatus == SUCCESS);
+      }
+      dBuild = Bench_now() - dStart;
+
+      dStart = Bench_now();
+      for(i = 0; i < COPIES; i++) {
+         sprintf(acPath, "bench/t%lu", (unsigned long) i);
+         iStatus = FT_copyIn(oFTree, "bench/skel", acPath);
+         assert(iStatus == SUCCESS);
+      }
+      dCopy = (Bench_now() - dStart) / COPIES;
+
+      dStart = Bench_now();
+      (void) FT_replaceFileContentsIn(oFTree, "bench/t0/d0/f0",
+                                      apcVersions[1],
+                                      strlen(apcVersions[1]) + 1);
+      dFirst = Bench_now() - dStart;
+
+      /* the skeleton and the other clones are untouched */
+      assert(FT_getFileContentsIn(oFTree, "bench/skel/d0/f0") ==
+             apcVersions[0]);
+      assert(FT_getFileContentsIn(oFTree, "bench/t1/d0/f0") ==
+             apcVersions[0]);
+      FT_free(oFTree);
+
+      printf("%10lu %14.0f %14.0f %14.0f\n", ulFiles, dBuild * 1e9,
+             dCopy * 1e9, dFirst * 1e9);
+   }
+}
+
+/* Counts the path reported by FT_globIn or FT_findByNameIn in
+   *pvCount. */
+static void Bench_countFound(const char *pcPath, boolean bIsFile,
+                             void *pvCount) {
+   (void) pcPath;
+   (void) bIsFile;
+   (*(size_t *) pvCount)++;
+}
+
+/* Measures, for trees of growing size, how long FT_globIn takes with
+   a pattern that must walk every directory and with one whose literal
+   prefix narrows the directories visited, and how many paths each
+   matches, and prints them. Runs in one thread; ulMaxThreads and
+   ulMillis are unused. */
+static void Bench_scenarioGlob(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   enum { GLOBS = 100 };
+   static const char *apcPatterns[2] = { "**/f7", "bench/d7*/f7" };
+   FT_T oFTree;
+   double adGlob[2];
+   size_t aulFound[2];
+   char acPath[MAX_PATH];
+   unsigned long ulFiles, ulFile;
+   double dStart;
+   size_t i, j;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+
+   printf("glob: FT_globIn of %s against %s\n", apcPatterns[0],
+          apcPatterns[1]);
+   printf("%10s %12s %12s %12s %12s\n", "files", "walk found",
+          "walk us", "prefix found", "prefix us");
+   for(ulFiles = 1024; ulFiles <= 1024UL * 256; ulFiles *= 16) {
+      iStatus = FT_new(&oFTree);
+      assert(iStatus == SUCCESS);
+      for(ulFile = 0; ulFile < ulFiles; ulFile++) {
+         sprintf(acPath, "bench/d%lu/f%lu", ulFile / FILES_PER_DIR,
+                 ulFile % FILES_PER_DIR);
+         iStatus = FT_insertFileIn(oFTree, acPath, apcVersions[0],
+                                   strlen(apcVersions[0]) + 1);
+         assert(iStatus == SUCCESS);
+      }
+
+      for(i = 0; i < 2; i++) {
+         dStart = Bench_now();
+         for(j = 0; j < GLOBS; j++) {
+            aulFound[i] = 0;
+            iStatus = FT_globIn(oFTree, apcPatterns[i],
+                                Bench_countFound, &aulFound[i]);
+            assert(iStatus == SUCCESS);
+         }
+         adGlob[i] = (Bench_now() - dStart) / GLOBS;
+      }
+      /* one f7 in every directory */
+      assert(aulFound[0] == ulFiles / FILES_PER_DIR);
+      FT_free(oFTree);
+
+      printf("%10lu %12lu %12.1f %12lu %12.1f\n", ulFiles,
+             (unsigned long) aulFound[0], adGlob[0] * 1e6,
+             (unsigned long) aulFound[1], adGlob[1] * 1e6);
+   }
+}
+
+/* Lists into psEntries a page of ulPage entries of the directory
+   "bench/big" of oFTree, and frees them, in way ulWay: 0 from the
+   start and 1 after the file named pcMiddle with FT_listRangeIn, 2
+   from offset ulMiddle and 3 after pcMiddle with FT_listDirIn.
+   Returns how many entries there were. */
+static size_t Bench_listPage(FT_T oFTree, size_t ulWay,
+                             const char *pcMiddle, size_t ulMiddle,
+                             struct FT_entry *psEntries, size_t ulPage) {
+   struct FT_entry sAfter;
+   size_t ulCount;
+   int iStatus;
+
+   sAfter.pcName = (char *) pcMiddle;
+   sAfter.bIsFile = TRUE;
+   sAfter.ulSize = strlen(apcVersions[0]) + 1;
+   if(ulWay < 2)
+      iStatus = FT_listRangeIn(oFTree, "bench/big", NULL, NULL, ulPage,
+                               ulWay == 0 ? NULL : pcMiddle, psEntries,
+                               &ulCount);
+   else
+      iStatus = FT_listDirIn(oFTree, "bench/big",
+                             ulWay == 2 ? ulMiddle : 0,
+                             ulWay == 3 ? &sAfter : NULL, ulPage,
+                             psEntries, &ulCount);
+   assert(iStatus == SUCCESS);
+   FT_freeEntries(psEntries, ulCount);
+   return ulCount;
+}
+
+/* Measures, for directories of growing size, up to a million files,
+   how long a page from halfway through takes against one from the
+   start, listed by FT_listRangeIn resumed from a cursor, and by
+   FT_listDirIn both from an offset and resumed after an entry, and
+   prints the times. Runs in one thread; ulMaxThreads and ulMillis are
+   unused. */
+static void Bench_scenarioList(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   enum { PAGE = 100, PAGES = 1000, WAYS = 4 };
+   struct FT_entry asEntries[PAGE];
+   FT_T oFTree;
+   double adPage[WAYS];
+   char acPath[MAX_PATH];
+   char acMiddle[MAX_PATH];
+   unsigned long ulFiles, ulFile;
+   double dStart;
+   size_t ulCount;
+   size_t i, j;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+
+   printf("list: a page of %d entries of one directory\n", PAGE);
+   printf("%10s %12s %12s %12s %12s\n", "files", "range 1st us",
+          "range mid us", "dir mid us", "after mid us");
+   for(ulFiles = 1024; ulFiles <= 1024UL * 1024; ulFiles *= 32) {
+      iStatus = FT_new(&oFTree);
+      assert(iStatus == SUCCESS);
+      /* in order of name, so that each is added at the end */
+      for(ulFile = 0; ulFile < ulFiles; ulFile++) {
+         sprintf(acPath, "bench/big/e%07lu", ulFile);
+         iStatus = FT_insertFileIn(oFTree, acPath, apcVersions[0],
+                                   strlen(apcVersions[0]) + 1);
+         assert(iStatus == SUCCESS);
+      }
+      sprintf(acMiddle, "e%07lu", ulFiles / 2);
+
+      for(j = 0; j < WAYS; j++) {
+         dStart = Bench_now();
+         for(i = 0; i < PAGES; i++) {
+            ulCount = Bench_listPage(oFTree, j, acMiddle, ulFiles / 2,
+                                     asEntries, PAGE);
+            assert(ulCount == PAGE);
+         }
+         adPage[j] = (Bench_now() - dStart) / PAGES;
+      }
+      FT_free(oFTree);
+
+      printf("%10lu %12.1f %12.1f %12.1f %12.1f\n", ulFiles,
+             adPage[0] * 1e6, adPage[1] * 1e6, adPage[2] * 1e6,
+             adPage[3] * 1e6);
+   }
+}
+
+/* Measures, for trees of growing size, what a name index costs and
+   saves: how long building the tree takes without and with
+   FT_NAMEINDEX, how long FT_findByNameIn takes to find the one file of
+   each directory with a given name either way, and how many bytes the
+   index takes per node, and prints them. Runs in one thread;
+   ulMaxThreads and ulMillis are unused. */
+static void Bench_scenarioFind(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   FT_T aoTrees[2];
+   double adBuild[2], adFind[2];
+   char acPath[MAX_PATH];
+   unsigned long ulFiles, ulFile;
+   double dStart;
+   size_t ulFound;
+   size_t i;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+
+   printf("find: FT_findByNameIn without and with FT_NAMEINDEX\n");
+   printf("%10s %12s %12s %12s %12s %12s\n", "files", "build ns",
+          "indexed ns", "walk us", "index us", "index B/node");
+   for(ulFiles = 1024; ulFiles <= 1024UL * 256; ulFiles *= 16) {
+      for(i = 0; i < 2; i++) {
+         iStatus = FT_newWithFlags(i ? FT_NAMEINDEX : 0, &aoTrees[i]);
+         assert(iStatus == SUCCESS);
+         dStart = Bench_now();
+         for(ulFile = 0; ulFile < ulFiles; ulFile++) {
+            sprintf(acPath, "bench/d%lu/f%lu", ulFile / FILES_PER_DIR,
+                    ulFile % FILES_PER_DIR);
+            iStatus = FT_insertFileIn(aoTrees[i], acPath,
+                                      apcVersions[0],
+                                      strlen(apcVersions[0]) + 1);
+            assert(iStatus == SUCCESS);
+         }
+         adBuild[i] = (Bench_now() - dStart) / ulFiles;
+
+         ulFound = 0;
+         dStart = Bench_now();
+         iStatus = FT_findByNameIn(aoTrees[i], "f7", Bench_countFound,
+                                   &ulFound);
+         adFind[i] = Bench_now() - dStart;
+         assert(iStatus == SUCCESS);
+         assert(ulFound == ulFiles / FILES_PER_DIR);
+      }
+
+      /* the files, their directories and the root */
+      printf("%10lu %12.0f %12.0f %12.1f %12.1f %12.1f\n", ulFiles,
+             adBuild[0] * 1e9, adBuild[1] * 1e9, adFind[0] * 1e6,
+             adFind[1] * 1e6,
+             (double) FT_getNameIndexSizeIn(aoTrees[1]) /
+             (double) (ulFiles + ulFiles / FILES_PER_DIR + 1));
+      FT_free(aoTrees[0]);
+      FT_free(aoTrees[1]);
+   }
+}
+
+/* Counts the file reported by FT_topKIn in *pvCount. */
+static void Bench_countLarge(const char *pcPath, size_t ulSize,
+                             void *pvCount) {
+   (void) pcPath;
+   (void) ulSize;
+   (*(size_t *) pvCount)++;
+}
+
+/* Measures, for trees of growing size, how long FT_topKIn takes to
+   find the 100 largest files without and with FT_SIZEINDEX, below the
+   root and below one directory of FILES_PER_DIR files, and how many
+   bytes the index takes per file, and prints them. Runs in one
+   thread; ulMaxThreads and ulMillis are unused. */
+static void Bench_scenarioTopK(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   enum { K = 100 };
+   FT_T aoTrees[2];
+   double adTopK[2], adDirTopK[2];
+   char acPath[MAX_PATH];
+   unsigned long ulFiles, ulFile;
+   double dStart;
+   size_t ulFound;
+   size_t i;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+
+   printf("topk: FT_topKIn of %d files without and with "
+          "FT_SIZEINDEX\n", K);
+   printf("%10s %12s %12s %12s %12s %12s\n", "files", "walk us",
+          "index us", "dir walk us", "dir index us", "index B/file");
+   for(ulFiles = 1024; ulFiles <= 1024UL * 256; ulFiles *= 16) {
+      for(i = 0; i < 2; i++) {
+         iStatus = FT_newWithFlags(i ? FT_SIZEINDEX : 0, &aoTrees[i]);
+         assert(iStatus == SUCCESS);
+         for(ulFile = 0; ulFile < ulFiles; ulFile++) {
+            sprintf(acPath, "bench/d%lu/f%lu", ulFile / FILES_PER_DIR,
+                    ulFile % FILES_PER_DIR);
+            /* sizes in no particular order */
+            iStatus = FT_insertFileIn(aoTrees[i], acPath, NULL,
+                                      (ulFile * 2654435761UL) % 100000);
+            assert(iStatus == SUCCESS);
+         }
+
+         /* first, before the frees of a walk of the root leave the
+            allocator work to do */
+         ulFound = 0;
+         dStart = Bench_now();
+         iStatus = FT_topKIn(aoTrees[i], "bench/d7", K, Bench_countLarge,
+                             &ulFound);
+         adDirTopK[i] = Bench_now() - dStart;
+         assert(iStatus == SUCCESS);
+         assert(ulFound == FILES_PER_DIR);
+
+         ulFound = 0;
+         dStart = Bench_now();
+         iStatus = FT_topKIn(aoTrees[i], "bench", K, Bench_countLarge,
+                             &ulFound);
+         adTopK[i] = Bench_now() - dStart;
+         assert(iStatus == SUCCESS);
+         assert(ulFound == K);
+      }
+
+      printf("%10lu %12.1f %12.1f %12.1f %12.1f %12.1f\n", ulFiles,
+             adTopK[0] * 1e6, adTopK[1] * 1e6, adDirTopK[0] * 1e6,
+             adDirTopK[1] * 1e6,
+             (double) FT_getSizeIndexSizeIn(aoTrees[1]) /
+             (double) ulFiles);
+      FT_free(aoTrees[0]);
+      FT_free(aoTrees[1]);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Measures, for trees of growing size, how long FT_saveIn takes to
+   write the tree to a temporary file, how long rebuilding it by
+   insertion takes against FT_loadMapped, and how long the first and
+   a later lookup of a file on the loaded tree take, and prints them.
+   Runs in one thread; ulMaxThreads and ulMillis are unused. */
+static void Bench_scenarioImage(size_t ulMaxThreads,
+                                unsigned long ulMillis) {
+   char acImage[] = "/tmp/ft_benchXXXXXX";
+   FT_T oFTree, oFLoaded;
+   double dSave, dBuild, dLoad, dFirst, dLater;
+   char acPath[MAX_PATH];
+   unsigned long ulFiles, ulFile;
+   double dStart;
+   boolean bFound;
+   int iFd;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+
+   iFd = mkstemp(acImage);
+   assert(iFd >= 0);
+   printf("image: FT_saveIn, and FT_loadMapped against insertion\n");
+   printf("%10s %12s %12s %12s %12s %12s\n", "files", "save ms",
+          "build ms", "load us", "first us", "later us");
+   for(ulFiles = 1024; ulFiles <= 1024UL * 256; ulFiles *= 16) {
+      iStatus = FT_new(&oFTree);
+      assert(iStatus == SUCCESS);
+      dStart = Bench_now();
+      for(ulFile = 0; ulFile < ulFiles; ulFile++) {
+         sprintf(acPath, "bench/d%lu/f%lu", ulFile / FILES_PER_DIR,
+                 ulFile % FILES_PER_DIR);
+         iStatus = FT_insertFileIn(oFTree, acPath, apcVersions[0],
+                                   strlen(apcVersions[0]) + 1);
+         assert(iStatus == SUCCESS);
+      }
+      dBuild = Bench_now() - dStart;
+
+      iStatus = ftruncate(iFd, 0);
+      assert(iStatus == 0);
+      (void) lseek(iFd, 0, SEEK_SET);
+      dStart = Bench_now();
+      iStatus = FT_saveIn(oFTree, iFd);
+      dSave = Bench_now() - dStart;
+      assert(iStatus == SUCCESS);
+
+      dStart = Bench_now();
+      iStatus = FT_loadMapped(acImage, 0, &oFLoaded);
+      dLoad = Bench_now() - dStart;
+      assert(iStatus == SUCCESS);
+      sprintf(acPath, "bench/d%lu/f7", (ulFiles - 1) / FILES_PER_DIR);
+      dStart = Bench_now();
+      bFound = FT_containsFileIn(oFLoaded, acPath);
+      dFirst = Bench_now() - dStart;
+      assert(bFound);
+      dStart = Bench_now();
+      bFound = FT_containsFileIn(oFLoaded, acPath);
+      dLater = Bench_now() - dStart;
+      assert(bFound);
+
+      printf("%10lu %12.1f %12.1f %12.1f %12.1f %12.1f\n", ulFiles,
+             dSave * 1e3, dBuild * 1e3, dLoad * 1e6, dFirst * 1e6,
+             dLater * 1e6);
+      FT_free(oFLoaded);
+      FT_free(oFTree);
+   }
+   (void) close(iFd);
+   (void) unlink(acImage);
+}
+
+/* Measures writers that each insert and remove files in their own
+   subtree of an FT_FINEGRAINED tree opened by FT_openLogged, with 1,
+   2, 4, ... up to ulMaxThreads threads, whose changes share syncs of
+   the log, and prints the throughputs. Then writes a log of
+   WAL_RECORDS records directly, inserting NUM_FILES files and then
+   replacing their contents over and over, and prints how long
+   FT_openLogged takes to replay it, along with the checkpoint that
+   follows, and to open the tree again with nothing to replay. The
+   tree's files go in a temporary directory. */
+static void Bench_scenarioWal(size_t ulMaxThreads,
+                              unsigned long ulMillis) {
+   char acDir[] = "/tmp/ft_benchXXXXXX";
+   char acFile[sizeof(acDir) + 16];
+   struct run sRun;
+   struct Wal_record sRecord;
+   Wal_T oWal;
+   size_t ulThreads;
+   unsigned long ulRecord;
+   double dRate, dStart, dReplay, dClean;
+   int iStatus;
+
+   if(mkdtemp(acDir) == NULL) {
+      perror("mkdtemp");
+      return;
+   }
+   sprintf(acFile, "%s/tree", acDir);
+
+   sRun.eMode = MODE_FINEGRAINED;
+   sRun.uWritePct = 0;
+   sRun.bWriter = FALSE;
+   sRun.oSTree = NULL;
+   (void) pthread_mutex_init(&sRun.sMutex, NULL);
+   iStatus = FT_openLogged(acFile, FT_FINEGRAINED, &sRun.oFTree);
+   assert(iStatus == SUCCESS);
+
+   printf("wal: insertFile/rmFile, one subtree per thread, each change "
+          "durable\n");
+   printf("%8s %16s %16s\n", "threads", "ops/s", "ops/s/thread");
+   for(ulThreads = 1; ulThreads <= ulMaxThreads; ulThreads *= 2) {
+      dRate = Bench_run(&sRun, Bench_writeDisjoint, ulThreads, ulMillis);
+      printf("%8lu %16.0f %16.0f\n", (unsigned long) ulThreads, dRate,
+             dRate / (double) ulThreads);
+   }
+   Bench_freeRun(&sRun);
+
+   /* replaces what the writers logged, with a generation later than
+      any image's */
+   for(ulRecord = 0; ulRecord < NUM_FILES; ulRecord++)
+      sprintf(acPaths[ulRecord], "bench/d%lu/f%lu",
+              ulRecord / FILES_PER_DIR, ulRecord % FILES_PER_DIR);
+   sprintf(acFile, "%s/tree.log", acDir);
+   iStatus = Wal_create(acFile, 1000, &oWal);
+   assert(iStatus == SUCCESS);
+   for(ulRecord = 0; ulRecord < WAL_RECORDS; ulRecord++) {
+      sRecord.eOp = ulRecord < NUM_FILES ? WAL_INSERTFILE : WAL_REPLACE;
+      sRecord.pcPath = acPaths[ulRecord % NUM_FILES];
+      sRecord.pcOther = NULL;
+      sRecord.pvContents = apcVersions[ulRecord % NUM_VERSIONS];
+      sRecord.ulLength = strlen(sRecord.pvContents) + 1;
+      iStatus = Wal_append(oWal, &sRecord);
+      assert(iStatus == SUCCESS);
+   }
+   iStatus = Wal_close(oWal);
+   assert(iStatus == SUCCESS);
+
+   sprintf(acFile, "%s/tree", acDir);
+   dStart = Bench_now();
+   iStatus = FT_openLogged(acFile, FT_FINEGRAINED, &sRun.oFTree);
+   dReplay = Bench_now() - dStart;
+   assert(iStatus == SUCCESS);
+   assert(FT_containsFileIn(sRun.oFTree, acPaths[NUM_FILES - 1]));
+   FT_free(sRun.oFTree);
+   dStart = Bench_now();
+   iStatus = FT_openLogged(acFile, FT_FINEGRAINED, &sRun.oFTree);
+   dClean = Bench_now() - dStart;
+   assert(iStatus == SUCCESS);
+   FT_free(sRun.oFTree);
+   printf("reopen: %d records replayed and checkpointed in %.1f ms "
+          "(%.0f records/s), %.1f ms with none\n", WAL_RECORDS,
+          dReplay * 1e3, WAL_RECORDS / dReplay, dClean * 1e3);
+
+   sprintf(acFile, "%s/tree.img", acDir);
+   (void) unlink(acFile);
+   sprintf(acFile, "%s/tree.log", acDir);
+   (void) unlink(acFile);
+   (void) rmdir(acDir);
+}
+
+/* Creates the directory pcDir/d<i> of NUM_DIRS directories with
+   FILES_PER_DIR files each, or removes it if bCreate is FALSE. */
+static void Bench_importFiles(const char *pcDir, boolean bCreate) {
+   char acFile[sizeof("/tmp/ft_benchXXXXXX") + MAX_PATH];
+   unsigned long ulDir, ulFile;
+   const char *pcContents;
+   int iFd;
+
+   for(ulDir = 0; ulDir < NUM_DIRS; ulDir++) {
+      sprintf(acFile, "%s/d%lu", pcDir, ulDir);
+      if(bCreate && mkdir(acFile, 0777) != 0) {
+         perror(acFile);
+         return;
+      }
+      for(ulFile = 0; ulFile < FILES_PER_DIR; ulFile++) {
+         sprintf(acFile, "%s/d%lu/f%lu", pcDir, ulDir, ulFile);
+         if(!bCreate) {
+            (void) unlink(acFile);
+            continue;
+         }
+         iFd = open(acFile, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+         if(iFd < 0) {
+            perror(acFile);
+            return;
+         }
+         pcContents = apcVersions[ulFile % NUM_VERSIONS];
+         if(write(iFd, pcContents, strlen(pcContents)) < 0)
+            perror(acFile);
+         (void) close(iFd);
+      }
+      if(!bCreate) {
+         sprintf(acFile, "%s/d%lu", pcDir, ulDir);
+         (void) rmdir(acFile);
+      }
+   }
+}
+
+/* Measures FT_importDirIn of a directory of NUM_FILES files, recording
+   sizes only and reading contents, with more and more threads. */
+static void Bench_scenarioImport(size_t ulMaxThreads,
+                                 unsigned long ulMillis) {
+   char acDir[] = "/tmp/ft_benchXXXXXX";
+   FT_T oFTree;
+   size_t ulThreads;
+   unsigned long ulFile;
+   unsigned int uFlags;
+   double dStart, dTime;
+   int iStatus;
+
+   (void) ulMillis;
+   if(mkdtemp(acDir) == NULL) {
+      perror("mkdtemp");
+      return;
+   }
+   Bench_importFiles(acDir, TRUE);
+   for(ulFile = 0; ulFile < NUM_FILES; ulFile++)
+      sprintf(acPaths[ulFile], "bench/d%lu/f%lu",
+              ulFile / FILES_PER_DIR, ulFile % FILES_PER_DIR);
+
+   printf("import: %d directories of %d files\n", NUM_DIRS,
+          FILES_PER_DIR);
+   printf("%8s %16s %16s\n", "threads", "sizes ms", "contents ms");
+   for(ulThreads = 1; ulThreads <= ulMaxThreads; ulThreads *= 2) {
+      printf("%8lu", (unsigned long) ulThreads);
+      for(uFlags = 0; uFlags <= FT_IMPORTCONTENTS; uFlags++) {
+         iStatus = FT_newWithFlags(FT_THREADSAFE, &oFTree);
+         assert(iStatus == SUCCESS);
+         dStart = Bench_now();
+         iStatus = FT_importDirIn(oFTree, acDir, "bench", ulThreads,
+                                  uFlags);
+         dTime = Bench_now() - dStart;
+         assert(iStatus == SUCCESS);
+         if(uFlags & FT_IMPORTCONTENTS)
+            for(ulFile = 0; ulFile < NUM_FILES; ulFile++)
+               free(FT_getFileContentsIn(oFTree, acPaths[ulFile]));
+         FT_free(oFTree);
+         printf(" %16.2f", dTime * 1e3);
+      }
+      printf("\n");
+   }
+
+   Bench_importFiles(acDir, FALSE);
+   (void) rmdir(acDir);
+}
+
+/* Writes ulTotal bytes of pcBuffer, ulLength bytes long, over and
+   over to iFd, and returns how many seconds that took, or -1 if a
+   write failed. */
+static double Bench_writeRaw(int iFd, const char *pcBuffer,
+                             size_t ulLength, size_t ulTotal) {
+   double dStart = Bench_now();
+   ssize_t lWritten;
+
+   while(ulTotal > 0) {
+      lWritten = write(iFd, pcBuffer,
+                       ulTotal < ulLength ? ulTotal : ulLength);
+      if(lWritten <= 0)
+         return -1;
+      ulTotal -= (size_t) lWritten;
+   }
+   return Bench_now() - dStart;
+}
+
+/* Measures FT_exportTarIn of a tree of NUM_FILES files of TAR_FILE
+   bytes each, to /dev/null and to a file, against writing as many
+   bytes to the same place with plain writes. */
+static void Bench_scenarioTar(size_t ulMaxThreads,
+                              unsigned long ulMillis) {
+   char acFile[] = "/tmp/ft_benchXXXXXX";
+   const char *apcTargets[2];
+   char *pcContents;
+   FT_T oFTree;
+   unsigned long ulFile;
+   size_t ulTotal = (size_t) NUM_FILES * TAR_FILE;
+   double dTime;
+   int iFd;
+   int iStatus;
+   size_t i;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+   pcContents = malloc(TAR_FILE);
+   assert(pcContents != NULL);
+   memset(pcContents, 'x', TAR_FILE);
+   iStatus = FT_new(&oFTree);
+   assert(iStatus == SUCCESS);
+   for(ulFile = 0; ulFile < NUM_FILES; ulFile++) {
+      sprintf(acPaths[ulFile], "bench/d%lu/f%lu",
+              ulFile / FILES_PER_DIR, ulFile % FILES_PER_DIR);
+      iStatus = FT_insertFileIn(oFTree, acPaths[ulFile], pcContents,
+                                TAR_FILE);
+      assert(iStatus == SUCCESS);
+   }
+   iFd = mkstemp(acFile);
+   assert(iFd >= 0);
+   (void) close(iFd);
+   apcTargets[0] = "/dev/null";
+   apcTargets[1] = acFile;
+
+   printf("tar: %d files of %d KB\n", NUM_FILES, TAR_FILE / 1024);
+   printf("%-12s %16s %16s\n", "to", "tar MB/s", "write MB/s");
+   for(i = 0; i < 2; i++) {
+      printf("%-12s", i == 0 ? "/dev/null" : "file");
+      iFd = open(apcTargets[i], O_WRONLY | O_TRUNC);
+      assert(iFd >= 0);
+      dTime = Bench_now();
+      iStatus = FT_exportTarIn(oFTree, "bench", iFd);
+      dTime = Bench_now() - dTime;
+      assert(iStatus == SUCCESS);
+      (void) close(iFd);
+      printf(" %16.0f", ulTotal / dTime / 1e6);
+      iFd = open(apcTargets[i], O_WRONLY | O_TRUNC);
+      assert(iFd >= 0);
+      dTime = Bench_writeRaw(iFd, pcContents, TAR_FILE, ulTotal);
+      (void) close(iFd);
+      printf(" %16.0f\n", ulTotal / dTime / 1e6);
+   }
+
+   (void) unlink(acFile);
+   FT_free(oFTree);
+   free(pcContents);
+}
+
+/*
+  Imports the archive in pcFile into a new tree with uFlags for
+  FT_importTarIn, the contents of NUM_FILES files, and returns how
+  many seconds that took, counting the freeing of the contents.
+*/
+static double Bench_untarOnce(const char *pcFile, unsigned int uFlags) {
+   FT_T oFTree;
+   double dTime;
+   int iFd;
+   int iStatus;
+   size_t i;
+
+   iStatus = FT_new(&oFTree);
+   assert(iStatus == SUCCESS);
+   iFd = open(pcFile, O_RDONLY);
+   assert(iFd >= 0);
+   dTime = Bench_now();
+   iStatus = FT_importTarIn(oFTree, iFd, uFlags);
+   assert(iStatus == SUCCESS);
+   if(!(uFlags & FT_TARARENA))
+      for(i = 0; i < NUM_FILES; i++)
+         free(FT_getFileContentsIn(oFTree, acPaths[i]));
+   FT_free(oFTree);
+   dTime = Bench_now() - dTime;
+   (void) close(iFd);
+   return dTime;
+}
+
+/* Measures FT_importTarIn of an archive of NUM_FILES files of
+   UNTAR_FILE bytes each, with contents allocated per file and in the
+   tree's arena, against inserting the same files one at a time. */
+static void Bench_scenarioUntar(size_t ulMaxThreads,
+                                unsigned long ulMillis) {
+   char acFile[] = "/tmp/ft_benchXXXXXX";
+   char *pcContents;
+   char *pcCopy;
+   FT_T oFTree;
+   unsigned long ulFile;
+   double dTime;
+   int iFd;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+   pcContents = malloc(UNTAR_FILE);
+   assert(pcContents != NULL);
+   memset(pcContents, 'x', UNTAR_FILE);
+   iStatus = FT_new(&oFTree);
+   assert(iStatus == SUCCESS);
+   for(ulFile = 0; ulFile < NUM_FILES; ulFile++) {
+      sprintf(acPaths[ulFile], "bench/d%lu/f%lu",
+              ulFile / FILES_PER_DIR, ulFile % FILES_PER_DIR);
+      iStatus = FT_insertFileIn(oFTree, acPaths[ulFile], pcContents,
+                                UNTAR_FILE);
+      assert(iStatus == SUCCESS);
+   }
+   iFd = mkstemp(acFile);
+   assert(iFd >= 0);
+   iStatus = FT_exportTarIn(oFTree, "bench", iFd);
+   assert(iStatus == SUCCESS);
+   (void) close(iFd);
+   FT_free(oFTree);
+
+   printf("untar: %d files of %d bytes\n", NUM_FILES, UNTAR_FILE);
+   printf("%-12s %16s\n", "how", "files/s");
+   /* inserting copies one by one, as a client would without a tar */
+   dTime = Bench_now();
+   iStatus = FT_new(&oFTree);
+   assert(iStatus == SUCCESS);
+   for(ulFile = 0; ulFile < NUM_FILES; ulFile++) {
+      pcCopy = malloc(UNTAR_FILE);
+      assert(pcCopy != NULL);
+      memcpy(pcCopy, pcContents, UNTAR_FILE);
+      iStatus = FT_insertFileIn(oFTree, acPaths[ulFile], pcCopy,
+                                UNTAR_FILE);
+      assert(iStatus == SUCCESS);
+   }
+   for(ulFile = 0; ulFile < NUM_FILES; ulFile++)
+      free(FT_getFileContentsIn(oFTree, acPaths[ulFile]));
+   FT_free(oFTree);
+   dTime = Bench_now() - dTime;
+   printf("%-12s %16.0f\n", "insert", NUM_FILES / dTime);
+   printf("%-12s %16.0f\n", "untar",
+          NUM_FILES / Bench_untarOnce(acFile, 0));
+   printf("%-12s %16.0f\n", "untar arena",
+          NUM_FILES / Bench_untarOnce(acFile, FT_TARARENA));
+
+   (void) unlink(acFile);
+   free(pcContents);
+}
+
+/*
+  Measures edits of EDIT_SIZE bytes to a file of EDIT_FILE bytes made
+  with FT_writeAtIn against the same edits made by copying the whole
+  file and replacing its contents, and appends of EDIT_SIZE bytes with
+  FT_appendIn that grow an empty file to EDIT_FILE bytes.
+*/
+static void Bench_scenarioEdit(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   char acEdit[EDIT_SIZE];
+   char *pcContents;
+   char *pcCopy;
+   FT_T oFTree;
+   double dTime;
+   unsigned long ulEdit;
+   size_t ulOffset;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+   memset(acEdit, 'e', EDIT_SIZE);
+   pcContents = malloc(EDIT_FILE);
+   assert(pcContents != NULL);
+   memset(pcContents, 'x', EDIT_FILE);
+   iStatus = FT_new(&oFTree);
+   assert(iStatus == SUCCESS);
+   iStatus = FT_insertFileIn(oFTree, "bench/f", pcContents, EDIT_FILE);
+   assert(iStatus == SUCCESS);
+
+   printf("edit: %d edits of %d bytes to a file of %d MB\n", EDITS,
+          EDIT_SIZE, EDIT_FILE / (1024 * 1024));
+   printf("%-12s %16s\n", "how", "edits/s");
+   dTime = Bench_now();
+   for(ulEdit = 0; ulEdit < EDITS; ulEdit++) {
+      ulOffset = ulEdit * 7919 % (EDIT_FILE - EDIT_SIZE);
+      pcCopy = malloc(EDIT_FILE);
+      assert(pcCopy != NULL);
+      memcpy(pcCopy, FT_getFileContentsIn(oFTree, "bench/f"), EDIT_FILE);
+      memcpy(pcCopy + ulOffset, acEdit, EDIT_SIZE);
+      free(FT_replaceFileContentsIn(oFTree, "bench/f", pcCopy,
+                                    EDIT_FILE));
+   }
+   dTime = Bench_now() - dTime;
+   printf("%-12s %16.0f\n", "replace", EDITS / dTime);
+
+   /* the first write moves the contents into the tree's buffer */
+   pcCopy = FT_getFileContentsIn(oFTree, "bench/f");
+   iStatus = FT_writeAtIn(oFTree, "bench/f", 0, acEdit, EDIT_SIZE);
+   assert(iStatus == SUCCESS);
+   free(pcCopy);
+   dTime = Bench_now();
+   for(ulEdit = 0; ulEdit < EDITS; ulEdit++) {
+      ulOffset = ulEdit * 7919 % (EDIT_FILE - EDIT_SIZE);
+      iStatus = FT_writeAtIn(oFTree, "bench/f", ulOffset, acEdit,
+                             EDIT_SIZE);
+      assert(iStatus == SUCCESS);
+   }
+   dTime = Bench_now() - dTime;
+   printf("%-12s %16.0f\n", "writeAt", EDITS / dTime);
+
+   /* a log grown from nothing to the size of the file */
+   iStatus = FT_insertFileIn(oFTree, "bench/log", NULL, 0);
+   assert(iStatus == SUCCESS);
+   dTime = Bench_now();
+   for(ulEdit = 0; ulEdit < EDIT_FILE / EDIT_SIZE; ulEdit++) {
+      iStatus = FT_appendIn(oFTree, "bench/log", acEdit, EDIT_SIZE);
+      assert(iStatus == SUCCESS);
+   }
+   dTime = Bench_now() - dTime;
+   printf("%-12s %16.0f\n", "append", EDIT_FILE / EDIT_SIZE / dTime);
+
+   /* the first replace handed pcContents back, and freed it */
+   FT_free(oFTree);
+}
+
+/*
+  Inserts the DEDUP_COPIES files apcCopies, of lengths aulLengths,
+  into a new tree made with uFlags, reads them back with FT_readAtIn,
+  and prints how fast each went, how much memory the contents take
+  and how many times over they share it, under the name pcHow.
+  Returns the time the inserts took, in seconds.
+*/
+static double Bench_dedupOnce(const char *pcHow, unsigned int uFlags,
+                              char *apcCopies[], size_t aulLengths[]) {
+   static char acBuffer[TAR_FILE];
+   char acPath[MAX_PATH];
+   FT_T oFTree;
+   double dInsert, dRead;
+   size_t ulCopy, ulOffset, ulRead, ulTotal = 0;
+   size_t ulSize, ulStored;
+   boolean bIsFile;
+   int iStatus;
+
+   iStatus = FT_newWithFlags(uFlags, &oFTree);
+   assert(iStatus == SUCCESS);
+   dInsert = Bench_now();
+   for(ulCopy = 0; ulCopy < DEDUP_COPIES; ulCopy++) {
+      sprintf(acPath, "bench/%lu", (unsigned long) ulCopy);
+      iStatus = FT_insertFileIn(oFTree, acPath, apcCopies[ulCopy],
+                                aulLengths[ulCopy]);
+      assert(iStatus == SUCCESS);
+      ulTotal += aulLengths[ulCopy];
+   }
+   dInsert = Bench_now() - dInsert;
+
+   dRead = Bench_now();
+   for(ulCopy = 0; ulCopy < DEDUP_COPIES; ulCopy++) {
+      sprintf(acPath, "bench/%lu", (unsigned long) ulCopy);
+      for(ulOffset = 0; ulOffset < aulLengths[ulCopy];
+          ulOffset += ulRead) {
+         iStatus = FT_readAtIn(oFTree, acPath, ulOffset, acBuffer,
+                               TAR_FILE, &ulRead);
+         assert(iStatus == SUCCESS && ulRead > 0);
+      }
+   }
+   dRead = Bench_now() - dRead;
+
+   iStatus = FT_statStoredIn(oFTree, "bench", &bIsFile, &ulSize,
+                             &ulStored);
+   assert(iStatus == SUCCESS && ulSize == ulTotal);
+   /* a plain tree holds the client's contents, all of them */
+   printf("%-12s %12.0f %12.0f %12.1f %8.1f\n", pcHow,
+          ulTotal / dInsert / (1024 * 1024),
+          ulTotal / dRead / (1024 * 1024),
+          (uFlags != 0 ? FT_getChunkStoreSizeIn(oFTree) : ulTotal) /
+          (1024.0 * 1024), (double) ulSize / ulStored);
+   FT_free(oFTree);
+   return dInsert;
+}
+
+/*
+  Prints the rows of the dedup scenario for the DEDUP_COPIES files
+  apcCopies, of lengths aulLengths, described by pcWhat, and returns
+  the time inserting them whole with FT_DEDUP took, in seconds.
+*/
+static double Bench_dedupSet(const char *pcWhat, char *apcCopies[],
+                             size_t aulLengths[]) {
+   double dWhole;
+
+   printf("%s\n", pcWhat);
+   printf("%-12s %12s %12s %12s %8s\n", "store", "insert MB/s",
+          "read MB/s", "memory MB", "ratio");
+   (void) Bench_dedupOnce("plain", 0, apcCopies, aulLengths);
+   dWhole = Bench_dedupOnce("whole", FT_DEDUP, apcCopies, aulLengths);
+   (void) Bench_dedupOnce("chunked", FT_CHUNKED, apcCopies, aulLengths);
+   return dWhole;
+}
+
+/*
+  Measures DEDUP_COPIES copies of a file of DEDUP_FILE bytes, the same
+  and then each with DEDUP_EDITS runs of bytes inserted at random,
+  stored as they are, kept whole with FT_DEDUP and in chunks: how fast
+  they are inserted and read back, and the memory they take. Also
+  measures how much of the time taken to insert the edited copies
+  whole, none of which match, goes to hashing them.
+*/
+static void Bench_scenarioDedup(size_t ulMaxThreads,
+                                unsigned long ulMillis) {
+   char *apcCopies[DEDUP_COPIES];
+   size_t aulLengths[DEDUP_COPIES];
+   size_t aulAt[DEDUP_EDITS];
+   char *pcBase;
+   size_t ulCopy, ulEdit, ulFrom, ulTo, i;
+   unsigned long ulState = 1;
+   unsigned long ulHash = 0;
+   double dWhole, dHash;
+   char acWhat[64];
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+   pcBase = malloc(DEDUP_FILE);
+   assert(pcBase != NULL);
+   for(i = 0; i < DEDUP_FILE; i++)
+      pcBase[i] = (char) (Bench_random(&ulState) >> 24);
+
+   printf("dedup: %d files of %d KB\n", DEDUP_COPIES, DEDUP_FILE / 1024);
+   for(ulCopy = 0; ulCopy < DEDUP_COPIES; ulCopy++) {
+      apcCopies[ulCopy] = pcBase;
+      aulLengths[ulCopy] = DEDUP_FILE;
+   }
+   (void) Bench_dedupSet("the same", apcCopies, aulLengths);
+
+   for(ulCopy = 0; ulCopy < DEDUP_COPIES; ulCopy++) {
+      aulLengths[ulCopy] = DEDUP_FILE + DEDUP_EDITS * DEDUP_RUN;
+      apcCopies[ulCopy] = malloc(aulLengths[ulCopy]);
+      assert(apcCopies[ulCopy] != NULL);
+      /* edits at increasing offsets, so the base is copied in order */
+      for(ulEdit = 0; ulEdit < DEDUP_EDITS; ulEdit++)
+         aulAt[ulEdit] = (DEDUP_FILE / DEDUP_EDITS) * ulEdit +
+                         (size_t) Bench_random(&ulState) %
+                         (DEDUP_FILE / DEDUP_EDITS);
+      ulFrom = 0;
+      ulTo = 0;
+      for(ulEdit = 0; ulEdit < DEDUP_EDITS; ulEdit++) {
+         memcpy(apcCopies[ulCopy] + ulTo, pcBase + ulFrom,
+                aulAt[ulEdit] - ulFrom);
+         ulTo += aulAt[ulEdit] - ulFrom;
+         ulFrom = aulAt[ulEdit];
+         for(i = 0; i < DEDUP_RUN; i++)
+            apcCopies[ulCopy][ulTo++] = (char) Bench_random(&ulState);
+      }
+      memcpy(apcCopies[ulCopy] + ulTo, pcBase + ulFrom,
+             DEDUP_FILE - ulFrom);
+   }
+
+   printf("\n");
+   sprintf(acWhat, "copies each with %d edits", DEDUP_EDITS);
+   dWhole = Bench_dedupSet(acWhat, apcCopies, aulLengths);
+
+   dHash = Bench_now();
+   for(ulCopy = 0; ulCopy < DEDUP_COPIES; ulCopy++)
+      ulHash ^= ChunkStore_hash(apcCopies[ulCopy], aulLengths[ulCopy]);
+   dHash = Bench_now() - dHash;
+   printf("\nhashing: %.0f MB/s, %.0f%% of the time to insert the "
+          "edited copies whole (%lx)\n",
+          DEDUP_COPIES * (double) aulLengths[0] / dHash / (1024 * 1024),
+          100 * dHash / dWhole, ulHash);
+
+   for(ulCopy = 0; ulCopy < DEDUP_COPIES; ulCopy++)
+      free(apcCopies[ulCopy]);
+   free(pcBase);
+}
+
+/*
+  Exports the ulFiles files of ulLength bytes of oFTree with
+  FT_exportTarIn to a temporary file, imports the archive into a
+  tree of its own, and checks each file against what FT_readAtIn
+  reads of it, so that contents the export reads through hot buffers
+  are checked to come out whole. Prints how fast the export went and
+  the memory the contents then take, under the name pcHow.
+*/
+static void Bench_exportCheck(const char *pcHow, FT_T oFTree,
+                              size_t ulFiles, size_t ulLength) {
+   static char acBuffer[TAR_FILE];
+   char acFile[] = "/tmp/ft_benchXXXXXX";
+   char acPath[MAX_PATH];
+   FT_T oFCopy;
+   const char *pcCopy;
+   double dExport;
+   size_t ulFile, ulOffset, ulRead;
+   int iFd;
+   int iStatus;
+
+   iFd = mkstemp(acFile);
+   assert(iFd >= 0);
+   (void) unlink(acFile);
+   dExport = Bench_now();
+   iStatus = FT_exportTarIn(oFTree, "bench", iFd);
+   dExport = Bench_now() - dExport;
+   assert(iStatus == SUCCESS);
+
+   (void) lseek(iFd, 0, SEEK_SET);
+   iStatus = FT_new(&oFCopy);
+   assert(iStatus == SUCCESS);
+   iStatus = FT_importTarIn(oFCopy, iFd, FT_TARARENA);
+   assert(iStatus == SUCCESS);
+   (void) close(iFd);
+   for(ulFile = 0; ulFile < ulFiles; ulFile++) {
+      sprintf(acPath, "bench/%lu", (unsigned long) ulFile);
+      pcCopy = FT_getFileContentsIn(oFCopy, acPath);
+      assert(pcCopy != NULL);
+      for(ulOffset = 0; ulOffset < ulLength; ulOffset += ulRead) {
+         iStatus = FT_readAtIn(oFTree, acPath, ulOffset, acBuffer,
+                               TAR_FILE, &ulRead);
+         assert(iStatus == SUCCESS && ulRead > 0);
+         iStatus = memcmp(acBuffer, pcCopy + ulOffset, ulRead);
+         assert(iStatus == 0);
+      }
+   }
+   FT_free(oFCopy);
+
+   printf("%-12s %12.0f %12.1f\n", pcHow,
+          (double) ulFiles * ulLength / dExport / (1024 * 1024),
+          FT_getChunkStoreSizeIn(oFTree) / (1024.0 * 1024));
+}
+
+/*
+  Reads each of the COLD_FILES files of oFTree through once with
+  FT_readAtIn, ulRounds times, only the first if bOne, and prints how
+  fast that went and the memory the contents then take, under the
+  name pcHow.
+*/
+static void Bench_coldRead(const char *pcHow, FT_T oFTree,
+                           size_t ulRounds, boolean bOne) {
+   static char acBuffer[TAR_FILE];
+   char acPath[MAX_PATH];
+   double dRead;
+   size_t ulRound, ulFile, ulOffset, ulRead, ulTotal = 0;
+   int iStatus;
+
+   dRead = Bench_now();
+   for(ulRound = 0; ulRound < ulRounds; ulRound++)
+      for(ulFile = 0; ulFile < (bOne ? 1 : COLD_FILES); ulFile++) {
+         sprintf(acPath, "bench/%lu", (unsigned long) ulFile);
+         for(ulOffset = 0; ulOffset < COLD_FILE; ulOffset += ulRead) {
+            iStatus = FT_readAtIn(oFTree, acPath, ulOffset, acBuffer,
+                                  TAR_FILE, &ulRead);
+            assert(iStatus == SUCCESS && ulRead > 0);
+         }
+         ulTotal += COLD_FILE;
+      }
+   dRead = Bench_now() - dRead;
+   printf("%-12s %12.0f %12.1f\n", pcHow,
+          ulTotal / dRead / (1024 * 1024),
+          FT_getChunkStoreSizeIn(oFTree) / (1024.0 * 1024));
+}
+
+/*
+  Measures COLD_FILES files of COLD_FILE bytes of text in a tree made
+  with FT_COLD, idle after ulMillis / 4 milliseconds and with
+  COLD_BUFFERS hot buffers: the memory they take and how fast they are
+  read while hot, once they have gone cold, and when the same cold
+  file is read again and again, and how fast they are exported with
+  FT_exportTarIn once cold.
+*/
+static void Bench_scenarioCold(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   static const char *apcWords[] = {
+      "the ", "of ", "file ", "tree ", "node ", "path ", "to ", "a ",
+      "is ", "directory ", "contents ", "and ", "in ", "returns ",
+      "SUCCESS", "NULL", ", ", ".\n", "(", ")", "{\n   ", "}\n"
+   };
+   enum { WORDS = sizeof(apcWords) / sizeof(apcWords[0]) };
+   const char *pcWord;
+   char *pcText;
+   char acPath[MAX_PATH];
+   FT_T oFTree;
+   struct timespec sSleep;
+   size_t ulFile, ulAt, ulWord, ulLast, ulNow;
+   unsigned long ulState = 1;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   iStatus = FT_newWithFlags(FT_COLD, &oFTree);
+   assert(iStatus == SUCCESS);
+   FT_setColdIn(oFTree, ulMillis / 4 + 1, COLD_BUFFERS);
+   pcText = malloc(COLD_FILE);
+   assert(pcText != NULL);
+
+   printf("cold: %d files of %d KB of text\n", COLD_FILES,
+          COLD_FILE / 1024);
+   printf("%-12s %12s %12s\n", "contents", "read MB/s", "memory MB");
+   for(ulFile = 0; ulFile < COLD_FILES; ulFile++) {
+      for(ulAt = 0; ulAt < COLD_FILE; ulAt += ulWord) {
+         pcWord = apcWords[Bench_random(&ulState) % WORDS];
+         ulWord = strlen(pcWord);
+         ulWord = ulWord < COLD_FILE - ulAt ? ulWord : COLD_FILE - ulAt;
+         memcpy(pcText + ulAt, pcWord, ulWord);
+      }
+      sprintf(acPath, "bench/%lu", (unsigned long) ulFile);
+      iStatus = FT_insertFileIn(oFTree, acPath, pcText, COLD_FILE);
+      assert(iStatus == SUCCESS);
+   }
+   free(pcText);
+   Bench_coldRead("hot", oFTree, 1, FALSE);
+
+   /* wait until the sweeps stop freeing memory */
+   sSleep.tv_sec = (time_t) (ulMillis / 1000);
+   sSleep.tv_nsec = (long) (ulMillis % 1000) * 1000000L;
+   ulNow = FT_getChunkStoreSizeIn(oFTree);
+   do {
+      ulLast = ulNow;
+      (void) nanosleep(&sSleep, NULL);
+      ulNow = FT_getChunkStoreSizeIn(oFTree);
+   } while(ulNow < ulLast);
+
+   Bench_coldRead("cold", oFTree, 1, FALSE);
+   Bench_coldRead("cold, again", oFTree, 16, TRUE);
+   Bench_exportCheck("cold, tar", oFTree, COLD_FILES, COLD_FILE);
+   FT_free(oFTree);
+}
+
+/*
+  Reads the SPILL_FILES files of oFTree through with FT_readAtIn, every
+  ulStep-th starting from the first, ulStep times, so that every file
+  is read once, and prints how fast that went and the memory the
+  contents then take, under the name pcHow.
+*/
+static void Bench_spillRead(const char *pcHow, FT_T oFTree,
+                            size_t ulStep) {
+   static char acBuffer[TAR_FILE];
+   char acPath[MAX_PATH];
+   double dRead;
+   size_t ulStart, ulFile, ulOffset, ulRead;
+   int iStatus;
+
+   dRead = Bench_now();
+   for(ulStart = 0; ulStart < ulStep; ulStart++)
+      for(ulFile = ulStart; ulFile < SPILL_FILES; ulFile += ulStep) {
+         sprintf(acPath, "bench/%lu", (unsigned long) ulFile);
+         for(ulOffset = 0; ulOffset < SPILL_FILE; ulOffset += ulRead) {
+            iStatus = FT_readAtIn(oFTree, acPath, ulOffset, acBuffer,
+                                  TAR_FILE, &ulRead);
+            assert(iStatus == SUCCESS && ulRead > 0);
+         }
+      }
+   dRead = Bench_now() - dRead;
+   printf("%-12s %12.0f %12.1f\n", pcHow,
+          (double) SPILL_FILES * SPILL_FILE / dRead / (1024 * 1024),
+          FT_getChunkStoreSizeIn(oFTree) / (1024.0 * 1024));
+}
+
+/*
+  Measures SPILL_FILES files of SPILL_FILE random bytes, ten times
+  SPILL_BUDGET, in a tree made with FT_SPILL and that budget: how fast
+  they are inserted, with inserts waiting on the spills they cause,
+  and read back in order and in a scattered order, and exported with
+  FT_exportTarIn, and the memory the contents take meanwhile.
+*/
+static void Bench_scenarioSpill(size_t ulMaxThreads,
+                                unsigned long ulMillis) {
+   char *pcBytes;
+   char acPath[MAX_PATH];
+   FT_T oFTree;
+   double dInsert;
+   size_t ulFile, i;
+   unsigned long ulState = 1;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+   iStatus = FT_newWithFlags(FT_SPILL, &oFTree);
+   assert(iStatus == SUCCESS);
+   iStatus = FT_setSpillIn(oFTree, SPILL_BUDGET, NULL);
+   assert(iStatus == SUCCESS);
+   pcBytes = malloc(SPILL_FILE);
+   assert(pcBytes != NULL);
+
+   printf("spill: %d files of %d KB, a budget of %d MB\n", SPILL_FILES,
+          SPILL_FILE / 1024, SPILL_BUDGET / (1024 * 1024));
+   printf("%-12s %12s %12s\n", "contents", "MB/s", "memory MB");
+   dInsert = Bench_now();
+   for(ulFile = 0; ulFile < SPILL_FILES; ulFile++) {
+      for(i = 0; i < SPILL_FILE; i++)
+         pcBytes[i] = (char) (Bench_random(&ulState) >> 24);
+      sprintf(acPath, "bench/%lu", (unsigned long) ulFile);
+      iStatus = FT_insertFileIn(oFTree, acPath, pcBytes, SPILL_FILE);
+      assert(iStatus == SUCCESS);
+   }
+   dInsert = Bench_now() - dInsert;
+   free(pcBytes);
+   printf("%-12s %12.0f %12.1f\n", "insert",
+          (double) SPILL_FILES * SPILL_FILE / dInsert / (1024 * 1024),
+          FT_getChunkStoreSizeIn(oFTree) / (1024.0 * 1024));
+
+   Bench_spillRead("in order", oFTree, 1);
+   Bench_spillRead("scattered", oFTree, 37);
+   Bench_exportCheck("tar", oFTree, SPILL_FILES, SPILL_FILE);
+   FT_free(oFTree);
+}
+
+/*
+  Measures MAPPED_FILES files of MAPPED_FILE bytes, each a part of one
+  file on disk: how fast they are inserted, read with pread into
+  memory of their own for FT_insertFileIn or mapped by
+  FT_insertFileMappedIn, and then read through with FT_readAtIn.
+*/
+static void Bench_scenarioMapped(size_t ulMaxThreads,
+                                 unsigned long ulMillis) {
+   char acFile[] = "/tmp/ft_benchXXXXXX";
+   char acPath[MAX_PATH];
+   char *apcContents[MAPPED_FILES];
+   char *pcBuffer;
+   FT_T oFTree;
+   size_t ulTotal = (size_t) MAPPED_FILES * MAPPED_FILE;
+   size_t ulFile, ulRead, i;
+   double dInsert, dRead;
+   ssize_t lRead;
+   boolean bMapped;
+   int iFd;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+   pcBuffer = malloc(MAPPED_FILE);
+   assert(pcBuffer != NULL);
+   memset(pcBuffer, 'x', MAPPED_FILE);
+   iFd = mkstemp(acFile);
+   assert(iFd >= 0);
+   (void) unlink(acFile);
+   dInsert = Bench_writeRaw(iFd, pcBuffer, MAPPED_FILE, ulTotal);
+   assert(dInsert >= 0);
+
+   printf("mapped: %d files of %d MB\n", MAPPED_FILES,
+          MAPPED_FILE / (1024 * 1024));
+   printf("%-12s %12s %12s\n", "contents", "insert MB/s", "read MB/s");
+   for(i = 0; i < 2; i++) {
+      bMapped = i == 1;
+      iStatus = FT_new(&oFTree);
+      assert(iStatus == SUCCESS);
+      dInsert = Bench_now();
+      for(ulFile = 0; ulFile < MAPPED_FILES; ulFile++) {
+         sprintf(acPath, "bench/%lu", (unsigned long) ulFile);
+         if(bMapped)
+            iStatus = FT_insertFileMappedIn(oFTree, acPath, iFd,
+                                            ulFile * MAPPED_FILE,
+                                            MAPPED_FILE);
+         else {
+            apcContents[ulFile] = malloc(MAPPED_FILE);
+            assert(apcContents[ulFile] != NULL);
+            lRead = pread(iFd, apcContents[ulFile], MAPPED_FILE,
+                          (off_t) (ulFile * MAPPED_FILE));
+            assert(lRead == MAPPED_FILE);
+            iStatus = FT_insertFileIn(oFTree, acPath,
+                                      apcContents[ulFile], MAPPED_FILE);
+         }
+         assert(iStatus == SUCCESS);
+      }
+      dInsert = Bench_now() - dInsert;
+      dRead = Bench_now();
+      for(ulFile = 0; ulFile < MAPPED_FILES; ulFile++) {
+         sprintf(acPath, "bench/%lu", (unsigned long) ulFile);
+         iStatus = FT_readAtIn(oFTree, acPath, 0, pcBuffer, MAPPED_FILE,
+                               &ulRead);
+         assert(iStatus == SUCCESS && ulRead == MAPPED_FILE);
+      }
+      dRead = Bench_now() - dRead;
+      printf("%-12s %12.0f %12.0f\n", bMapped ? "mapped" : "read",
+             ulTotal / dInsert / (1024 * 1024),
+             ulTotal / dRead / (1024 * 1024));
+      FT_free(oFTree);
+      if(!bMapped)
+         for(ulFile = 0; ulFile < MAPPED_FILES; ulFile++)
+            free(apcContents[ulFile]);
+   }
+
+   (void) close(iFd);
+   free(pcBuffer);
+}
+
+/* Reads the pipe *pvPipe through to its end, splicing it to
+   /dev/null, so that only the sending side of a pipe is measured. */
+static void *Bench_drain(void *pvPipe) {
+   int iPipe = *(int *) pvPipe;
+   int iNull = open("/dev/null", O_WRONLY);
+   ssize_t lMoved;
+
+   assert(iNull >= 0);
+   do
+      lMoved = splice(iPipe, NULL, iNull, NULL, MAPPED_FILE,
+                      SPLICE_F_MOVE);
+   while(lMoved > 0);
+   (void) close(iNull);
+   return NULL;
+}
+
+/*
+  Sends the MAPPED_FILES files of oFTree SEND_ROUNDS times each into a
+  pipe that another thread drains, with FT_sendFileIn if bSend is
+  TRUE, or else with FT_getFileContentsIn and write, and prints how
+  fast that went under the name pcHow.
+*/
+static void Bench_sendOnce(const char *pcHow, FT_T oFTree,
+                           boolean bSend) {
+   char acPath[MAX_PATH];
+   pthread_t sDrain;
+   int aiPipe[2];
+   char *pcContents;
+   double dTime;
+   size_t ulFile, ulSent, i;
+   ssize_t lWritten;
+   int iStatus;
+
+   iStatus = pipe(aiPipe);
+   assert(iStatus == 0);
+   (void) fcntl(aiPipe[1], F_SETPIPE_SZ, 1024 * 1024);
+   iStatus = pthread_create(&sDrain, NULL, Bench_drain, &aiPipe[0]);
+   assert(iStatus == 0);
+   dTime = Bench_now();
+   for(i = 0; i < SEND_ROUNDS; i++)
+      for(ulFile = 0; ulFile < MAPPED_FILES; ulFile++) {
+         sprintf(acPath, "bench/%lu", (unsigned long) ulFile);
+         if(bSend) {
+            iStatus = FT_sendFileIn(oFTree, acPath, aiPipe[1], 0,
+                                    MAPPED_FILE, &ulSent);
+            assert(iStatus == SUCCESS && ulSent == MAPPED_FILE);
+            continue;
+         }
+         pcContents = FT_getFileContentsIn(oFTree, acPath);
+         assert(pcContents != NULL);
+         for(ulSent = 0; ulSent < MAPPED_FILE; ulSent += lWritten) {
+            lWritten = write(aiPipe[1], pcContents + ulSent,
+                             MAPPED_FILE - ulSent);
+            assert(lWritten > 0);
+         }
+      }
+   (void) close(aiPipe[1]);
+   (void) pthread_join(sDrain, NULL);
+   dTime = Bench_now() - dTime;
+   (void) close(aiPipe[0]);
+   printf("%-12s %12.0f\n", pcHow, (double) SEND_ROUNDS * MAPPED_FILES *
+          MAPPED_FILE / dTime / (1024 * 1024));
+}
+
+/*
+  Measures sending MAPPED_FILES files of MAPPED_FILE bytes into a pipe,
+  with FT_sendFileIn against FT_getFileContentsIn and write, for
+  contents read into memory, mapped by FT_insertFileMappedIn, and cut
+  into the chunks of a tree made with FT_CHUNKED.
+*/
+static void Bench_scenarioSend(size_t ulMaxThreads,
+                               unsigned long ulMillis) {
+   static const char *apcHow[3] = { "memory", "mapped", "chunked" };
+   char acFile[] = "/tmp/ft_benchXXXXXX";
+   char acPath[MAX_PATH];
+   char acName[32];
+   char *pcContents;
+   FT_T oFTree;
+   size_t ulFile, i;
+   double dWrite;
+   int iFd;
+   int iStatus;
+
+   (void) ulMaxThreads;
+   (void) ulMillis;
+   pcContents = malloc(MAPPED_FILE);
+   assert(pcContents != NULL);
+   for(ulFile = 0; ulFile < MAPPED_FILE; ulFile++)
+      pcContents[ulFile] = (char) (ulFile * 131 >> 5);
+   iFd = mkstemp(acFile);
+   assert(iFd >= 0);
+   (void) unlink(acFile);
+   dWrite = Bench_writeRaw(iFd, pcContents, MAPPED_FILE,
+                           (size_t) MAPPED_FILES * MAPPED_FILE);
+   assert(dWrite >= 0);
+
+   printf("send: %d files of %d MB into a pipe, %d times each\n",
+          MAPPED_FILES, MAPPED_FILE / (1024 * 1024), SEND_ROUNDS);
+   printf("%-12s %12s\n", "contents", "MB/s");
+   for(i = 0; i < 3; i++) {
+      iStatus = FT_newWithFlags(i == 2 ? FT_CHUNKED : 0, &oFTree);
+      assert(iStatus == SUCCESS);
+      for(ulFile = 0; ulFile < MAPPED_FILES; ulFile++) {
+         sprintf(acPath, "bench/%lu", (unsigned long) ulFile);
+         if(i == 1)
+            iStatus = FT_insertFileMappedIn(oFTree, acPath, iFd,
+                                            ulFile * MAPPED_FILE,
+                                            MAPPED_FILE);
+         else
+            iStatus = FT_insertFileIn(oFTree, acPath, pcContents,
+                                      MAPPED_FILE);
+         assert(iStatus == SUCCESS);
+      }
+      sprintf(acName, "%s write", apcHow[i]);
+      Bench_sendOnce(acName, oFTree, FALSE);
+      sprintf(acName, "%s send", apcHow[i]);
+      Bench_sendOnce(acName, oFTree, TRUE);
+      FT_free(oFTree);
+   }
+
+   (void) close(iFd);
+   free(pcContents);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Runs the scenario named by argv[1] (default "read") with at most
+   argv[2] threads (default 8), each measurement lasting argv[3]
+   milliseconds (default 500). Every operation's result is checked
+   along the way, so the benchmark doubles as a stress test.
+   Returns 0, or 1 on a usage error. */
+int main(int argc, char *argv[]) {
+   const char *pcScenario = "read";
+   size_t ulMaxThreads = 8;
+   unsigned long ulMillis = 500;
+
+   if(argc > 1)
+      pcScenario = argv[1];
+   if(argc > 2)
+      ulMaxThreads = (size_t) strtoul(argv[2], NULL, 10);
+   if(argc > 3)
+      ulMillis = strtoul(argv[3], NULL, 10);
+   if(ulMaxThreads == 0 || ulMillis == 0) {
+      fprintf(stderr, "usage: %s [scenario [maxThreads [millis]]]\n",
+              argv[0]);
+      return 1;
+   }
+
+   if(!strcmp(pcScenario, "read"))
+      Bench_scenarioRead(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "write"))
+      Bench_scenarioWrite(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "latency"))
+      Bench_scenarioLatency(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "shard"))
+      Bench_scenarioShard(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "snapshot"))
+      Bench_scenarioSnapshot(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "move"))
+      Bench_scenarioMove(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "copy"))
+      Bench_scenarioCopy(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "glob"))
+      Bench_scenarioGlob(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "list"))
+      Bench_scenarioList(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "find"))
+      Bench_scenarioFind(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "topk"))
+      Bench_scenarioTopK(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "image"))
+      Bench_scenarioImage(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "wal"))
+      Bench_scenarioWal(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "import"))
+      Bench_scenarioImport(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "tar"))
+      Bench_scenarioTar(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "untar"))
+      Bench_scenarioUntar(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "edit"))
+      Bench_scenarioEdit(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "dedup"))
+      Bench_scenarioDedup(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "cold"))
+      Bench_scenarioCold(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "spill"))
+      Bench_scenarioSpill(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "mapped"))
+      Bench_scenarioMapped(ulMaxThreads, ulMillis);
+   else if(!strcmp(pcScenario, "send"))
+      Bench_scenarioSend(ulMaxThreads, ulMillis);
+   else {
+      fprintf(stderr, "%s: unknown scenario %s (try read, write, "
+              "latency, shard, snapshot, move, copy, glob, list, find, "
+              "topk, image, wal, import, tar, untar, edit, dedup, cold, "
+              "spill, mapped or send)\n",
+              argv[0], pcScenario);
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,583 @@
+/*--------------------------------------------------------------------*/
+/* image.c                                                            */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "image.h"
+#include "ft.h"
+
+/* The bytes every image starts and its trailer ends with */
+static const char acMagic[8] = "FTIMAGE";
+
+/* The bytes an image writer buffers before writing them out */
+enum { BUFFER_SIZE = 64 * 1024 };
+
+/* The offset in a file record of no contents */
+#define NO_CONTENTS ((Image_Offset) -1)
+
+/* The record of a node */
+struct record {
+   /* the offset of the node's name */
+   Image_Offset ulName;
+   /* nonzero if the node is a file */
+   unsigned long ulIsFile;
+   /* for a file, the offset of its contents, or NO_CONTENTS; for a
+      directory, the offset of the offsets of its children */
+   Image_Offset ulData;
+   /* for a file, the size of its contents; for a directory, the
+      number of its file children */
+   unsigned long ulLength;
+   /* for a directory, the number of its directory children */
+   unsigned long ulDirs;
+};
+
+/* The end of an image */
+struct trailer {
+   /* the record of the root, or IMAGE_NONE */
+   Image_Offset ulRoot;
+   /* the tag given by ImageWriter_setTag, or 0 */
+   unsigned long ulTag;
+   /* the size of a word where the image was written */
+   unsigned long ulWordSize;
+   /* acMagic */
+   char acMagic[8];
+};
+
+/* A mapped image */
+struct image {
+   /* the start of the mapping */
+   const char *pcBase;
+   /* the size of the mapping */
+   size_t ulSize;
+   /* the number of references to the image */
+   size_t ulRefs;
+   /* the record of the root, or IMAGE_NONE */
+   Image_Offset ulRoot;
+   /* the image's tag */
+   unsigned long ulTag;
+};
+
+/* A name already written by an image writer */
+struct nameSlot {
+   /* the name, which belongs to the writer's caller */
+   const char *pcName;
+   /* where it was written */
+   Image_Offset ulOffset;
+};
+
+/* A writer of an image */
+struct imageWriter {
+   /* the file descriptor written to */
+   int iFd;
+   /* the bytes not written out yet */
+   char *pcBuffer;
+   size_t ulBuffered;
+   /* the offset of the next byte to be written */
+   Image_Offset ulOffset;
+   /* the names written so far, hashed by open addressing into
+      ulSlots slots, of which ulNames are in use */
+   struct nameSlot *psSlots;
+   size_t ulSlots;
+   size_t ulNames;
+   /* the tag to write in the trailer */
+   unsigned long ulTag;
+   /* SUCCESS, or the first error */
+   int iStatus;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the record at ulRecord in oImage. */
+static const struct record *Image_record(Image_T oImage,
+                                         Image_Offset ulRecord) {
+   assert(oImage != NULL);
+   assert(ulRecord != IMAGE_NONE);
+   assert(ulRecord + sizeof(struct record) <= oImage->ulSize);
+
+   return (const struct record *) (oImage->pcBase + ulRecord);
+}
+
+/*--------------------------------------------------------------------*/
+
+int Image_map(const char *pcPath, Image_T *poIResult) {
+   Image_T oImage;
+   struct stat sStat;
+   struct trailer sTrailer;
+   void *pvBase;
+   int iFd;
+   int iErrno;
+
+   assert(pcPath != NULL);
+   assert(poIResult != NULL);
+
+   *poIResult = NULL;
+   iFd = open(pcPath, O_RDONLY);
+   if(iFd < 0)
+      return IO_ERROR;
+   if(fstat(iFd, &sStat) != 0) {
+      iErrno = errno;
+      (void) close(iFd);
+      errno = iErrno;
+      return IO_ERROR;
+   }
+   if(sStat.st_size < (off_t) (sizeof(acMagic) + sizeof(sTrailer))) {
+      (void) close(iFd);
+      errno = EINVAL;
+      return IO_ERROR;
+   }
+   pvBase = mmap(NULL, (size_t) sStat.st_size, PROT_READ, MAP_PRIVATE,
+                 iFd, 0);
+   iErrno = errno;
+   (void) close(iFd);
+   if(pvBase == MAP_FAILED) {
+      errno = iErrno;
+      return IO_ERROR;
+   }
+
+   memcpy(&sTrailer, (char *) pvBase + sStat.st_size - sizeof(sTrailer),
+          sizeof(sTrailer));
+   if(memcmp(pvBase, acMagic, sizeof(acMagic)) ||
+      memcmp(sTrailer.acMagic, acMagic, sizeof(acMagic)) ||
+      sTrailer.ulWordSize != sizeof(unsigned long) ||
+      (sTrailer.ulRoot != IMAGE_NONE &&
+       sTrailer.ulRoot + sizeof(struct record) >
+       (size_t) sStat.st_size)) {
+      (void) munmap(pvBase, (size_t) sStat.st_size);
+      errno = EINVAL;
+      return IO_ERROR;
+   }
+
+   oImage = malloc(sizeof(struct image));
+   if(oImage == NULL) {
+      (void) munmap(pvBase, (size_t) sStat.st_size);
+      return MEMORY_ERROR;
+   }
+   oImage->pcBase = pvBase;
+   oImage->ulSize = (size_t) sStat.st_size;
+   oImage->ulRefs = 1;
+   oImage->ulRoot = sTrailer.ulRoot;
+   oImage->ulTag = sTrailer.ulTag;
+
+   *poIResult = oImage;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void Image_retain(Image_T oImage) {
+   assert(oImage != NULL);
+
+   (void) __atomic_add_fetch(&oImage->ulRefs, 1, __ATOMIC_RELAXED);
+}
+
+/*--------------------------------------------------------------------*/
+
+void Image_release(Image_T oImage) {
+   if(oImage == NULL)
+      return;
+
+   if(__atomic_sub_fetch(&oImage->ulRefs, 1, __ATOMIC_ACQ_REL) != 0)
+      return;
+   (void) munmap((void *) oImage->pcBase, oImage->ulSize);
+   free(oImage);
+}
+
+/*--------------------------------------------------------------------*/
+
+Image_Offset Image_getRoot(Image_T oImage) {
+   assert(oImage != NULL);
+
+   return oImage->ulRoot;
+}
+
+/*--------------------------------------------------------------------*/
+
+unsigned long Image_getTag(Image_T oImage) {
+   assert(oImage != NULL);
+
+   return oImage->ulTag;
+}
+
+/*--------------------------------------------------------------------*/
+
+const char *Image_getName(Image_T oImage, Image_Offset ulRecord) {
+   return oImage->pcBase + Image_record(oImage, ulRecord)->ulName;
+}
+
+/*--------------------------------------------------------------------*/
+
+boolean Image_isFile(Image_T oImage, Image_Offset ulRecord) {
+   return Image_record(oImage, ulRecord)->ulIsFile != 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+void *Image_getContents(Image_T oImage, Image_Offset ulRecord) {
+   const struct record *psRecord = Image_record(oImage, ulRecord);
+
+   assert(psRecord->ulIsFile);
+
+   if(psRecord->ulData == NO_CONTENTS)
+      return NULL;
+   /* the mapping is read-only, whatever the type says */
+   return (void *) (oImage->pcBase + psRecord->ulData);
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t Image_getLength(Image_T oImage, Image_Offset ulRecord) {
+   const struct record *psRecord = Image_record(oImage, ulRecord);
+
+   assert(psRecord->ulIsFile);
+
+   return psRecord->ulLength;
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t Image_getNumChildren(Image_T oImage, Image_Offset ulRecord,
+                            boolean bIsFile) {
+   const struct record *psRecord = Image_record(oImage, ulRecord);
+
+   assert(!psRecord->ulIsFile);
+
+   return bIsFile ? psRecord->ulLength : psRecord->ulDirs;
+}
+
+/*--------------------------------------------------------------------*/
+
+Image_Offset Image_getChild(Image_T oImage, Image_Offset ulRecord,
+                            boolean bIsFile, size_t ulIndex) {
+   const struct record *psRecord = Image_record(oImage, ulRecord);
+   const Image_Offset *pulChildren;
+
+   assert(!psRecord->ulIsFile);
+   assert(ulIndex < Image_getNumChildren(oImage, ulRecord, bIsFile));
+
+   pulChildren = (const Image_Offset *) (oImage->pcBase +
+                                         psRecord->ulData);
+   if(!bIsFile)
+      ulIndex += psRecord->ulLength;
+   return pulChildren[ulIndex];
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Writes out everything oWriter has buffered. */
+static void ImageWriter_flush(ImageWriter_T oWriter) {
+   size_t ulDone = 0;
+   ssize_t lWritten;
+
+   assert(oWriter != NULL);
+
+   while(oWriter->iStatus == SUCCESS && ulDone < oWriter->ulBuffered) {
+      lWritten = write(oWriter->iFd, oWriter->pcBuffer + ulDone,
+                       oWriter->ulBuffered - ulDone);
+      if(lWritten < 0 && errno != EINTR)
+         oWriter->iStatus = IO_ERROR;
+      else if(lWritten > 0)
+         ulDone += (size_t) lWritten;
+   }
+   oWriter->ulBuffered = 0;
+}
+
+/* Buffers the ulLength bytes pvBytes for oWriter to write out. */
+static void ImageWriter_put(ImageWriter_T oWriter, const void *pvBytes,
+                            size_t ulLength) {
+   const char *pcBytes = pvBytes;
+   size_t ulChunk;
+
+   assert(oWriter != NULL);
+   assert(pvBytes != NULL || ulLength == 0);
+
+   oWriter->ulOffset += ulLength;
+   while(oWriter->iStatus == SUCCESS && ulLength > 0) {
+      if(oWriter->ulBuffered == BUFFER_SIZE)
+         ImageWriter_flush(oWriter);
+      ulChunk = BUFFER_SIZE - oWriter->ulBuffered;
+      if(ulChunk > ulLength)
+         ulChunk = ulLength;
+      memcpy(oWriter->pcBuffer + oWriter->ulBuffered, pcBytes, ulChunk);
+      oWriter->ulBuffered += ulChunk;
+      pcBytes += ulChunk;
+      ulLength -= ulChunk;
+   }
+}
+
+/* Buffers for oWriter enough zeros to align what follows ulLength
+   bytes, which started aligned, for a word. */
+static void ImageWriter_pad(ImageWriter_T oWriter, size_t ulLength) {
+   static const char acZeros[sizeof(unsigned long)] = { 0 };
+
+   ImageWriter_put(oWriter, acZeros,
+                   (sizeof(unsigned long) - ulLength % sizeof(unsigned long))
+                   % sizeof(unsigned long));
+}
+
+/*
+  Appends the ulLength bytes pvBytes to the image oWriter is writing,
+  followed by enough zeros to align what comes next for a word, and
+  returns the offset of the first of them.
+*/
+static Image_Offset ImageWriter_append(ImageWriter_T oWriter,
+                                       const void *pvBytes,
+                                       size_t ulLength) {
+   Image_Offset ulStart;
+
+   assert(oWriter != NULL);
+
+   ulStart = oWriter->ulOffset;
+   ImageWriter_put(oWriter, pvBytes, ulLength);
+   ImageWriter_pad(oWriter, ulLength);
+   return ulStart;
+}
+
+/* Returns the hash of the name pcName. */
+static size_t ImageWriter_hash(const char *pcName) {
+   unsigned long ulHash = 5381;
+
+   assert(pcName != NULL);
+
+   while(*pcName != '\0')
+      ulHash = ulHash * 33 + (unsigned char) *pcName++;
+   return (size_t) ulHash;
+}
+
+/*
+  Doubles the slots of oWriter's name table. Returns SUCCESS, or
+  MEMORY_ERROR, in which case nothing changed.
+*/
+static int ImageWriter_growNames(ImageWriter_T oWriter) {
+   struct nameSlot *psOld = oWriter->psSlots;
+   size_t ulOldSlots = oWriter->ulSlots;
+   size_t i, j;
+
+   assert(oWriter != NULL);
+
+   oWriter->psSlots = calloc(2 * ulOldSlots, sizeof(struct nameSlot));
+   if(oWriter->psSlots == NULL) {
+      oWriter->psSlots = psOld;
+      return MEMORY_ERROR;
+   }
+   oWriter->ulSlots = 2 * ulOldSlots;
+   for(i = 0; i < ulOldSlots; i++) {
+      if(psOld[i].pcName == NULL)
+         continue;
+      j = ImageWriter_hash(psOld[i].pcName) % oWriter->ulSlots;
+      while(oWriter->psSlots[j].pcName != NULL)
+         j = (j + 1) % oWriter->ulSlots;
+      oWriter->psSlots[j] = psOld[i];
+   }
+   free(psOld);
+   return SUCCESS;
+}
+
+/* Returns the offset of the name pcName in the image oWriter is
+   writing, writing it first if it is new. */
+static Image_Offset ImageWriter_addName(ImageWriter_T oWriter,
+                                        const char *pcName) {
+   size_t i;
+
+   assert(oWriter != NULL);
+   assert(pcName != NULL);
+
+   /* at most half full */
+   if(2 * (oWriter->ulNames + 1) > oWriter->ulSlots &&
+      ImageWriter_growNames(oWriter) != SUCCESS) {
+      ImageWriter_fail(oWriter, MEMORY_ERROR);
+      return IMAGE_NONE;
+   }
+
+   i = ImageWriter_hash(pcName) % oWriter->ulSlots;
+   while(oWriter->psSlots[i].pcName != NULL) {
+      if(!strcmp(oWriter->psSlots[i].pcName, pcName))
+         return oWriter->psSlots[i].ulOffset;
+      i = (i + 1) % oWriter->ulSlots;
+   }
+   oWriter->psSlots[i].pcName = pcName;
+   oWriter->psSlots[i].ulOffset = ImageWriter_append(oWriter, pcName,
+                                                     strlen(pcName) + 1);
+   oWriter->ulNames++;
+   return oWriter->psSlots[i].ulOffset;
+}
+
+/*--------------------------------------------------------------------*/
+
+int ImageWriter_new(int iFd, ImageWriter_T *poWResult) {
+   ImageWriter_T oWriter;
+
+   assert(poWResult != NULL);
+
+   *poWResult = NULL;
+   oWriter = malloc(sizeof(struct imageWriter));
+   if(oWriter == NULL)
+      return MEMORY_ERROR;
+   oWriter->pcBuffer = malloc(BUFFER_SIZE);
+   oWriter->ulSlots = 64;
+   oWriter->psSlots = calloc(oWriter->ulSlots, sizeof(struct nameSlot));
+   if(oWriter->pcBuffer == NULL || oWriter->psSlots == NULL) {
+      free(oWriter->pcBuffer);
+      free(oWriter->psSlots);
+      free(oWriter);
+      return MEMORY_ERROR;
+   }
+   oWriter->iFd = iFd;
+   oWriter->ulBuffered = 0;
+   oWriter->ulOffset = 0;
+   oWriter->ulNames = 0;
+   oWriter->ulTag = 0;
+   oWriter->iStatus = SUCCESS;
+
+   /* so that no record is ever at offset IMAGE_NONE */
+   (void) ImageWriter_append(oWriter, acMagic, sizeof(acMagic));
+
+   *poWResult = oWriter;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+Image_Offset ImageWriter_addFile(ImageWriter_T oWriter,
+                                 const char *pcName,
+                                 const void *pvContents,
+                                 size_t ulLength) {
+   struct record sRecord;
+
+   assert(oWriter != NULL);
+   assert(pcName != NULL);
+
+   sRecord.ulName = ImageWriter_addName(oWriter, pcName);
+   sRecord.ulIsFile = 1;
+   sRecord.ulLength = ulLength;
+   sRecord.ulDirs = 0;
+   if(pvContents == NULL)
+      sRecord.ulData = NO_CONTENTS;
+   else
+      sRecord.ulData = ImageWriter_append(oWriter, pvContents, ulLength);
+   if(oWriter->iStatus != SUCCESS)
+      return IMAGE_NONE;
+   return ImageWriter_append(oWriter, &sRecord, sizeof(sRecord));
+}
+
+/*--------------------------------------------------------------------*/
+
+Image_Offset ImageWriter_addFileRead(ImageWriter_T oWriter,
+                                     const char *pcName, size_t ulLength,
+                                     size_t (*pfRead)(void *pvSource,
+                                                      size_t ulOffset,
+                                                      void *pvDest,
+                                                      size_t ulCount),
+                                     void *pvSource) {
+   struct record sRecord;
+   size_t ulDone = 0;
+   size_t ulChunk, ulRead;
+
+   assert(oWriter != NULL);
+   assert(pcName != NULL);
+   assert(pfRead != NULL);
+
+   sRecord.ulName = ImageWriter_addName(oWriter, pcName);
+   sRecord.ulIsFile = 1;
+   sRecord.ulLength = ulLength;
+   sRecord.ulDirs = 0;
+   sRecord.ulData = oWriter->ulOffset;
+   /* read straight into the buffer, a buffer's worth at a time */
+   while(oWriter->iStatus == SUCCESS && ulDone < ulLength) {
+      if(oWriter->ulBuffered == BUFFER_SIZE)
+         ImageWriter_flush(oWriter);
+      ulChunk = BUFFER_SIZE - oWriter->ulBuffered;
+      if(ulChunk > ulLength - ulDone)
+         ulChunk = ulLength - ulDone;
+      ulRead = (*pfRead)(pvSource, ulDone,
+                         oWriter->pcBuffer + oWriter->ulBuffered, ulChunk);
+      oWriter->ulBuffered += ulRead;
+      oWriter->ulOffset += ulRead;
+      ulDone += ulRead;
+      if(ulRead < ulChunk && oWriter->iStatus == SUCCESS)
+         oWriter->iStatus = MEMORY_ERROR;
+   }
+   ImageWriter_pad(oWriter, ulLength);
+   if(oWriter->iStatus != SUCCESS)
+      return IMAGE_NONE;
+   return ImageWriter_append(oWriter, &sRecord, sizeof(sRecord));
+}
+
+/*--------------------------------------------------------------------*/
+
+Image_Offset ImageWriter_addDir(ImageWriter_T oWriter,
+                                const char *pcName,
+                                const Image_Offset *pulFiles,
+                                size_t ulFiles,
+                                const Image_Offset *pulDirs,
+                                size_t ulDirs) {
+   struct record sRecord;
+
+   assert(oWriter != NULL);
+   assert(pcName != NULL);
+   assert(pulFiles != NULL || ulFiles == 0);
+   assert(pulDirs != NULL || ulDirs == 0);
+
+   sRecord.ulName = ImageWriter_addName(oWriter, pcName);
+   sRecord.ulIsFile = 0;
+   sRecord.ulLength = ulFiles;
+   sRecord.ulDirs = ulDirs;
+   /* the files' offsets and the directories' follow each other */
+   sRecord.ulData = ImageWriter_append(oWriter, pulFiles,
+                                       ulFiles * sizeof(Image_Offset));
+   (void) ImageWriter_append(oWriter, pulDirs,
+                             ulDirs * sizeof(Image_Offset));
+   if(oWriter->iStatus != SUCCESS)
+      return IMAGE_NONE;
+   return ImageWriter_append(oWriter, &sRecord, sizeof(sRecord));
+}
+
+/*--------------------------------------------------------------------*/
+
+void ImageWriter_setTag(ImageWriter_T oWriter, unsigned long ulTag) {
+   assert(oWriter != NULL);
+
+   oWriter->ulTag = ulTag;
+}
+
+/*--------------------------------------------------------------------*/
+
+void ImageWriter_fail(ImageWriter_T oWriter, int iStatus) {
+   assert(oWriter != NULL);
+   assert(iStatus != SUCCESS);
+
+   if(oWriter->iStatus == SUCCESS)
+      oWriter->iStatus = iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+int ImageWriter_finish(ImageWriter_T oWriter, Image_Offset ulRoot) {
+   struct trailer sTrailer;
+   int iStatus;
+
+   assert(oWriter != NULL);
+
+   memset(&sTrailer, 0, sizeof(sTrailer));
+   sTrailer.ulRoot = ulRoot;
+   sTrailer.ulTag = oWriter->ulTag;
+   sTrailer.ulWordSize = sizeof(unsigned long);
+   memcpy(sTrailer.acMagic, acMagic, sizeof(acMagic));
+   (void) ImageWriter_append(oWriter, &sTrailer, sizeof(sTrailer));
+   ImageWriter_flush(oWriter);
+
+   iStatus = oWriter->iStatus;
+   free(oWriter->pcBuffer);
+   free(oWriter->psSlots);
+   free(oWriter);
+   return iStatus;
+}
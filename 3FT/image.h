@@ -0,0 +1,173 @@
+/*--------------------------------------------------------------------*/
+/* image.h                                                            */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef IMAGE_INCLUDED
+#define IMAGE_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  An image is a File Tree written out as one file, to be mapped into
+  memory and read in place. It refers to everything by its offset from
+  the start of the file rather than by pointer, so it reads the same
+  wherever it is mapped. Each node is a fixed-size record: a file's
+  holds its size and the offset of its contents, a directory's the
+  offset of an array of the offsets of its children's records, files
+  first and then directories, each in order of name. Every distinct
+  name is stored once, however many nodes carry it. A trailer at the
+  end of the file locates the root, so that an image can be written
+  to a pipe or socket as well as to a file.
+
+  Words are written in the byte order and size of the machine that
+  wrote them, and an image is only read on the same kind of machine.
+  Images are trusted: a damaged one may make a reader crash.
+*/
+
+/* The offset of a node's record in an image */
+typedef unsigned long Image_Offset;
+
+/* The Image_Offset of no record at all */
+#define IMAGE_NONE ((Image_Offset) 0)
+
+/*--------------------------------------------------------------------*/
+
+/* An Image_T is an image mapped read-only into memory */
+typedef struct image *Image_T;
+
+/*
+  Maps the image in the file pcPath. Returns SUCCESS and sets
+  *poIResult to it if successful. Otherwise, sets *poIResult to NULL
+  and returns:
+  * IO_ERROR (from ft.h) if the file could not be opened or mapped, or
+             is not an image, in which case errno tells why
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  Only the trailer is read: the rest of the file is read by the
+  operating system as it is first used.
+*/
+int Image_map(const char *pcPath, Image_T *poIResult);
+
+/* Takes another reference to oImage, which starts with one. */
+void Image_retain(Image_T oImage);
+
+/* Drops a reference to oImage, and unmaps it once the last one is
+   gone. Does nothing if oImage is NULL. */
+void Image_release(Image_T oImage);
+
+/* Returns the record of the root of oImage, or IMAGE_NONE if its tree
+   is empty. */
+Image_Offset Image_getRoot(Image_T oImage);
+
+/* Returns the tag oImage was written with, or 0 if it had none. */
+unsigned long Image_getTag(Image_T oImage);
+
+/* Returns the name of the node whose record is ulRecord in oImage. */
+const char *Image_getName(Image_T oImage, Image_Offset ulRecord);
+
+/* Returns TRUE if the record ulRecord of oImage is a file's. */
+boolean Image_isFile(Image_T oImage, Image_Offset ulRecord);
+
+/* Returns the contents of the file whose record is ulRecord in
+   oImage, within the mapping, or NULL if the file had none. */
+void *Image_getContents(Image_T oImage, Image_Offset ulRecord);
+
+/* Returns the size of the file whose record is ulRecord in oImage. */
+size_t Image_getLength(Image_T oImage, Image_Offset ulRecord);
+
+/* Returns the number of file children if bIsFile is TRUE, or
+   directory children otherwise, of the directory whose record is
+   ulRecord in oImage. */
+size_t Image_getNumChildren(Image_T oImage, Image_Offset ulRecord,
+                            boolean bIsFile);
+
+/* Returns the record of the file child if bIsFile is TRUE, or
+   directory child otherwise, with index ulIndex in name order of the
+   directory whose record is ulRecord in oImage. */
+Image_Offset Image_getChild(Image_T oImage, Image_Offset ulRecord,
+                            boolean bIsFile, size_t ulIndex);
+
+/*--------------------------------------------------------------------*/
+
+/*
+  An ImageWriter_T writes an image to a file descriptor, children
+  before their parents, so that each record is written once and in
+  order, without seeking. Errors are remembered rather than returned
+  by each call: once one occurs, later calls do nothing, and
+  ImageWriter_finish reports it.
+*/
+typedef struct imageWriter *ImageWriter_T;
+
+/*
+  Creates a writer that writes an image to iFd, from its current
+  position on. Returns SUCCESS and sets *poWResult to the writer if
+  successful. Otherwise, sets *poWResult to NULL and returns
+  MEMORY_ERROR.
+*/
+int ImageWriter_new(int iFd, ImageWriter_T *poWResult);
+
+/*
+  Writes the record of a file named pcName with contents pvContents
+  of ulLength bytes, or no contents if pvContents is NULL, and
+  returns its offset, or IMAGE_NONE if the writer has failed. pcName
+  must stay valid until ImageWriter_finish.
+*/
+Image_Offset ImageWriter_addFile(ImageWriter_T oWriter,
+                                 const char *pcName,
+                                 const void *pvContents,
+                                 size_t ulLength);
+
+/*
+  As ImageWriter_addFile, but with ulLength bytes of contents that
+  (*pfRead)(pvSource, ulOffset, pvDest, ulCount) copies to pvDest a
+  piece at a time, from offset ulOffset on, returning how many it
+  copied, so that the contents need only stay valid during each call.
+  The writer fails with MEMORY_ERROR if pfRead copies fewer than
+  asked.
+*/
+Image_Offset ImageWriter_addFileRead(ImageWriter_T oWriter,
+                                     const char *pcName, size_t ulLength,
+                                     size_t (*pfRead)(void *pvSource,
+                                                      size_t ulOffset,
+                                                      void *pvDest,
+                                                      size_t ulCount),
+                                     void *pvSource);
+
+/*
+  Writes the record of a directory named pcName whose file children's
+  records are the ulFiles offsets pulFiles and whose directory
+  children's are the ulDirs offsets pulDirs, each in order of name,
+  and returns its offset, or IMAGE_NONE if the writer has failed.
+  pcName must stay valid until ImageWriter_finish.
+*/
+Image_Offset ImageWriter_addDir(ImageWriter_T oWriter,
+                                const char *pcName,
+                                const Image_Offset *pulFiles,
+                                size_t ulFiles,
+                                const Image_Offset *pulDirs,
+                                size_t ulDirs);
+
+/*
+  Sets the tag written in the trailer of oWriter's image to ulTag, a
+  number of the caller's choosing, such as a version or generation,
+  which Image_getTag returns. Images are tagged 0 by default.
+*/
+void ImageWriter_setTag(ImageWriter_T oWriter, unsigned long ulTag);
+
+/*
+  Records the failure iStatus in oWriter, unless it has failed
+  already, so that nothing more is written.
+*/
+void ImageWriter_fail(ImageWriter_T oWriter, int iStatus);
+
+/*
+  Writes the trailer, with ulRoot as the root's record (IMAGE_NONE
+  for an empty tree), and everything still buffered, then frees
+  oWriter. Returns SUCCESS, or the first error: IO_ERROR (from ft.h)
+  if writing failed, in which case errno tells why, or MEMORY_ERROR,
+  or whatever ImageWriter_fail recorded.
+*/
+int ImageWriter_finish(ImageWriter_T oWriter, Image_Offset ulRoot);
+
+#endif
@@ -0,0 +1,442 @@
+/*--------------------------------------------------------------------*/
+/* import.c                                                           */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "import.h"
+#include "ft.h"
+
+/* An entry of a directory being scanned */
+struct entry {
+   /* the entry's name */
+   char *pcName;
+   /* TRUE if the entry is a directory, FALSE if a regular file */
+   boolean bIsDir;
+   /* for a file, its contents or NULL, and its size */
+   void *pvContents;
+   size_t ulSize;
+};
+
+/* A directory waiting to be scanned */
+struct job {
+   /* the directory's path in the local file system */
+   char *pcPath;
+   /* the node its entries become the children of */
+   Node_T oNDir;
+   /* the next job waiting */
+   struct job *psNext;
+};
+
+/* The state shared by the threads of one scan */
+struct importer {
+   /* the directories waiting to be scanned, the latest first */
+   struct job *psJobs;
+   /* the number of jobs waiting or being scanned */
+   size_t ulPending;
+   /* TRUE if files are read, FALSE if only their sizes are */
+   boolean bContents;
+   /* SUCCESS, or the first error, and the errno that went with it */
+   int iStatus;
+   int iErrno;
+   /* guards the fields above */
+   pthread_mutex_t sMutex;
+   /* signalled when a job is added or the last one is done */
+   pthread_cond_t sChanged;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Compares the entries pvFirst and pvSecond by name, in the order of
+   a node's children. */
+static int Import_compareEntries(const void *pvFirst,
+                                 const void *pvSecond) {
+   const struct entry *psFirst = pvFirst;
+   const struct entry *psSecond = pvSecond;
+
+   return strcmp(psFirst->pcName, psSecond->pcName);
+}
+
+/*
+  Reads the regular file pcName in the directory open on iDirFd into
+  memory, setting *ppvContents to the new copy and *pulSize to its
+  size. Returns SUCCESS, or IO_ERROR, in which case errno tells why,
+  or MEMORY_ERROR.
+*/
+static int Import_readFile(int iDirFd, const char *pcName,
+                           void **ppvContents, size_t *pulSize) {
+   struct stat sStat;
+   char *pcContents;
+   size_t ulRead = 0;
+   ssize_t lRead;
+   int iFd;
+   int iErrno;
+
+   assert(pcName != NULL);
+   assert(ppvContents != NULL);
+   assert(pulSize != NULL);
+
+   iFd = openat(iDirFd, pcName, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+   if(iFd < 0)
+      return IO_ERROR;
+   if(fstat(iFd, &sStat) != 0) {
+      iErrno = errno;
+      (void) close(iFd);
+      errno = iErrno;
+      return IO_ERROR;
+   }
+   /* one byte at least, so that empty contents are not NULL */
+   pcContents = malloc((size_t) sStat.st_size + 1);
+   if(pcContents == NULL) {
+      (void) close(iFd);
+      return MEMORY_ERROR;
+   }
+   /* a file that shrinks meanwhile is taken as it ends up */
+   while(ulRead < (size_t) sStat.st_size) {
+      lRead = read(iFd, pcContents + ulRead,
+                   (size_t) sStat.st_size - ulRead);
+      if(lRead == 0)
+         break;
+      if(lRead < 0 && errno != EINTR) {
+         iErrno = errno;
+         free(pcContents);
+         (void) close(iFd);
+         errno = iErrno;
+         return IO_ERROR;
+      }
+      if(lRead > 0)
+         ulRead += (size_t) lRead;
+   }
+   (void) close(iFd);
+
+   *ppvContents = pcContents;
+   *pulSize = ulRead;
+   return SUCCESS;
+}
+
+/* Adds a job to psImporter for the directory pcName in the directory
+   pcParent, or for pcParent itself if pcName is empty, to be scanned
+   into oNDir. Returns SUCCESS, or MEMORY_ERROR. */
+static int Import_push(struct importer *psImporter, const char *pcParent,
+                       const char *pcName, Node_T oNDir) {
+   struct job *psJob;
+
+   assert(psImporter != NULL);
+   assert(pcParent != NULL);
+   assert(pcName != NULL);
+   assert(oNDir != NULL);
+
+   psJob = malloc(sizeof(struct job));
+   if(psJob == NULL)
+      return MEMORY_ERROR;
+   psJob->pcPath = malloc(strlen(pcParent) + strlen(pcName) + 2);
+   if(psJob->pcPath == NULL) {
+      free(psJob);
+      return MEMORY_ERROR;
+   }
+   strcpy(psJob->pcPath, pcParent);
+   if(*pcName != '\0') {
+      strcat(psJob->pcPath, "/");
+      strcat(psJob->pcPath, pcName);
+   }
+   psJob->oNDir = oNDir;
+
+   (void) pthread_mutex_lock(&psImporter->sMutex);
+   psJob->psNext = psImporter->psJobs;
+   psImporter->psJobs = psJob;
+   psImporter->ulPending++;
+   (void) pthread_cond_signal(&psImporter->sChanged);
+   (void) pthread_mutex_unlock(&psImporter->sMutex);
+   return SUCCESS;
+}
+
+/*
+  Reads the entries of the directory open as psDir into a new array,
+  setting *ppsEntries to it and *pulCount to its length, reading or
+  sizing the files as psImporter asks. Returns SUCCESS, or IO_ERROR,
+  in which case errno tells why, or MEMORY_ERROR, in which case
+  whatever was read is freed.
+*/
+static int Import_readEntries(struct importer *psImporter, DIR *psDir,
+                              struct entry **ppsEntries,
+                              size_t *pulCount) {
+   struct entry *psEntries = NULL;
+   struct entry *psGrown;
+   struct dirent *psDirent;
+   struct stat sStat;
+   size_t ulCount = 0, ulCapacity = 0;
+   size_t i;
+   int iStatus = SUCCESS;
+   int iErrno;
+   boolean bIsDir;
+
+   assert(psImporter != NULL);
+   assert(psDir != NULL);
+
+   for(;;) {
+      errno = 0;
+      psDirent = readdir(psDir);
+      if(psDirent == NULL) {
+         if(errno != 0)
+            iStatus = IO_ERROR;
+         break;
+      }
+      if(!strcmp(psDirent->d_name, ".") || !strcmp(psDirent->d_name, ".."))
+         continue;
+
+      /* most file systems say what an entry is without a stat */
+      if(psDirent->d_type == DT_DIR)
+         bIsDir = TRUE;
+      else if(psDirent->d_type == DT_REG)
+         bIsDir = FALSE;
+      else if(psDirent->d_type != DT_UNKNOWN)
+         continue;
+      else if(fstatat(dirfd(psDir), psDirent->d_name, &sStat,
+                      AT_SYMLINK_NOFOLLOW) != 0) {
+         iStatus = IO_ERROR;
+         break;
+      }
+      else if(S_ISDIR(sStat.st_mode))
+         bIsDir = TRUE;
+      else if(S_ISREG(sStat.st_mode))
+         bIsDir = FALSE;
+      else
+         continue;
+
+      if(ulCount == ulCapacity) {
+         ulCapacity = ulCapacity == 0 ? 16 : 2 * ulCapacity;
+         psGrown = realloc(psEntries, ulCapacity * sizeof(struct entry));
+         if(psGrown == NULL) {
+            iStatus = MEMORY_ERROR;
+            break;
+         }
+         psEntries = psGrown;
+      }
+      psEntries[ulCount].pcName = malloc(strlen(psDirent->d_name) + 1);
+      if(psEntries[ulCount].pcName == NULL) {
+         iStatus = MEMORY_ERROR;
+         break;
+      }
+      strcpy(psEntries[ulCount].pcName, psDirent->d_name);
+      psEntries[ulCount].bIsDir = bIsDir;
+      psEntries[ulCount].pvContents = NULL;
+      psEntries[ulCount].ulSize = 0;
+      ulCount++;
+   }
+
+   for(i = 0; iStatus == SUCCESS && i < ulCount; i++) {
+      if(psEntries[i].bIsDir)
+         continue;
+      if(psImporter->bContents)
+         iStatus = Import_readFile(dirfd(psDir), psEntries[i].pcName,
+                                   &psEntries[i].pvContents,
+                                   &psEntries[i].ulSize);
+      else if(fstatat(dirfd(psDir), psEntries[i].pcName, &sStat,
+                      AT_SYMLINK_NOFOLLOW) != 0)
+         iStatus = IO_ERROR;
+      else
+         psEntries[i].ulSize = (size_t) sStat.st_size;
+   }
+
+   if(iStatus != SUCCESS) {
+      iErrno = errno;
+      for(i = 0; i < ulCount; i++) {
+         free(psEntries[i].pcName);
+         free(psEntries[i].pvContents);
+      }
+      free(psEntries);
+      errno = iErrno;
+      return iStatus;
+   }
+   *ppsEntries = psEntries;
+   *pulCount = ulCount;
+   return SUCCESS;
+}
+
+/*
+  Scans the directory of psJob into its node, in order of name, and
+  adds a job to psImporter for each directory found. Returns SUCCESS,
+  or IO_ERROR, in which case errno tells why, or MEMORY_ERROR.
+*/
+static int Import_scanDir(struct importer *psImporter,
+                          struct job *psJob) {
+   struct entry *psEntries = NULL;
+   size_t ulCount = 0;
+   size_t i;
+   DIR *psDir;
+   Node_T oNChild;
+   int iFd;
+   int iStatus;
+
+   assert(psImporter != NULL);
+   assert(psJob != NULL);
+
+   iFd = open(psJob->pcPath, O_RDONLY | O_DIRECTORY | O_NOFOLLOW |
+              O_CLOEXEC);
+   if(iFd < 0)
+      return IO_ERROR;
+   psDir = fdopendir(iFd);
+   if(psDir == NULL) {
+      (void) close(iFd);
+      return IO_ERROR;
+   }
+   iStatus = Import_readEntries(psImporter, psDir, &psEntries, &ulCount);
+   (void) closedir(psDir);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   /* in order, so that each node is added at the end of its array */
+   if(ulCount > 1)
+      qsort(psEntries, ulCount, sizeof(struct entry),
+            Import_compareEntries);
+   for(i = 0; i < ulCount; i++) {
+      if(iStatus == SUCCESS)
+         iStatus = Node_new(psEntries[i].pcName, psJob->oNDir,
+                            !psEntries[i].bIsDir, psEntries[i].pvContents,
+                            psEntries[i].ulSize, &oNChild);
+      if(iStatus == SUCCESS && psEntries[i].bIsDir)
+         iStatus = Import_push(psImporter, psJob->pcPath,
+                               psEntries[i].pcName, oNChild);
+      /* contents are the node's from now on */
+      else if(iStatus == SUCCESS)
+         psEntries[i].pvContents = NULL;
+      free(psEntries[i].pcName);
+      free(psEntries[i].pvContents);
+   }
+   free(psEntries);
+   return iStatus;
+}
+
+/*
+  Scans the directories of psImporter's jobs, and those they find,
+  until there are none left, by any thread. Once a scan has failed,
+  the remaining jobs are dropped unscanned. Takes a void pointer so
+  that it can be run by pthread_create; returns NULL.
+*/
+static void *Import_work(void *pvImporter) {
+   struct importer *psImporter = pvImporter;
+   struct job *psJob;
+   int iStatus;
+
+   assert(psImporter != NULL);
+
+   (void) pthread_mutex_lock(&psImporter->sMutex);
+   for(;;) {
+      while(psImporter->psJobs == NULL && psImporter->ulPending > 0)
+         (void) pthread_cond_wait(&psImporter->sChanged,
+                                  &psImporter->sMutex);
+      if(psImporter->psJobs == NULL)
+         break;
+      psJob = psImporter->psJobs;
+      psImporter->psJobs = psJob->psNext;
+      iStatus = psImporter->iStatus;
+      (void) pthread_mutex_unlock(&psImporter->sMutex);
+
+      if(iStatus == SUCCESS)
+         iStatus = Import_scanDir(psImporter, psJob);
+      free(psJob->pcPath);
+      free(psJob);
+
+      (void) pthread_mutex_lock(&psImporter->sMutex);
+      if(iStatus != SUCCESS && psImporter->iStatus == SUCCESS) {
+         psImporter->iStatus = iStatus;
+         psImporter->iErrno = errno;
+      }
+      /* the last job wakes everyone up to leave */
+      if(--psImporter->ulPending == 0)
+         (void) pthread_cond_broadcast(&psImporter->sChanged);
+   }
+   (void) pthread_mutex_unlock(&psImporter->sMutex);
+   return NULL;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Import_scan(const char *pcFsPath, const char *pcName, size_t ulThreads,
+                boolean bContents, Node_T *poNResult) {
+   struct importer sImporter;
+   pthread_t *psThreads;
+   Node_T oNRoot;
+   size_t ulStarted = 0;
+   size_t i;
+   int iStatus;
+
+   assert(pcFsPath != NULL);
+   assert(pcName != NULL);
+   assert(poNResult != NULL);
+
+   *poNResult = NULL;
+   if(ulThreads == 0)
+      ulThreads = 1;
+   iStatus = Node_new(pcName, NULL, FALSE, NULL, 0, &oNRoot);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   *poNResult = oNRoot;
+
+   sImporter.psJobs = NULL;
+   sImporter.ulPending = 0;
+   sImporter.bContents = bContents;
+   sImporter.iStatus = SUCCESS;
+   sImporter.iErrno = 0;
+   if(pthread_mutex_init(&sImporter.sMutex, NULL) != 0)
+      return MEMORY_ERROR;
+   if(pthread_cond_init(&sImporter.sChanged, NULL) != 0) {
+      (void) pthread_mutex_destroy(&sImporter.sMutex);
+      return MEMORY_ERROR;
+   }
+   iStatus = Import_push(&sImporter, pcFsPath, "", oNRoot);
+
+   /* the caller's thread is one of the workers, and makes do with
+      fewer helpers if not all can be started */
+   psThreads = calloc(ulThreads, sizeof(pthread_t));
+   if(iStatus == SUCCESS && psThreads != NULL)
+      for(ulStarted = 0; ulStarted < ulThreads - 1; ulStarted++)
+         if(pthread_create(&psThreads[ulStarted], NULL, Import_work,
+                           &sImporter) != 0)
+            break;
+   (void) Import_work(&sImporter);
+   for(i = 0; i < ulStarted; i++)
+      (void) pthread_join(psThreads[i], NULL);
+   free(psThreads);
+
+   if(iStatus == SUCCESS)
+      iStatus = sImporter.iStatus;
+   (void) pthread_cond_destroy(&sImporter.sChanged);
+   (void) pthread_mutex_destroy(&sImporter.sMutex);
+   errno = sImporter.iErrno;
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Frees the contents of oNNode if it is a file, and those of the files
+   below it otherwise. Takes a void pointer so that it can be handed
+   to Node_mapChildren. */
+static void Import_freeContents(Node_T oNNode, void *pvUnused) {
+   assert(oNNode != NULL);
+
+   if(Node_isFileNode(oNNode))
+      free(Node_getFileContent(oNNode));
+   else {
+      Node_mapChildren(oNNode, TRUE, Import_freeContents, pvUnused);
+      Node_mapChildren(oNNode, FALSE, Import_freeContents, pvUnused);
+   }
+}
+
+void Import_free(Node_T oNNode) {
+   if(oNNode == NULL)
+      return;
+
+   Import_freeContents(oNNode, NULL);
+   Node_release(oNNode, NULL);
+}
@@ -0,0 +1,38 @@
+/*--------------------------------------------------------------------*/
+/* import.h                                                           */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef IMPORT_INCLUDED
+#define IMPORT_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+#include "nodeFT.h"
+
+/*
+  Scans the directory pcFsPath of the local file system and everything
+  below it into a new directory node named pcName, linked nowhere, and
+  sets *poNResult to it. ulThreads threads, counting the caller's,
+  scan directories at once, each building the nodes of the directories
+  it scans independently of the others. Regular files become files:
+  with their contents, read into memory allocated for each, if
+  bContents is TRUE, or else with NULL contents and their size.
+  Directories are followed; symbolic links and other special files are
+  skipped. Returns SUCCESS, or:
+  * IO_ERROR (from ft.h) if a directory or file could not be read, in
+             which case errno tells why
+  * MEMORY_ERROR if memory could not be allocated to complete request
+  in which case *poNResult is set to what was built so far, or NULL,
+  for the caller to free with Import_free.
+*/
+int Import_scan(const char *pcFsPath, const char *pcName, size_t ulThreads,
+                boolean bContents, Node_T *poNResult);
+
+/*
+  Frees the subtree rooted at oNNode, made by Import_scan, along with
+  any contents it read into its files. Does nothing if oNNode is NULL.
+*/
+void Import_free(Node_T oNNode);
+
+#endif
@@ -0,0 +1,300 @@
+/*--------------------------------------------------------------------*/
+/* lz.c                                                               */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#include <string.h>
+#include <assert.h>
+#include "lz.h"
+
+/*
+  The coded bytes are a sequence of runs, each a token byte, whose top
+  4 bits are the number of literals and bottom 4 the length of the
+  copy less MIN_MATCH, either 15 meaning more follows in bytes of
+  255 until one less; then the literals; then, unless the run ends
+  the contents, the distance back to copy from in 2 bytes, least
+  significant first, and the rest of the copy's length.
+*/
+
+/* The shortest copy coded, and the farthest back one reaches */
+enum { MIN_MATCH = 4, MAX_OFFSET = 65535 };
+
+/* The value of a length nibble meaning more follows */
+enum { MORE = 15 };
+
+/* The number of bits of the table of positions, indexed by a hash of
+   the 4 bytes there */
+enum { TABLE_BITS = 12, TABLE_SIZE = 1 << TABLE_BITS };
+
+/* Runs this short are copied as one fixed-size block where there is
+   room past them, which is faster than copying their exact length */
+enum { SHORT_COPY = 16 };
+
+/* After every 2^SKIP_SHIFT positions without a match, the search
+   steps one byte further, so that incompressible bytes pass quickly */
+enum { SKIP_SHIFT = 6 };
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the 4 bytes at pucBytes as a number, least significant
+   first. */
+static unsigned long Lz_read4(const unsigned char *pucBytes) {
+   return (unsigned long) pucBytes[0] |
+          (unsigned long) pucBytes[1] << 8 |
+          (unsigned long) pucBytes[2] << 16 |
+          (unsigned long) pucBytes[3] << 24;
+}
+
+/* Returns the index in the table of positions of the 4 bytes
+   ulFour. */
+static size_t Lz_hash(unsigned long ulFour) {
+   return (size_t) (((ulFour * 2654435761UL) & 0xFFFFFFFFUL) >>
+                    (32 - TABLE_BITS));
+}
+
+/* Returns the number of bytes, up to ulMost, that pucA and pucB agree
+   in from the start, comparing a word at a time. */
+static size_t Lz_agree(const unsigned char *pucA,
+                       const unsigned char *pucB, size_t ulMost) {
+   enum { WORD = sizeof(unsigned long) };
+   unsigned long ulA, ulB;
+   size_t i = 0;
+
+   for(; ulMost - i >= WORD; i += WORD) {
+      memcpy(&ulA, pucA + i, WORD);
+      memcpy(&ulB, pucB + i, WORD);
+      if(ulA != ulB)
+         break;
+   }
+   while(i < ulMost && pucA[i] == pucB[i])
+      i++;
+   return i;
+}
+
+/* Writes the rest of a length ulLength, which its nibble counted
+   MORE of, to pucDest at *pulOut, advancing it. The caller has made
+   room. */
+static void Lz_putLength(unsigned char *pucDest, size_t *pulOut,
+                         size_t ulLength) {
+   ulLength -= MORE;
+   while(ulLength >= 255) {
+      pucDest[(*pulOut)++] = 255;
+      ulLength -= 255;
+   }
+   pucDest[(*pulOut)++] = (unsigned char) ulLength;
+}
+
+/*
+  Writes a run of the ulLiterals bytes pucLiterals, followed by a copy
+  of ulMatch bytes from ulOffset back unless ulMatch is 0, to pucDest
+  at *pulOut, advancing it. Returns FALSE if that would pass
+  ulCapacity.
+*/
+static boolean Lz_putRun(unsigned char *pucDest, size_t ulCapacity,
+                         size_t *pulOut,
+                         const unsigned char *pucLiterals,
+                         size_t ulLiterals, size_t ulOffset,
+                         size_t ulMatch) {
+   size_t ulNeed;
+
+   assert(pucDest != NULL);
+   assert(pulOut != NULL);
+
+   /* the token, the literals with their length, and the copy */
+   ulNeed = 1 + ulLiterals + ulLiterals / 255 + 1;
+   if(ulMatch > 0)
+      ulNeed += 2 + ulMatch / 255 + 1;
+   if(ulNeed > ulCapacity - *pulOut)
+      return FALSE;
+
+   pucDest[*pulOut] = (unsigned char)
+      ((ulLiterals < MORE ? ulLiterals : MORE) << 4);
+   if(ulMatch > 0)
+      pucDest[*pulOut] |= (unsigned char)
+         (ulMatch - MIN_MATCH < MORE ? ulMatch - MIN_MATCH : MORE);
+   (*pulOut)++;
+   if(ulLiterals >= MORE)
+      Lz_putLength(pucDest, pulOut, ulLiterals);
+   memcpy(pucDest + *pulOut, pucLiterals, ulLiterals);
+   *pulOut += ulLiterals;
+   if(ulMatch == 0)
+      return TRUE;
+   pucDest[(*pulOut)++] = (unsigned char) (ulOffset & 0xFF);
+   pucDest[(*pulOut)++] = (unsigned char) (ulOffset >> 8);
+   if(ulMatch - MIN_MATCH >= MORE)
+      Lz_putLength(pucDest, pulOut, ulMatch - MIN_MATCH);
+   return TRUE;
+}
+
+/*
+  Copies the ulCount bytes pucSrc to pucDest, where neither overlaps
+  the other within ulRoom bytes, which are valid at both, and may be
+  overwritten at pucDest.
+*/
+static void Lz_copy(unsigned char *pucDest, const unsigned char *pucSrc,
+                    size_t ulCount, size_t ulRoom) {
+   if(ulCount <= SHORT_COPY && ulRoom >= SHORT_COPY)
+      memcpy(pucDest, pucSrc, SHORT_COPY);
+   else
+      memcpy(pucDest, pucSrc, ulCount);
+}
+
+/*
+  Reads the rest of a length whose nibble was MORE from the ulPacked
+  bytes pucPacked at *pulIn, advancing it, and adds it to *pulLength.
+  Returns FALSE if the bytes end first or the length overflows.
+*/
+static boolean Lz_getLength(const unsigned char *pucPacked,
+                            size_t ulPacked, size_t *pulIn,
+                            size_t *pulLength) {
+   unsigned char ucByte;
+
+   do {
+      if(*pulIn >= ulPacked)
+         return FALSE;
+      ucByte = pucPacked[(*pulIn)++];
+      if(*pulLength > (size_t) -1 - ucByte)
+         return FALSE;
+      *pulLength += ucByte;
+   } while(ucByte == 255);
+   return TRUE;
+}
+
+/*
+  Decodes the ulPacked bytes pucPacked, which must come to ulLength
+  bytes: writes them to pucDest, or if pucCompare is not NULL,
+  compares them with pucCompare instead, whose bytes up to any point
+  are then also what was decoded up to it. Returns TRUE if the bytes
+  decode to exactly ulLength bytes, and those are pucCompare's.
+*/
+static boolean Lz_decode(const unsigned char *pucPacked, size_t ulPacked,
+                         unsigned char *pucDest,
+                         const unsigned char *pucCompare,
+                         size_t ulLength) {
+   size_t ulIn = 0, ulOut = 0;
+   size_t ulLiterals, ulMatch, ulOffset, ulRoom, ulDone, ulTake;
+   unsigned char ucToken;
+
+   assert(pucPacked != NULL || ulPacked == 0);
+
+   for(;;) {
+      if(ulIn >= ulPacked)
+         return FALSE;
+      ucToken = pucPacked[ulIn++];
+
+      ulLiterals = ucToken >> 4;
+      if(ulLiterals == MORE &&
+         !Lz_getLength(pucPacked, ulPacked, &ulIn, &ulLiterals))
+         return FALSE;
+      if(ulLiterals > ulPacked - ulIn || ulLiterals > ulLength - ulOut)
+         return FALSE;
+      if(pucCompare != NULL) {
+         if(memcmp(pucCompare + ulOut, pucPacked + ulIn,
+                   ulLiterals) != 0)
+            return FALSE;
+      }
+      else {
+         ulRoom = ulPacked - ulIn < ulLength - ulOut ?
+                  ulPacked - ulIn : ulLength - ulOut;
+         Lz_copy(pucDest + ulOut, pucPacked + ulIn, ulLiterals, ulRoom);
+      }
+      ulIn += ulLiterals;
+      ulOut += ulLiterals;
+      /* the last run has no copy */
+      if(ulOut == ulLength)
+         return ulIn == ulPacked;
+
+      if(ulPacked - ulIn < 2)
+         return FALSE;
+      ulOffset = (size_t) pucPacked[ulIn] |
+                 (size_t) pucPacked[ulIn + 1] << 8;
+      ulIn += 2;
+      ulMatch = ucToken & MORE;
+      if(ulMatch == MORE &&
+         !Lz_getLength(pucPacked, ulPacked, &ulIn, &ulMatch))
+         return FALSE;
+      ulMatch += MIN_MATCH;
+      if(ulOffset == 0 || ulOffset > ulOut ||
+         ulMatch > ulLength - ulOut)
+         return FALSE;
+
+      if(pucCompare != NULL) {
+         if(Lz_agree(pucCompare + ulOut, pucCompare + ulOut - ulOffset,
+                     ulMatch) != ulMatch)
+            return FALSE;
+      }
+      else if(ulOffset >= ulMatch)
+         Lz_copy(pucDest + ulOut, pucDest + ulOut - ulOffset, ulMatch,
+                 ulOffset < ulLength - ulOut ? ulOffset
+                                              : ulLength - ulOut);
+      else
+         /* the copy overlaps what it makes, repeating a pattern of
+            ulOffset bytes, so copy the pattern, and then what is made
+            so far, which repeats it too, doubling each time */
+         for(ulDone = 0; ulDone < ulMatch; ulDone += ulTake) {
+            ulTake = ulOffset + ulDone < ulMatch - ulDone ?
+                     ulOffset + ulDone : ulMatch - ulDone;
+            memcpy(pucDest + ulOut + ulDone, pucDest + ulOut - ulOffset,
+                   ulTake);
+         }
+      ulOut += ulMatch;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t Lz_compress(const void *pvSrc, size_t ulLength, void *pvDest,
+                   size_t ulCapacity) {
+   const unsigned char *pucSrc = pvSrc;
+   unsigned char *pucDest = pvDest;
+   /* each position, plus 1 so that 0 means none */
+   size_t aulTable[TABLE_SIZE];
+   size_t ulIn = 0, ulAnchor = 0, ulOut = 0;
+   size_t ulHash, ulCandidate, ulMatch;
+   unsigned long ulFour;
+
+   assert(pvSrc != NULL || ulLength == 0);
+   assert(pvDest != NULL || ulCapacity == 0);
+
+   memset(aulTable, 0, sizeof(aulTable));
+   /* the search may step past the end */
+   while(ulIn < ulLength && ulLength - ulIn >= MIN_MATCH) {
+      ulFour = Lz_read4(pucSrc + ulIn);
+      ulHash = Lz_hash(ulFour);
+      ulCandidate = aulTable[ulHash];
+      aulTable[ulHash] = ulIn + 1;
+      if(ulCandidate == 0 || ulIn - (ulCandidate - 1) > MAX_OFFSET ||
+         Lz_read4(pucSrc + ulCandidate - 1) != ulFour) {
+         ulIn += 1 + ((ulIn - ulAnchor) >> SKIP_SHIFT);
+         continue;
+      }
+      ulCandidate--;
+      ulMatch = MIN_MATCH +
+                Lz_agree(pucSrc + ulCandidate + MIN_MATCH,
+                         pucSrc + ulIn + MIN_MATCH,
+                         ulLength - ulIn - MIN_MATCH);
+      if(!Lz_putRun(pucDest, ulCapacity, &ulOut, pucSrc + ulAnchor,
+                    ulIn - ulAnchor, ulIn - ulCandidate, ulMatch))
+         return 0;
+      ulIn += ulMatch;
+      ulAnchor = ulIn;
+   }
+   if(!Lz_putRun(pucDest, ulCapacity, &ulOut, pucSrc + ulAnchor,
+                 ulLength - ulAnchor, 0, 0))
+      return 0;
+   return ulOut;
+}
+
+boolean Lz_decompress(const void *pvPacked, size_t ulPacked,
+                      void *pvDest, size_t ulLength) {
+   assert(pvDest != NULL || ulLength == 0);
+
+   return Lz_decode(pvPacked, ulPacked, pvDest, NULL, ulLength);
+}
+
+boolean Lz_equals(const void *pvPacked, size_t ulPacked,
+                  const void *pvBytes, size_t ulLength) {
+   assert(pvBytes != NULL || ulLength == 0);
+
+   return Lz_decode(pvPacked, ulPacked, NULL, pvBytes, ulLength);
+}
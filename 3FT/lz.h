@@ -0,0 +1,48 @@
+/*--------------------------------------------------------------------*/
+/* lz.h                                                               */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef LZ_INCLUDED
+#define LZ_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A fast compressor of the LZ77 family, in the manner of LZ4: the
+  bytes are coded as runs of literals, each followed by a copy of at
+  least 4 bytes from at most 64 KiB before, found through a table of
+  where each 4 bytes were last seen. It trades ratio for speed: text
+  and tables shrink by a third to a half or more, at well over 100
+  MB/s, and decompress several times faster still, while bytes that
+  do not compress pass at memory speed. Compressed bytes are only
+  meaningful with the length of what they were compressed from.
+*/
+
+/*
+  Compresses the ulLength bytes pvSrc into pvDest, which has room for
+  ulCapacity bytes. Returns the number of bytes written, or 0 if they
+  would not fit.
+*/
+size_t Lz_compress(const void *pvSrc, size_t ulLength, void *pvDest,
+                   size_t ulCapacity);
+
+/*
+  Decompresses the ulPacked bytes pvPacked into pvDest, which has room
+  for ulLength bytes, the length they were compressed from. Returns
+  TRUE if they decompress to exactly that many, or FALSE if they are
+  damaged, without writing past pvDest's room either way.
+*/
+boolean Lz_decompress(const void *pvPacked, size_t ulPacked,
+                      void *pvDest, size_t ulLength);
+
+/*
+  Returns TRUE if the ulPacked bytes pvPacked decompress to the
+  ulLength bytes pvBytes, which is found while decoding, comparing
+  rather than writing, so that nothing is allocated.
+*/
+boolean Lz_equals(const void *pvPacked, size_t ulPacked,
+                  const void *pvBytes, size_t ulLength);
+
+#endif
@@ -0,0 +1,365 @@
+/*--------------------------------------------------------------------*/
+/* nameindex.c                                                        */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "nameindex.h"
+
+/* The number of buckets a new index starts with */
+enum { INITIAL_BUCKETS = 64 };
+
+/*
+  A path in an index. Each entry is in two chains: that of the bucket
+  its path hashes to, and that of the bucket its name hashes to, so
+  every entry with the same name is in the same name chain.
+*/
+struct entry {
+   /* the path, stored right after the entry */
+   char *pcPath;
+   /* its last component, within pcPath */
+   const char *pcName;
+   /* TRUE if the path is a file's */
+   boolean bIsFile;
+   /* the hashes of pcPath and pcName */
+   unsigned long ulPathHash;
+   unsigned long ulNameHash;
+   /* the next entry in the chain of its path's bucket */
+   struct entry *psNextByPath;
+   /* the entries around it in the chain of its name's bucket, which
+      is doubly linked so that it can be unlinked from there without
+      a search */
+   struct entry *psPrevByName;
+   struct entry *psNextByName;
+};
+
+/* A set of paths indexed by name */
+struct nameIndex {
+   /* the chains by path and by name, ulBuckets of each */
+   struct entry **ppsByPath;
+   struct entry **ppsByName;
+   size_t ulBuckets;
+   /* the number of entries */
+   size_t ulCount;
+   /* the bytes allocated for the entries and their paths */
+   size_t ulEntryBytes;
+   /* FALSE once the index has given up */
+   boolean bComplete;
+   /* held shared by NameIndex_map and exclusively by changes */
+   pthread_rwlock_t sLock;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the hash of the first ulLength characters of pc. */
+static unsigned long NameIndex_hash(const char *pc, size_t ulLength) {
+   unsigned long ulHash = 5381;
+
+   assert(pc != NULL);
+
+   while(ulLength-- > 0)
+      ulHash = ulHash * 33 + (unsigned char) *pc++;
+   return ulHash;
+}
+
+/* Returns the last component of the path pcPath. */
+static const char *NameIndex_lastComponent(const char *pcPath) {
+   const char *pcSlash;
+
+   assert(pcPath != NULL);
+
+   pcSlash = strrchr(pcPath, '/');
+   return (pcSlash == NULL) ? pcPath : pcSlash + 1;
+}
+
+/* Frees every entry of oNIndex and empties its chains. */
+static void NameIndex_clear(NameIndex_T oNIndex) {
+   struct entry *psEntry;
+   struct entry *psNext;
+   size_t i;
+
+   assert(oNIndex != NULL);
+
+   for(i = 0; i < oNIndex->ulBuckets; i++) {
+      for(psEntry = oNIndex->ppsByPath[i]; psEntry != NULL;
+          psEntry = psNext) {
+         psNext = psEntry->psNextByPath;
+         free(psEntry);
+      }
+      oNIndex->ppsByPath[i] = NULL;
+      oNIndex->ppsByName[i] = NULL;
+   }
+   oNIndex->ulCount = 0;
+   oNIndex->ulEntryBytes = 0;
+}
+
+/*
+  Gives up on oNIndex: frees every entry and ignores later changes.
+  The caller holds oNIndex's lock exclusively.
+*/
+static void NameIndex_giveUp(NameIndex_T oNIndex) {
+   assert(oNIndex != NULL);
+
+   NameIndex_clear(oNIndex);
+   oNIndex->bComplete = FALSE;
+}
+
+/* Links psEntry into the chains of oNIndex that it hashes to. */
+static void NameIndex_link(NameIndex_T oNIndex, struct entry *psEntry) {
+   size_t ulPathBucket, ulNameBucket;
+
+   assert(oNIndex != NULL);
+   assert(psEntry != NULL);
+
+   ulPathBucket = psEntry->ulPathHash % oNIndex->ulBuckets;
+   psEntry->psNextByPath = oNIndex->ppsByPath[ulPathBucket];
+   oNIndex->ppsByPath[ulPathBucket] = psEntry;
+
+   ulNameBucket = psEntry->ulNameHash % oNIndex->ulBuckets;
+   psEntry->psPrevByName = NULL;
+   psEntry->psNextByName = oNIndex->ppsByName[ulNameBucket];
+   if(psEntry->psNextByName != NULL)
+      psEntry->psNextByName->psPrevByName = psEntry;
+   oNIndex->ppsByName[ulNameBucket] = psEntry;
+}
+
+/*
+  Doubles the number of buckets of oNIndex and relinks every entry.
+  Returns SUCCESS, or MEMORY_ERROR, in which case nothing changed.
+*/
+static int NameIndex_grow(NameIndex_T oNIndex) {
+   struct entry **ppsOldByPath;
+   struct entry **ppsNewByPath;
+   struct entry **ppsNewByName;
+   struct entry *psEntry;
+   struct entry *psNext;
+   size_t ulOldBuckets;
+   size_t i;
+
+   assert(oNIndex != NULL);
+
+   ppsNewByPath = calloc(2 * oNIndex->ulBuckets, sizeof(struct entry *));
+   ppsNewByName = calloc(2 * oNIndex->ulBuckets, sizeof(struct entry *));
+   if(ppsNewByPath == NULL || ppsNewByName == NULL) {
+      free(ppsNewByPath);
+      free(ppsNewByName);
+      return MEMORY_ERROR;
+   }
+
+   ppsOldByPath = oNIndex->ppsByPath;
+   ulOldBuckets = oNIndex->ulBuckets;
+   free(oNIndex->ppsByName);
+   oNIndex->ppsByPath = ppsNewByPath;
+   oNIndex->ppsByName = ppsNewByName;
+   oNIndex->ulBuckets *= 2;
+   for(i = 0; i < ulOldBuckets; i++)
+      for(psEntry = ppsOldByPath[i]; psEntry != NULL; psEntry = psNext) {
+         psNext = psEntry->psNextByPath;
+         NameIndex_link(oNIndex, psEntry);
+      }
+   free(ppsOldByPath);
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int NameIndex_new(NameIndex_T *poNResult) {
+   NameIndex_T oNIndex;
+
+   assert(poNResult != NULL);
+
+   *poNResult = NULL;
+   oNIndex = malloc(sizeof(struct nameIndex));
+   if(oNIndex == NULL)
+      return MEMORY_ERROR;
+   oNIndex->ulBuckets = INITIAL_BUCKETS;
+   oNIndex->ppsByPath = calloc(oNIndex->ulBuckets, sizeof(struct entry *));
+   oNIndex->ppsByName = calloc(oNIndex->ulBuckets, sizeof(struct entry *));
+   if(oNIndex->ppsByPath == NULL || oNIndex->ppsByName == NULL ||
+      pthread_rwlock_init(&oNIndex->sLock, NULL) != 0) {
+      free(oNIndex->ppsByPath);
+      free(oNIndex->ppsByName);
+      free(oNIndex);
+      return MEMORY_ERROR;
+   }
+   oNIndex->ulCount = 0;
+   oNIndex->ulEntryBytes = 0;
+   oNIndex->bComplete = TRUE;
+
+   *poNResult = oNIndex;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void NameIndex_free(NameIndex_T oNIndex) {
+   if(oNIndex == NULL)
+      return;
+
+   NameIndex_clear(oNIndex);
+   (void) pthread_rwlock_destroy(&oNIndex->sLock);
+   free(oNIndex->ppsByPath);
+   free(oNIndex->ppsByName);
+   free(oNIndex);
+}
+
+/*--------------------------------------------------------------------*/
+
+void NameIndex_add(NameIndex_T oNIndex, const char *pcPath,
+                   boolean bIsFile) {
+   struct entry *psEntry;
+   size_t ulLength;
+   size_t ulBytes;
+
+   assert(oNIndex != NULL);
+   assert(pcPath != NULL);
+
+   (void) pthread_rwlock_wrlock(&oNIndex->sLock);
+   if(!oNIndex->bComplete) {
+      (void) pthread_rwlock_unlock(&oNIndex->sLock);
+      return;
+   }
+
+   /* keep the chains about one entry long */
+   if(oNIndex->ulCount >= oNIndex->ulBuckets &&
+      NameIndex_grow(oNIndex) != SUCCESS) {
+      NameIndex_giveUp(oNIndex);
+      (void) pthread_rwlock_unlock(&oNIndex->sLock);
+      return;
+   }
+
+   ulLength = strlen(pcPath);
+   ulBytes = sizeof(struct entry) + ulLength + 1;
+   psEntry = malloc(ulBytes);
+   if(psEntry == NULL) {
+      NameIndex_giveUp(oNIndex);
+      (void) pthread_rwlock_unlock(&oNIndex->sLock);
+      return;
+   }
+   psEntry->pcPath = (char *) (psEntry + 1);
+   memcpy(psEntry->pcPath, pcPath, ulLength + 1);
+   psEntry->pcName = NameIndex_lastComponent(psEntry->pcPath);
+   psEntry->bIsFile = bIsFile;
+   psEntry->ulPathHash = NameIndex_hash(pcPath, ulLength);
+   psEntry->ulNameHash = NameIndex_hash(psEntry->pcName,
+                                        strlen(psEntry->pcName));
+   NameIndex_link(oNIndex, psEntry);
+   oNIndex->ulCount++;
+   oNIndex->ulEntryBytes += ulBytes;
+
+   (void) pthread_rwlock_unlock(&oNIndex->sLock);
+}
+
+/*--------------------------------------------------------------------*/
+
+void NameIndex_remove(NameIndex_T oNIndex, const char *pcPath) {
+   struct entry **ppsLink;
+   struct entry *psEntry;
+   unsigned long ulPathHash;
+   size_t ulLength;
+
+   assert(oNIndex != NULL);
+   assert(pcPath != NULL);
+
+   ulLength = strlen(pcPath);
+   ulPathHash = NameIndex_hash(pcPath, ulLength);
+
+   (void) pthread_rwlock_wrlock(&oNIndex->sLock);
+   ppsLink = &oNIndex->ppsByPath[ulPathHash % oNIndex->ulBuckets];
+   for(psEntry = *ppsLink; psEntry != NULL; psEntry = *ppsLink) {
+      if(psEntry->ulPathHash == ulPathHash &&
+         !strcmp(psEntry->pcPath, pcPath))
+         break;
+      ppsLink = &psEntry->psNextByPath;
+   }
+   if(psEntry == NULL) {
+      (void) pthread_rwlock_unlock(&oNIndex->sLock);
+      return;
+   }
+
+   *ppsLink = psEntry->psNextByPath;
+   if(psEntry->psPrevByName != NULL)
+      psEntry->psPrevByName->psNextByName = psEntry->psNextByName;
+   else
+      oNIndex->ppsByName[psEntry->ulNameHash % oNIndex->ulBuckets] =
+         psEntry->psNextByName;
+   if(psEntry->psNextByName != NULL)
+      psEntry->psNextByName->psPrevByName = psEntry->psPrevByName;
+   oNIndex->ulCount--;
+   oNIndex->ulEntryBytes -= sizeof(struct entry) + ulLength + 1;
+   free(psEntry);
+
+   (void) pthread_rwlock_unlock(&oNIndex->sLock);
+}
+
+/*--------------------------------------------------------------------*/
+
+void NameIndex_abandon(NameIndex_T oNIndex) {
+   assert(oNIndex != NULL);
+
+   (void) pthread_rwlock_wrlock(&oNIndex->sLock);
+   NameIndex_giveUp(oNIndex);
+   (void) pthread_rwlock_unlock(&oNIndex->sLock);
+}
+
+/*--------------------------------------------------------------------*/
+
+boolean NameIndex_map(NameIndex_T oNIndex, const char *pcName,
+                      void (*pfApply)(const char *pcPath,
+                                      boolean bIsFile, void *pvExtra),
+                      void *pvExtra) {
+   struct entry *psEntry;
+   unsigned long ulNameHash;
+
+   assert(oNIndex != NULL);
+   assert(pcName != NULL);
+   assert(pfApply != NULL);
+
+   ulNameHash = NameIndex_hash(pcName, strlen(pcName));
+
+   (void) pthread_rwlock_rdlock(&oNIndex->sLock);
+   if(!oNIndex->bComplete) {
+      (void) pthread_rwlock_unlock(&oNIndex->sLock);
+      return FALSE;
+   }
+   for(psEntry = oNIndex->ppsByName[ulNameHash % oNIndex->ulBuckets];
+       psEntry != NULL; psEntry = psEntry->psNextByName)
+      if(psEntry->ulNameHash == ulNameHash &&
+         !strcmp(psEntry->pcName, pcName))
+         (*pfApply)(psEntry->pcPath, psEntry->bIsFile, pvExtra);
+   (void) pthread_rwlock_unlock(&oNIndex->sLock);
+   return TRUE;
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t NameIndex_getCount(NameIndex_T oNIndex) {
+   size_t ulCount;
+
+   assert(oNIndex != NULL);
+
+   (void) pthread_rwlock_rdlock(&oNIndex->sLock);
+   ulCount = oNIndex->ulCount;
+   (void) pthread_rwlock_unlock(&oNIndex->sLock);
+   return ulCount;
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t NameIndex_getSize(NameIndex_T oNIndex) {
+   size_t ulSize;
+
+   assert(oNIndex != NULL);
+
+   (void) pthread_rwlock_rdlock(&oNIndex->sLock);
+   ulSize = sizeof(struct nameIndex) +
+            2 * oNIndex->ulBuckets * sizeof(struct entry *) +
+            oNIndex->ulEntryBytes;
+   (void) pthread_rwlock_unlock(&oNIndex->sLock);
+   return ulSize;
+}
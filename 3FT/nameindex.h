@@ -0,0 +1,67 @@
+/*--------------------------------------------------------------------*/
+/* nameindex.h                                                        */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef NAMEINDEX_INCLUDED
+#define NAMEINDEX_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A NameIndex_T is a set of absolute paths, each a file or a
+  directory, indexed by its last component, so that every path ending
+  in a given name is found without looking at the others. Paths are
+  added and removed one at a time, each in constant expected time.
+
+  An index that once fails to allocate memory gives up: it forgets
+  every path, ignores those added or removed later, and reports
+  itself incomplete, so that it is never wrong, only absent.
+
+  The functions may be called concurrently from multiple threads.
+*/
+typedef struct nameIndex *NameIndex_T;
+
+/*
+  Creates a new, empty index. Returns SUCCESS and sets *poNResult to
+  the new index if successful. Otherwise, sets *poNResult to NULL and
+  returns MEMORY_ERROR.
+*/
+int NameIndex_new(NameIndex_T *poNResult);
+
+/* Frees oNIndex. Does nothing if oNIndex is NULL. */
+void NameIndex_free(NameIndex_T oNIndex);
+
+/*
+  Adds pcPath, a file if bIsFile is TRUE or a directory otherwise, to
+  oNIndex, which must not hold it yet. Gives up on the index if memory
+  could not be allocated.
+*/
+void NameIndex_add(NameIndex_T oNIndex, const char *pcPath,
+                   boolean bIsFile);
+
+/* Removes pcPath from oNIndex. Does nothing if oNIndex lacks it. */
+void NameIndex_remove(NameIndex_T oNIndex, const char *pcPath);
+
+/* Gives up on oNIndex, as if memory had run out. */
+void NameIndex_abandon(NameIndex_T oNIndex);
+
+/*
+  Calls (*pfApply)(pcPath, bIsFile, pvExtra) for each path in oNIndex
+  whose last component is pcName, in no particular order, and returns
+  TRUE, or returns FALSE without calling it at all if oNIndex has
+  given up. pfApply must not change oNIndex.
+*/
+boolean NameIndex_map(NameIndex_T oNIndex, const char *pcName,
+                      void (*pfApply)(const char *pcPath,
+                                      boolean bIsFile, void *pvExtra),
+                      void *pvExtra);
+
+/* Returns the number of paths in oNIndex. */
+size_t NameIndex_getCount(NameIndex_T oNIndex);
+
+/* Returns the number of bytes oNIndex has allocated. */
+size_t NameIndex_getSize(NameIndex_T oNIndex);
+
+#endif
@@ -3,24 +3,61 @@
 /* Author: Isaac Gyamfi and Ndongo Njie                               */
 /*--------------------------------------------------------------------*/
 
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include "dynarray.h"
+#include "epoch.h"
+#include "image.h"
+#include "chunkstore.h"
+#include "send.h"
 #include "nodeFT.h"
 
 
+/* A reference-counted array of a node's children, which copies of
+   the node may share */
+struct children {
+   /* the children, ordered by path */
+   DynArray_T oDNodes;
+   /* the number of nodes using the array */
+   size_t ulRefs;
+};
+
+/* A reference-counted buffer holding the contents of a file that the
+   FT owns rather than the client, which copies of the node may share.
+   The bytes follow it in the same allocation, unless they lie in a
+   mapping of a file instead. */
+struct buffer {
+   /* the number of nodes using the buffer */
+   size_t ulRefs;
+   /* the number of bytes there is room for, 0 for a mapping */
+   size_t ulCapacity;
+   /* the read-only mapping the bytes lie in, unmapped along with the
+      buffer, and its length, or NULL */
+   void *pvMap;
+   size_t ulMapLength;
+};
+
+/* The least room a buffer is made with when a file grows */
+enum { MIN_BUFFER = 64 };
+
 /* A node in an FT */
 struct node {
-   /* the object corresponding to the node's absolute path */
-   Path_T oPPath;
-   /* this node's parent */
-   Node_T oNParent;
+   /* the last component of the node's absolute path; the rest is
+      implied by where the node is linked, so moving it renames
+      everything below it too */
+   char *pcName;
+   /* the number of child arrays and trees linking to this node */
+   size_t ulRefs;
    /* the object containing links to this node's directory children */
-   DynArray_T oDirChildren;
+   struct children *psDirChildren;
 
    /* the object containing links to this node's file children */
-   DynArray_T oFileChildren;
+   struct children *psFileChildren;
 
    /* The pointer to the content of a file node*/
    void *content;
@@ -28,15 +65,34 @@ struct node {
    /* The size of the content of a file node*/
    size_t ulength;
 
+   /* the buffer content lies in if the FT owns it, or NULL if the
+      client (or an image or a log) does */
+   struct buffer *psBuffer;
+
+   /* the chunks of a store that hold the contents instead, in which
+      case content is NULL, or NULL */
+   ChunkList_T oChunks;
+
    /* The type of Node*/
    boolean isFileNode;
 
+   /* the image the node was read from, or NULL; a directory from an
+      image has NULL for either record of children it has not read
+      from the image's record ulRecord yet, and a file from one has
+      contents within the image's mapping */
+   Image_T oImage;
+   Image_Offset ulRecord;
+
+   /* The latch guarding this node's fields and child arrays in a
+      fine-grained File Tree */
+   pthread_rwlock_t sLatch;
+
 };
 
 /*--------------------------------------------------------------------*/
 /*
-  Compares the string representation of oNfirst with a string
-  pcSecond representing a node's path.
+  Compares the name of oNfirst with a string pcSecond representing a
+  node's name.
   Returns <0, 0, or >0 if oNFirst is "less than", "equal to", or
   "greater than" pcSecond, respectively.
 */
@@ -45,65 +101,313 @@ static int Node_compareString(const Node_T oNFirst,
    assert(oNFirst != NULL);
    assert(pcSecond != NULL);
 
-   return Path_compareString(oNFirst->oPPath, pcSecond);
+   return strcmp(oNFirst->pcName, pcSecond);
+}
+
+/*--------------------------------------------------------------------*/
+/* Returns a copy of the name pcName, or NULL if there is an
+   allocation error. */
+static char *Node_dupName(const char *pcName) {
+   char *pcCopy;
+
+   assert(pcName != NULL);
+
+   pcCopy = malloc(strlen(pcName) + 1);
+   if(pcCopy == NULL)
+      return NULL;
+   return strcpy(pcCopy, pcName);
+}
+
+/*--------------------------------------------------------------------*/
+/* Drops a reference to the node pvNode, and frees it once the last
+   one is gone. Takes a void pointer so that it can be handed to
+   Epoch_retire. */
+static void Node_releaseNow(void *pvNode);
+
+/*--------------------------------------------------------------------*/
+/* The empty record of children handed out for a directory whose
+   children could not be read from its image for lack of memory, which
+   is never published, changed or freed; made by the first
+   Node_newFromImage under sUnreadableLock */
+static struct children *psUnreadable;
+static pthread_mutex_t sUnreadableLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*--------------------------------------------------------------------*/
+/*
+  Reads oNParent's record of file children if bIsFile is TRUE, or of
+  directory children otherwise, from its image, and publishes it
+  unless another thread got there first. Returns the published record,
+  or psUnreadable if there is an allocation error.
+*/
+static struct children *Node_readChildren(Node_T oNParent,
+                                          boolean bIsFile);
+
+/*--------------------------------------------------------------------*/
+/*
+  Returns oNParent's record of file children if bIsFile is TRUE, or of
+  directory children otherwise, as currently published, reading it
+  from oNParent's image first if need be.
+*/
+static struct children *Node_getChildren(Node_T oNParent,
+                                         boolean bIsFile) {
+    struct children *psChildren;
+
+    assert(oNParent != NULL);
+
+    if(bIsFile)
+        psChildren = __atomic_load_n(&oNParent->psFileChildren,
+                                     __ATOMIC_ACQUIRE);
+    else
+        psChildren = __atomic_load_n(&oNParent->psDirChildren,
+                                     __ATOMIC_ACQUIRE);
+    if(psChildren == NULL)
+        return Node_readChildren(oNParent, bIsFile);
+    return psChildren;
+}
+
+/*--------------------------------------------------------------------*/
+/* Returns the array of oNParent's file children if bIsFile is TRUE,
+   or of its directory children otherwise, as currently published. */
+static DynArray_T Node_loadChildren(Node_T oNParent, boolean bIsFile) {
+    return Node_getChildren(oNParent, bIsFile)->oDNodes;
+}
+
+/*--------------------------------------------------------------------*/
+/* Returns a new, empty record of children used by one node, or NULL
+   if there is an allocation error. */
+static struct children *Node_newChildren(void) {
+    struct children *psChildren;
+
+    psChildren = malloc(sizeof(struct children));
+    if(psChildren == NULL)
+        return NULL;
+    psChildren->oDNodes = DynArray_new(0);
+    if(psChildren->oDNodes == NULL) {
+        free(psChildren);
+        return NULL;
+    }
+    psChildren->ulRefs = 1;
+    return psChildren;
 }
 
 /*--------------------------------------------------------------------*/
 /*
-  Links new child oNChild into oNParent's children array at index
-  ulIndex. Returns SUCCESS if the new child was added successfully,
-  or  MEMORY_ERROR if allocation fails adding oNChild to the array.
+  Drops a reference to the record of children pvChildren. Once the
+  last one is gone, drops the record's reference to each child and
+  frees it. Takes a void pointer so that it can be handed to
+  Epoch_retire.
 */
-static int Node_addChild(Node_T oNParent, Node_T oNChild) {
+static void Node_dropChildren(void *pvChildren) {
+    struct children *psChildren = pvChildren;
+    size_t i;
+
+    assert(psChildren != NULL);
+
+    if(__atomic_sub_fetch(&psChildren->ulRefs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+    for(i = 0; i < DynArray_getLength(psChildren->oDNodes); i++)
+        Node_releaseNow(DynArray_get(psChildren->oDNodes, i));
+    DynArray_free(psChildren->oDNodes);
+    free(psChildren);
+}
+
+/*--------------------------------------------------------------------*/
+/* Drops a reference to the buffer pvBuffer, and frees it if that was
+   the last. Takes a void pointer so that it can be handed to
+   Epoch_retire. */
+static void Node_dropBuffer(void *pvBuffer) {
+    struct buffer *psBuffer = pvBuffer;
+
+    assert(psBuffer != NULL);
+
+    if(__atomic_sub_fetch(&psBuffer->ulRefs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+    if(psBuffer->pvMap != NULL)
+        (void) munmap(psBuffer->pvMap, psBuffer->ulMapLength);
+    free(psBuffer);
+}
+
+/*--------------------------------------------------------------------*/
+/* Drops a reference to the chunk list pvChunks. Takes a void pointer
+   so that it can be handed to Epoch_retire. */
+static void Node_dropChunks(void *pvChunks) {
+    assert(pvChunks != NULL);
+
+    ChunkList_release(pvChunks);
+}
+
+/*--------------------------------------------------------------------*/
+/* Returns a copy of the record of children psSource, holding a
+   reference of its own to each child, or NULL if there is an
+   allocation error. */
+static struct children *Node_copyChildren(struct children *psSource) {
+    struct children *psCopy;
+    Node_T oNChild;
+    size_t ulLength;
+    size_t i;
+
+    assert(psSource != NULL);
+
+    psCopy = malloc(sizeof(struct children));
+    if(psCopy == NULL)
+        return NULL;
+    ulLength = DynArray_getLength(psSource->oDNodes);
+    psCopy->oDNodes = DynArray_new(ulLength);
+    if(psCopy->oDNodes == NULL) {
+        free(psCopy);
+        return NULL;
+    }
+    for(i = 0; i < ulLength; i++) {
+        oNChild = DynArray_get(psSource->oDNodes, i);
+        (void) __atomic_add_fetch(&oNChild->ulRefs, 1, __ATOMIC_RELAXED);
+        (void) DynArray_set(psCopy->oDNodes, i, oNChild);
+    }
+    psCopy->ulRefs = 1;
+    return psCopy;
+}
+
+/*--------------------------------------------------------------------*/
+/*
+  Returns a record of oNParent's file children if bIsFile is TRUE, or
+  of its directory children otherwise, that the caller may change and
+  then hand to Node_endEdit or Node_abortEdit, or NULL if there is an
+  allocation error. That is the published record itself if oNParent
+  alone uses it and no lock-free reader can be looking at it (oEpoch
+  is NULL), and a copy otherwise.
+*/
+static struct children *Node_beginEdit(Node_T oNParent, boolean bIsFile,
+                                       Epoch_T oEpoch) {
+    struct children *psChildren;
+
+    assert(oNParent != NULL);
+
+    psChildren = Node_getChildren(oNParent, bIsFile);
+    if(psChildren == psUnreadable)
+        return NULL;
+    if(oEpoch == NULL &&
+       __atomic_load_n(&psChildren->ulRefs, __ATOMIC_ACQUIRE) == 1)
+        return psChildren;
+    return Node_copyChildren(psChildren);
+}
+
+/*--------------------------------------------------------------------*/
+/*
+  Makes psEdit, from Node_beginEdit, oNParent's record of file
+  children if bIsFile is TRUE, or of directory children otherwise, so
+  that readers see either the old record or the complete new one. The
+  reference to the old record is dropped once lock-free readers are
+  done with it, if oEpoch is not NULL, or at once otherwise.
+*/
+static void Node_endEdit(Node_T oNParent, boolean bIsFile,
+                         struct children *psEdit, Epoch_T oEpoch) {
+    struct children *psOld;
+
+    assert(oNParent != NULL);
+    assert(psEdit != NULL);
+
+    if(psEdit == Node_getChildren(oNParent, bIsFile))
+        return;
+    if(bIsFile)
+        psOld = __atomic_exchange_n(&oNParent->psFileChildren, psEdit,
+                                    __ATOMIC_ACQ_REL);
+    else
+        psOld = __atomic_exchange_n(&oNParent->psDirChildren, psEdit,
+                                    __ATOMIC_ACQ_REL);
+    if(oEpoch != NULL)
+        Epoch_retire(oEpoch, Node_dropChildren, psOld);
+    else
+        Node_dropChildren(psOld);
+}
+
+/*--------------------------------------------------------------------*/
+/* Discards psEdit, from Node_beginEdit on the same arguments, which
+   the caller left unchanged. */
+static void Node_abortEdit(Node_T oNParent, boolean bIsFile,
+                           struct children *psEdit) {
+    assert(oNParent != NULL);
+    assert(psEdit != NULL);
+
+    if(psEdit != Node_getChildren(oNParent, bIsFile))
+        Node_dropChildren(psEdit);
+}
+
+/*--------------------------------------------------------------------*/
+/*
+  Links new child oNChild into oNParent's children array, which takes
+  over the caller's reference to it, as by Node_endEdit with oEpoch.
+  Returns SUCCESS if the new child was added successfully, or
+  MEMORY_ERROR if allocation fails adding oNChild to the array.
+*/
+static int Node_addChild(Node_T oNParent, Node_T oNChild,
+                         Epoch_T oEpoch) {
+    struct children *psEdit;
     size_t ulIndex;
+
     assert(oNParent != NULL);
     assert(oNChild != NULL);
 
-    if (oNChild->isFileNode == TRUE){
-        /* Wrong index if node is a file*/
-        DynArray_bsearch(oNParent->oFileChildren,
-            (char*) Path_getPathname(oNChild->oPPath), &ulIndex,
-            (int (*)(const void*,const void*)) Node_compareString);
-        if (DynArray_addAt(oNParent->oFileChildren, ulIndex, oNChild)){
-            return SUCCESS;
-        }
-        else
-            return MEMORY_ERROR;
-    }  
+    psEdit = Node_beginEdit(oNParent, oNChild->isFileNode, oEpoch);
+    if(psEdit == NULL)
+        return MEMORY_ERROR;
 
-    DynArray_bsearch(oNParent->oDirChildren,
-            (char*) Path_getPathname(oNChild->oPPath), &ulIndex,
+    (void) DynArray_bsearch(psEdit->oDNodes,
+            oNChild->pcName, &ulIndex,
             (int (*)(const void*,const void*)) Node_compareString);
-    if(DynArray_addAt(oNParent->oDirChildren, ulIndex, oNChild))
-        return SUCCESS;
-    else
+    if(!DynArray_addAt(psEdit->oDNodes, ulIndex, oNChild)) {
+        Node_abortEdit(oNParent, oNChild->isFileNode, psEdit);
         return MEMORY_ERROR;
+    }
+
+    Node_endEdit(oNParent, oNChild->isFileNode, psEdit, oEpoch);
+    return SUCCESS;
 }
 
 /*--------------------------------------------------------------------*/
 /*
-  Creates a new node with path oPPath and parent oNParent.  Returns an
+  Unlinks child oNChild from oNParent's children array as by
+  Node_endEdit with oEpoch, handing the array's reference to it over
+  to the caller. Returns SUCCESS, or MEMORY_ERROR, in which case
+  oNChild is still linked.
+*/
+static int Node_removeChild(Node_T oNParent, Node_T oNChild,
+                            Epoch_T oEpoch) {
+    struct children *psEdit;
+    size_t ulIndex;
+
+    assert(oNParent != NULL);
+    assert(oNChild != NULL);
+
+    psEdit = Node_beginEdit(oNParent, oNChild->isFileNode, oEpoch);
+    if(psEdit == NULL)
+        return MEMORY_ERROR;
+
+    if(DynArray_bsearch(psEdit->oDNodes, oNChild, &ulIndex,
+            (int (*)(const void *, const void *)) Node_compare))
+        (void) DynArray_removeAt(psEdit->oDNodes, ulIndex);
+
+    Node_endEdit(oNParent, oNChild->isFileNode, psEdit, oEpoch);
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+/*
+  Creates a new node named pcName with parent oNParent, without
+  linking it into oNParent's children.  Returns an
   int SUCCESS status and sets *poNResult to be the new node if
   successful. Otherwise, sets *poNResult to NULL and returns status:
   * MEMORY_ERROR if memory could not be allocated to complete request
-  * CONFLICTING_PATH if oNParent's path is not an ancestor of oPPath
-  * NO_SUCH_PATH if oPPath is of depth 0
-                 or oNParent's path is not oPPath's direct parent
-                 or oNParent is NULL but oPPath is not of depth 1
-  * ALREADY_IN_TREE if oNParent already has a child with this path
+  * NOT_A_DIRECTORY if oNParent is a file
+  * CONFLICTING_PATH if oNParent is NULL but the new node is a file
+  * ALREADY_IN_TREE if oNParent already has a child with this name
 */
-int Node_new(Path_T oPPath, Node_T oNParent, boolean bIsFile, 
-void *pvContent, size_t ulength, Node_T *poNResult)
+static int Node_create(const char *pcName, Node_T oNParent,
+boolean bIsFile, void *pvContent, size_t ulength, Node_T *poNResult)
 {
     struct node *psNew;
-    Path_T oPParentPath = NULL;
-    Path_T oPNewPath = NULL;
-    size_t ulParentDepth;
     size_t ulIndex;
-    int iStatus;
 
     assert(poNResult != NULL);
-    assert(oPPath != NULL);
+    assert(pcName != NULL);
 
     /* allocate space for a new node */
     psNew = malloc(sizeof(struct node));
@@ -112,89 +416,64 @@ void *pvContent, size_t ulength, Node_T *poNResult)
         return MEMORY_ERROR;
     }
 
-    /* set the new node's path */
-    iStatus = Path_dup(oPPath, &oPNewPath);
-    if(iStatus != SUCCESS) {
+    /* set the new node's name */
+    psNew->pcName = Node_dupName(pcName);
+    if(psNew->pcName == NULL) {
         free(psNew);
         *poNResult = NULL;
-        return iStatus;
+        return MEMORY_ERROR;
     }
-    psNew->oPPath = oPNewPath;
 
-    /* validate and set the new node's parent */
+    /* validate the new node's parent */
    if(oNParent != NULL) {
-      size_t ulSharedDepth;
-
-      oPParentPath = oNParent->oPPath;
-      ulParentDepth = Path_getDepth(oPParentPath);
-      ulSharedDepth = Path_getSharedPrefixDepth(psNew->oPPath,
-                                                oPParentPath);
-      /* parent must be an ancestor of child */
-      if(ulSharedDepth < ulParentDepth) {
-         Path_free(psNew->oPPath);
-         free(psNew);
-         *poNResult = NULL;
-         return CONFLICTING_PATH;
-      }
-
-      /* parent must be exactly one level up from child */
-      if(Path_getDepth(psNew->oPPath) != ulParentDepth + 1) {
-         Path_free(psNew->oPPath);
-         free(psNew);
-         *poNResult = NULL;
-         return NO_SUCH_PATH;
-      }
         /* Parent must be a directory*/
         if (oNParent->isFileNode){
-            Path_free(psNew->oPPath);
+            free(psNew->pcName);
             free(psNew);
             *poNResult = NULL;
             return NOT_A_DIRECTORY;
         }
 
-      /* parent must not already have child with this path */
-      if(Node_hasDirChild(oNParent, oPPath, &ulIndex)) {
-         Path_free(psNew->oPPath);
+      /* parent must not already have child with this name */
+      if(Node_hasDirChild(oNParent, pcName, &ulIndex)) {
+         free(psNew->pcName);
          free(psNew);
          *poNResult = NULL;
          return ALREADY_IN_TREE;
       }
    }
    else {
-      /* new node must be root */
-      /* can only create one "level" at a time */
-      if(Path_getDepth(psNew->oPPath) != 1) {
-         Path_free(psNew->oPPath);
-         free(psNew);
-         *poNResult = NULL;
-         return NO_SUCH_PATH;
-      }
+      /* new node must be root, which is a directory */
       if(bIsFile){
-        Path_free(psNew->oPPath);
+        free(psNew->pcName);
         free(psNew);
         *poNResult = NULL;
         return CONFLICTING_PATH;
       }
    }
     /* initialize the new node */
-    psNew->oNParent = oNParent;
+    psNew->ulRefs = 1;
     psNew->isFileNode = bIsFile;
+    psNew->psBuffer = NULL;
+    psNew->oChunks = NULL;
+    psNew->oImage = NULL;
+    psNew->ulRecord = IMAGE_NONE;
     if (!psNew->isFileNode)
     {
             psNew->content = NULL;
             psNew->ulength = 0;
 
-            psNew->oFileChildren = DynArray_new(0);
-            if(psNew->oFileChildren == NULL) {
-                Path_free(psNew->oPPath);
+            psNew->psFileChildren = Node_newChildren();
+            if(psNew->psFileChildren == NULL) {
+                free(psNew->pcName);
                 free(psNew);
                 *poNResult = NULL;
                 return MEMORY_ERROR;
             }
-            psNew->oDirChildren = DynArray_new(0);
-            if(psNew->oDirChildren == NULL) {
-                Path_free(psNew->oPPath);
-                DynArray_free(psNew->oFileChildren);
+            psNew->psDirChildren = Node_newChildren();
+            if(psNew->psDirChildren == NULL) {
+                free(psNew->pcName);
+                Node_dropChildren(psNew->psFileChildren);
                 free(psNew);
                 *poNResult = NULL;
                 return MEMORY_ERROR;
@@ -204,100 +483,735 @@ void *pvContent, size_t ulength, Node_T *poNResult)
     {
         psNew->content = pvContent;
         psNew->ulength = ulength;
-        psNew->oFileChildren = NULL;
-        psNew->oDirChildren = NULL;
+        psNew->psFileChildren = NULL;
+        psNew->psDirChildren = NULL;
+    }
+
+    if(pthread_rwlock_init(&psNew->sLatch, NULL) != 0) {
+        free(psNew->pcName);
+        if (!psNew->isFileNode) {
+            Node_dropChildren(psNew->psFileChildren);
+            Node_dropChildren(psNew->psDirChildren);
+        }
+        free(psNew);
+        *poNResult = NULL;
+        return MEMORY_ERROR;
     }
 
+    *poNResult = psNew;
+    return SUCCESS;     
+}
+
+/*--------------------------------------------------------------------*/
+/*
+  Frees oNNode, whose last reference is gone, and drops its references
+  to the arrays of its children, freeing in turn whatever nothing else
+  uses any more, without latching any of it.
+*/
+static void Node_destroy(Node_T oNNode) {
+    assert(oNNode != NULL);
+
+    /* the records an image-backed directory never read are NULL */
+    if(oNNode->psFileChildren != NULL)
+        Node_dropChildren(oNNode->psFileChildren);
+    if(oNNode->psDirChildren != NULL)
+        Node_dropChildren(oNNode->psDirChildren);
+    if(oNNode->psBuffer != NULL)
+        Node_dropBuffer(oNNode->psBuffer);
+    ChunkList_release(oNNode->oChunks);
+    Image_release(oNNode->oImage);
+    free(oNNode->pcName);
+    (void) pthread_rwlock_destroy(&oNNode->sLatch);
+    free(oNNode);
+}
+
+/*--------------------------------------------------------------------*/
+static void Node_releaseNow(void *pvNode) {
+    Node_T oNNode = pvNode;
+
+    assert(oNNode != NULL);
+
+    if(__atomic_sub_fetch(&oNNode->ulRefs, 1, __ATOMIC_ACQ_REL) == 0)
+        Node_destroy(oNNode);
+}
+
+/*--------------------------------------------------------------------*/
+int Node_new(const char *pcName, Node_T oNParent, boolean bIsFile, 
+void *pvContent, size_t ulength, Node_T *poNResult)
+{
+    int iStatus;
+
+    assert(poNResult != NULL);
+
+    iStatus = Node_create(pcName, oNParent, bIsFile, pvContent, ulength,
+                          poNResult);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
     /* Add the child to its parent if it is not NULL. */
     if (oNParent != NULL){
-        iStatus = Node_addChild(oNParent, psNew);
+        iStatus = Node_addChild(oNParent, *poNResult, NULL);
         if(iStatus != SUCCESS) {
-            Path_free(psNew->oPPath);
-            free(psNew);
+            Node_destroy(*poNResult);
             *poNResult = NULL;
             return iStatus;
         }
     }
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+int Node_newUnpublished(const char *pcName, Node_T oNParent,
+                        boolean bIsFile,
+                        void *pvContent, size_t ulength,
+                        Node_T *poNResult)
+{
+    assert(oNParent != NULL);
+
+    return Node_create(pcName, oNParent, bIsFile, pvContent, ulength,
+                       poNResult);
+}
+
+/*--------------------------------------------------------------------*/
+int Node_newFromImage(Image_T oImage, Image_Offset ulRecord,
+                      Node_T *poNResult)
+{
+    struct node *psNew;
+    struct children *psEmpty;
+
+    assert(oImage != NULL);
+    assert(ulRecord != IMAGE_NONE);
+    assert(poNResult != NULL);
+
+    *poNResult = NULL;
+    if(__atomic_load_n(&psUnreadable, __ATOMIC_ACQUIRE) == NULL) {
+        (void) pthread_mutex_lock(&sUnreadableLock);
+        if(psUnreadable == NULL) {
+            psEmpty = Node_newChildren();
+            __atomic_store_n(&psUnreadable, psEmpty, __ATOMIC_RELEASE);
+        }
+        (void) pthread_mutex_unlock(&sUnreadableLock);
+        if(psUnreadable == NULL)
+            return MEMORY_ERROR;
+    }
+
+    psNew = malloc(sizeof(struct node));
+    if(psNew == NULL)
+        return MEMORY_ERROR;
+    psNew->pcName = Node_dupName(Image_getName(oImage, ulRecord));
+    if(psNew->pcName == NULL) {
+        free(psNew);
+        return MEMORY_ERROR;
+    }
+    if(pthread_rwlock_init(&psNew->sLatch, NULL) != 0) {
+        free(psNew->pcName);
+        free(psNew);
+        return MEMORY_ERROR;
+    }
+
+    psNew->ulRefs = 1;
+    psNew->isFileNode = Image_isFile(oImage, ulRecord);
+    psNew->psBuffer = NULL;
+    psNew->oChunks = NULL;
+    if(psNew->isFileNode) {
+        psNew->content = Image_getContents(oImage, ulRecord);
+        psNew->ulength = Image_getLength(oImage, ulRecord);
+    }
+    else {
+        psNew->content = NULL;
+        psNew->ulength = 0;
+    }
+    /* a directory's children are read when first wanted */
+    psNew->psFileChildren = NULL;
+    psNew->psDirChildren = NULL;
+    Image_retain(oImage);
+    psNew->oImage = oImage;
+    psNew->ulRecord = ulRecord;
+
     *poNResult = psNew;
-    return SUCCESS;     
+    return SUCCESS;
 }
 
 /*--------------------------------------------------------------------*/
-void *Node_replaceOldContent(Node_T oNNode, void *newContent, 
-size_t length) {
-    void *oldContents = NULL;
+static struct children *Node_readChildren(Node_T oNParent,
+                                          boolean bIsFile)
+{
+    struct children *psChildren;
+    struct children *psPublished = NULL;
+    struct children **ppsField;
+    Node_T oNChild;
+    size_t ulLength;
+    size_t i;
+
+    assert(oNParent != NULL);
+    assert(oNParent->oImage != NULL);
+    assert(!oNParent->isFileNode);
+
+    ppsField = bIsFile ? &oNParent->psFileChildren
+                       : &oNParent->psDirChildren;
+    ulLength = Image_getNumChildren(oNParent->oImage,
+                                    oNParent->ulRecord, bIsFile);
+    psChildren = malloc(sizeof(struct children));
+    if(psChildren == NULL)
+        return psUnreadable;
+    psChildren->oDNodes = DynArray_new(ulLength);
+    if(psChildren->oDNodes == NULL) {
+        free(psChildren);
+        return psUnreadable;
+    }
+    psChildren->ulRefs = 1;
+    for(i = 0; i < ulLength; i++) {
+        if(Node_newFromImage(oNParent->oImage,
+                             Image_getChild(oNParent->oImage,
+                                            oNParent->ulRecord,
+                                            bIsFile, i),
+                             &oNChild) != SUCCESS) {
+            while(i-- > 0)
+                Node_releaseNow(DynArray_get(psChildren->oDNodes, i));
+            DynArray_free(psChildren->oDNodes);
+            free(psChildren);
+            return psUnreadable;
+        }
+        (void) DynArray_set(psChildren->oDNodes, i, oNChild);
+    }
+
+    if(!__atomic_compare_exchange_n(ppsField, &psPublished, psChildren,
+                                    FALSE, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE)) {
+        /* another thread read them first */
+        Node_dropChildren(psChildren);
+        return psPublished;
+    }
+    return psChildren;
+}
+
+/*--------------------------------------------------------------------*/
+int Node_publish(Node_T oNParent, Node_T oNNode, Epoch_T oEpoch)
+{
+    assert(oNParent != NULL);
     assert(oNNode != NULL);
 
-    oldContents = oNNode->content;
-    oNNode->content = newContent;
-    oNNode->ulength = length;
+    return Node_addChild(oNParent, oNNode, oEpoch);
+}
+
+/*--------------------------------------------------------------------*/
+/* Latches every node of the subtree rooted at oNNode exclusively in
+   turn, top-down. */
+static void Node_drain(Node_T oNNode) {
+    struct children *apsChildren[2];
+    size_t i, j;
+
+    assert(oNNode != NULL);
 
-    return oldContents;
+    Node_latchExclusive(oNNode);
+    Node_unlatch(oNNode);
+    /* children not read from an image yet have no writers inside */
+    apsChildren[0] = __atomic_load_n(&oNNode->psFileChildren,
+                                     __ATOMIC_ACQUIRE);
+    apsChildren[1] = __atomic_load_n(&oNNode->psDirChildren,
+                                     __ATOMIC_ACQUIRE);
+    for(j = 0; j < 2; j++) {
+        if(apsChildren[j] == NULL)
+            continue;
+        for(i = 0; i < DynArray_getLength(apsChildren[j]->oDNodes); i++)
+            Node_drain(DynArray_get(apsChildren[j]->oDNodes, i));
+    }
 }
 
 /*--------------------------------------------------------------------*/
-size_t Node_getFileSize(Node_T oNNode){
+int Node_remove(Node_T oNParent, Node_T oNNode, Epoch_T oEpoch)
+{
+    int iStatus;
+
     assert(oNNode != NULL);
 
-    return oNNode->ulength;
+    if(oNParent != NULL) {
+        iStatus = Node_removeChild(oNParent, oNNode, oEpoch);
+        if(iStatus != SUCCESS)
+            return iStatus;
+    }
+
+    /* unreachable now, but writers already inside must finish */
+    Node_drain(oNNode);
+    Node_release(oNNode, oEpoch);
+    return SUCCESS;
 }
 
 /*--------------------------------------------------------------------*/
-size_t Node_free(Node_T oNNode){
-    size_t ulIndex;
-    size_t ulCount = 0;
+void Node_release(Node_T oNNode, Epoch_T oEpoch)
+{
+    assert(oNNode != NULL);
 
+    if(oEpoch != NULL)
+        Epoch_retire(oEpoch, Node_releaseNow, oNNode);
+    else
+        Node_releaseNow(oNNode);
+}
+
+/*--------------------------------------------------------------------*/
+void Node_retain(Node_T oNNode)
+{
     assert(oNNode != NULL);
 
-    if(oNNode->oNParent != NULL) {
-        if (oNNode->isFileNode) {  
-            if(DynArray_bsearch(
-                    oNNode->oNParent->oFileChildren,
-                    oNNode, &ulIndex,
-                    (int (*)(const void *, const void *)) Node_compare)
-                )
-                (void) DynArray_removeAt(oNNode->oNParent->oFileChildren,
-                                        ulIndex);
-        }
-        else{
-            if(DynArray_bsearch(
-                        oNNode->oNParent->oDirChildren,
-                        oNNode, &ulIndex,
-                        (int (*)(const void *, const void *)) Node_compare)
-                    )
-                    (void) DynArray_removeAt(oNNode->oNParent->oDirChildren,
-                                            ulIndex);
-        }
+    (void) __atomic_add_fetch(&oNNode->ulRefs, 1, __ATOMIC_RELAXED);
+}
+
+/*--------------------------------------------------------------------*/
+boolean Node_isShared(Node_T oNNode)
+{
+    assert(oNNode != NULL);
+
+    return __atomic_load_n(&oNNode->ulRefs, __ATOMIC_ACQUIRE) > 1;
+}
+
+/*--------------------------------------------------------------------*/
+int Node_copy(Node_T oNNode, const char *pcName, Node_T *poNResult)
+{
+    struct node *psNew;
+
+    assert(oNNode != NULL);
+    assert(poNResult != NULL);
+
+    psNew = malloc(sizeof(struct node));
+    if(psNew == NULL) {
+        *poNResult = NULL;
+        return MEMORY_ERROR;
+    }
+    if(pcName == NULL)
+        pcName = oNNode->pcName;
+    psNew->pcName = Node_dupName(pcName);
+    if(psNew->pcName == NULL) {
+        free(psNew);
+        *poNResult = NULL;
+        return MEMORY_ERROR;
+    }
+    if(pthread_rwlock_init(&psNew->sLatch, NULL) != 0) {
+        free(psNew->pcName);
+        free(psNew);
+        *poNResult = NULL;
+        return MEMORY_ERROR;
+    }
+
+    psNew->ulRefs = 1;
+    psNew->isFileNode = oNNode->isFileNode;
+    psNew->content = __atomic_load_n(&oNNode->content, __ATOMIC_ACQUIRE);
+    psNew->ulength = Node_getFileSize(oNNode);
+    /* and its contents, until either side writes to them */
+    psNew->psBuffer = oNNode->psBuffer;
+    if(psNew->psBuffer != NULL)
+        (void) __atomic_add_fetch(&psNew->psBuffer->ulRefs, 1,
+                                  __ATOMIC_RELAXED);
+    psNew->oChunks = oNNode->oChunks;
+    if(psNew->oChunks != NULL)
+        ChunkList_retain(psNew->oChunks);
+    psNew->psFileChildren = __atomic_load_n(&oNNode->psFileChildren,
+                                            __ATOMIC_ACQUIRE);
+    psNew->psDirChildren = __atomic_load_n(&oNNode->psDirChildren,
+                                           __ATOMIC_ACQUIRE);
+    /* the copy shares its children until either side changes, and
+       reads for itself whatever oNNode has not read from its image */
+    if(psNew->psFileChildren != NULL)
+        (void) __atomic_add_fetch(&psNew->psFileChildren->ulRefs, 1,
+                                  __ATOMIC_RELAXED);
+    if(psNew->psDirChildren != NULL)
+        (void) __atomic_add_fetch(&psNew->psDirChildren->ulRefs, 1,
+                                  __ATOMIC_RELAXED);
+    psNew->oImage = oNNode->oImage;
+    psNew->ulRecord = oNNode->ulRecord;
+    if(psNew->oImage != NULL)
+        Image_retain(psNew->oImage);
+
+    *poNResult = psNew;
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+boolean Node_isChildShared(Node_T oNParent, Node_T oNChild)
+{
+    assert(oNParent != NULL);
+    assert(oNChild != NULL);
+
+    return Node_isShared(oNChild) ||
+           __atomic_load_n(&Node_getChildren(oNParent,
+                                             oNChild->isFileNode)->ulRefs,
+                           __ATOMIC_ACQUIRE) > 1;
+}
+
+/*--------------------------------------------------------------------*/
+int Node_unshareChild(Node_T oNParent, Node_T oNChild, Epoch_T oEpoch,
+                      Node_T *poNResult)
+{
+    struct children *psEdit;
+    Node_T oNCopy;
+    size_t ulIndex;
+    int iStatus;
+
+    assert(oNParent != NULL);
+    assert(oNChild != NULL);
+    assert(poNResult != NULL);
+
+    if(!Node_isChildShared(oNParent, oNChild)) {
+        *poNResult = oNChild;
+        return SUCCESS;
     }
 
-    if(!oNNode->isFileNode) {
-        /* recursively remove children in File DynArray*/
-        while(DynArray_getLength(oNNode->oFileChildren) != 0) {
-            ulCount += Node_free(DynArray_get(oNNode->oFileChildren, 0));
+    /* a copy of the array takes a reference to oNChild, so it is
+       shared from here on either way */
+    psEdit = Node_beginEdit(oNParent, oNChild->isFileNode, oEpoch);
+    if(psEdit == NULL) {
+        *poNResult = NULL;
+        return MEMORY_ERROR;
+    }
+    if(Node_isShared(oNChild)) {
+        iStatus = Node_copy(oNChild, NULL, &oNCopy);
+        if(iStatus != SUCCESS) {
+            Node_abortEdit(oNParent, oNChild->isFileNode, psEdit);
+            *poNResult = NULL;
+            return iStatus;
         }
-        DynArray_free(oNNode->oFileChildren);
-        
-        /* recursively remove children in Directory DynArray*/
-        while(DynArray_getLength(oNNode->oDirChildren) != 0) {
-            ulCount += Node_free(DynArray_get(oNNode->oDirChildren, 0));
+        (void) DynArray_bsearch(psEdit->oDNodes, oNChild, &ulIndex,
+                (int (*)(const void *, const void *)) Node_compare);
+        (void) DynArray_set(psEdit->oDNodes, ulIndex, oNCopy);
+        Node_release(oNChild, oEpoch);
+        oNChild = oNCopy;
+    }
+    Node_endEdit(oNParent, oNChild->isFileNode, psEdit, oEpoch);
+
+    *poNResult = oNChild;
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+int Node_relink(Node_T oNOldParent, Node_T oNNode, Node_T oNNewParent,
+                const char *pcName, Epoch_T oEpoch)
+{
+    struct children *psOld;
+    struct children *psNew;
+    Node_T oNCopy;
+    size_t ulIndex;
+    int iStatus;
+
+    assert(oNOldParent != NULL);
+    assert(oNNode != NULL);
+    assert(oNNewParent != NULL);
+    assert(pcName != NULL);
+
+    /* readers may be looking at oNNode's name, so it gets a new node
+       that shares everything below it */
+    iStatus = Node_copy(oNNode, pcName, &oNCopy);
+    if(iStatus != SUCCESS)
+        return iStatus;
+
+    psNew = Node_beginEdit(oNNewParent, oNNode->isFileNode, oEpoch);
+    if(psNew == NULL) {
+        Node_destroy(oNCopy);
+        return MEMORY_ERROR;
+    }
+    if(oNOldParent == oNNewParent)
+        psOld = psNew;
+    else {
+        psOld = Node_beginEdit(oNOldParent, oNNode->isFileNode, oEpoch);
+        if(psOld == NULL) {
+            Node_abortEdit(oNNewParent, oNNode->isFileNode, psNew);
+            Node_destroy(oNCopy);
+            return MEMORY_ERROR;
         }
-        DynArray_free(oNNode->oDirChildren);
     }
 
-    /* remove path */
-    Path_free(oNNode->oPPath);
+    (void) DynArray_bsearch(psNew->oDNodes, (char*) pcName, &ulIndex,
+            (int (*)(const void*,const void*)) Node_compareString);
+    if(!DynArray_addAt(psNew->oDNodes, ulIndex, oNCopy)) {
+        Node_abortEdit(oNNewParent, oNNode->isFileNode, psNew);
+        if(psOld != psNew)
+            Node_abortEdit(oNOldParent, oNNode->isFileNode, psOld);
+        Node_destroy(oNCopy);
+        return MEMORY_ERROR;
+    }
+    if(DynArray_bsearch(psOld->oDNodes, oNNode, &ulIndex,
+            (int (*)(const void *, const void *)) Node_compare))
+        (void) DynArray_removeAt(psOld->oDNodes, ulIndex);
+
+    /* link the new place before unlinking the old, so that lock-free
+       readers always find the subtree somewhere */
+    Node_endEdit(oNNewParent, oNNode->isFileNode, psNew, oEpoch);
+    if(psOld != psNew)
+        Node_endEdit(oNOldParent, oNNode->isFileNode, psOld, oEpoch);
+    Node_release(oNNode, oEpoch);
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+/*
+  Makes pvContent of ulength bytes, or oChunks if it is not NULL, the
+  contents of oNNode, taking a reference to oChunks. Returns the old
+  contents if they were the client's, or drops them as by Node_release
+  with oEpoch and returns NULL.
+*/
+static void *Node_swapContent(Node_T oNNode, void *pvContent,
+                              size_t ulength, ChunkList_T oChunks,
+                              Epoch_T oEpoch) {
+    void *oldContents = NULL;
+    struct buffer *psOld;
+    ChunkList_T oOldChunks;
 
-    /* finally, free the struct node */
-    free(oNNode);
-    ulCount++;
+    assert(oNNode != NULL);
+
+    if(oChunks != NULL)
+        ChunkList_retain(oChunks);
+    /* lock-free readers may load any of the fields at any time */
+    oldContents = __atomic_exchange_n(&oNNode->content, pvContent,
+                                      __ATOMIC_ACQ_REL);
+    oOldChunks = __atomic_exchange_n(&oNNode->oChunks, oChunks,
+                                     __ATOMIC_ACQ_REL);
+    __atomic_store_n(&oNNode->ulength, ulength, __ATOMIC_RELEASE);
+
+    if(oOldChunks != NULL) {
+        if(oEpoch != NULL)
+            Epoch_retire(oEpoch, Node_dropChunks, oOldChunks);
+        else
+            Node_dropChunks(oOldChunks);
+        return NULL;
+    }
+    psOld = oNNode->psBuffer;
+    if(psOld == NULL)
+        return oldContents;
+    /* the old contents were the FT's, not the client's */
+    oNNode->psBuffer = NULL;
+    if(oEpoch != NULL)
+        Epoch_retire(oEpoch, Node_dropBuffer, psOld);
+    else
+        Node_dropBuffer(psOld);
+    return NULL;
+}
+
+/*--------------------------------------------------------------------*/
+void *Node_replaceOldContent(Node_T oNNode, void *newContent, 
+size_t length, Epoch_T oEpoch) {
+    assert(oNNode != NULL);
+
+    return Node_swapContent(oNNode, newContent, length, NULL, oEpoch);
+}
+
+/*--------------------------------------------------------------------*/
+void *Node_replaceChunks(Node_T oNNode, ChunkList_T oChunks,
+                         Epoch_T oEpoch) {
+    assert(oNNode != NULL);
+    assert(oChunks != NULL);
+
+    return Node_swapContent(oNNode, NULL, ChunkList_getLength(oChunks),
+                            oChunks, oEpoch);
+}
+
+/*--------------------------------------------------------------------*/
+int Node_adoptMapping(Node_T oNNode, void *pvMap, size_t ulMapLength) {
+    struct buffer *psBuffer;
+
+    assert(oNNode != NULL);
+    assert(oNNode->isFileNode);
+    assert(oNNode->psBuffer == NULL);
+    assert(oNNode->oChunks == NULL);
+    assert(pvMap != NULL);
+
+    psBuffer = malloc(sizeof(struct buffer));
+    if(psBuffer == NULL)
+        return MEMORY_ERROR;
+    psBuffer->ulRefs = 1;
+    /* so that Node_writeContent never writes to it in place */
+    psBuffer->ulCapacity = 0;
+    psBuffer->pvMap = pvMap;
+    psBuffer->ulMapLength = ulMapLength;
+    oNNode->psBuffer = psBuffer;
+    return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+size_t Node_readContent(Node_T oNNode, size_t ulOffset, void *pvDest,
+                        size_t ulCount) {
+    const char *pcContents;
+    ChunkList_T oChunks;
+    size_t ulLength;
+
+    assert(oNNode != NULL);
+    assert(pvDest != NULL || ulCount == 0);
+
+    ulLength = Node_getFileSize(oNNode);
+    if(ulOffset >= ulLength)
+        return 0;
+    if(ulCount > ulLength - ulOffset)
+        ulCount = ulLength - ulOffset;
+    oChunks = __atomic_load_n(&oNNode->oChunks, __ATOMIC_ACQUIRE);
+    if(oChunks != NULL)
+        return ChunkList_read(oChunks, ulOffset, pvDest, ulCount);
+    pcContents = __atomic_load_n(&oNNode->content, __ATOMIC_ACQUIRE);
+    if(pcContents == NULL)
+        memset(pvDest, 0, ulCount);
+    else
+        memcpy(pvDest, pcContents + ulOffset, ulCount);
     return ulCount;
 }
 
+/*--------------------------------------------------------------------*/
+int Node_sendContent(Node_T oNNode, size_t ulOffset, size_t ulCount,
+                     int iFd, size_t *pulSent) {
+    const char *pcContents;
+    ChunkList_T oChunks;
+    size_t ulLength;
+    boolean bMapped;
+
+    assert(oNNode != NULL);
+    assert(pulSent != NULL);
+
+    *pulSent = 0;
+    ulLength = Node_getFileSize(oNNode);
+    if(ulOffset >= ulLength)
+        return SUCCESS;
+    if(ulCount > ulLength - ulOffset)
+        ulCount = ulLength - ulOffset;
+    oChunks = __atomic_load_n(&oNNode->oChunks, __ATOMIC_ACQUIRE);
+    if(oChunks != NULL)
+        return ChunkList_send(oChunks, ulOffset, ulCount, iFd, pulSent);
+    pcContents = __atomic_load_n(&oNNode->content, __ATOMIC_ACQUIRE);
+    if(pcContents == NULL)
+        return Send_bytes(iFd, NULL, ulCount, pulSent);
+
+    /* pages of a file are passed on by reference, but those of memory
+       the FT or the client may free or change in place are copied */
+    bMapped = oNNode->psBuffer != NULL ?
+              oNNode->psBuffer->pvMap != NULL :
+              oNNode->oImage != NULL &&
+              (void *) pcContents == Image_getContents(oNNode->oImage,
+                                                       oNNode->ulRecord);
+    if(bMapped)
+        return Send_mapped(iFd, pcContents + ulOffset, ulCount, pulSent);
+    return Send_bytes(iFd, pcContents + ulOffset, ulCount, pulSent);
+}
+
+/*--------------------------------------------------------------------*/
+int Node_writeContent(Node_T oNNode, size_t ulOffset,
+                      const void *pvBytes, size_t ulCount,
+                      Epoch_T oEpoch) {
+    struct buffer *psOld = oNNode->psBuffer;
+    struct buffer *psNew;
+    ChunkList_T oChunks;
+    char *pcContents;
+    size_t ulLength, ulEnd, ulCapacity, ulKept;
+
+    assert(oNNode != NULL);
+    assert(oNNode->isFileNode);
+    assert(pvBytes != NULL || ulCount == 0);
+
+    ulLength = oNNode->ulength;
+    if(ulOffset > (size_t) -1 - ulCount)
+        return MEMORY_ERROR;
+    ulEnd = ulOffset + ulCount;
+
+    /* in place if the buffer is the node's alone and has room */
+    if(psOld != NULL && ulEnd <= psOld->ulCapacity &&
+       __atomic_load_n(&psOld->ulRefs, __ATOMIC_ACQUIRE) == 1) {
+        pcContents = oNNode->content;
+        if(ulOffset > ulLength)
+            memset(pcContents + ulLength, 0, ulOffset - ulLength);
+        if(ulCount > 0)
+            memcpy(pcContents + ulOffset, pvBytes, ulCount);
+        if(ulEnd > ulLength)
+            __atomic_store_n(&oNNode->ulength, ulEnd, __ATOMIC_RELEASE);
+        return SUCCESS;
+    }
+
+    /* a file that grows gets room to grow further, so that a run of
+       appends copies each byte a constant number of times */
+    ulCapacity = ulEnd > ulLength ? ulEnd : ulLength;
+    if(ulEnd > ulLength) {
+        if(psOld != NULL && psOld->ulCapacity <= ((size_t) -1) / 2 &&
+           ulCapacity < 2 * psOld->ulCapacity)
+            ulCapacity = 2 * psOld->ulCapacity;
+        if(ulCapacity <= ((size_t) -1) / 2 &&
+           ulCapacity < ulLength + ulLength / 2)
+            ulCapacity = ulLength + ulLength / 2;
+        if(ulCapacity < MIN_BUFFER)
+            ulCapacity = MIN_BUFFER;
+    }
+    if(ulCapacity > (size_t) -1 - sizeof(struct buffer))
+        return MEMORY_ERROR;
+    psNew = malloc(sizeof(struct buffer) + ulCapacity);
+    if(psNew == NULL)
+        return MEMORY_ERROR;
+    psNew->ulRefs = 1;
+    psNew->ulCapacity = ulCapacity;
+    psNew->pvMap = NULL;
+    psNew->ulMapLength = 0;
+    pcContents = (char *) (psNew + 1);
+
+    /* cold chunks may fail to thaw */
+    ulKept = ulLength < ulOffset ? ulLength : ulOffset;
+    if(Node_readContent(oNNode, 0, pcContents, ulKept) != ulKept ||
+       (ulEnd < ulLength &&
+        Node_readContent(oNNode, ulEnd, pcContents + ulEnd,
+                         ulLength - ulEnd) != ulLength - ulEnd)) {
+        free(psNew);
+        return MEMORY_ERROR;
+    }
+    if(ulOffset > ulLength)
+        memset(pcContents + ulLength, 0, ulOffset - ulLength);
+    if(ulCount > 0)
+        memcpy(pcContents + ulOffset, pvBytes, ulCount);
+
+    /* lock-free readers see the old contents or the new, whole */
+    __atomic_store_n(&oNNode->content, pcContents, __ATOMIC_RELEASE);
+    oChunks = __atomic_exchange_n(&oNNode->oChunks, NULL,
+                                  __ATOMIC_ACQ_REL);
+    if(ulEnd > ulLength)
+        __atomic_store_n(&oNNode->ulength, ulEnd, __ATOMIC_RELEASE);
+    oNNode->psBuffer = psNew;
+    if(oChunks != NULL) {
+        /* the file no longer shares chunks with others */
+        if(oEpoch != NULL)
+            Epoch_retire(oEpoch, Node_dropChunks, oChunks);
+        else
+            Node_dropChunks(oChunks);
+    }
+    if(psOld != NULL) {
+        if(oEpoch != NULL)
+            Epoch_retire(oEpoch, Node_dropBuffer, psOld);
+        else
+            Node_dropBuffer(psOld);
+    }
+    return SUCCESS;
+}
 
-Path_T Node_getPath(Node_T oNNode) {
+/*--------------------------------------------------------------------*/
+size_t Node_getStoredSize(Node_T oNNode) {
+    ChunkList_T oChunks;
+
+    assert(oNNode != NULL);
+
+    oChunks = __atomic_load_n(&oNNode->oChunks, __ATOMIC_ACQUIRE);
+    if(oChunks != NULL)
+        return ChunkList_getStored(oChunks);
+    /* the pages of a mapping are the operating system's to drop */
+    if(oNNode->psBuffer != NULL && oNNode->psBuffer->pvMap != NULL)
+        return 0;
+    if(oNNode->psBuffer != NULL)
+        return oNNode->ulength /
+               __atomic_load_n(&oNNode->psBuffer->ulRefs,
+                               __ATOMIC_RELAXED);
+    if(__atomic_load_n(&oNNode->content, __ATOMIC_ACQUIRE) == NULL)
+        return 0;
+    return Node_getFileSize(oNNode);
+}
+
+/*--------------------------------------------------------------------*/
+size_t Node_getFileSize(Node_T oNNode){
+    assert(oNNode != NULL);
+
+    return __atomic_load_n(&oNNode->ulength, __ATOMIC_ACQUIRE);
+}
+
+
+const char *Node_getName(Node_T oNNode) {
    assert(oNNode != NULL);
 
-   return oNNode->oPPath;
+   return oNNode->pcName;
 }
 
 
@@ -309,17 +1223,29 @@ boolean Node_isFileNode(Node_T oNNode){
 
 
 void *Node_getFileContent(Node_T oNNode){
+    ChunkList_T oChunks;
+
     assert(oNNode != NULL);
-    
-    return oNNode->content;
+
+    oChunks = __atomic_load_n(&oNNode->oChunks, __ATOMIC_ACQUIRE);
+    if(oChunks != NULL)
+        return ChunkList_getBytes(oChunks);
+    return __atomic_load_n(&oNNode->content, __ATOMIC_ACQUIRE);
 }
 
 
-boolean Node_hasDirChild(Node_T oNParent, Path_T oPPath,
+boolean Node_hasChunks(Node_T oNNode){
+    assert(oNNode != NULL);
+
+    return __atomic_load_n(&oNNode->oChunks, __ATOMIC_ACQUIRE) != NULL;
+}
+
+
+boolean Node_hasDirChild(Node_T oNParent, const char *pcName,
                          size_t *pulChildID) {
     boolean found;
     assert(oNParent != NULL);
-    assert(oPPath != NULL);
+    assert(pcName != NULL);
     assert(pulChildID != NULL);
 
     if (oNParent->isFileNode)
@@ -327,8 +1253,8 @@ boolean Node_hasDirChild(Node_T oNParent, Path_T oPPath,
 
 
     /* Is it a directory child */
-    found = DynArray_bsearch(oNParent->oDirChildren, 
-    (char*) Path_getPathname(oPPath), pulChildID,
+    found = DynArray_bsearch(Node_loadChildren(oNParent, FALSE), 
+    (char*) pcName, pulChildID,
     (int (*)(const void*,const void*)) Node_compareString);
     
     if(found == TRUE) return TRUE;
@@ -337,19 +1263,19 @@ boolean Node_hasDirChild(Node_T oNParent, Path_T oPPath,
 }
 
 
-boolean Node_hasFileChild(Node_T oNParent, Path_T oPPath,
+boolean Node_hasFileChild(Node_T oNParent, const char *pcName,
                          size_t *pulChildID) {
     boolean found;
     assert(oNParent != NULL);
-    assert(oPPath != NULL);
+    assert(pcName != NULL);
     assert(pulChildID != NULL);
 
     if (oNParent->isFileNode)
         return FALSE;
 
     /* Is it a file child */
-    found = DynArray_bsearch(oNParent->oFileChildren, 
-    (char*) Path_getPathname(oPPath), pulChildID,
+    found = DynArray_bsearch(Node_loadChildren(oNParent, TRUE), 
+    (char*) pcName, pulChildID,
     (int (*)(const void*,const void*)) Node_compareString);
     
     if(found == TRUE) return TRUE;
@@ -377,7 +1303,7 @@ size_t Node_getNumChildren(Node_T oNParent) {
 size_t Node_getNumFileChildren(Node_T oNParent){
     assert(oNParent != NULL);
 
-    return DynArray_getLength(oNParent->oFileChildren);
+    return DynArray_getLength(Node_loadChildren(oNParent, TRUE));
 
 }
 
@@ -385,62 +1311,182 @@ size_t Node_getNumFileChildren(Node_T oNParent){
 size_t Node_getNumDirChildren(Node_T oNParent){
     assert(oNParent != NULL);
 
-    return DynArray_getLength(oNParent->oDirChildren);
+    return DynArray_getLength(Node_loadChildren(oNParent, FALSE));
 
 }
 
 /*--------------------------------------------------------------------*/
 int  Node_getChild(Node_T oNParent, size_t ulChildID, boolean bIsFile,
                    Node_T *poNResult) {
+   DynArray_T oDChildren;
 
    assert(oNParent != NULL);
    assert(poNResult != NULL);
 
-   /* ulChildID is the index into oNParent->oDChildren */
-   if (bIsFile){
-        if(ulChildID >= DynArray_getLength(oNParent->oFileChildren)) {
-            *poNResult = NULL;
-            return NO_SUCH_PATH;
-        }
-        else {
-            *poNResult = DynArray_get(oNParent->oFileChildren, ulChildID);
-            return SUCCESS;
-        }
-    }
-    if(ulChildID >=DynArray_getLength(oNParent->oDirChildren)) {
-        *poNResult = NULL;
-        return NO_SUCH_PATH;
-    }
-    else {
-        *poNResult = DynArray_get(oNParent->oDirChildren, ulChildID);
-        return SUCCESS;
-    } 
+   /* ulChildID is the index into one of oNParent's child arrays */
+   oDChildren = Node_loadChildren(oNParent, bIsFile);
+   if(ulChildID >= DynArray_getLength(oDChildren)) {
+      *poNResult = NULL;
+      return NO_SUCH_PATH;
+   }
+   *poNResult = DynArray_get(oDChildren, ulChildID);
+   return SUCCESS;
 }
 
 /*--------------------------------------------------------------------*/
-Node_T Node_getParent(Node_T oNNode) {
-   assert(oNNode != NULL);
-
-   return oNNode->oNParent;
-}
-
 int Node_compare(Node_T oNFirst, Node_T oNSecond) {
    assert(oNFirst != NULL);
    assert(oNSecond != NULL);
 
-   return Path_comparePath(oNFirst->oPPath, oNSecond->oPPath);
+   return strcmp(oNFirst->pcName, oNSecond->pcName);
 }
 
 /*--------------------------------------------------------------------*/
 char *Node_toString(Node_T oNNode) {
-   char *copyPath;
+   assert(oNNode != NULL);
 
+   return Node_dupName(oNNode->pcName);
+}
+
+/*--------------------------------------------------------------------*/
+void Node_latchShared(Node_T oNNode) {
    assert(oNNode != NULL);
 
-   copyPath = malloc(Path_getStrLength(Node_getPath(oNNode))+1);
-   if(copyPath == NULL)
-      return NULL;
-   else
-      return strcpy(copyPath, Path_getPathname(Node_getPath(oNNode)));
+   (void) pthread_rwlock_rdlock(&oNNode->sLatch);
+}
+
+/*--------------------------------------------------------------------*/
+void Node_latchExclusive(Node_T oNNode) {
+   assert(oNNode != NULL);
+
+   (void) pthread_rwlock_wrlock(&oNNode->sLatch);
+}
+
+/*--------------------------------------------------------------------*/
+void Node_unlatch(Node_T oNNode) {
+   assert(oNNode != NULL);
+
+   (void) pthread_rwlock_unlock(&oNNode->sLatch);
 }
 
+/*--------------------------------------------------------------------*/
+int Node_lookupChild(Node_T oNParent, const char *pcName,
+                     Node_T *poNResult) {
+   DynArray_T oDChildren;
+   size_t ulIndex;
+
+   assert(oNParent != NULL);
+   assert(pcName != NULL);
+   assert(poNResult != NULL);
+
+   if(!oNParent->isFileNode) {
+      oDChildren = Node_loadChildren(oNParent, FALSE);
+      if(DynArray_bsearch(oDChildren, (char*) pcName,
+            &ulIndex, (int (*)(const void*,const void*)) Node_compareString)) {
+         *poNResult = DynArray_get(oDChildren, ulIndex);
+         return SUCCESS;
+      }
+      oDChildren = Node_loadChildren(oNParent, TRUE);
+      if(DynArray_bsearch(oDChildren, (char*) pcName,
+            &ulIndex, (int (*)(const void*,const void*)) Node_compareString)) {
+         *poNResult = DynArray_get(oDChildren, ulIndex);
+         return SUCCESS;
+      }
+   }
+   *poNResult = NULL;
+   return NO_SUCH_PATH;
+}
+
+/*--------------------------------------------------------------------*/
+void Node_mapChildren(Node_T oNParent, boolean bIsFile,
+                      void (*pfApply)(Node_T oNChild, void *pvExtra),
+                      void *pvExtra) {
+   DynArray_T oDChildren;
+   size_t i;
+
+   assert(oNParent != NULL);
+   assert(pfApply != NULL);
+
+   if(oNParent->isFileNode)
+      return;
+
+   oDChildren = Node_loadChildren(oNParent, bIsFile);
+   for(i = 0; i < DynArray_getLength(oDChildren); i++)
+      (*pfApply)(DynArray_get(oDChildren, i), pvExtra);
+}
+
+/*--------------------------------------------------------------------*/
+void Node_mapChildRange(Node_T oNParent, boolean bIsFile,
+                        const char *pcPrefix,
+                        void (*pfApply)(Node_T oNChild, void *pvExtra),
+                        void *pvExtra) {
+   DynArray_T oDChildren;
+   Node_T oNChild;
+   size_t ulPrefixLength;
+   size_t i;
+
+   assert(oNParent != NULL);
+   assert(pcPrefix != NULL);
+   assert(pfApply != NULL);
+
+   if(oNParent->isFileNode)
+      return;
+
+   /* the names starting with pcPrefix sort together, first among
+      those not less than it */
+   ulPrefixLength = strlen(pcPrefix);
+   oDChildren = Node_loadChildren(oNParent, bIsFile);
+   (void) DynArray_bsearch(oDChildren, (char *) pcPrefix, &i,
+            (int (*)(const void *, const void *)) Node_compareString);
+   for(; i < DynArray_getLength(oDChildren); i++) {
+      oNChild = DynArray_get(oDChildren, i);
+      if(strncmp(oNChild->pcName, pcPrefix, ulPrefixLength) != 0)
+         break;
+      (*pfApply)(oNChild, pvExtra);
+   }
+}
+
+/*--------------------------------------------------------------------*/
+void Node_mapChildrenFrom(Node_T oNParent, boolean bIsFile,
+                          const char *pcFrom, boolean bInclusive,
+                          boolean (*pfApply)(Node_T oNChild,
+                                             void *pvExtra),
+                          void *pvExtra) {
+   DynArray_T oDChildren;
+   size_t i = 0;
+
+   assert(oNParent != NULL);
+   assert(pfApply != NULL);
+
+   if(oNParent->isFileNode)
+      return;
+
+   oDChildren = Node_loadChildren(oNParent, bIsFile);
+   if(pcFrom != NULL &&
+      DynArray_bsearch(oDChildren, (char *) pcFrom, &i,
+            (int (*)(const void *, const void *)) Node_compareString) &&
+      !bInclusive)
+      i++;
+   for(; i < DynArray_getLength(oDChildren); i++)
+      if(!(*pfApply)(DynArray_get(oDChildren, i), pvExtra))
+         break;
+}
+
+/*--------------------------------------------------------------------*/
+void Node_mapChildrenAt(Node_T oNParent, boolean bIsFile, size_t ulIndex,
+                        boolean (*pfApply)(Node_T oNChild, void *pvExtra),
+                        void *pvExtra) {
+   DynArray_T oDChildren;
+   size_t i;
+
+   assert(oNParent != NULL);
+   assert(pfApply != NULL);
+
+   if(oNParent->isFileNode)
+      return;
+
+   oDChildren = Node_loadChildren(oNParent, bIsFile);
+   for(i = ulIndex; i < DynArray_getLength(oDChildren); i++)
+      if(!(*pfApply)(DynArray_get(oDChildren, i), pvExtra))
+         break;
+}
@@ -8,63 +8,255 @@
 
 #include <stddef.h>
 #include "a4def.h"
-#include "path.h"
+#include "epoch.h"
+#include "image.h"
+#include "chunkstore.h"
 
 
-/* A Node_T is a node in a File Tree */
+/*
+  A Node_T is a node in a File Tree. A node only knows its own name,
+  the last component of its absolute path: the path is the chain of
+  names from the root down to it, so relinking a node elsewhere moves
+  and renames everything below it at once.
+*/
 typedef struct node *Node_T;
 
 /*
-  Creates a new node in the File Tree, with path oPPath and
+  Creates a new node in the File Tree, named pcName, with
   parent oNParent. Sets the file status of the node to the boolean bIsFile,
   assigns the contents of the node the pvContent and the size of the content
   to ulength and Returns an int SUCCESS status and sets *poNResult
   to be the new node if successful. Otherwise, sets *poNResult to NULL
   and returns status:
   * MEMORY_ERROR if memory could not be allocated to complete request
-  * CONFLICTING_PATH if oNParent's path is not an ancestor of oPPath
-  * NO_SUCH_PATH if oPPath is of depth 0
-                 or oNParent's path is not oPPath's direct parent
-                 or oNParent is NULL but oPPath is not of depth 1
-  * ALREADY_IN_TREE if oNParent already has a child with this path
+  * NOT_A_DIRECTORY if oNParent is a file
+  * CONFLICTING_PATH if oNParent is NULL (the new node is a root) but
+                     bIsFile is TRUE
+  * ALREADY_IN_TREE if oNParent already has a child with this name
+*/
+int Node_new(const char *pcName, Node_T oNParent, boolean bIsFile,
+void *pvContent, size_t ulength, Node_T *poNResult);
+
+/*
+  As Node_new, but does not link the new node into oNParent's
+  children, so that readers cannot reach it until Node_publish. Nodes
+  may be added below it with Node_new meanwhile. oNParent must not be
+  NULL.
+*/
+int Node_newUnpublished(const char *pcName, Node_T oNParent,
+                        boolean bIsFile, void *pvContent, size_t ulength,
+                        Node_T *poNResult);
+
+/*
+  Creates a new node, linked nowhere yet, from the record ulRecord of
+  oImage, which it holds a reference to. A file's contents are those
+  within oImage's mapping. A directory's children are read from oImage
+  one level at a time, the first time each is looked at, even by a
+  lock-free reader; if memory runs out then, the directory looks empty
+  until it is looked at again, and changing its children fails with
+  MEMORY_ERROR. Returns SUCCESS and sets *poNResult to the new node,
+  or sets it to NULL and returns MEMORY_ERROR.
+*/
+int Node_newFromImage(Image_T oImage, Image_Offset ulRecord,
+                      Node_T *poNResult);
+
+/*
+  Links oNNode, made by Node_newUnpublished with parent oNParent, by
+  Node_new with no parent, or by Node_copy, and not linked anywhere
+  yet, into oNParent's children, which must not have one of the same
+  name. If oEpoch is not NULL,
+  this publishes a copy of the parent's child array, which lock-free
+  readers see either whole or not at all, and the old array is retired
+  into oEpoch. The caller holds the parent's latch exclusively.
+  Returns SUCCESS, or MEMORY_ERROR, in which case oNNode is still
+  unpublished.
+*/
+int Node_publish(Node_T oNParent, Node_T oNNode, Epoch_T oEpoch);
+
+/*
+  Unlinks the subtree rooted at oNNode from its parent oNParent (which
+  is NULL if oNNode is a root, already unlinked by the caller), waits
+  for writers already inside it to finish, and drops the reference
+  that linked it as by Node_release. If oEpoch is not NULL, the
+  parent's children are replaced as by Node_publish. The caller holds
+  the parent's latch exclusively, but not oNNode's. Returns SUCCESS,
+  or MEMORY_ERROR, in which case the subtree is still linked.
+*/
+int Node_remove(Node_T oNParent, Node_T oNNode, Epoch_T oEpoch);
+
+/*
+  Nodes and their child arrays are reference counted, so that a node
+  may be linked from several parents or trees: each node starts with
+  one reference, held by whatever links it, and is freed together with
+  everything below it that nothing else uses once the last one is
+  dropped. Only nodes and arrays with a single reference are ever
+  changed in place; Node_unshareChild copies the others first.
+*/
+
+/* Takes another reference to oNNode. */
+void Node_retain(Node_T oNNode);
+
+/*
+  Drops a reference to oNNode. If oEpoch is not NULL, the reference is
+  dropped once no lock-free reader in oEpoch can still be looking at
+  oNNode, and the caller must not be inside a read-side section.
+*/
+void Node_release(Node_T oNNode, Epoch_T oEpoch);
+
+/* Returns TRUE if more than one reference to oNNode is held. */
+boolean Node_isShared(Node_T oNNode);
+
+/*
+  Creates a new node with the same type and contents as oNNode, named
+  pcName (or as oNNode if pcName is NULL), sharing oNNode's child
+  arrays, and holding a single reference. Returns SUCCESS and sets
+  *poNResult to the copy, or sets it to NULL and returns MEMORY_ERROR.
 */
-int Node_new(Path_T oPPath, Node_T oNParent, boolean bIsFile, void *pvContent, 
-size_t ulength, Node_T *poNResult);
+int Node_copy(Node_T oNNode, const char *pcName, Node_T *poNResult);
 
 /*
-  Destroys and frees all memory allocated for the subtree rooted at
-  oNNode, i.e., deletes this node and all its descendents. Returns the
-  number of nodes deleted.
+  Makes the child oNChild of oNParent, which must itself be used only
+  once, safe to change: copies the array of oNParent's children that
+  holds oNChild if another node shares it, and then oNChild if another
+  array links to it, replacing it in the array. Arrays are replaced and
+  references dropped as by Node_publish and Node_release with oEpoch.
+  Returns SUCCESS and sets *poNResult to the node now linked in
+  oNChild's place, which may be oNChild itself, or sets it to NULL and
+  returns MEMORY_ERROR.
 */
-size_t Node_free(Node_T oNNode);
+int Node_unshareChild(Node_T oNParent, Node_T oNChild, Epoch_T oEpoch,
+                      Node_T *poNResult);
+
+/*
+  Returns TRUE if Node_unshareChild would copy anything to make the
+  child oNChild of oNParent safe to change: oNChild, or the array of
+  oNParent's children that holds it. Safe under a shared latch on
+  oNParent.
+*/
+boolean Node_isChildShared(Node_T oNParent, Node_T oNChild);
+
+/*
+  Moves the child oNNode of oNOldParent to oNNewParent, which may be
+  the same node, under the name pcName, which no child of oNNewParent
+  has yet. The whole subtree moves with it in constant time: oNNode is
+  replaced by a copy named pcName that shares its children, and the
+  parents' arrays are replaced as by Node_publish with oEpoch, the new
+  one first, so that a lock-free reader racing the move may find the
+  subtree in both places but never in neither. Both parents must be
+  used only once. Returns SUCCESS, or MEMORY_ERROR, in which case
+  nothing changed.
+*/
+int Node_relink(Node_T oNOldParent, Node_T oNNode, Node_T oNNewParent,
+                const char *pcName, Epoch_T oEpoch);
 
 /*Replaces the old content. Takes oNNode, newContent, and length as arguments
-and return a void pointer. */
-void *Node_replaceOldContent(Node_T oNNode, void *newContent, size_t length);
+and return a void pointer. If the old content lay in a buffer the node
+owns, the buffer is dropped as by Node_release with oEpoch and NULL is
+returned. */
+void *Node_replaceOldContent(Node_T oNNode, void *newContent, size_t length,
+                             Epoch_T oEpoch);
 
-/* Takes oNNode as an argument and returns the path object representing 
-oNNode's absolute path. */
-Path_T Node_getPath(Node_T oNNode);
+/*
+  Makes the chunks oChunks the contents of the file oNNode, taking a
+  reference to them, and its size theirs. Returns the old contents if
+  they were the client's, or drops them as by Node_replaceOldContent
+  and returns NULL. The caller holds oNNode's latch exclusively.
+*/
+void *Node_replaceChunks(Node_T oNNode, ChunkList_T oChunks,
+                         Epoch_T oEpoch);
+
+/*
+  Makes the contents of the file oNNode, which lie within the
+  read-only mapping pvMap of ulMapLength bytes, the FT's, as if they
+  lay in a buffer the node owns: copies of the node share the mapping,
+  which is unmapped once none uses it, and Node_writeContent copies
+  the contents out first. oNNode must hold neither a buffer nor
+  chunks, and no reader can reach it yet. Returns SUCCESS, or
+  MEMORY_ERROR, in which case the mapping is still the caller's.
+*/
+int Node_adoptMapping(Node_T oNNode, void *pvMap, size_t ulMapLength);
+
+/*
+  Copies up to ulCount bytes of the contents of the file oNNode, from
+  offset ulOffset on, to pvDest, as zeros if the file has no contents,
+  and returns how many were copied, fewer than ulCount only at the end
+  of the file, or if memory to decompress cold chunks runs out, or
+  spilled ones cannot be read back.
+*/
+size_t Node_readContent(Node_T oNNode, size_t ulOffset, void *pvDest,
+                        size_t ulCount);
+
+/*
+  Writes up to ulCount bytes of the contents of the file oNNode, from
+  offset ulOffset on, to the file descriptor iFd, as zeros if the file
+  has no contents, and sets *pulSent to how many were written, fewer
+  than ulCount only at the end of the file or on failure. Contents
+  that lie in a mapping of a file, from Node_adoptMapping or an image,
+  are spliced by reference as by Send_mapped of send.h, chunks are sent
+  as by ChunkList_send, and other contents are written from where they
+  lie. Returns SUCCESS, or the status ChunkList_send returns, or
+  IO_ERROR if a write failed, in which case errno tells why.
+*/
+int Node_sendContent(Node_T oNNode, size_t ulOffset, size_t ulCount,
+                     int iFd, size_t *pulSent);
+
+/*
+  Writes the ulCount bytes pvBytes into the contents of the file
+  oNNode at offset ulOffset, extending the file if they end past it,
+  with zeros filling any gap. The bytes are written in place if the
+  contents lie in a buffer the node owns, that no copy of it shares,
+  with room for them. Otherwise the contents are first copied into a
+  new buffer, with room to spare if the file grows, so that appending
+  takes time in proportion to what is appended; the old buffer is
+  dropped as by Node_release with oEpoch, and contents the node did
+  not own are left to their owner, while chunks are dropped, so that
+  the file shares them no more. The caller holds oNNode's latch
+  exclusively. Returns SUCCESS, or MEMORY_ERROR, in which case the
+  contents are unchanged.
+*/
+int Node_writeContent(Node_T oNNode, size_t ulOffset,
+                      const void *pvBytes, size_t ulCount,
+                      Epoch_T oEpoch);
+
+/* Takes oNNode as an argument and returns its name, the last component
+of its absolute path. */
+const char *Node_getName(Node_T oNNode);
 
 /* Checks if it is file. Takes oNNode as an argument and return TRUE 
 when the node is a file but FALSE otherwiae. */
 boolean Node_isFileNode(Node_T oNNode);
 
-/*Takes oNNode as an argument and return its content */
+/*Takes oNNode as an argument and return its content. Contents held
+as chunks are assembled in one piece as by ChunkList_getBytes, and
+NULL is returned if memory for that could not be allocated. */
 void *Node_getFileContent(Node_T oNNode);
 
+/* Returns TRUE if the contents of the file oNNode are held as chunks,
+   which are read safely only through Node_readContent and
+   Node_sendContent, FALSE otherwise. */
+boolean Node_hasChunks(Node_T oNNode);
+
 /* Returns the number of file children that oNParent has. */
 size_t Node_getNumFileChildren(Node_T oNParent);
 
 /* Returns the number of directory children that oNParent has. */
 size_t Node_getNumDirChildren(Node_T oNParent);
 
+/*
+  Returns the number of bytes of memory the contents of the file
+  oNNode take, divided among the files that share them, as by
+  ChunkList_getStored: its size if they are the client's alone, or 0
+  if it has none, or they lie in a mapping (see Node_adoptMapping).
+  Safe where Node_readContent is.
+*/
+size_t Node_getStoredSize(Node_T oNNode);
+
 /*It takes a node oNNode and returns the size of the file. If it is not 
 a file, it returns 0 if it is a directory */
 size_t Node_getFileSize(Node_T oNNode);
 
 /*
-  Returns TRUE if oNParent has a directory Child with path oPPath.
+  Returns TRUE if oNParent has a directory Child named pcName.
   Returns FALSE if it does not.
 
   If oNParent has such a child, stores in *pulChildID the child's
@@ -72,12 +264,12 @@ size_t Node_getFileSize(Node_T oNNode);
   such a child, stores in *pulChildID the identifier that such a
   child _would_ have if inserted.
 */
-boolean Node_hasDirChild(Node_T oNParent, Path_T oPPath,
+boolean Node_hasDirChild(Node_T oNParent, const char *pcName,
                          size_t *pulChildID);
 
 
 /*
-  Returns TRUE if oNParent has a file child with path oPPath. Returns
+  Returns TRUE if oNParent has a file child named pcName. Returns
   FALSE if it does not.
 
   If oNParent has such a child, stores in *pulChildID the child's
@@ -85,7 +277,7 @@ boolean Node_hasDirChild(Node_T oNParent, Path_T oPPath,
   such a child, stores in *pulChildID the identifier that such a
   child _would_ have if inserted.
 */
-boolean Node_hasFileChild(Node_T oNParent, Path_T oPPath,
+boolean Node_hasFileChild(Node_T oNParent, const char *pcName,
                          size_t *pulChildID);
 
 /*
@@ -100,20 +292,14 @@ int Node_getChild(Node_T oNParent, size_t ulChildID, boolean bIsFile,
                   Node_T *poNResult);
 
 /*
-  Returns a the parent node of oNNode.
-  Returns NULL if oNNode is the root and thus has no parent.
-*/
-Node_T Node_getParent(Node_T oNNode);
-
-/*
-  Compares oNFirst and oNSecond lexicographically based on their paths.
+  Compares oNFirst and oNSecond lexicographically based on their names.
   Returns <0, 0, or >0 if onFirst is "less than", "equal to", or
   "greater than" oNSecond, respectively.
 */
 int Node_compare(Node_T oNFirst, Node_T oNSecond);
 
 /*
-  Returns a string representation for oNNode, or NULL if
+  Returns a string representation for oNNode, its name, or NULL if
   there is an allocation error.
 
   Allocates memory for the returned string, which is then owned by
@@ -121,4 +307,74 @@ int Node_compare(Node_T oNFirst, Node_T oNSecond);
 */
 char *Node_toString(Node_T oNNode);
 
+/*
+  Acquires oNNode's latch for reading, which other readers may hold
+  at the same time. Node_getChild, Node_has*Child, Node_getFileContent
+  and Node_getFileSize are safe under a shared latch.
+*/
+void Node_latchShared(Node_T oNNode);
+
+/*
+  Acquires oNNode's latch for writing, excluding all other holders.
+  Adding children to oNNode (via Node_new), removing them (via
+  Node_remove), Node_replaceOldContent, Node_replaceChunks and
+  Node_writeContent require an exclusive latch; Node_readContent needs
+  a shared one if writers may be at work.
+*/
+void Node_latchExclusive(Node_T oNNode);
+
+/* Releases the latch on oNNode held by the calling thread. */
+void Node_unlatch(Node_T oNNode);
+
+/*
+  Sets *poNResult to oNParent's child, file or directory, named
+  pcName and returns SUCCESS, or sets it to NULL and returns
+  NO_SUCH_PATH if there is none. Safe without any latch while the
+  caller is inside a read-side section of the tree's epoch.
+*/
+int Node_lookupChild(Node_T oNParent, const char *pcName,
+                     Node_T *poNResult);
+
+/*
+  Calls (*pfApply)(oNChild, pvExtra) for each file child of oNParent
+  if bIsFile is TRUE, or each directory child otherwise, in order.
+  Visits one consistent version of the children, so it is safe where
+  Node_lookupChild is.
+*/
+void Node_mapChildren(Node_T oNParent, boolean bIsFile,
+                      void (*pfApply)(Node_T oNChild, void *pvExtra),
+                      void *pvExtra);
+
+/*
+  As Node_mapChildren, but only for the children whose names start
+  with pcPrefix, which are found by binary search, so the others cost
+  nothing.
+*/
+void Node_mapChildRange(Node_T oNParent, boolean bIsFile,
+                        const char *pcPrefix,
+                        void (*pfApply)(Node_T oNChild, void *pvExtra),
+                        void *pvExtra);
+
+/*
+  Calls (*pfApply)(oNChild, pvExtra) for the file children of
+  oNParent if bIsFile is TRUE, or its directory children otherwise, in
+  order, until it returns FALSE. Starts with the first child whose name
+  is not less than pcFrom if bInclusive is TRUE, or greater than it
+  otherwise, found by binary search, or with the first child of all if
+  pcFrom is NULL. Safe where Node_mapChildren is.
+*/
+void Node_mapChildrenFrom(Node_T oNParent, boolean bIsFile,
+                          const char *pcFrom, boolean bInclusive,
+                          boolean (*pfApply)(Node_T oNChild,
+                                             void *pvExtra),
+                          void *pvExtra);
+
+/*
+  As Node_mapChildrenFrom, but starts with the child whose identifier
+  (as used in Node_getChild) is ulIndex, if there is one.
+*/
+void Node_mapChildrenAt(Node_T oNParent, boolean bIsFile, size_t ulIndex,
+                        boolean (*pfApply)(Node_T oNChild, void *pvExtra),
+                        void *pvExtra);
+
 #endif
@@ -0,0 +1,330 @@
+/*--------------------------------------------------------------------*/
+/* pattern.c                                                          */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include "pattern.h"
+
+/* The most components a pattern may have: one bit of a Pattern_State
+   is needed for each, and one more for having matched them all */
+enum { MAX_COMPONENTS = sizeof(Pattern_State) * CHAR_BIT - 1 };
+
+/* One component of a pattern */
+struct component {
+   /* the component itself */
+   char *pcText;
+   /* the literal characters it starts with, which every name it
+      matches starts with as well */
+   char *pcPrefix;
+   /* TRUE if the component is "**" */
+   boolean bAnyDepth;
+};
+
+/* A compiled glob pattern */
+struct pattern {
+   /* the number of components */
+   size_t ulLength;
+   /* the components, from the root down */
+   struct component *psComponents;
+   /* the text of every component and prefix, each NUL-terminated */
+   char *pcStrings;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the Pattern_State holding position ulPosition alone. */
+static Pattern_State Pattern_bit(size_t ulPosition) {
+   return (Pattern_State) 1 << ulPosition;
+}
+
+/*
+  Returns the ']' that closes the "[...]" starting at pcClass, or NULL
+  if it is not closed. A ']' right after the '[' or after its '!' or
+  '^' is a member rather than the end.
+*/
+static const char *Pattern_classEnd(const char *pcClass) {
+   assert(pcClass != NULL);
+   assert(*pcClass == '[');
+
+   pcClass++;
+   if(*pcClass == '!' || *pcClass == '^')
+      pcClass++;
+   if(*pcClass == '\0')
+      return NULL;
+   return strchr(pcClass + 1, ']');
+}
+
+/*
+  Matches the character c against the element of a component that
+  starts at pcGlob, which is not '*' or the end: '?', a "[...]" or a
+  literal character. Sets *pbMatched to TRUE if c matches it, and
+  returns the start of the next element.
+*/
+static const char *Pattern_matchChar(const char *pcGlob, char c,
+                                     boolean *pbMatched) {
+   const char *pcEnd;
+   boolean bNegated = FALSE;
+   boolean bFound = FALSE;
+
+   assert(pcGlob != NULL);
+   assert(pbMatched != NULL);
+
+   if(*pcGlob == '?') {
+      *pbMatched = TRUE;
+      return pcGlob + 1;
+   }
+   if(*pcGlob != '[') {
+      *pbMatched = (*pcGlob == c);
+      return pcGlob + 1;
+   }
+
+   /* compiled patterns only hold closed classes */
+   pcEnd = Pattern_classEnd(pcGlob);
+   assert(pcEnd != NULL);
+   pcGlob++;
+   if(*pcGlob == '!' || *pcGlob == '^') {
+      bNegated = TRUE;
+      pcGlob++;
+   }
+   do {
+      if(pcGlob[1] == '-' && pcGlob + 2 < pcEnd) {
+         if((unsigned char) pcGlob[0] <= (unsigned char) c &&
+            (unsigned char) c <= (unsigned char) pcGlob[2])
+            bFound = TRUE;
+         pcGlob += 3;
+      }
+      else {
+         if(*pcGlob == c)
+            bFound = TRUE;
+         pcGlob++;
+      }
+   } while(pcGlob < pcEnd);
+
+   *pbMatched = (bFound != bNegated);
+   return pcEnd + 1;
+}
+
+/*
+  Returns TRUE if the name pcName matches the component pcGlob as a
+  whole. A '*' that fails to match is retried one character further
+  on, and only the latest '*' needs retrying, so this takes time
+  proportional to the product of the two lengths at worst.
+*/
+static boolean Pattern_matchComponent(const char *pcGlob,
+                                      const char *pcName) {
+   const char *pcStar = NULL;
+   const char *pcRetry = NULL;
+   const char *pcNext;
+   boolean bMatched = FALSE;
+
+   assert(pcGlob != NULL);
+   assert(pcName != NULL);
+
+   while(*pcName != '\0') {
+      if(*pcGlob == '*') {
+         pcStar = ++pcGlob;
+         pcRetry = pcName;
+         continue;
+      }
+      if(*pcGlob != '\0') {
+         pcNext = Pattern_matchChar(pcGlob, *pcName, &bMatched);
+         if(bMatched) {
+            pcGlob = pcNext;
+            pcName++;
+            continue;
+         }
+      }
+      if(pcStar == NULL)
+         return FALSE;
+      /* let the latest '*' swallow one more character */
+      pcGlob = pcStar;
+      pcName = ++pcRetry;
+   }
+
+   while(*pcGlob == '*')
+      pcGlob++;
+   return *pcGlob == '\0';
+}
+
+/*
+  Returns sState together with every position reachable from it
+  without matching a component, which is past any "**".
+*/
+static Pattern_State Pattern_close(Pattern_T oPattern,
+                                   Pattern_State sState) {
+   size_t i;
+
+   assert(oPattern != NULL);
+
+   for(i = 0; i < oPattern->ulLength; i++)
+      if((sState & Pattern_bit(i)) &&
+         oPattern->psComponents[i].bAnyDepth)
+         sState |= Pattern_bit(i + 1);
+   return sState;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Pattern_new(const char *pcPattern, Pattern_T *poPResult) {
+   Pattern_T oPattern;
+   struct component *psComponent;
+   const char *pcCurr;
+   const char *pcEnd;
+   char *pcOut;
+   size_t ulLength;
+   size_t ulComponents = 1;
+   size_t ulTextLength;
+   size_t i;
+
+   assert(pcPattern != NULL);
+   assert(poPResult != NULL);
+
+   *poPResult = NULL;
+   ulLength = strlen(pcPattern);
+
+   /* the same shape as a path: no empty components */
+   if(ulLength == 0 || pcPattern[0] == '/' ||
+      pcPattern[ulLength - 1] == '/' || strstr(pcPattern, "//") != NULL)
+      return BAD_PATH;
+   for(i = 0; i < ulLength; i++) {
+      if(pcPattern[i] == '/')
+         ulComponents++;
+      else if(pcPattern[i] == '[') {
+         pcEnd = Pattern_classEnd(pcPattern + i);
+         if(pcEnd == NULL || memchr(pcPattern + i, '/',
+                                    (size_t) (pcEnd - pcPattern - i)))
+            return BAD_PATH;
+         i = (size_t) (pcEnd - pcPattern);
+      }
+   }
+   if(ulComponents > MAX_COMPONENTS)
+      return BAD_PATH;
+
+   oPattern = malloc(sizeof(struct pattern));
+   if(oPattern == NULL)
+      return MEMORY_ERROR;
+   oPattern->psComponents = malloc(ulComponents *
+                                   sizeof(struct component));
+   /* each component and its prefix, which is no longer */
+   oPattern->pcStrings = malloc(2 * (ulLength + 1));
+   if(oPattern->psComponents == NULL || oPattern->pcStrings == NULL) {
+      Pattern_free(oPattern);
+      return MEMORY_ERROR;
+   }
+
+   oPattern->ulLength = 0;
+   pcOut = oPattern->pcStrings;
+   for(pcCurr = pcPattern; pcCurr != NULL;
+       pcCurr = (*pcEnd == '/') ? pcEnd + 1 : NULL) {
+      pcEnd = strchr(pcCurr, '/');
+      if(pcEnd == NULL)
+         pcEnd = pcCurr + strlen(pcCurr);
+      ulTextLength = (size_t) (pcEnd - pcCurr);
+
+      /* "**" twice in a row matches nothing more than once does */
+      if(ulTextLength == 2 && !strncmp(pcCurr, "**", 2) &&
+         oPattern->ulLength > 0 &&
+         oPattern->psComponents[oPattern->ulLength - 1].bAnyDepth)
+         continue;
+
+      psComponent = &oPattern->psComponents[oPattern->ulLength++];
+      psComponent->bAnyDepth =
+         (ulTextLength == 2 && !strncmp(pcCurr, "**", 2));
+      psComponent->pcText = pcOut;
+      memcpy(pcOut, pcCurr, ulTextLength);
+      pcOut[ulTextLength] = '\0';
+      pcOut += ulTextLength + 1;
+      psComponent->pcPrefix = pcOut;
+      ulTextLength = strcspn(psComponent->pcText, "*?[");
+      memcpy(pcOut, psComponent->pcText, ulTextLength);
+      pcOut[ulTextLength] = '\0';
+      pcOut += ulTextLength + 1;
+   }
+
+   *poPResult = oPattern;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void Pattern_free(Pattern_T oPattern) {
+   if(oPattern == NULL)
+      return;
+
+   free(oPattern->psComponents);
+   free(oPattern->pcStrings);
+   free(oPattern);
+}
+
+/*--------------------------------------------------------------------*/
+
+Pattern_State Pattern_start(Pattern_T oPattern) {
+   assert(oPattern != NULL);
+
+   return Pattern_close(oPattern, Pattern_bit(0));
+}
+
+/*--------------------------------------------------------------------*/
+
+Pattern_State Pattern_step(Pattern_T oPattern, Pattern_State sState,
+                           const char *pcName) {
+   Pattern_State sNext = 0;
+   struct component *psComponent;
+   size_t i;
+
+   assert(oPattern != NULL);
+   assert(pcName != NULL);
+
+   for(i = 0; i < oPattern->ulLength; i++) {
+      if(!(sState & Pattern_bit(i)))
+         continue;
+      psComponent = &oPattern->psComponents[i];
+      /* "**" may take this component and more after it */
+      if(psComponent->bAnyDepth)
+         sNext |= Pattern_bit(i);
+      else if(Pattern_matchComponent(psComponent->pcText, pcName))
+         sNext |= Pattern_bit(i + 1);
+   }
+   return Pattern_close(oPattern, sNext);
+}
+
+/*--------------------------------------------------------------------*/
+
+boolean Pattern_isMatch(Pattern_T oPattern, Pattern_State sState) {
+   assert(oPattern != NULL);
+
+   return (sState & Pattern_bit(oPattern->ulLength)) != 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+boolean Pattern_canExtend(Pattern_T oPattern, Pattern_State sState) {
+   assert(oPattern != NULL);
+
+   return (sState & ~Pattern_bit(oPattern->ulLength)) != 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+const char *Pattern_getPrefix(Pattern_T oPattern, Pattern_State sState) {
+   struct component *psComponent;
+   size_t i;
+
+   assert(oPattern != NULL);
+
+   sState &= ~Pattern_bit(oPattern->ulLength);
+   /* with several positions live, a name need only suit one of them */
+   if(sState == 0 || (sState & (sState - 1)) != 0)
+      return NULL;
+
+   for(i = 0; !(sState & Pattern_bit(i)); i++)
+      ;
+   psComponent = &oPattern->psComponents[i];
+   if(psComponent->bAnyDepth || psComponent->pcPrefix[0] == '\0')
+      return NULL;
+   return psComponent->pcPrefix;
+}
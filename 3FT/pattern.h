@@ -0,0 +1,71 @@
+/*--------------------------------------------------------------------*/
+/* pattern.h                                                          */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef PATTERN_INCLUDED
+#define PATTERN_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A Pattern_T is a compiled glob pattern over absolute paths. Like a
+  path, a pattern is a sequence of components separated by '/'. In a
+  component, '*' matches any run of characters, '?' any one character,
+  and "[...]" any one of the characters listed, which may include
+  ranges such as "a-z", or any character not listed if the list starts
+  with '!' or '^'. Every other character matches itself. A component
+  that is exactly "**" matches any number of components, including
+  none.
+
+  A path is matched one component at a time, from the root down, so
+  that a walk of a tree can give up on a directory as soon as nothing
+  below it can match. The progress of a match is a set of positions in
+  the pattern, represented as a bit mask.
+*/
+typedef struct pattern *Pattern_T;
+
+/* The progress of a match of a Pattern_T */
+typedef unsigned long Pattern_State;
+
+/*
+  Compiles pcPattern. Returns SUCCESS and sets *poPResult to the new
+  pattern if successful. Otherwise, sets *poPResult to NULL and
+  returns:
+  * BAD_PATH if pcPattern is not a well-formatted path, has a "[...]"
+             that is not closed, or has more components than fit in a
+             Pattern_State less one
+  * MEMORY_ERROR if memory could not be allocated to complete request
+*/
+int Pattern_new(const char *pcPattern, Pattern_T *poPResult);
+
+/* Frees oPattern. Does nothing if oPattern is NULL. */
+void Pattern_free(Pattern_T oPattern);
+
+/* Returns the state of a match of oPattern before any component. */
+Pattern_State Pattern_start(Pattern_T oPattern);
+
+/*
+  Returns the state of a match of oPattern that was in state sState
+  once it has matched one more component, named pcName.
+*/
+Pattern_State Pattern_step(Pattern_T oPattern, Pattern_State sState,
+                           const char *pcName);
+
+/* Returns TRUE if the components matched to reach sState match all of
+   oPattern. */
+boolean Pattern_isMatch(Pattern_T oPattern, Pattern_State sState);
+
+/* Returns TRUE if some further components could be matched from
+   sState, and FALSE if no longer path can match oPattern. */
+boolean Pattern_canExtend(Pattern_T oPattern, Pattern_State sState);
+
+/*
+  Returns a string that the name of the next component must start with
+  to be matched from sState, or NULL if any name might be. The string
+  belongs to oPattern.
+*/
+const char *Pattern_getPrefix(Pattern_T oPattern, Pattern_State sState);
+
+#endif
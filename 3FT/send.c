@@ -0,0 +1,238 @@
+/*--------------------------------------------------------------------*/
+/* send.c                                                             */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include "ft.h"
+#include "send.h"
+
+/* The bytes of zeros and of a file copied through memory at a time,
+   where nothing better will do */
+enum { SEND_BUFFER = 16384 };
+
+/* The room asked for in the pipe Send_mapped splices through, which
+   bounds the bytes moved per pair of calls */
+enum { SEND_PIPE = 1024 * 1024 };
+
+/*--------------------------------------------------------------------*/
+
+/* Returns IO_ERROR, with errno set to EIO if a transfer of lDone
+   bytes failed without saying why. */
+static int Send_fail(ssize_t lDone) {
+   if(lDone == 0)
+      errno = EIO;
+   return IO_ERROR;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Send_bytes(int iFd, const void *pvBytes, size_t ulCount,
+               size_t *pulSent) {
+   static const char acZeros[SEND_BUFFER];
+   const char *pcBytes = pvBytes;
+   size_t ulTake;
+   ssize_t lDone;
+
+   assert(pulSent != NULL);
+
+   while(ulCount > 0) {
+      ulTake = ulCount;
+      if(pcBytes == NULL && ulTake > SEND_BUFFER)
+         ulTake = SEND_BUFFER;
+      lDone = write(iFd, pcBytes != NULL ? pcBytes : acZeros, ulTake);
+      if(lDone < 0 && errno == EINTR)
+         continue;
+      if(lDone <= 0)
+         return Send_fail(lDone);
+      if(pcBytes != NULL)
+         pcBytes += lDone;
+      ulCount -= (size_t) lDone;
+      *pulSent += (size_t) lDone;
+   }
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Send_vector(int iFd, struct iovec *psVector, size_t ulCount,
+                size_t *pulSent) {
+   size_t ulDone;
+   ssize_t lDone;
+
+   assert(psVector != NULL || ulCount == 0);
+   assert(pulSent != NULL);
+
+   while(ulCount > 0) {
+      /* the pieces written already, and empty ones, are skipped */
+      if(psVector->iov_len == 0) {
+         psVector++;
+         ulCount--;
+         continue;
+      }
+      lDone = writev(iFd, psVector,
+                     ulCount < IOV_MAX ? (int) ulCount : IOV_MAX);
+      if(lDone < 0 && errno == EINTR)
+         continue;
+      if(lDone <= 0)
+         return Send_fail(lDone);
+      *pulSent += (size_t) lDone;
+      for(ulDone = (size_t) lDone; ulDone > 0; ) {
+         if(ulDone < psVector->iov_len) {
+            psVector->iov_base = (char *) psVector->iov_base + ulDone;
+            psVector->iov_len -= ulDone;
+            break;
+         }
+         ulDone -= psVector->iov_len;
+         psVector->iov_len = 0;
+         psVector++;
+         ulCount--;
+      }
+   }
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Splices the ulCount bytes pcBytes into the pipe iPipe by reference,
+   as Send_mapped does when iFd is a pipe, and returns as it does. */
+static int Send_toPipe(int iPipe, const char *pcBytes, size_t ulCount,
+                       size_t *pulSent) {
+   struct iovec sVector;
+   ssize_t lDone;
+
+   while(ulCount > 0) {
+      sVector.iov_base = (void *) pcBytes;
+      sVector.iov_len = ulCount;
+      lDone = vmsplice(iPipe, &sVector, 1, 0);
+      if(lDone < 0 && errno == EINTR)
+         continue;
+      if(lDone <= 0)
+         return Send_fail(lDone);
+      pcBytes += lDone;
+      ulCount -= (size_t) lDone;
+      *pulSent += (size_t) lDone;
+   }
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Send_mapped(int iFd, const void *pvBytes, size_t ulCount,
+                size_t *pulSent) {
+   const char *pcBytes = pvBytes;
+   struct stat sStat;
+   struct iovec sVector;
+   int aiPipe[2];
+   size_t ulRoom, ulQueued;
+   ssize_t lDone;
+   int iStatus = SUCCESS;
+
+   assert(pvBytes != NULL || ulCount == 0);
+   assert(pulSent != NULL);
+
+   if(ulCount == 0)
+      return SUCCESS;
+   if(fstat(iFd, &sStat) == 0 && S_ISFIFO(sStat.st_mode))
+      return Send_toPipe(iFd, pcBytes, ulCount, pulSent);
+   if(pipe2(aiPipe, O_CLOEXEC) != 0)
+      return Send_bytes(iFd, pcBytes, ulCount, pulSent);
+   (void) fcntl(aiPipe[1], F_SETPIPE_SZ, SEND_PIPE);
+   lDone = fcntl(aiPipe[1], F_GETPIPE_SZ);
+   /* a pipe holds at least a page */
+   ulRoom = lDone > 0 ? (size_t) lDone : 4096;
+
+   while(ulCount > 0 && iStatus == SUCCESS) {
+      /* no more than the pipe holds, so that this never blocks */
+      sVector.iov_base = (void *) pcBytes;
+      sVector.iov_len = ulCount < ulRoom ? ulCount : ulRoom;
+      lDone = vmsplice(aiPipe[1], &sVector, 1, 0);
+      if(lDone < 0 && errno == EINTR)
+         continue;
+      if(lDone <= 0) {
+         iStatus = Send_bytes(iFd, pcBytes, ulCount, pulSent);
+         break;
+      }
+
+      /* what is left in the pipe on failure is dropped with it */
+      for(ulQueued = (size_t) lDone; ulQueued > 0; ) {
+         lDone = splice(aiPipe[0], NULL, iFd, NULL, ulQueued,
+                        SPLICE_F_MOVE |
+                        (ulCount > ulQueued ? SPLICE_F_MORE : 0));
+         if(lDone < 0 && errno == EINTR)
+            continue;
+         if(lDone < 0 && errno == EINVAL) {
+            iStatus = Send_bytes(iFd, pcBytes, ulCount, pulSent);
+            break;
+         }
+         if(lDone <= 0) {
+            iStatus = Send_fail(lDone);
+            break;
+         }
+         pcBytes += lDone;
+         ulCount -= (size_t) lDone;
+         ulQueued -= (size_t) lDone;
+         *pulSent += (size_t) lDone;
+      }
+      /* Send_bytes wrote the rest, if it was called */
+      if(ulQueued > 0)
+         break;
+   }
+
+   (void) close(aiPipe[0]);
+   (void) close(aiPipe[1]);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Send_file(int iFd, int iInFd, size_t ulOffset, size_t ulCount,
+              size_t *pulSent) {
+   char acBuffer[SEND_BUFFER];
+   off_t lOffset;
+   size_t ulTake;
+   ssize_t lDone;
+   int iStatus;
+
+   assert(pulSent != NULL);
+
+   while(ulCount > 0) {
+      lOffset = (off_t) ulOffset;
+      lDone = sendfile(iFd, iInFd, &lOffset, ulCount);
+      if(lDone < 0 && errno == EINTR)
+         continue;
+      if(lDone < 0 && (errno == EINVAL || errno == ENOSYS))
+         break;
+      if(lDone <= 0)
+         return Send_fail(lDone);
+      ulOffset += (size_t) lDone;
+      ulCount -= (size_t) lDone;
+      *pulSent += (size_t) lDone;
+   }
+
+   /* iFd takes no sendfile, as one opened with O_APPEND */
+   while(ulCount > 0) {
+      ulTake = ulCount < SEND_BUFFER ? ulCount : SEND_BUFFER;
+      lDone = pread(iInFd, acBuffer, ulTake, (off_t) ulOffset);
+      if(lDone < 0 && errno == EINTR)
+         continue;
+      if(lDone <= 0)
+         return Send_fail(lDone);
+      ulTake = (size_t) lDone;
+      iStatus = Send_bytes(iFd, acBuffer, ulTake, pulSent);
+      if(iStatus != SUCCESS)
+         return iStatus;
+      ulOffset += ulTake;
+      ulCount -= ulTake;
+   }
+   return SUCCESS;
+}
@@ -0,0 +1,55 @@
+/*--------------------------------------------------------------------*/
+/* send.h                                                             */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef SEND_INCLUDED
+#define SEND_INCLUDED
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include "a4def.h"
+
+/*
+  Ways of writing bytes to a file descriptor that copy as little as
+  the bytes allow: bytes in memory of the caller's are copied once,
+  by the kernel; those in a mapping of a file, and those of a file,
+  are handed over by reference where the descriptor takes them so. Each
+  function carries on after partial transfers and interruptions, adds
+  how many bytes it wrote to *pulSent, and returns SUCCESS once all of
+  them were, or IO_ERROR (from ft.h) if a write failed, in which case
+  errno tells why: EAGAIN if the descriptor is non-blocking and full.
+*/
+
+/* Writes the ulCount bytes pvBytes, or as many zeros if pvBytes is
+   NULL, to iFd. */
+int Send_bytes(int iFd, const void *pvBytes, size_t ulCount,
+               size_t *pulSent);
+
+/* Writes the bytes of the ulCount pieces psVector in order to iFd,
+   with as few calls as it can, changing psVector as it goes. */
+int Send_vector(int iFd, struct iovec *psVector, size_t ulCount,
+                size_t *pulSent);
+
+/*
+  Writes the ulCount bytes pvBytes, which lie in a read-only mapping
+  of a file, to iFd, spliced into a pipe by reference and on from
+  there, or straight into iFd if it is a pipe, so that the pages of
+  the file reach a socket or pipe uncopied. Falls back on Send_bytes
+  where iFd takes no splice. The pages stay referenced after the call
+  until they are consumed, so that changes made to the file meanwhile
+  may show through.
+*/
+int Send_mapped(int iFd, const void *pvBytes, size_t ulCount,
+                size_t *pulSent);
+
+/*
+  Writes the ulCount bytes of the file iInFd from offset ulOffset on
+  to iFd with sendfile, within the kernel, or with pread and write
+  where iFd takes no sendfile. As with Send_mapped, changes made to
+  those bytes of iInFd before they are consumed may show through.
+*/
+int Send_file(int iFd, int iInFd, size_t ulOffset, size_t ulCount,
+              size_t *pulSent);
+
+#endif
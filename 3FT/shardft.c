@@ -0,0 +1,873 @@
+/*--------------------------------------------------------------------*/
+/* shardft.c                                                          */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "dynarray.h"
+#include "path.h"
+#include "ft.h"
+#include "shardft.h"
+
+/* The operations a shard's worker performs on its tree */
+enum Op { OP_INSERTDIR, OP_CONTAINSDIR, OP_RMDIR, OP_INSERTFILE,
+          OP_CONTAINSFILE, OP_RMFILE, OP_GETCONTENTS, OP_REPLACE,
+          OP_STAT, OP_DESCRIBE, OP_STOP };
+
+/* A shard's FT_toStringIn output, taken apart for merging */
+struct listing {
+   /* the output itself */
+   char *pcString;
+   /* the lines of pcString naming files that are children of the
+      root, which are not NUL-terminated */
+   DynArray_T oDFiles;
+   /* likewise for directories that are children of the root; each is
+      followed in pcString by the lines of its descendants */
+   DynArray_T oDDirs;
+};
+
+/* A request queued for a shard's worker, with its results */
+struct request {
+   /* the operation to perform */
+   enum Op eOp;
+   /* its path argument */
+   const char *pcPath;
+   /* its contents arguments, for OP_INSERTFILE and OP_REPLACE */
+   void *pvContents;
+   size_t ulLength;
+   /* the status returned by the operation, if it returns one */
+   int iStatus;
+   /* the boolean returned by the operation, if it returns one */
+   boolean bResult;
+   /* the contents returned by the operation, if it returns any */
+   void *pvResult;
+   /* the results of OP_STAT */
+   boolean bIsFile;
+   size_t ulSize;
+   /* the result of OP_DESCRIBE */
+   struct listing sListing;
+   /* TRUE once the worker has performed the request */
+   boolean bDone;
+   /* the request queued after this one */
+   struct request *psNext;
+};
+
+/* One shard and the worker that owns it */
+struct shard {
+   /* the shard's tree; only the worker touches it, so nodes come from
+      the worker's own malloc arena and need no locking */
+   FT_T oFTree;
+   /* the worker */
+   pthread_t sThread;
+   /* guards the queue and the bDone flags of the queued requests */
+   pthread_mutex_t sMutex;
+   /* signaled when a request is queued */
+   pthread_cond_t sWork;
+   /* broadcast when queued requests have been performed */
+   pthread_cond_t sDone;
+   /* the queued requests, oldest first */
+   struct request *psHead;
+   struct request *psTail;
+};
+
+/* A File Tree partitioned across shards */
+struct shardft {
+   /* the number of shards */
+   size_t ulShards;
+   /* the shards */
+   struct shard *psShards;
+   /* held shared by operations confined to one shard, and exclusively
+      by those that create or remove the root or need every shard */
+   pthread_rwlock_t sLock;
+   /* TRUE if the tree has a root; guarded by sLock */
+   boolean bHasRoot;
+   /* one request per shard, for the operations that hold sLock
+      exclusively */
+   struct request *psBroadcast;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Frees the contents of psListing, which may be partially built. */
+static void ShardFT_freeListing(struct listing *psListing) {
+   assert(psListing != NULL);
+
+   free(psListing->pcString);
+   if(psListing->oDFiles != NULL)
+      DynArray_free(psListing->oDFiles);
+   if(psListing->oDDirs != NULL)
+      DynArray_free(psListing->oDDirs);
+   psListing->pcString = NULL;
+   psListing->oDFiles = NULL;
+   psListing->oDDirs = NULL;
+}
+
+/* Returns the number of '/' in the line pcLine. */
+static size_t ShardFT_lineDepth(const char *pcLine) {
+   size_t ulSlashes = 0;
+
+   assert(pcLine != NULL);
+
+   for(; *pcLine != '\n' && *pcLine != '\0'; pcLine++)
+      if(*pcLine == '/')
+         ulSlashes++;
+   return ulSlashes;
+}
+
+/*
+  Fills in psListing from oFTree, classifying each child of the root
+  in its FT_toStringIn output with FT_statIn. Returns SUCCESS, or
+  MEMORY_ERROR with psListing empty.
+*/
+static int ShardFT_describe(FT_T oFTree, struct listing *psListing) {
+   char *pcLine;
+   char *pcEnd;
+   boolean bIsFile;
+   size_t ulSize;
+   int iStatus;
+
+   assert(oFTree != NULL);
+   assert(psListing != NULL);
+
+   psListing->pcString = FT_toStringIn(oFTree);
+   psListing->oDFiles = DynArray_new(0);
+   psListing->oDDirs = DynArray_new(0);
+   if(psListing->pcString == NULL || psListing->oDFiles == NULL ||
+      psListing->oDDirs == NULL) {
+      ShardFT_freeListing(psListing);
+      return MEMORY_ERROR;
+   }
+
+   for(pcLine = psListing->pcString; *pcLine != '\0';
+       pcLine = pcEnd + 1) {
+      pcEnd = strchr(pcLine, '\n');
+      assert(pcEnd != NULL);
+      if(ShardFT_lineDepth(pcLine) != 1)
+         continue;
+
+      *pcEnd = '\0';
+      iStatus = FT_statIn(oFTree, pcLine, &bIsFile, &ulSize);
+      *pcEnd = '\n';
+      if(iStatus != SUCCESS ||
+         !DynArray_add(bIsFile ? psListing->oDFiles : psListing->oDDirs,
+                       pcLine)) {
+         ShardFT_freeListing(psListing);
+         return MEMORY_ERROR;
+      }
+   }
+   return SUCCESS;
+}
+
+/* Performs psRequest on oFTree, filling in its results. */
+static void ShardFT_perform(FT_T oFTree, struct request *psRequest) {
+   assert(oFTree != NULL);
+   assert(psRequest != NULL);
+
+   switch(psRequest->eOp) {
+      case OP_INSERTDIR:
+         psRequest->iStatus = FT_insertDirIn(oFTree, psRequest->pcPath);
+         break;
+      case OP_CONTAINSDIR:
+         psRequest->bResult = FT_containsDirIn(oFTree,
+                                               psRequest->pcPath);
+         break;
+      case OP_RMDIR:
+         psRequest->iStatus = FT_rmDirIn(oFTree, psRequest->pcPath);
+         break;
+      case OP_INSERTFILE:
+         psRequest->iStatus = FT_insertFileIn(oFTree, psRequest->pcPath,
+                                              psRequest->pvContents,
+                                              psRequest->ulLength);
+         break;
+      case OP_CONTAINSFILE:
+         psRequest->bResult = FT_containsFileIn(oFTree,
+                                                psRequest->pcPath);
+         break;
+      case OP_RMFILE:
+         psRequest->iStatus = FT_rmFileIn(oFTree, psRequest->pcPath);
+         break;
+      case OP_GETCONTENTS:
+         psRequest->pvResult = FT_getFileContentsIn(oFTree,
+                                                    psRequest->pcPath);
+         break;
+      case OP_REPLACE:
+         psRequest->pvResult = FT_replaceFileContentsIn(oFTree,
+                                  psRequest->pcPath,
+                                  psRequest->pvContents,
+                                  psRequest->ulLength);
+         break;
+      case OP_STAT:
+         psRequest->iStatus = FT_statIn(oFTree, psRequest->pcPath,
+                                        &psRequest->bIsFile,
+                                        &psRequest->ulSize);
+         break;
+      case OP_DESCRIBE:
+         psRequest->iStatus = ShardFT_describe(oFTree,
+                                               &psRequest->sListing);
+         break;
+      case OP_STOP:
+         break;
+   }
+}
+
+/*
+  The worker of the shard pvShard (a struct shard): takes everything
+  queued at once, performs it in order, and wakes the waiting clients,
+  until it performs an OP_STOP. Returns NULL.
+*/
+static void *ShardFT_work(void *pvShard) {
+   struct shard *psShard = pvShard;
+   struct request *psBatch;
+   struct request *psRequest;
+   boolean bStop = FALSE;
+
+   assert(psShard != NULL);
+
+   while(!bStop) {
+      (void) pthread_mutex_lock(&psShard->sMutex);
+      while(psShard->psHead == NULL)
+         (void) pthread_cond_wait(&psShard->sWork, &psShard->sMutex);
+      psBatch = psShard->psHead;
+      psShard->psHead = NULL;
+      psShard->psTail = NULL;
+      (void) pthread_mutex_unlock(&psShard->sMutex);
+
+      for(psRequest = psBatch; psRequest != NULL;
+          psRequest = psRequest->psNext) {
+         ShardFT_perform(psShard->oFTree, psRequest);
+         if(psRequest->eOp == OP_STOP)
+            bStop = TRUE;
+      }
+
+      /* a client may reuse its request as soon as bDone is set, so
+         the links are not followed after that */
+      (void) pthread_mutex_lock(&psShard->sMutex);
+      while(psBatch != NULL) {
+         psRequest = psBatch;
+         psBatch = psBatch->psNext;
+         psRequest->bDone = TRUE;
+      }
+      (void) pthread_cond_broadcast(&psShard->sDone);
+      (void) pthread_mutex_unlock(&psShard->sMutex);
+   }
+   return NULL;
+}
+
+/* Queues psRequest for psShard's worker. */
+static void ShardFT_submit(struct shard *psShard,
+                           struct request *psRequest) {
+   assert(psShard != NULL);
+   assert(psRequest != NULL);
+
+   psRequest->bDone = FALSE;
+   psRequest->psNext = NULL;
+
+   (void) pthread_mutex_lock(&psShard->sMutex);
+   if(psShard->psTail == NULL)
+      psShard->psHead = psRequest;
+   else
+      psShard->psTail->psNext = psRequest;
+   psShard->psTail = psRequest;
+   (void) pthread_cond_signal(&psShard->sWork);
+   (void) pthread_mutex_unlock(&psShard->sMutex);
+}
+
+/* Waits until psShard's worker has performed psRequest. */
+static void ShardFT_wait(struct shard *psShard,
+                         struct request *psRequest) {
+   assert(psShard != NULL);
+   assert(psRequest != NULL);
+
+   (void) pthread_mutex_lock(&psShard->sMutex);
+   while(!psRequest->bDone)
+      (void) pthread_cond_wait(&psShard->sDone, &psShard->sMutex);
+   (void) pthread_mutex_unlock(&psShard->sMutex);
+}
+
+/*
+  Returns the index of the shard of oSTree that holds pcPath: a hash
+  of its second component, or 0 if it has none. Every shard holds the
+  root, and a malformed path fails the same way in every shard.
+*/
+static size_t ShardFT_shardOf(ShardFT_T oSTree, const char *pcPath) {
+   const char *pc;
+   unsigned long ulHash = 5381;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   pc = strchr(pcPath, '/');
+   if(pc == NULL)
+      return 0;
+   for(pc++; *pc != '\0' && *pc != '/'; pc++)
+      ulHash = ulHash * 33 + (unsigned char) *pc;
+   return (size_t) (ulHash % oSTree->ulShards);
+}
+
+/*
+  Performs psRequest in the shard of oSTree holding its path and
+  waits for the result. The caller holds oSTree's lock.
+*/
+static void ShardFT_call(ShardFT_T oSTree, struct request *psRequest) {
+   struct shard *psShard;
+
+   assert(oSTree != NULL);
+   assert(psRequest != NULL);
+
+   psShard = &oSTree->psShards[ShardFT_shardOf(oSTree,
+                                               psRequest->pcPath)];
+   ShardFT_submit(psShard, psRequest);
+   ShardFT_wait(psShard, psRequest);
+}
+
+/*
+  Performs operation eOp with path pcPath in every shard of oSTree at
+  once and waits for all of them. The results are left in
+  oSTree->psBroadcast. Returns the status of the first shard that
+  failed, or SUCCESS if none did. The caller holds oSTree's lock
+  exclusively.
+*/
+static int ShardFT_callAll(ShardFT_T oSTree, enum Op eOp,
+                           const char *pcPath) {
+   struct request *psRequest;
+   int iStatus = SUCCESS;
+   size_t i;
+
+   assert(oSTree != NULL);
+
+   for(i = 0; i < oSTree->ulShards; i++) {
+      psRequest = &oSTree->psBroadcast[i];
+      psRequest->eOp = eOp;
+      psRequest->pcPath = pcPath;
+      psRequest->iStatus = SUCCESS;
+      ShardFT_submit(&oSTree->psShards[i], psRequest);
+   }
+   for(i = 0; i < oSTree->ulShards; i++) {
+      psRequest = &oSTree->psBroadcast[i];
+      ShardFT_wait(&oSTree->psShards[i], psRequest);
+      if(iStatus == SUCCESS)
+         iStatus = psRequest->iStatus;
+   }
+   return iStatus;
+}
+
+/*
+  Sets up psShard with an empty tree and starts its worker. Returns
+  SUCCESS, or MEMORY_ERROR with nothing left to clean up.
+*/
+static int ShardFT_startShard(struct shard *psShard) {
+   assert(psShard != NULL);
+
+   psShard->psHead = NULL;
+   psShard->psTail = NULL;
+   if(FT_new(&psShard->oFTree) != SUCCESS)
+      return MEMORY_ERROR;
+   if(pthread_mutex_init(&psShard->sMutex, NULL) != 0) {
+      FT_free(psShard->oFTree);
+      return MEMORY_ERROR;
+   }
+   if(pthread_cond_init(&psShard->sWork, NULL) != 0) {
+      (void) pthread_mutex_destroy(&psShard->sMutex);
+      FT_free(psShard->oFTree);
+      return MEMORY_ERROR;
+   }
+   if(pthread_cond_init(&psShard->sDone, NULL) != 0) {
+      (void) pthread_cond_destroy(&psShard->sWork);
+      (void) pthread_mutex_destroy(&psShard->sMutex);
+      FT_free(psShard->oFTree);
+      return MEMORY_ERROR;
+   }
+   if(pthread_create(&psShard->sThread, NULL, ShardFT_work,
+                     psShard) != 0) {
+      (void) pthread_cond_destroy(&psShard->sDone);
+      (void) pthread_cond_destroy(&psShard->sWork);
+      (void) pthread_mutex_destroy(&psShard->sMutex);
+      FT_free(psShard->oFTree);
+      return MEMORY_ERROR;
+   }
+   return SUCCESS;
+}
+
+/* Stops the worker of psShard, started by ShardFT_startShard, and
+   frees the shard's tree. */
+static void ShardFT_stopShard(struct shard *psShard) {
+   struct request sStop;
+
+   assert(psShard != NULL);
+
+   sStop.eOp = OP_STOP;
+   sStop.pcPath = NULL;
+   ShardFT_submit(psShard, &sStop);
+   (void) pthread_join(psShard->sThread, NULL);
+
+   (void) pthread_cond_destroy(&psShard->sDone);
+   (void) pthread_cond_destroy(&psShard->sWork);
+   (void) pthread_mutex_destroy(&psShard->sMutex);
+   FT_free(psShard->oFTree);
+}
+
+/*--------------------------------------------------------------------*/
+
+int ShardFT_new(size_t ulShards, ShardFT_T *poSResult) {
+   ShardFT_T oSTree;
+   size_t i;
+
+   assert(ulShards > 0);
+   assert(poSResult != NULL);
+
+   *poSResult = NULL;
+   oSTree = malloc(sizeof(struct shardft));
+   if(oSTree == NULL)
+      return MEMORY_ERROR;
+   oSTree->ulShards = ulShards;
+   oSTree->bHasRoot = FALSE;
+   oSTree->psShards = calloc(ulShards, sizeof(struct shard));
+   oSTree->psBroadcast = calloc(ulShards, sizeof(struct request));
+   if(oSTree->psShards == NULL || oSTree->psBroadcast == NULL ||
+      pthread_rwlock_init(&oSTree->sLock, NULL) != 0) {
+      free(oSTree->psBroadcast);
+      free(oSTree->psShards);
+      free(oSTree);
+      return MEMORY_ERROR;
+   }
+
+   for(i = 0; i < ulShards; i++)
+      if(ShardFT_startShard(&oSTree->psShards[i]) != SUCCESS) {
+         while(i > 0)
+            ShardFT_stopShard(&oSTree->psShards[--i]);
+         (void) pthread_rwlock_destroy(&oSTree->sLock);
+         free(oSTree->psBroadcast);
+         free(oSTree->psShards);
+         free(oSTree);
+         return MEMORY_ERROR;
+      }
+
+   *poSResult = oSTree;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void ShardFT_free(ShardFT_T oSTree) {
+   size_t i;
+
+   if(oSTree == NULL)
+      return;
+
+   for(i = 0; i < oSTree->ulShards; i++)
+      ShardFT_stopShard(&oSTree->psShards[i]);
+   (void) pthread_rwlock_destroy(&oSTree->sLock);
+   free(oSTree->psBroadcast);
+   free(oSTree->psShards);
+   free(oSTree);
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Returns TRUE if pcPath has a single component, i.e. names the root
+   if it names anything. */
+static boolean ShardFT_isRootPath(const char *pcPath) {
+   assert(pcPath != NULL);
+
+   return strchr(pcPath, '/') == NULL;
+}
+
+/*
+  Performs psRequest, which is confined to one shard, with oSTree's
+  lock held shared, and returns psRequest.
+*/
+static struct request *ShardFT_callShared(ShardFT_T oSTree,
+                                          struct request *psRequest) {
+   assert(oSTree != NULL);
+   assert(psRequest != NULL);
+
+   (void) pthread_rwlock_rdlock(&oSTree->sLock);
+   ShardFT_call(oSTree, psRequest);
+   (void) pthread_rwlock_unlock(&oSTree->sLock);
+   return psRequest;
+}
+
+/*
+  Performs the insertion psRequest (OP_INSERTDIR or OP_INSERTFILE)
+  in oSTree, which has no root, after creating the root of its path in
+  every shard. Returns the status of the insertion; if it fails, no
+  shard keeps the root. The caller holds oSTree's lock exclusively.
+*/
+static int ShardFT_insertWithRoot(ShardFT_T oSTree,
+                                  struct request *psRequest) {
+   Path_T oPPath = NULL;
+   Path_T oPRoot = NULL;
+   int iStatus;
+
+   assert(oSTree != NULL);
+   assert(psRequest != NULL);
+
+   iStatus = Path_new(psRequest->pcPath, &oPPath);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   iStatus = Path_prefix(oPPath, 1, &oPRoot);
+   Path_free(oPPath);
+   if(iStatus != SUCCESS)
+      return iStatus;
+
+   iStatus = ShardFT_callAll(oSTree, OP_INSERTDIR,
+                             Path_getPathname(oPRoot));
+   if(iStatus == SUCCESS) {
+      ShardFT_call(oSTree, psRequest);
+      iStatus = psRequest->iStatus;
+   }
+   if(iStatus == SUCCESS)
+      oSTree->bHasRoot = TRUE;
+   else
+      (void) ShardFT_callAll(oSTree, OP_RMDIR, Path_getPathname(oPRoot));
+   Path_free(oPRoot);
+   return iStatus;
+}
+
+/*
+  Performs the insertion psRequest (OP_INSERTDIR or OP_INSERTFILE),
+  creating the root in every shard first if it is missing, and
+  returns its status.
+*/
+static int ShardFT_insert(ShardFT_T oSTree, struct request *psRequest) {
+   int iStatus;
+
+   assert(oSTree != NULL);
+   assert(psRequest != NULL);
+
+   if(ShardFT_isRootPath(psRequest->pcPath) &&
+      psRequest->eOp == OP_INSERTDIR) {
+      /* creating the root, or failing to, involves every shard */
+      (void) pthread_rwlock_wrlock(&oSTree->sLock);
+      iStatus = ShardFT_callAll(oSTree, OP_INSERTDIR, psRequest->pcPath);
+      if(iStatus == SUCCESS)
+         oSTree->bHasRoot = TRUE;
+      (void) pthread_rwlock_unlock(&oSTree->sLock);
+      return iStatus;
+   }
+
+   (void) pthread_rwlock_rdlock(&oSTree->sLock);
+   if(oSTree->bHasRoot || ShardFT_isRootPath(psRequest->pcPath)) {
+      ShardFT_call(oSTree, psRequest);
+      (void) pthread_rwlock_unlock(&oSTree->sLock);
+      return psRequest->iStatus;
+   }
+   (void) pthread_rwlock_unlock(&oSTree->sLock);
+
+   /* the insertion creates the root, which must appear in every shard
+      as the new node appears in one */
+   (void) pthread_rwlock_wrlock(&oSTree->sLock);
+   if(oSTree->bHasRoot) {
+      ShardFT_call(oSTree, psRequest);
+      iStatus = psRequest->iStatus;
+   }
+   else
+      iStatus = ShardFT_insertWithRoot(oSTree, psRequest);
+   (void) pthread_rwlock_unlock(&oSTree->sLock);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+int ShardFT_insertDir(ShardFT_T oSTree, const char *pcPath) {
+   struct request sRequest;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   sRequest.eOp = OP_INSERTDIR;
+   sRequest.pcPath = pcPath;
+   return ShardFT_insert(oSTree, &sRequest);
+}
+
+boolean ShardFT_containsDir(ShardFT_T oSTree, const char *pcPath) {
+   struct request sRequest;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   sRequest.eOp = OP_CONTAINSDIR;
+   sRequest.pcPath = pcPath;
+   return ShardFT_callShared(oSTree, &sRequest)->bResult;
+}
+
+int ShardFT_rmDir(ShardFT_T oSTree, const char *pcPath) {
+   struct request sRequest;
+   int iStatus;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   if(!ShardFT_isRootPath(pcPath)) {
+      sRequest.eOp = OP_RMDIR;
+      sRequest.pcPath = pcPath;
+      return ShardFT_callShared(oSTree, &sRequest)->iStatus;
+   }
+
+   (void) pthread_rwlock_wrlock(&oSTree->sLock);
+   iStatus = ShardFT_callAll(oSTree, OP_RMDIR, pcPath);
+   if(iStatus == SUCCESS)
+      oSTree->bHasRoot = FALSE;
+   (void) pthread_rwlock_unlock(&oSTree->sLock);
+   return iStatus;
+}
+
+int ShardFT_insertFile(ShardFT_T oSTree, const char *pcPath,
+                       void *pvContents, size_t ulLength) {
+   struct request sRequest;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   sRequest.eOp = OP_INSERTFILE;
+   sRequest.pcPath = pcPath;
+   sRequest.pvContents = pvContents;
+   sRequest.ulLength = ulLength;
+   return ShardFT_insert(oSTree, &sRequest);
+}
+
+boolean ShardFT_containsFile(ShardFT_T oSTree, const char *pcPath) {
+   struct request sRequest;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   sRequest.eOp = OP_CONTAINSFILE;
+   sRequest.pcPath = pcPath;
+   return ShardFT_callShared(oSTree, &sRequest)->bResult;
+}
+
+int ShardFT_rmFile(ShardFT_T oSTree, const char *pcPath) {
+   struct request sRequest;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   sRequest.eOp = OP_RMFILE;
+   sRequest.pcPath = pcPath;
+   return ShardFT_callShared(oSTree, &sRequest)->iStatus;
+}
+
+void *ShardFT_getFileContents(ShardFT_T oSTree, const char *pcPath) {
+   struct request sRequest;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   sRequest.eOp = OP_GETCONTENTS;
+   sRequest.pcPath = pcPath;
+   return ShardFT_callShared(oSTree, &sRequest)->pvResult;
+}
+
+void *ShardFT_replaceFileContents(ShardFT_T oSTree, const char *pcPath,
+                                  void *pvNewContents,
+                                  size_t ulNewLength) {
+   struct request sRequest;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+
+   sRequest.eOp = OP_REPLACE;
+   sRequest.pcPath = pcPath;
+   sRequest.pvContents = pvNewContents;
+   sRequest.ulLength = ulNewLength;
+   return ShardFT_callShared(oSTree, &sRequest)->pvResult;
+}
+
+int ShardFT_stat(ShardFT_T oSTree, const char *pcPath,
+                 boolean *pbIsFile, size_t *pulSize) {
+   struct request sRequest;
+
+   assert(oSTree != NULL);
+   assert(pcPath != NULL);
+   assert(pbIsFile != NULL);
+   assert(pulSize != NULL);
+
+   sRequest.eOp = OP_STAT;
+   sRequest.pcPath = pcPath;
+   (void) ShardFT_callShared(oSTree, &sRequest);
+   if(sRequest.iStatus == SUCCESS) {
+      *pbIsFile = sRequest.bIsFile;
+      if(sRequest.bIsFile)
+         *pulSize = sRequest.ulSize;
+   }
+   return sRequest.iStatus;
+}
+
+/* --------------------------------------------------------------------
+
+  The following auxiliary functions merge the shards' listings into
+  the string representation of the whole tree.
+*/
+
+/*
+  Compares the lines pvLine1 and pvLine2 as strcmp would compare them
+  without their newlines, which is the order of siblings in a tree.
+*/
+static int ShardFT_compareLines(const void *pvLine1,
+                                const void *pvLine2) {
+   const unsigned char *puc1 = pvLine1;
+   const unsigned char *puc2 = pvLine2;
+
+   assert(puc1 != NULL);
+   assert(puc2 != NULL);
+
+   while(*puc1 == *puc2 && *puc1 != '\n') {
+      puc1++;
+      puc2++;
+   }
+   if(*puc1 == '\n')
+      return *puc2 == '\n' ? 0 : -1;
+   if(*puc2 == '\n')
+      return 1;
+   return (int) *puc1 - (int) *puc2;
+}
+
+/*
+  Returns the length of the line pcLine, including its newline, and if
+  bWithDescendants is TRUE, of the lines that follow it as long as they
+  are deeper than it.
+*/
+static size_t ShardFT_blockLength(const char *pcLine,
+                                  boolean bWithDescendants) {
+   const char *pcEnd;
+   size_t ulDepth;
+
+   assert(pcLine != NULL);
+
+   ulDepth = ShardFT_lineDepth(pcLine);
+   pcEnd = strchr(pcLine, '\n') + 1;
+   if(bWithDescendants)
+      while(*pcEnd != '\0' && ShardFT_lineDepth(pcEnd) > ulDepth)
+         pcEnd = strchr(pcEnd, '\n') + 1;
+   return (size_t) (pcEnd - pcLine);
+}
+
+/*
+  Appends the blocks of the lines in oDLines (with their descendants if
+  bWithDescendants is TRUE) to the end of the string at *ppcAcc, and
+  advances *ppcAcc past them.
+*/
+static void ShardFT_appendBlocks(DynArray_T oDLines,
+                                 boolean bWithDescendants,
+                                 char **ppcAcc) {
+   const char *pcLine;
+   size_t ulLength;
+   size_t i;
+
+   assert(oDLines != NULL);
+   assert(ppcAcc != NULL);
+
+   for(i = 0; i < DynArray_getLength(oDLines); i++) {
+      pcLine = DynArray_get(oDLines, i);
+      ulLength = ShardFT_blockLength(pcLine, bWithDescendants);
+      memcpy(*ppcAcc, pcLine, ulLength);
+      *ppcAcc += ulLength;
+   }
+}
+
+/*
+  Adds the lines of the root's file children in the listings left in
+  oSTree->psBroadcast to oDFiles, and those of its directory children
+  to oDDirs, and stores in *pulTotal the length of the merged string,
+  whose root line is ulRootLength long. Returns TRUE, or FALSE if there
+  is an allocation error.
+*/
+static boolean ShardFT_collect(ShardFT_T oSTree, DynArray_T oDFiles,
+                               DynArray_T oDDirs, size_t ulRootLength,
+                               size_t *pulTotal) {
+   struct listing *psListing;
+   size_t i, j;
+
+   assert(oSTree != NULL);
+   assert(oDFiles != NULL);
+   assert(oDDirs != NULL);
+   assert(pulTotal != NULL);
+
+   *pulTotal = ulRootLength + 1;
+   for(i = 0; i < oSTree->ulShards; i++) {
+      psListing = &oSTree->psBroadcast[i].sListing;
+      *pulTotal += strlen(psListing->pcString) - ulRootLength;
+      for(j = 0; j < DynArray_getLength(psListing->oDFiles); j++)
+         if(!DynArray_add(oDFiles, DynArray_get(psListing->oDFiles, j)))
+            return FALSE;
+      for(j = 0; j < DynArray_getLength(psListing->oDDirs); j++)
+         if(!DynArray_add(oDDirs, DynArray_get(psListing->oDDirs, j)))
+            return FALSE;
+   }
+   return TRUE;
+}
+
+/*
+  Merges the listings left in oSTree->psBroadcast, whose shards all
+  have the root, into the representation of the whole tree: the root,
+  then all its file children in order, then all its directory children
+  in order, each followed by its descendants. Returns the string, or
+  NULL if there is an allocation error.
+*/
+static char *ShardFT_merge(ShardFT_T oSTree) {
+   DynArray_T oDFiles;
+   DynArray_T oDDirs;
+   const char *pcRoot;
+   size_t ulRootLength;
+   size_t ulTotal;
+   char *pcResult = NULL;
+   char *pcAcc;
+
+   assert(oSTree != NULL);
+
+   pcRoot = oSTree->psBroadcast[0].sListing.pcString;
+   ulRootLength = ShardFT_blockLength(pcRoot, FALSE);
+   oDFiles = DynArray_new(0);
+   oDDirs = DynArray_new(0);
+   if(oDFiles != NULL && oDDirs != NULL &&
+      ShardFT_collect(oSTree, oDFiles, oDDirs, ulRootLength, &ulTotal))
+      pcResult = malloc(ulTotal);
+
+   if(pcResult != NULL) {
+      DynArray_sort(oDFiles, ShardFT_compareLines);
+      DynArray_sort(oDDirs, ShardFT_compareLines);
+      memcpy(pcResult, pcRoot, ulRootLength);
+      pcAcc = pcResult + ulRootLength;
+      ShardFT_appendBlocks(oDFiles, FALSE, &pcAcc);
+      ShardFT_appendBlocks(oDDirs, TRUE, &pcAcc);
+      *pcAcc = '\0';
+   }
+
+   if(oDFiles != NULL)
+      DynArray_free(oDFiles);
+   if(oDDirs != NULL)
+      DynArray_free(oDDirs);
+   return pcResult;
+}
+
+/*--------------------------------------------------------------------*/
+
+char *ShardFT_toString(ShardFT_T oSTree) {
+   char *pcResult = NULL;
+   size_t i;
+
+   assert(oSTree != NULL);
+
+   (void) pthread_rwlock_wrlock(&oSTree->sLock);
+   if(!oSTree->bHasRoot) {
+      (void) pthread_rwlock_unlock(&oSTree->sLock);
+      pcResult = malloc(1);
+      if(pcResult != NULL)
+         *pcResult = '\0';
+      return pcResult;
+   }
+
+   if(ShardFT_callAll(oSTree, OP_DESCRIBE, NULL) == SUCCESS)
+      pcResult = ShardFT_merge(oSTree);
+   for(i = 0; i < oSTree->ulShards; i++)
+      if(oSTree->psBroadcast[i].iStatus == SUCCESS)
+         ShardFT_freeListing(&oSTree->psBroadcast[i].sListing);
+   (void) pthread_rwlock_unlock(&oSTree->sLock);
+   return pcResult;
+}
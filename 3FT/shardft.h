@@ -0,0 +1,80 @@
+/*--------------------------------------------------------------------*/
+/* shardft.h                                                          */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef SHARDFT_INCLUDED
+#define SHARDFT_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A ShardFT_T is a File Tree partitioned by subtree across several
+  independent FT_T shards. Each shard is owned by a worker thread of
+  its own, which performs the requests queued for it one after the
+  other, so shards never contend with each other. A path belongs to
+  the shard chosen by hashing its second component: everything below
+  one child of the root lives in one shard, and the root itself is
+  kept in all of them.
+
+  The operations behave as the FT_ functions of the same name do on a
+  single tree, including the single root and the order of toString,
+  and may be called concurrently from any number of threads.
+*/
+typedef struct shardft *ShardFT_T;
+
+/*
+  Creates a new, empty sharded File Tree with ulShards shards and
+  starts their workers. Returns SUCCESS and sets *poSResult to the new
+  tree if successful. Otherwise, sets *poSResult to NULL and returns
+  MEMORY_ERROR.
+*/
+int ShardFT_new(size_t ulShards, ShardFT_T *poSResult);
+
+/*
+  Stops the workers of oSTree and frees it and everything in it. Does
+  nothing if oSTree is NULL. File contents are owned by the client and
+  are not freed. No other thread may be using oSTree.
+*/
+void ShardFT_free(ShardFT_T oSTree);
+
+/* As FT_insertDir, but on oSTree. */
+int ShardFT_insertDir(ShardFT_T oSTree, const char *pcPath);
+
+/* As FT_containsDir, but on oSTree. */
+boolean ShardFT_containsDir(ShardFT_T oSTree, const char *pcPath);
+
+/* As FT_rmDir, but on oSTree. */
+int ShardFT_rmDir(ShardFT_T oSTree, const char *pcPath);
+
+/* As FT_insertFile, but on oSTree. */
+int ShardFT_insertFile(ShardFT_T oSTree, const char *pcPath,
+                       void *pvContents, size_t ulLength);
+
+/* As FT_containsFile, but on oSTree. */
+boolean ShardFT_containsFile(ShardFT_T oSTree, const char *pcPath);
+
+/* As FT_rmFile, but on oSTree. */
+int ShardFT_rmFile(ShardFT_T oSTree, const char *pcPath);
+
+/* As FT_getFileContents, but on oSTree. */
+void *ShardFT_getFileContents(ShardFT_T oSTree, const char *pcPath);
+
+/* As FT_replaceFileContents, but on oSTree. */
+void *ShardFT_replaceFileContents(ShardFT_T oSTree, const char *pcPath,
+                                  void *pvNewContents,
+                                  size_t ulNewLength);
+
+/* As FT_stat, but on oSTree. */
+int ShardFT_stat(ShardFT_T oSTree, const char *pcPath,
+                 boolean *pbIsFile, size_t *pulSize);
+
+/*
+  As FT_toString, but on oSTree: the shards' listings merged into the
+  one a single tree with the same contents would produce. Every shard
+  is stopped for the duration, so the result is a consistent view.
+*/
+char *ShardFT_toString(ShardFT_T oSTree);
+
+#endif
@@ -0,0 +1,331 @@
+/*--------------------------------------------------------------------*/
+/* sizeindex.c                                                        */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "sizeindex.h"
+
+/* The most levels an entry may have, which suits any number of
+   entries that fits in memory */
+enum { MAX_LEVELS = 32 };
+
+/*
+  A path in an index, linked into the first ulLevels levels of the
+  skip list. Level 0 links every entry in order; each level above
+  links about a quarter of the entries of the one below.
+*/
+struct entry {
+   /* the size of the file */
+   size_t ulSize;
+   /* the path, stored after the links */
+   char *pcPath;
+   /* the number of levels the entry is linked into */
+   size_t ulLevels;
+   /* the next entry at each of its levels; the entry is allocated
+      with room for ulLevels of them */
+   struct entry *apsNext[1];
+};
+
+/* A set of paths in order of size */
+struct sizeIndex {
+   /* the first entry at each level */
+   struct entry *apsHead[MAX_LEVELS];
+   /* the number of levels in use */
+   size_t ulLevels;
+   /* the bytes allocated for the entries, and their number */
+   size_t ulEntryBytes;
+   size_t ulEntries;
+   /* the state of the generator of levels */
+   unsigned long ulSeed;
+   /* FALSE once the index has given up */
+   boolean bComplete;
+   /* held shared by SizeIndex_map and exclusively by changes */
+   pthread_rwlock_t sLock;
+};
+
+/*--------------------------------------------------------------------*/
+
+/*
+  Returns <0, 0, or >0 if a file of size ulSize with path pcPath comes
+  before, is, or comes after psEntry in the order of an index.
+*/
+static int SizeIndex_compare(size_t ulSize, const char *pcPath,
+                             struct entry *psEntry) {
+   assert(pcPath != NULL);
+   assert(psEntry != NULL);
+
+   if(ulSize != psEntry->ulSize)
+      return (ulSize > psEntry->ulSize) ? -1 : 1;
+   return strcmp(pcPath, psEntry->pcPath);
+}
+
+/*
+  Sets apsPrev[i], for each level i in use in oSIndex, to the place at
+  level i after which a file of size ulSize with path pcPath belongs:
+  the link to the first entry not before it.
+*/
+static void SizeIndex_search(SizeIndex_T oSIndex, size_t ulSize,
+                             const char *pcPath,
+                             struct entry **appsPrev[]) {
+   struct entry **apsLinks = oSIndex->apsHead;
+   size_t i;
+
+   assert(oSIndex != NULL);
+   assert(pcPath != NULL);
+   assert(appsPrev != NULL);
+
+   for(i = oSIndex->ulLevels; i-- > 0; ) {
+      while(apsLinks[i] != NULL &&
+            SizeIndex_compare(ulSize, pcPath, apsLinks[i]) > 0)
+         apsLinks = apsLinks[i]->apsNext;
+      appsPrev[i] = &apsLinks[i];
+   }
+}
+
+/* Returns the number of levels for a new entry of oSIndex: 1, with
+   each further level a quarter as likely as the one before. */
+static size_t SizeIndex_randomLevels(SizeIndex_T oSIndex) {
+   size_t ulLevels = 1;
+
+   assert(oSIndex != NULL);
+
+   for(;;) {
+      oSIndex->ulSeed = oSIndex->ulSeed * 1103515245UL + 12345UL;
+      if(ulLevels == MAX_LEVELS || ((oSIndex->ulSeed >> 16) & 3) != 0)
+         return ulLevels;
+      ulLevels++;
+   }
+}
+
+/* Frees every entry of oSIndex and empties it. */
+static void SizeIndex_clear(SizeIndex_T oSIndex) {
+   struct entry *psEntry;
+   struct entry *psNext;
+   size_t i;
+
+   assert(oSIndex != NULL);
+
+   for(psEntry = oSIndex->apsHead[0]; psEntry != NULL; psEntry = psNext) {
+      psNext = psEntry->apsNext[0];
+      free(psEntry);
+   }
+   for(i = 0; i < MAX_LEVELS; i++)
+      oSIndex->apsHead[i] = NULL;
+   oSIndex->ulLevels = 1;
+   oSIndex->ulEntryBytes = 0;
+   oSIndex->ulEntries = 0;
+}
+
+/*
+  Gives up on oSIndex: frees every entry and ignores later changes.
+  The caller holds oSIndex's lock exclusively.
+*/
+static void SizeIndex_giveUp(SizeIndex_T oSIndex) {
+   assert(oSIndex != NULL);
+
+   SizeIndex_clear(oSIndex);
+   oSIndex->bComplete = FALSE;
+}
+
+/* Returns the bytes allocated for an entry with ulLevels levels and a
+   path of ulLength characters. */
+static size_t SizeIndex_entryBytes(size_t ulLevels, size_t ulLength) {
+   return sizeof(struct entry) + (ulLevels - 1) * sizeof(struct entry *)
+          + ulLength + 1;
+}
+
+/*--------------------------------------------------------------------*/
+
+int SizeIndex_new(SizeIndex_T *poSResult) {
+   SizeIndex_T oSIndex;
+   size_t i;
+
+   assert(poSResult != NULL);
+
+   *poSResult = NULL;
+   oSIndex = malloc(sizeof(struct sizeIndex));
+   if(oSIndex == NULL)
+      return MEMORY_ERROR;
+   if(pthread_rwlock_init(&oSIndex->sLock, NULL) != 0) {
+      free(oSIndex);
+      return MEMORY_ERROR;
+   }
+   for(i = 0; i < MAX_LEVELS; i++)
+      oSIndex->apsHead[i] = NULL;
+   oSIndex->ulLevels = 1;
+   oSIndex->ulEntryBytes = 0;
+   oSIndex->ulEntries = 0;
+   oSIndex->ulSeed = 1;
+   oSIndex->bComplete = TRUE;
+
+   *poSResult = oSIndex;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void SizeIndex_free(SizeIndex_T oSIndex) {
+   if(oSIndex == NULL)
+      return;
+
+   SizeIndex_clear(oSIndex);
+   (void) pthread_rwlock_destroy(&oSIndex->sLock);
+   free(oSIndex);
+}
+
+/*--------------------------------------------------------------------*/
+
+void SizeIndex_add(SizeIndex_T oSIndex, const char *pcPath,
+                   size_t ulSize) {
+   struct entry **appsPrev[MAX_LEVELS];
+   struct entry *psEntry;
+   size_t ulLevels;
+   size_t ulLength;
+   size_t ulBytes;
+   size_t i;
+
+   assert(oSIndex != NULL);
+   assert(pcPath != NULL);
+
+   (void) pthread_rwlock_wrlock(&oSIndex->sLock);
+   if(!oSIndex->bComplete) {
+      (void) pthread_rwlock_unlock(&oSIndex->sLock);
+      return;
+   }
+
+   ulLevels = SizeIndex_randomLevels(oSIndex);
+   ulLength = strlen(pcPath);
+   ulBytes = SizeIndex_entryBytes(ulLevels, ulLength);
+   psEntry = malloc(ulBytes);
+   if(psEntry == NULL) {
+      SizeIndex_giveUp(oSIndex);
+      (void) pthread_rwlock_unlock(&oSIndex->sLock);
+      return;
+   }
+   psEntry->ulSize = ulSize;
+   psEntry->ulLevels = ulLevels;
+   psEntry->pcPath = (char *) &psEntry->apsNext[ulLevels];
+   memcpy(psEntry->pcPath, pcPath, ulLength + 1);
+
+   /* the levels new to the list start at the head */
+   for(i = oSIndex->ulLevels; i < ulLevels; i++)
+      oSIndex->apsHead[i] = NULL;
+   if(ulLevels > oSIndex->ulLevels)
+      oSIndex->ulLevels = ulLevels;
+   SizeIndex_search(oSIndex, ulSize, pcPath, appsPrev);
+   for(i = 0; i < ulLevels; i++) {
+      psEntry->apsNext[i] = *appsPrev[i];
+      *appsPrev[i] = psEntry;
+   }
+   oSIndex->ulEntryBytes += ulBytes;
+   oSIndex->ulEntries++;
+
+   (void) pthread_rwlock_unlock(&oSIndex->sLock);
+}
+
+/*--------------------------------------------------------------------*/
+
+void SizeIndex_remove(SizeIndex_T oSIndex, const char *pcPath,
+                      size_t ulSize) {
+   struct entry **appsPrev[MAX_LEVELS];
+   struct entry *psEntry;
+   size_t i;
+
+   assert(oSIndex != NULL);
+   assert(pcPath != NULL);
+
+   (void) pthread_rwlock_wrlock(&oSIndex->sLock);
+   SizeIndex_search(oSIndex, ulSize, pcPath, appsPrev);
+   psEntry = *appsPrev[0];
+   if(psEntry == NULL || SizeIndex_compare(ulSize, pcPath, psEntry) != 0) {
+      (void) pthread_rwlock_unlock(&oSIndex->sLock);
+      return;
+   }
+
+   for(i = 0; i < psEntry->ulLevels; i++)
+      *appsPrev[i] = psEntry->apsNext[i];
+   while(oSIndex->ulLevels > 1 &&
+         oSIndex->apsHead[oSIndex->ulLevels - 1] == NULL)
+      oSIndex->ulLevels--;
+   oSIndex->ulEntryBytes -= SizeIndex_entryBytes(psEntry->ulLevels,
+                                                 strlen(pcPath));
+   oSIndex->ulEntries--;
+   free(psEntry);
+
+   (void) pthread_rwlock_unlock(&oSIndex->sLock);
+}
+
+/*--------------------------------------------------------------------*/
+
+void SizeIndex_abandon(SizeIndex_T oSIndex) {
+   assert(oSIndex != NULL);
+
+   (void) pthread_rwlock_wrlock(&oSIndex->sLock);
+   SizeIndex_giveUp(oSIndex);
+   (void) pthread_rwlock_unlock(&oSIndex->sLock);
+}
+
+/*--------------------------------------------------------------------*/
+
+boolean SizeIndex_map(SizeIndex_T oSIndex, size_t ulHigh,
+                      boolean (*pfApply)(const char *pcPath,
+                                         size_t ulSize, void *pvExtra),
+                      void *pvExtra) {
+   struct entry **apsLinks;
+   struct entry *psEntry;
+   size_t i;
+
+   assert(oSIndex != NULL);
+   assert(pfApply != NULL);
+
+   (void) pthread_rwlock_rdlock(&oSIndex->sLock);
+   if(!oSIndex->bComplete) {
+      (void) pthread_rwlock_unlock(&oSIndex->sLock);
+      return FALSE;
+   }
+
+   /* skip the files larger than ulHigh */
+   apsLinks = oSIndex->apsHead;
+   for(i = oSIndex->ulLevels; i-- > 0; )
+      while(apsLinks[i] != NULL && apsLinks[i]->ulSize > ulHigh)
+         apsLinks = apsLinks[i]->apsNext;
+
+   for(psEntry = apsLinks[0]; psEntry != NULL;
+       psEntry = psEntry->apsNext[0])
+      if(!(*pfApply)(psEntry->pcPath, psEntry->ulSize, pvExtra))
+         break;
+   (void) pthread_rwlock_unlock(&oSIndex->sLock);
+   return TRUE;
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t SizeIndex_getSize(SizeIndex_T oSIndex) {
+   size_t ulSize;
+
+   assert(oSIndex != NULL);
+
+   (void) pthread_rwlock_rdlock(&oSIndex->sLock);
+   ulSize = sizeof(struct sizeIndex) + oSIndex->ulEntryBytes;
+   (void) pthread_rwlock_unlock(&oSIndex->sLock);
+   return ulSize;
+}
+
+/*--------------------------------------------------------------------*/
+
+size_t SizeIndex_getCount(SizeIndex_T oSIndex) {
+   size_t ulCount;
+
+   assert(oSIndex != NULL);
+
+   (void) pthread_rwlock_rdlock(&oSIndex->sLock);
+   ulCount = oSIndex->ulEntries;
+   (void) pthread_rwlock_unlock(&oSIndex->sLock);
+   return ulCount;
+}
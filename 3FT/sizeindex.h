@@ -0,0 +1,71 @@
+/*--------------------------------------------------------------------*/
+/* sizeindex.h                                                        */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef SIZEINDEX_INCLUDED
+#define SIZEINDEX_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A SizeIndex_T is a set of absolute paths of files, each with its
+  size, kept in order of decreasing size and, among files of the same
+  size, increasing path. It is a skip list, so paths are added and
+  removed in logarithmic expected time, and a scan can start at any
+  size without looking at the larger files.
+
+  As with a NameIndex_T, an index that once fails to allocate memory
+  gives up: it forgets every path, ignores later changes, and reports
+  itself incomplete.
+
+  The functions may be called concurrently from multiple threads.
+*/
+typedef struct sizeIndex *SizeIndex_T;
+
+/*
+  Creates a new, empty index. Returns SUCCESS and sets *poSResult to
+  the new index if successful. Otherwise, sets *poSResult to NULL and
+  returns MEMORY_ERROR.
+*/
+int SizeIndex_new(SizeIndex_T *poSResult);
+
+/* Frees oSIndex. Does nothing if oSIndex is NULL. */
+void SizeIndex_free(SizeIndex_T oSIndex);
+
+/*
+  Adds pcPath, of size ulSize, to oSIndex, which must not hold it
+  yet. Gives up on the index if memory could not be allocated.
+*/
+void SizeIndex_add(SizeIndex_T oSIndex, const char *pcPath,
+                   size_t ulSize);
+
+/*
+  Removes pcPath, which was added with size ulSize, from oSIndex.
+  Does nothing if oSIndex lacks it.
+*/
+void SizeIndex_remove(SizeIndex_T oSIndex, const char *pcPath,
+                      size_t ulSize);
+
+/* Gives up on oSIndex, as if memory had run out. */
+void SizeIndex_abandon(SizeIndex_T oSIndex);
+
+/*
+  Calls (*pfApply)(pcPath, ulSize, pvExtra) for each path in oSIndex
+  of size at most ulHigh, in order, until it returns FALSE, and
+  returns TRUE, or returns FALSE without calling it at all if oSIndex
+  has given up. pfApply must not change oSIndex.
+*/
+boolean SizeIndex_map(SizeIndex_T oSIndex, size_t ulHigh,
+                      boolean (*pfApply)(const char *pcPath,
+                                         size_t ulSize, void *pvExtra),
+                      void *pvExtra);
+
+/* Returns the number of bytes oSIndex has allocated. */
+size_t SizeIndex_getSize(SizeIndex_T oSIndex);
+
+/* Returns the number of paths oSIndex holds, 0 once it has given up. */
+size_t SizeIndex_getCount(SizeIndex_T oSIndex);
+
+#endif
@@ -0,0 +1,1003 @@
+/*--------------------------------------------------------------------*/
+/* tar.c                                                              */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "tar.h"
+#include "ft.h"
+
+/* The size of a header, and the unit members are padded to */
+enum { BLOCK_SIZE = 512 };
+
+/* The initial size of a writer's header buffer */
+enum { HEADER_BUFFER = 64 * 1024 };
+
+/* The most pieces a writer gathers into one writev */
+enum { MAX_IOVECS = 1024 };
+
+/* The largest size a header can hold, in its 11 octal digits */
+#define MAX_HEADER_SIZE 077777777777UL
+
+/* The lengths of the fields of a header that hold a path */
+enum { NAME_LENGTH = 100, PREFIX_LENGTH = 155 };
+
+/* The size of a reader's buffer */
+enum { READ_BUFFER = 1024 * 1024 };
+
+/* What TarWriter_split returns for a path that fits no header */
+#define NO_SPLIT ((size_t) -1)
+
+/* A ustar header */
+struct header {
+   char acName[NAME_LENGTH];
+   char acMode[8];
+   char acUid[8];
+   char acGid[8];
+   char acSize[12];
+   char acMtime[12];
+   char acChecksum[8];
+   char cType;
+   char acLinkName[100];
+   char acMagic[6];
+   char acVersion[2];
+   char acUname[32];
+   char acGname[32];
+   char acDevMajor[8];
+   char acDevMinor[8];
+   char acPrefix[PREFIX_LENGTH];
+   char acPad[12];
+};
+
+/* The name given to extended headers, which tar programs never
+   extract as files */
+static const char acPaxName[] = "././@PaxHeader";
+
+struct tarWriter {
+   /* the file descriptor written to */
+   int iFd;
+   /* headers built but not written out yet, and the buffer's size */
+   char *pcHeaders;
+   size_t ulHeaders;
+   size_t ulCapacity;
+   /* the pieces of the archive waiting for the next writev: runs of
+      pcHeaders and the contents of files, in order */
+   struct iovec asPieces[MAX_IOVECS];
+   size_t ulPieces;
+   /* the most pieces writev takes at once here */
+   size_t ulMaxPieces;
+   /* the zeros owed after the contents of the last file added */
+   size_t ulPadding;
+   /* the name of the last directory added, with its slash */
+   char *pcDirName;
+   size_t ulDirName;
+   /* SUCCESS, or the first error */
+   int iStatus;
+};
+
+struct tarReader {
+   /* the file descriptor read from */
+   int iFd;
+   /* the buffer read into, and the bytes in it not consumed yet */
+   char *pcBuffer;
+   size_t ulStart;
+   size_t ulEnd;
+   /* the bytes of the last member not consumed yet, with its padding,
+      and how many of them are contents that TarReader_read reads */
+   size_t ulSkip;
+   size_t ulData;
+   /* TRUE once the end of the archive has been read */
+   boolean bEnded;
+   /* the path of the last member */
+   char *pcPath;
+   size_t ulPathCapacity;
+   /* the records of the last extended header */
+   char *pcRecords;
+   size_t ulRecordsCapacity;
+   /* what extended headers and GNU long names gave for the next member:
+      its path, in pcLongPath, its size and its FT.size */
+   char *pcLongPath;
+   size_t ulLongPathCapacity;
+   boolean bLongPath;
+   boolean bSize;
+   size_t ulSize;
+   boolean bFtSize;
+   size_t ulFtSize;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Writes out every piece oWriter holds, and empties its header
+   buffer. */
+static void TarWriter_flush(TarWriter_T oWriter) {
+   struct iovec *psNext = oWriter->asPieces;
+   size_t ulLeft = oWriter->ulPieces;
+   size_t ulCount;
+   ssize_t lWritten;
+
+   assert(oWriter != NULL);
+
+   while(oWriter->iStatus == SUCCESS && ulLeft > 0) {
+      ulCount = ulLeft < oWriter->ulMaxPieces ? ulLeft
+                                               : oWriter->ulMaxPieces;
+      lWritten = writev(oWriter->iFd, psNext, (int) ulCount);
+      if(lWritten < 0) {
+         if(errno != EINTR)
+            oWriter->iStatus = IO_ERROR;
+         continue;
+      }
+      /* skip what was written, which may end part way into a piece */
+      while(ulLeft > 0 && (size_t) lWritten >= psNext->iov_len) {
+         lWritten -= (ssize_t) psNext->iov_len;
+         psNext++;
+         ulLeft--;
+      }
+      if(ulLeft > 0) {
+         psNext->iov_base = (char *) psNext->iov_base + lWritten;
+         psNext->iov_len -= (size_t) lWritten;
+      }
+   }
+   oWriter->ulPieces = 0;
+   oWriter->ulHeaders = 0;
+}
+
+/* Adds the ulLength bytes pvBytes as the next piece of oWriter's
+   archive, joining them to the last piece if they follow it. */
+static void TarWriter_push(TarWriter_T oWriter, const void *pvBytes,
+                           size_t ulLength) {
+   struct iovec *psLast;
+
+   assert(oWriter != NULL);
+   assert(oWriter->ulPieces < oWriter->ulMaxPieces);
+
+   if(ulLength == 0)
+      return;
+   if(oWriter->ulPieces > 0) {
+      psLast = &oWriter->asPieces[oWriter->ulPieces - 1];
+      if((const char *) psLast->iov_base + psLast->iov_len ==
+         (const char *) pvBytes) {
+         psLast->iov_len += ulLength;
+         return;
+      }
+   }
+   oWriter->asPieces[oWriter->ulPieces].iov_base = (void *) pvBytes;
+   oWriter->asPieces[oWriter->ulPieces].iov_len = ulLength;
+   oWriter->ulPieces++;
+}
+
+/*
+  Makes room in oWriter for ulBytes more bytes of headers and two more
+  pieces, writing out what it holds if need be, and returns where the
+  bytes go, or NULL if oWriter has failed.
+*/
+static char *TarWriter_reserve(TarWriter_T oWriter, size_t ulBytes) {
+   char *pcGrown;
+
+   assert(oWriter != NULL);
+
+   if(oWriter->ulHeaders + ulBytes > oWriter->ulCapacity ||
+      oWriter->ulPieces + 2 > oWriter->ulMaxPieces)
+      TarWriter_flush(oWriter);
+   if(oWriter->iStatus != SUCCESS)
+      return NULL;
+   /* nothing is pending after the flush, so the buffer can move */
+   if(ulBytes > oWriter->ulCapacity) {
+      pcGrown = realloc(oWriter->pcHeaders, ulBytes);
+      if(pcGrown == NULL) {
+         oWriter->iStatus = MEMORY_ERROR;
+         return NULL;
+      }
+      oWriter->pcHeaders = pcGrown;
+      oWriter->ulCapacity = ulBytes;
+   }
+   oWriter->ulHeaders += ulBytes;
+   return oWriter->pcHeaders + oWriter->ulHeaders - ulBytes;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the length of a pax record of the key pcKey and a value
+   ulValue bytes long, counting the digits of the length itself. */
+static size_t TarWriter_recordLength(const char *pcKey, size_t ulValue) {
+   /* a space, an equals sign and a newline */
+   size_t ulLength = strlen(pcKey) + ulValue + 3;
+   size_t ulDigits = 1;
+   size_t ulPower = 10;
+
+   assert(pcKey != NULL);
+
+   while(ulLength + ulDigits >= ulPower) {
+      ulDigits++;
+      ulPower *= 10;
+   }
+   return ulLength + ulDigits;
+}
+
+/* Writes the pax record of the key pcKey and the value pcValue, of
+   ulValue bytes, at pcDest, and returns the byte after it. */
+static char *TarWriter_putRecord(char *pcDest, const char *pcKey,
+                                 const char *pcValue, size_t ulValue) {
+   assert(pcDest != NULL);
+   assert(pcKey != NULL);
+   assert(pcValue != NULL);
+
+   pcDest += sprintf(pcDest, "%lu %s=",
+                     (unsigned long) TarWriter_recordLength(pcKey,
+                                                            ulValue),
+                     pcKey);
+   memcpy(pcDest, pcValue, ulValue);
+   pcDest += ulValue;
+   *pcDest++ = '\n';
+   return pcDest;
+}
+
+/*
+  Returns how the path pcName, ulName bytes long, fits in a header: 0
+  if it fits in the name field alone, the index of the separator after
+  the part that goes in the prefix field if it fits split between the
+  two, or NO_SPLIT if it fits neither way.
+*/
+static size_t TarWriter_split(const char *pcName, size_t ulName) {
+   size_t i;
+
+   assert(pcName != NULL);
+
+   if(ulName <= NAME_LENGTH)
+      return 0;
+   /* the longest prefix that leaves a name, short enough */
+   i = ulName - 2 < PREFIX_LENGTH ? ulName - 2 : PREFIX_LENGTH;
+   for(; i > 0 && ulName - i - 1 <= NAME_LENGTH; i--)
+      if(pcName[i] == '/')
+         return i;
+   return NO_SPLIT;
+}
+
+/*
+  Fills in the header at psHeader, which is all zeros, of a member of
+  type cType and size ulSize named pcName, split as TarWriter_split
+  says by ulSplit; a name that fits no header is cut short, to be
+  given in full in an extended header.
+*/
+static void TarWriter_fillHeader(struct header *psHeader, char cType,
+                                 const char *pcName, size_t ulSplit,
+                                 size_t ulSize) {
+   const unsigned char *pucByte;
+   unsigned long ulChecksum = 0;
+   size_t i;
+
+   assert(psHeader != NULL);
+   assert(pcName != NULL);
+
+   if(ulSplit == NO_SPLIT)
+      memcpy(psHeader->acName, pcName, NAME_LENGTH);
+   else if(ulSplit == 0)
+      memcpy(psHeader->acName, pcName, strlen(pcName));
+   else {
+      memcpy(psHeader->acPrefix, pcName, ulSplit);
+      memcpy(psHeader->acName, pcName + ulSplit + 1,
+             strlen(pcName + ulSplit + 1));
+   }
+
+   sprintf(psHeader->acMode, "%07o", cType == '5' ? 0755 : 0644);
+   sprintf(psHeader->acUid, "%07o", 0);
+   sprintf(psHeader->acGid, "%07o", 0);
+   sprintf(psHeader->acSize, "%011lo",
+           ulSize > MAX_HEADER_SIZE ? 0UL : (unsigned long) ulSize);
+   sprintf(psHeader->acMtime, "%011o", 0);
+   psHeader->cType = cType;
+   memcpy(psHeader->acMagic, "ustar", 6);
+   memcpy(psHeader->acVersion, "00", 2);
+
+   /* summed with the checksum field itself taken as spaces */
+   memset(psHeader->acChecksum, ' ', sizeof(psHeader->acChecksum));
+   pucByte = (const unsigned char *) psHeader;
+   for(i = 0; i < sizeof(struct header); i++)
+      ulChecksum += pucByte[i];
+   sprintf(psHeader->acChecksum, "%06lo", ulChecksum);
+}
+
+/*
+  Adds the header of a member of type cType named pcName and of size
+  ulSize to oWriter's archive, after the padding owed by the last
+  file, and after an extended header if the member needs one. If
+  ulFtSize is not 0, it is recorded as the member's FT.size.
+*/
+static void TarWriter_addHeader(TarWriter_T oWriter, char cType,
+                                const char *pcName, size_t ulSize,
+                                size_t ulFtSize) {
+   char acSize[32], acFtSize[32];
+   char *pcStart, *pcNext, *pcRecords;
+   size_t ulName, ulSplit, ulTotal;
+   size_t ulRecords = 0, ulExtended = 0;
+
+   assert(oWriter != NULL);
+   assert(pcName != NULL);
+
+   if(oWriter->iStatus != SUCCESS)
+      return;
+
+   ulName = strlen(pcName);
+   ulSplit = TarWriter_split(pcName, ulName);
+   if(ulSplit == NO_SPLIT)
+      ulRecords += TarWriter_recordLength("path", ulName);
+   if(ulSize > MAX_HEADER_SIZE) {
+      sprintf(acSize, "%lu", (unsigned long) ulSize);
+      ulRecords += TarWriter_recordLength("size", strlen(acSize));
+   }
+   if(ulFtSize != 0) {
+      sprintf(acFtSize, "%lu", (unsigned long) ulFtSize);
+      ulRecords += TarWriter_recordLength("FT.size", strlen(acFtSize));
+   }
+   if(ulRecords != 0)
+      ulExtended = BLOCK_SIZE +
+                   (ulRecords + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+
+   ulTotal = oWriter->ulPadding + ulExtended + BLOCK_SIZE;
+   pcStart = TarWriter_reserve(oWriter, ulTotal);
+   if(pcStart == NULL)
+      return;
+   memset(pcStart, 0, ulTotal);
+   pcNext = pcStart + oWriter->ulPadding;
+
+   if(ulRecords != 0) {
+      TarWriter_fillHeader((struct header *) pcNext, 'x', acPaxName, 0,
+                           ulRecords);
+      pcRecords = pcNext + BLOCK_SIZE;
+      if(ulSplit == NO_SPLIT)
+         pcRecords = TarWriter_putRecord(pcRecords, "path", pcName,
+                                         ulName);
+      if(ulSize > MAX_HEADER_SIZE)
+         pcRecords = TarWriter_putRecord(pcRecords, "size", acSize,
+                                         strlen(acSize));
+      if(ulFtSize != 0)
+         pcRecords = TarWriter_putRecord(pcRecords, "FT.size", acFtSize,
+                                         strlen(acFtSize));
+      pcNext += ulExtended;
+   }
+   TarWriter_fillHeader((struct header *) pcNext, cType, pcName, ulSplit,
+                        ulSize);
+
+   TarWriter_push(oWriter, pcStart, ulTotal);
+   oWriter->ulPadding = 0;
+}
+
+/*--------------------------------------------------------------------*/
+
+int TarWriter_new(int iFd, TarWriter_T *poWResult) {
+   TarWriter_T oWriter;
+   long lMaxPieces;
+
+   assert(poWResult != NULL);
+
+   *poWResult = NULL;
+   oWriter = malloc(sizeof(struct tarWriter));
+   if(oWriter == NULL)
+      return MEMORY_ERROR;
+   oWriter->pcHeaders = malloc(HEADER_BUFFER);
+   if(oWriter->pcHeaders == NULL) {
+      free(oWriter);
+      return MEMORY_ERROR;
+   }
+   oWriter->iFd = iFd;
+   oWriter->ulHeaders = 0;
+   oWriter->ulCapacity = HEADER_BUFFER;
+   oWriter->ulPieces = 0;
+   lMaxPieces = sysconf(_SC_IOV_MAX);
+   /* POSIX promises at least 16 */
+   if(lMaxPieces < 16)
+      lMaxPieces = 16;
+   oWriter->ulMaxPieces = lMaxPieces < MAX_IOVECS ? (size_t) lMaxPieces
+                                                   : MAX_IOVECS;
+   oWriter->ulPadding = 0;
+   oWriter->pcDirName = NULL;
+   oWriter->ulDirName = 0;
+   oWriter->iStatus = SUCCESS;
+
+   *poWResult = oWriter;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+void TarWriter_addDir(TarWriter_T oWriter, const char *pcPath) {
+   size_t ulLength;
+   char *pcGrown;
+
+   assert(oWriter != NULL);
+   assert(pcPath != NULL);
+
+   if(oWriter->iStatus != SUCCESS)
+      return;
+   /* tar programs mark directories with a trailing slash */
+   ulLength = strlen(pcPath);
+   if(ulLength + 2 > oWriter->ulDirName) {
+      pcGrown = realloc(oWriter->pcDirName, 2 * ulLength + 2);
+      if(pcGrown == NULL) {
+         oWriter->iStatus = MEMORY_ERROR;
+         return;
+      }
+      oWriter->pcDirName = pcGrown;
+      oWriter->ulDirName = 2 * ulLength + 2;
+   }
+   memcpy(oWriter->pcDirName, pcPath, ulLength);
+   strcpy(oWriter->pcDirName + ulLength, "/");
+   TarWriter_addHeader(oWriter, '5', oWriter->pcDirName, 0, 0);
+}
+
+/*--------------------------------------------------------------------*/
+
+void TarWriter_addFile(TarWriter_T oWriter, const char *pcPath,
+                       const void *pvContents, size_t ulLength) {
+   assert(oWriter != NULL);
+   assert(pcPath != NULL);
+
+   if(pvContents == NULL) {
+      TarWriter_addHeader(oWriter, '0', pcPath, 0, ulLength);
+      return;
+   }
+   TarWriter_addHeader(oWriter, '0', pcPath, ulLength, 0);
+   if(oWriter->iStatus != SUCCESS)
+      return;
+   /* the header made room for this piece */
+   TarWriter_push(oWriter, pvContents, ulLength);
+   oWriter->ulPadding = (BLOCK_SIZE - ulLength % BLOCK_SIZE) % BLOCK_SIZE;
+}
+
+/*--------------------------------------------------------------------*/
+
+void TarWriter_sendFile(TarWriter_T oWriter, const char *pcPath,
+                        size_t ulLength,
+                        int (*pfSend)(void *pvSource, int iFd,
+                                      size_t *pulSent),
+                        void *pvSource) {
+   size_t ulSent = 0;
+   int iStatus;
+
+   assert(oWriter != NULL);
+   assert(pcPath != NULL);
+   assert(pfSend != NULL);
+
+   TarWriter_addHeader(oWriter, '0', pcPath, ulLength, 0);
+   /* the contents follow everything pending, so that goes first */
+   TarWriter_flush(oWriter);
+   if(oWriter->iStatus != SUCCESS)
+      return;
+   iStatus = (*pfSend)(pvSource, oWriter->iFd, &ulSent);
+   if(iStatus == SUCCESS && ulSent != ulLength) {
+      errno = EIO;
+      iStatus = IO_ERROR;
+   }
+   if(iStatus != SUCCESS) {
+      oWriter->iStatus = iStatus;
+      return;
+   }
+   oWriter->ulPadding = (BLOCK_SIZE - ulLength % BLOCK_SIZE) % BLOCK_SIZE;
+}
+
+/*--------------------------------------------------------------------*/
+
+void TarWriter_fail(TarWriter_T oWriter, int iStatus) {
+   assert(oWriter != NULL);
+
+   if(oWriter->iStatus == SUCCESS)
+      oWriter->iStatus = iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+int TarWriter_finish(TarWriter_T oWriter) {
+   size_t ulTotal;
+   char *pcEnd;
+   int iStatus;
+
+   assert(oWriter != NULL);
+
+   ulTotal = oWriter->ulPadding + 2 * BLOCK_SIZE;
+   pcEnd = TarWriter_reserve(oWriter, ulTotal);
+   if(pcEnd != NULL) {
+      memset(pcEnd, 0, ulTotal);
+      TarWriter_push(oWriter, pcEnd, ulTotal);
+   }
+   TarWriter_flush(oWriter);
+
+   iStatus = oWriter->iStatus;
+   free(oWriter->pcHeaders);
+   free(oWriter->pcDirName);
+   free(oWriter);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+/* Makes the buffer at *ppcBuffer, of *pulCapacity bytes, at least
+   ulNeeded bytes. Returns TRUE, or FALSE if memory ran out. */
+static boolean TarReader_grow(char **ppcBuffer, size_t *pulCapacity,
+                              size_t ulNeeded) {
+   char *pcGrown;
+
+   assert(ppcBuffer != NULL);
+   assert(pulCapacity != NULL);
+
+   if(ulNeeded <= *pulCapacity)
+      return TRUE;
+   if(ulNeeded < 2 * *pulCapacity)
+      ulNeeded = 2 * *pulCapacity;
+   pcGrown = realloc(*ppcBuffer, ulNeeded);
+   if(pcGrown == NULL)
+      return FALSE;
+   *ppcBuffer = pcGrown;
+   *pulCapacity = ulNeeded;
+   return TRUE;
+}
+
+/*
+  Reads into oReader's buffer until it holds at least ulWanted bytes
+  not consumed yet, or the archive ends, and returns SUCCESS, or
+  IO_ERROR if reading failed.
+*/
+static int TarReader_fill(TarReader_T oReader, size_t ulWanted) {
+   ssize_t lRead;
+
+   assert(oReader != NULL);
+   assert(ulWanted <= READ_BUFFER);
+
+   if(oReader->ulEnd - oReader->ulStart >= ulWanted)
+      return SUCCESS;
+   memmove(oReader->pcBuffer, oReader->pcBuffer + oReader->ulStart,
+           oReader->ulEnd - oReader->ulStart);
+   oReader->ulEnd -= oReader->ulStart;
+   oReader->ulStart = 0;
+   while(oReader->ulEnd < ulWanted) {
+      lRead = read(oReader->iFd, oReader->pcBuffer + oReader->ulEnd,
+                   READ_BUFFER - oReader->ulEnd);
+      if(lRead < 0) {
+         if(errno == EINTR)
+            continue;
+         return IO_ERROR;
+      }
+      if(lRead == 0)
+         break;
+      oReader->ulEnd += (size_t) lRead;
+   }
+   return SUCCESS;
+}
+
+/*
+  Consumes the next ulLength bytes of oReader's archive, copying them
+  to pcDest unless it is NULL. Returns SUCCESS, or IO_ERROR, with errno
+  EINVAL if the archive ends first.
+*/
+static int TarReader_take(TarReader_T oReader, char *pcDest,
+                          size_t ulLength) {
+   size_t ulCopied;
+   ssize_t lRead;
+
+   assert(oReader != NULL);
+
+   ulCopied = oReader->ulEnd - oReader->ulStart;
+   if(ulCopied > ulLength)
+      ulCopied = ulLength;
+   if(pcDest != NULL) {
+      memcpy(pcDest, oReader->pcBuffer + oReader->ulStart, ulCopied);
+      pcDest += ulCopied;
+   }
+   oReader->ulStart += ulCopied;
+   ulLength -= ulCopied;
+
+   /* the rest is read straight where it goes, or through the buffer
+      to be dropped */
+   while(ulLength > 0) {
+      if(pcDest != NULL)
+         lRead = read(oReader->iFd, pcDest, ulLength);
+      else
+         lRead = read(oReader->iFd, oReader->pcBuffer,
+                      ulLength < READ_BUFFER ? ulLength : READ_BUFFER);
+      if(lRead < 0) {
+         if(errno == EINTR)
+            continue;
+         return IO_ERROR;
+      }
+      if(lRead == 0) {
+         errno = EINVAL;
+         return IO_ERROR;
+      }
+      if(pcDest != NULL)
+         pcDest += lRead;
+      ulLength -= (size_t) lRead;
+   }
+   return SUCCESS;
+}
+
+/*
+  Parses the number in the header field pcField, ulWidth bytes wide,
+  into *pulResult: octal digits after any spaces, ending in a space or
+  a NUL, or a base-256 number if the first byte has its high bit set.
+  Returns TRUE, or FALSE if the field holds no such number, or one too
+  large for a size_t.
+*/
+static boolean TarReader_number(const char *pcField, size_t ulWidth,
+                                size_t *pulResult) {
+   const unsigned char *pucByte = (const unsigned char *) pcField;
+   size_t ulValue = 0;
+   size_t i = 0;
+
+   assert(pcField != NULL);
+   assert(pulResult != NULL);
+
+   if((pucByte[0] & 0x80) != 0) {
+      /* a negative number, with the next bit set, is no size */
+      if((pucByte[0] & 0x40) != 0)
+         return FALSE;
+      ulValue = pucByte[0] & 0x3f;
+      for(i = 1; i < ulWidth; i++) {
+         if(ulValue > ((size_t) -1) >> 8)
+            return FALSE;
+         ulValue = ulValue << 8 | pucByte[i];
+      }
+      *pulResult = ulValue;
+      return TRUE;
+   }
+
+   while(i < ulWidth && pcField[i] == ' ')
+      i++;
+   for(; i < ulWidth && pcField[i] >= '0' && pcField[i] <= '7'; i++) {
+      if(ulValue > ((size_t) -1) >> 3)
+         return FALSE;
+      ulValue = ulValue << 3 | (size_t) (pcField[i] - '0');
+   }
+   if(i < ulWidth && pcField[i] != ' ' && pcField[i] != '\0')
+      return FALSE;
+   *pulResult = ulValue;
+   return TRUE;
+}
+
+/* Parses the ulLength decimal digits at pcDigits into *pulResult.
+   Returns TRUE, or FALSE if they are not all digits or the number is
+   too large for a size_t. */
+static boolean TarReader_decimal(const char *pcDigits, size_t ulLength,
+                                 size_t *pulResult) {
+   size_t ulValue = 0;
+   size_t i;
+
+   assert(pcDigits != NULL);
+   assert(pulResult != NULL);
+
+   if(ulLength == 0)
+      return FALSE;
+   for(i = 0; i < ulLength; i++) {
+      if(pcDigits[i] < '0' || pcDigits[i] > '9' ||
+         ulValue > ((size_t) -1 - 9) / 10)
+         return FALSE;
+      ulValue = ulValue * 10 + (size_t) (pcDigits[i] - '0');
+   }
+   *pulResult = ulValue;
+   return TRUE;
+}
+
+/* Returns TRUE if the checksum of psHeader is right, summed with its
+   bytes taken as unsigned or, as some old tar programs did, signed. */
+static boolean TarReader_checksum(const struct header *psHeader) {
+   const unsigned char *pucByte = (const unsigned char *) psHeader;
+   const signed char *pscByte = (const signed char *) psHeader;
+   unsigned long ulSum = 0;
+   long lSum = 0;
+   size_t ulExpected;
+   size_t i;
+
+   assert(psHeader != NULL);
+
+   if(!TarReader_number(psHeader->acChecksum,
+                        sizeof(psHeader->acChecksum), &ulExpected))
+      return FALSE;
+   for(i = 0; i < sizeof(struct header); i++) {
+      if(i >= offsetof(struct header, acChecksum) &&
+         i < offsetof(struct header, cType)) {
+         ulSum += ' ';
+         lSum += ' ';
+      }
+      else {
+         ulSum += pucByte[i];
+         lSum += pscByte[i];
+      }
+   }
+   return ulSum == ulExpected || (lSum >= 0 &&
+                                  (unsigned long) lSum == ulExpected);
+}
+
+/*
+  Applies the ulLength bytes of pax records in oReader's pcRecords to
+  the next member. Returns SUCCESS, or IO_ERROR with errno EINVAL if
+  they are malformed, or MEMORY_ERROR.
+*/
+static int TarReader_applyRecords(TarReader_T oReader, size_t ulLength) {
+   const char *pcRecord = oReader->pcRecords;
+   const char *pcEnd = oReader->pcRecords + ulLength;
+   const char *pcKey, *pcValue, *pcSpace;
+   size_t ulRecord, ulKey, ulValue;
+
+   assert(oReader != NULL);
+
+   /* each record is "<length> <key>=<value>\n" */
+   while(pcRecord < pcEnd) {
+      pcSpace = memchr(pcRecord, ' ', (size_t) (pcEnd - pcRecord));
+      if(pcSpace == NULL ||
+         !TarReader_decimal(pcRecord, (size_t) (pcSpace - pcRecord),
+                            &ulRecord) ||
+         ulRecord > (size_t) (pcEnd - pcRecord) ||
+         pcRecord + ulRecord <= pcSpace + 1 ||
+         pcRecord[ulRecord - 1] != '\n')
+         goto malformed;
+      pcKey = pcSpace + 1;
+      pcValue = memchr(pcKey, '=', (size_t) (pcRecord + ulRecord - pcKey));
+      if(pcValue == NULL)
+         goto malformed;
+      ulKey = (size_t) (pcValue - pcKey);
+      pcValue++;
+      ulValue = (size_t) (pcRecord + ulRecord - 1 - pcValue);
+
+      if(ulKey == 4 && strncmp(pcKey, "path", 4) == 0) {
+         if(!TarReader_grow(&oReader->pcLongPath,
+                            &oReader->ulLongPathCapacity, ulValue + 1))
+            return MEMORY_ERROR;
+         memcpy(oReader->pcLongPath, pcValue, ulValue);
+         oReader->pcLongPath[ulValue] = '\0';
+         oReader->bLongPath = TRUE;
+      }
+      else if(ulKey == 4 && strncmp(pcKey, "size", 4) == 0) {
+         if(!TarReader_decimal(pcValue, ulValue, &oReader->ulSize))
+            goto malformed;
+         oReader->bSize = TRUE;
+      }
+      else if(ulKey == 7 && strncmp(pcKey, "FT.size", 7) == 0) {
+         if(!TarReader_decimal(pcValue, ulValue, &oReader->ulFtSize))
+            goto malformed;
+         oReader->bFtSize = TRUE;
+      }
+      pcRecord += ulRecord;
+   }
+   return SUCCESS;
+
+ malformed:
+   errno = EINVAL;
+   return IO_ERROR;
+}
+
+/* Sets oReader's pcPath to the path of the member of header psHeader,
+   made relative. Returns TRUE, or FALSE if memory ran out. */
+static boolean TarReader_setPath(TarReader_T oReader,
+                                 const struct header *psHeader) {
+   const char *pcName;
+   size_t ulName, ulPrefix = 0;
+   char *pcPath;
+
+   assert(oReader != NULL);
+   assert(psHeader != NULL);
+
+   if(oReader->bLongPath) {
+      pcName = oReader->pcLongPath;
+      ulName = strlen(pcName);
+   }
+   else {
+      pcName = psHeader->acName;
+      for(ulName = 0; ulName < NAME_LENGTH && pcName[ulName] != '\0';
+          ulName++)
+         ;
+      /* GNU tar's own format keeps other fields where the prefix is */
+      if(memcmp(psHeader->acMagic, "ustar", 6) == 0)
+         while(ulPrefix < PREFIX_LENGTH &&
+               psHeader->acPrefix[ulPrefix] != '\0')
+            ulPrefix++;
+   }
+
+   if(!TarReader_grow(&oReader->pcPath, &oReader->ulPathCapacity,
+                      ulPrefix + ulName + 2))
+      return FALSE;
+   pcPath = oReader->pcPath;
+   if(ulPrefix != 0) {
+      memcpy(pcPath, psHeader->acPrefix, ulPrefix);
+      pcPath[ulPrefix++] = '/';
+   }
+   memcpy(pcPath + ulPrefix, pcName, ulName);
+   pcPath[ulPrefix + ulName] = '\0';
+
+   /* drop any leading "/" and "./", and any trailing "/" */
+   for(;;) {
+      if(pcPath[0] == '/')
+         pcPath++;
+      else if(pcPath[0] == '.' && pcPath[1] == '/')
+         pcPath += 2;
+      else if(pcPath[0] == '.' && pcPath[1] == '\0')
+         pcPath++;
+      else
+         break;
+   }
+   ulName = strlen(pcPath);
+   while(ulName > 0 && pcPath[ulName - 1] == '/')
+      pcPath[--ulName] = '\0';
+   memmove(oReader->pcPath, pcPath, ulName + 1);
+   return TRUE;
+}
+
+/*--------------------------------------------------------------------*/
+
+int TarReader_new(int iFd, TarReader_T *poRResult) {
+   TarReader_T oReader;
+
+   assert(poRResult != NULL);
+
+   *poRResult = NULL;
+   oReader = calloc(1, sizeof(struct tarReader));
+   if(oReader == NULL)
+      return MEMORY_ERROR;
+   oReader->pcBuffer = malloc(READ_BUFFER);
+   if(oReader->pcBuffer == NULL) {
+      free(oReader);
+      return MEMORY_ERROR;
+   }
+   oReader->iFd = iFd;
+
+   *poRResult = oReader;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int TarReader_next(TarReader_T oReader, struct Tar_member *psMember) {
+   struct header sHeader;
+   size_t ulSize, ulAvailable, i;
+   int iStatus;
+
+   assert(oReader != NULL);
+   assert(psMember != NULL);
+
+   psMember->pcPath = NULL;
+   for(;;) {
+      if(oReader->bEnded)
+         return SUCCESS;
+      iStatus = TarReader_take(oReader, NULL, oReader->ulSkip);
+      oReader->ulSkip = 0;
+      oReader->ulData = 0;
+      if(iStatus == SUCCESS)
+         iStatus = TarReader_fill(oReader, BLOCK_SIZE);
+      if(iStatus != SUCCESS)
+         return iStatus;
+
+      /* an archive may end without its blocks of zeros, but not within
+         a header */
+      ulAvailable = oReader->ulEnd - oReader->ulStart;
+      if(ulAvailable == 0) {
+         oReader->bEnded = TRUE;
+         continue;
+      }
+      if(ulAvailable < BLOCK_SIZE) {
+         errno = EINVAL;
+         return IO_ERROR;
+      }
+      memcpy(&sHeader, oReader->pcBuffer + oReader->ulStart, BLOCK_SIZE);
+      oReader->ulStart += BLOCK_SIZE;
+
+      for(i = 0; i < BLOCK_SIZE && ((char *) &sHeader)[i] == '\0'; i++)
+         ;
+      if(i == BLOCK_SIZE) {
+         oReader->bEnded = TRUE;
+         continue;
+      }
+      if(!TarReader_checksum(&sHeader) ||
+         !TarReader_number(sHeader.acSize, sizeof(sHeader.acSize),
+                           &ulSize)) {
+         errno = EINVAL;
+         return IO_ERROR;
+      }
+      if((sHeader.cType == '0' || sHeader.cType == '\0' ||
+          sHeader.cType == '7') && oReader->bSize)
+         ulSize = oReader->ulSize;
+      if(ulSize > (size_t) -1 - (BLOCK_SIZE - 1)) {
+         errno = EINVAL;
+         return IO_ERROR;
+      }
+      oReader->ulSkip = (ulSize + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+
+      switch(sHeader.cType) {
+         case 'x':
+         case 'L':
+            /* an extended header, or a GNU long name */
+            if(!TarReader_grow(&oReader->pcRecords,
+                               &oReader->ulRecordsCapacity, ulSize + 1))
+               return MEMORY_ERROR;
+            iStatus = TarReader_take(oReader, oReader->pcRecords, ulSize);
+            if(iStatus != SUCCESS)
+               return iStatus;
+            oReader->ulSkip -= ulSize;
+            if(sHeader.cType == 'x') {
+               iStatus = TarReader_applyRecords(oReader, ulSize);
+               if(iStatus != SUCCESS)
+                  return iStatus;
+            }
+            else {
+               oReader->pcRecords[ulSize] = '\0';
+               if(!TarReader_grow(&oReader->pcLongPath,
+                                  &oReader->ulLongPathCapacity,
+                                  ulSize + 1))
+                  return MEMORY_ERROR;
+               strcpy(oReader->pcLongPath, oReader->pcRecords);
+               oReader->bLongPath = TRUE;
+            }
+            continue;
+
+         case 'g':
+         case 'K':
+            /* global headers and GNU long link names matter to none of
+               the members kept */
+            continue;
+
+         case '5':
+         case '0':
+         case '\0':
+         case '7':
+            break;
+
+         default:
+            oReader->bLongPath = FALSE;
+            oReader->bSize = FALSE;
+            oReader->bFtSize = FALSE;
+            continue;
+      }
+
+      if(!TarReader_setPath(oReader, &sHeader))
+         return MEMORY_ERROR;
+      psMember->bIsDir = (boolean) (sHeader.cType == '5');
+      psMember->ulLength = psMember->bIsDir ? 0 : ulSize;
+      psMember->bHasContents = TRUE;
+      if(!psMember->bIsDir && oReader->bFtSize && ulSize == 0) {
+         psMember->ulLength = oReader->ulFtSize;
+         psMember->bHasContents = FALSE;
+      }
+      if(!psMember->bIsDir && psMember->bHasContents)
+         oReader->ulData = ulSize;
+      oReader->bLongPath = FALSE;
+      oReader->bSize = FALSE;
+      oReader->bFtSize = FALSE;
+
+      /* a member with no path left names the root of the archive */
+      if(oReader->pcPath[0] == '\0')
+         continue;
+      psMember->pcPath = oReader->pcPath;
+      return SUCCESS;
+   }
+}
+
+/*--------------------------------------------------------------------*/
+
+int TarReader_read(TarReader_T oReader, void *pvDest) {
+   int iStatus;
+
+   assert(oReader != NULL);
+   assert(pvDest != NULL || oReader->ulData == 0);
+
+   iStatus = TarReader_take(oReader, pvDest, oReader->ulData);
+   if(iStatus == SUCCESS) {
+      oReader->ulSkip -= oReader->ulData;
+      oReader->ulData = 0;
+   }
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+void TarReader_free(TarReader_T oReader) {
+   if(oReader == NULL)
+      return;
+   free(oReader->pcBuffer);
+   free(oReader->pcPath);
+   free(oReader->pcRecords);
+   free(oReader->pcLongPath);
+   free(oReader);
+}
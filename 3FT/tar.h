@@ -0,0 +1,143 @@
+/*--------------------------------------------------------------------*/
+/* tar.h                                                              */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef TAR_INCLUDED
+#define TAR_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A tar archive, in the pax format of POSIX.1-2001 that any tar
+  program reads, is a sequence of members, each a 512-byte ustar
+  header followed by the member's bytes, padded with zeros to a
+  multiple of 512, and ends with two blocks of zeros. A path that does
+  not fit in a header, or a size too large for one, is given in a pax
+  extended header, a member of its own, just before the member it
+  applies to.
+
+  A file with no contents but a nonzero size, which a File Tree can
+  hold, is written as an empty member with its size in the extended
+  header keyword FT.size, which other tar programs skip (GNU tar with
+  a warning).
+*/
+
+/*
+  A TarWriter_T writes an archive to a file descriptor. Headers are
+  built in a buffer that is reused once written out, while contents
+  are written straight from where they lie, with writev, so that they
+  are never copied, or by the caller, for contents that cannot stay
+  put until the archive is done. Errors are remembered rather than
+  returned by each call: once one occurs, later calls do nothing, and
+  TarWriter_finish reports it.
+*/
+typedef struct tarWriter *TarWriter_T;
+
+/*
+  Creates a writer that writes an archive to iFd, from its current
+  position on. Returns SUCCESS and sets *poWResult to the writer if
+  successful. Otherwise, sets *poWResult to NULL and returns
+  MEMORY_ERROR.
+*/
+int TarWriter_new(int iFd, TarWriter_T *poWResult);
+
+/* Adds the directory pcPath, a relative path, to oWriter's archive. */
+void TarWriter_addDir(TarWriter_T oWriter, const char *pcPath);
+
+/*
+  Adds the file pcPath, a relative path, with contents pvContents of
+  ulLength bytes, or no contents if pvContents is NULL, to oWriter's
+  archive. pvContents is written from where it lies, and must stay
+  valid and unchanged until TarWriter_finish.
+*/
+void TarWriter_addFile(TarWriter_T oWriter, const char *pcPath,
+                       const void *pvContents, size_t ulLength);
+
+/*
+  Adds the file pcPath, a relative path, with ulLength bytes of
+  contents to oWriter's archive, which (*pfSend)(pvSource, iFd,
+  &ulSent) writes to oWriter's file descriptor iFd itself, adding to
+  ulSent how many it wrote, once everything pending is written out,
+  so that the contents need only stay valid during the call. Records
+  the status pfSend returns if it is not SUCCESS, or IO_ERROR, with
+  errno set to EIO, if it wrote other than ulLength bytes.
+*/
+void TarWriter_sendFile(TarWriter_T oWriter, const char *pcPath,
+                        size_t ulLength,
+                        int (*pfSend)(void *pvSource, int iFd,
+                                      size_t *pulSent),
+                        void *pvSource);
+
+/*
+  Records the failure iStatus in oWriter, unless it has failed
+  already, so that nothing more is written.
+*/
+void TarWriter_fail(TarWriter_T oWriter, int iStatus);
+
+/*
+  Writes the end of the archive and everything still pending, then
+  frees oWriter. Returns SUCCESS, or the first error: IO_ERROR (from
+  ft.h) if writing failed, in which case errno tells why, or
+  MEMORY_ERROR, or whatever TarWriter_fail recorded.
+*/
+int TarWriter_finish(TarWriter_T oWriter);
+
+/*--------------------------------------------------------------------*/
+
+/* A directory or regular file of an archive, as read by
+   TarReader_next */
+struct Tar_member {
+   /* the member's path, with no leading "/" or "./" and no trailing
+      "/", valid until the next call to TarReader_next */
+   const char *pcPath;
+   /* TRUE if the member is a directory, FALSE if it is a file */
+   boolean bIsDir;
+   /* for a file, its size */
+   size_t ulLength;
+   /* for a file, TRUE if the archive holds its contents, or FALSE if
+      it has none, as recorded by FT.size */
+   boolean bHasContents;
+};
+
+/*
+  A TarReader_T reads the members of an archive from a file
+  descriptor, in large reads into a buffer that headers are parsed in
+  place from. Contents are copied out of the buffer, or read straight
+  into their destination if they are not there yet. Extended headers
+  and GNU long names are applied to the member they precede; members
+  other than directories and regular files, such as links, are
+  skipped.
+*/
+typedef struct tarReader *TarReader_T;
+
+/*
+  Creates a reader of the archive iFd holds from its current position
+  on. Returns SUCCESS and sets *poRResult to the reader if successful.
+  Otherwise, sets *poRResult to NULL and returns MEMORY_ERROR.
+*/
+int TarReader_new(int iFd, TarReader_T *poRResult);
+
+/*
+  Reads the header of the next directory or file of oReader's archive
+  into *psMember, skipping whatever was not read of the last member's
+  contents. Returns SUCCESS, having set psMember->pcPath to NULL if
+  the archive has ended, or returns IO_ERROR, in which case errno
+  tells why (EINVAL if the archive is damaged or cut short), or
+  MEMORY_ERROR.
+*/
+int TarReader_next(TarReader_T oReader, struct Tar_member *psMember);
+
+/*
+  Reads the contents of the file TarReader_next found last, as many
+  bytes as its ulLength, into pvDest. Returns SUCCESS, or IO_ERROR, in
+  which case errno tells why (EINVAL if the archive ends first).
+*/
+int TarReader_read(TarReader_T oReader, void *pvDest);
+
+/* Frees oReader, leaving its file descriptor open. Does nothing if
+   oReader is NULL. */
+void TarReader_free(TarReader_T oReader);
+
+#endif
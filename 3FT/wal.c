@@ -0,0 +1,702 @@
+/*--------------------------------------------------------------------*/
+/* wal.c                                                              */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "wal.h"
+#include "ft.h"
+
+/* The bytes every log starts with */
+static const unsigned char aucMagic[8] = "FTWAL";
+
+/* The size of a log's header: the magic bytes and the generation */
+enum { HEADER_SIZE = 16 };
+
+/* The size of a record's checksum, and of its kind */
+enum { CHECKSUM_SIZE = 4, OP_SIZE = 1 };
+
+/* The most bytes a length takes in a record */
+enum { MAX_VARINT = 10 };
+
+/* The flag in a record's kind of a file without contents */
+enum { NO_CONTENTS = 0x80 };
+
+/* A buffer of records not written out yet */
+struct walBuffer {
+   unsigned char *pucBytes;
+   size_t ulLength;
+   size_t ulCapacity;
+};
+
+/* A log being appended to */
+struct wal {
+   /* the file descriptor of the log */
+   int iFd;
+   /* the records appended since the last flush began */
+   struct walBuffer sPending;
+   /* the buffer the next flush leaves the pending records in */
+   struct walBuffer sSpare;
+   /* the bytes appended since the Wal_T was made, and how many of
+      those are durable */
+   unsigned long ulAppended;
+   unsigned long ulDurable;
+   /* the size of the log, counting pending records */
+   unsigned long ulSize;
+   /* TRUE while a thread writes out and syncs records */
+   boolean bFlushing;
+   /* SUCCESS, or the status with which the log failed */
+   int iStatus;
+   /* guards the fields above */
+   pthread_mutex_t sMutex;
+   /* signalled whenever a flush ends */
+   pthread_cond_t sFlushed;
+};
+
+/* A log being read */
+struct walReader {
+   /* the mapping of the log */
+   unsigned char *pucBase;
+   size_t ulSize;
+   /* the offset of the next record */
+   size_t ulOffset;
+   /* the generation in the header */
+   unsigned long ulGeneration;
+};
+
+/*--------------------------------------------------------------------*/
+
+/* Returns the FNV-1a hash of the ulLength bytes pucBytes, cut to 32
+   bits. */
+static unsigned long Wal_checksum(const unsigned char *pucBytes,
+                                  size_t ulLength) {
+   unsigned long ulHash = 2166136261UL;
+   size_t i;
+
+   assert(pucBytes != NULL || ulLength == 0);
+
+   for(i = 0; i < ulLength; i++)
+      ulHash = ((ulHash ^ pucBytes[i]) * 16777619UL) & 0xffffffffUL;
+   return ulHash;
+}
+
+/* Stores the ulBytes low bytes of ulValue at pucTo, least significant
+   first. */
+static void Wal_putFixed(unsigned char *pucTo, unsigned long ulValue,
+                         size_t ulBytes) {
+   size_t i;
+
+   assert(pucTo != NULL);
+
+   for(i = 0; i < ulBytes; i++) {
+      pucTo[i] = (unsigned char) (ulValue & 0xff);
+      ulValue >>= 8;
+   }
+}
+
+/* Returns the number stored by Wal_putFixed in the ulBytes bytes at
+   pucFrom. */
+static unsigned long Wal_getFixed(const unsigned char *pucFrom,
+                                  size_t ulBytes) {
+   unsigned long ulValue = 0;
+
+   assert(pucFrom != NULL);
+
+   while(ulBytes-- > 0)
+      ulValue = (ulValue << 8) | pucFrom[ulBytes];
+   return ulValue;
+}
+
+/* Stores ulValue at pucTo in seven bits per byte, the low ones first,
+   with the top bit set in every byte but the last, and returns the
+   number of bytes used. Stores nothing if pucTo is NULL. */
+static size_t Wal_putVarint(unsigned char *pucTo, size_t ulValue) {
+   size_t ulBytes = 0;
+
+   do {
+      if(pucTo != NULL)
+         pucTo[ulBytes] = (unsigned char) ((ulValue & 0x7f) |
+                                           (ulValue > 0x7f ? 0x80 : 0));
+      ulBytes++;
+      ulValue >>= 7;
+   } while(ulValue != 0);
+   return ulBytes;
+}
+
+/*
+  Reads a number stored by Wal_putVarint from the bytes at *ppucFrom,
+  which end before pucEnd, into *pulValue and moves *ppucFrom past it.
+  Returns FALSE if the bytes end first or the number is too long.
+*/
+static boolean Wal_getVarint(const unsigned char **ppucFrom,
+                             const unsigned char *pucEnd,
+                             size_t *pulValue) {
+   const unsigned char *pucFrom;
+   size_t ulValue = 0;
+   size_t i;
+
+   assert(ppucFrom != NULL);
+   assert(pulValue != NULL);
+
+   pucFrom = *ppucFrom;
+   for(i = 0; i < MAX_VARINT && pucFrom < pucEnd; i++) {
+      ulValue |= (size_t) (*pucFrom & 0x7f) << (7 * i);
+      if((*pucFrom++ & 0x80) == 0) {
+         *ppucFrom = pucFrom;
+         *pulValue = ulValue;
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+/*
+  Writes the ulLength bytes pucBytes to iFd, however many calls that
+  takes. Returns SUCCESS, or IO_ERROR, in which case errno tells why.
+*/
+static int Wal_writeAll(int iFd, const unsigned char *pucBytes,
+                        size_t ulLength) {
+   ssize_t lWritten;
+
+   assert(pucBytes != NULL || ulLength == 0);
+
+   while(ulLength > 0) {
+      lWritten = write(iFd, pucBytes, ulLength);
+      if(lWritten < 0 && errno != EINTR)
+         return IO_ERROR;
+      if(lWritten > 0) {
+         pucBytes += lWritten;
+         ulLength -= (size_t) lWritten;
+      }
+   }
+   return SUCCESS;
+}
+
+/*
+  Makes the directory holding pcPath durable, so that a file just
+  created or renamed there survives a crash. Returns SUCCESS, or
+  IO_ERROR, in which case errno tells why.
+*/
+static int Wal_syncDirectory(const char *pcPath) {
+   const char *pcSlash;
+   char *pcDir;
+   int iFd;
+   int iStatus = SUCCESS;
+
+   assert(pcPath != NULL);
+
+   pcSlash = strrchr(pcPath, '/');
+   if(pcSlash == NULL)
+      pcSlash = pcPath;
+   else if(pcSlash == pcPath)
+      pcSlash++;
+   pcDir = malloc((size_t) (pcSlash - pcPath) + 2);
+   if(pcDir == NULL)
+      return MEMORY_ERROR;
+   if(pcSlash == pcPath)
+      strcpy(pcDir, ".");
+   else {
+      memcpy(pcDir, pcPath, (size_t) (pcSlash - pcPath));
+      pcDir[pcSlash - pcPath] = '\0';
+   }
+
+   iFd = open(pcDir, O_RDONLY | O_DIRECTORY);
+   free(pcDir);
+   if(iFd < 0)
+      return IO_ERROR;
+   if(fsync(iFd) != 0)
+      iStatus = IO_ERROR;
+   (void) close(iFd);
+   return iStatus;
+}
+
+/*
+  Creates the log pcPath, replacing any file there, with generation
+  ulGeneration and no records, and makes it durable. Returns its file
+  descriptor, or -1 if that fails, in which case errno tells why.
+*/
+static int Wal_createFile(const char *pcPath, unsigned long ulGeneration) {
+   unsigned char aucHeader[HEADER_SIZE];
+   int iFd;
+   int iErrno;
+
+   assert(pcPath != NULL);
+
+   memcpy(aucHeader, aucMagic, sizeof(aucMagic));
+   Wal_putFixed(aucHeader + sizeof(aucMagic), ulGeneration,
+                HEADER_SIZE - sizeof(aucMagic));
+
+   iFd = open(pcPath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if(iFd < 0)
+      return -1;
+   if(Wal_writeAll(iFd, aucHeader, HEADER_SIZE) != SUCCESS ||
+      fsync(iFd) != 0 || Wal_syncDirectory(pcPath) != SUCCESS) {
+      iErrno = errno;
+      (void) close(iFd);
+      errno = iErrno;
+      return -1;
+   }
+   return iFd;
+}
+
+/*
+  Creates a Wal_T appending to the log open on iFd, which is ulSize
+  bytes long. Returns SUCCESS and sets *poWResult to it, or closes iFd,
+  sets *poWResult to NULL and returns MEMORY_ERROR.
+*/
+static int Wal_new(int iFd, unsigned long ulSize, Wal_T *poWResult) {
+   Wal_T oWal;
+
+   assert(poWResult != NULL);
+
+   *poWResult = NULL;
+   oWal = calloc(1, sizeof(struct wal));
+   if(oWal == NULL) {
+      (void) close(iFd);
+      return MEMORY_ERROR;
+   }
+   if(pthread_mutex_init(&oWal->sMutex, NULL) != 0) {
+      free(oWal);
+      (void) close(iFd);
+      return MEMORY_ERROR;
+   }
+   if(pthread_cond_init(&oWal->sFlushed, NULL) != 0) {
+      (void) pthread_mutex_destroy(&oWal->sMutex);
+      free(oWal);
+      (void) close(iFd);
+      return MEMORY_ERROR;
+   }
+   oWal->iFd = iFd;
+   oWal->ulSize = ulSize;
+   oWal->bFlushing = FALSE;
+   oWal->iStatus = SUCCESS;
+
+   *poWResult = oWal;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Wal_create(const char *pcPath, unsigned long ulGeneration,
+               Wal_T *poWResult) {
+   int iFd;
+
+   assert(pcPath != NULL);
+   assert(poWResult != NULL);
+
+   *poWResult = NULL;
+   iFd = Wal_createFile(pcPath, ulGeneration);
+   if(iFd < 0)
+      return IO_ERROR;
+   return Wal_new(iFd, HEADER_SIZE, poWResult);
+}
+
+/*--------------------------------------------------------------------*/
+
+int Wal_openAt(const char *pcPath, unsigned long ulLength,
+               Wal_T *poWResult) {
+   int iFd;
+   int iErrno;
+
+   assert(pcPath != NULL);
+   assert(poWResult != NULL);
+
+   *poWResult = NULL;
+   iFd = open(pcPath, O_WRONLY);
+   if(iFd < 0)
+      return IO_ERROR;
+   if(ftruncate(iFd, (off_t) ulLength) != 0 ||
+      lseek(iFd, (off_t) ulLength, SEEK_SET) < 0) {
+      iErrno = errno;
+      (void) close(iFd);
+      errno = iErrno;
+      return IO_ERROR;
+   }
+   return Wal_new(iFd, ulLength, poWResult);
+}
+
+/*--------------------------------------------------------------------*/
+
+int Wal_append(Wal_T oWal, const struct Wal_record *psRecord) {
+   const char *pcSecond;
+   unsigned char *pucRecord;
+   unsigned char *pucGrown;
+   size_t ulFirst, ulSecond, ulSecondBytes;
+   size_t ulSize, ulCapacity;
+   int iOp;
+   int iStatus;
+
+   assert(oWal != NULL);
+   assert(psRecord != NULL);
+   assert(psRecord->pcPath != NULL);
+
+   /* what follows the path */
+   iOp = (int) psRecord->eOp;
+   if(psRecord->eOp == WAL_MOVE || psRecord->eOp == WAL_COPY) {
+      assert(psRecord->pcOther != NULL);
+      pcSecond = psRecord->pcOther;
+      ulSecond = strlen(pcSecond) + 1;
+      ulSecondBytes = ulSecond;
+   }
+   else if(psRecord->eOp == WAL_INSERTFILE ||
+           psRecord->eOp == WAL_REPLACE || psRecord->eOp == WAL_WRITE) {
+      pcSecond = psRecord->pvContents;
+      ulSecond = psRecord->ulLength;
+      ulSecondBytes = ulSecond;
+      if(pcSecond == NULL) {
+         iOp |= NO_CONTENTS;
+         ulSecondBytes = 0;
+      }
+   }
+   else {
+      pcSecond = NULL;
+      ulSecond = 0;
+      ulSecondBytes = 0;
+   }
+   ulFirst = strlen(psRecord->pcPath) + 1;
+   ulSize = CHECKSUM_SIZE + OP_SIZE + Wal_putVarint(NULL, ulFirst) +
+            Wal_putVarint(NULL, ulSecond) + ulFirst + ulSecondBytes;
+   if(psRecord->eOp == WAL_WRITE)
+      ulSize += Wal_putVarint(NULL, psRecord->ulOffset);
+
+   (void) pthread_mutex_lock(&oWal->sMutex);
+   if(oWal->iStatus != SUCCESS) {
+      iStatus = oWal->iStatus;
+      (void) pthread_mutex_unlock(&oWal->sMutex);
+      return iStatus;
+   }
+   if(oWal->sPending.ulLength + ulSize > oWal->sPending.ulCapacity) {
+      ulCapacity = 2 * oWal->sPending.ulCapacity;
+      if(ulCapacity < oWal->sPending.ulLength + ulSize)
+         ulCapacity = oWal->sPending.ulLength + ulSize + 4096;
+      pucGrown = realloc(oWal->sPending.pucBytes, ulCapacity);
+      if(pucGrown == NULL) {
+         oWal->iStatus = MEMORY_ERROR;
+         (void) pthread_mutex_unlock(&oWal->sMutex);
+         return MEMORY_ERROR;
+      }
+      oWal->sPending.pucBytes = pucGrown;
+      oWal->sPending.ulCapacity = ulCapacity;
+   }
+
+   pucRecord = oWal->sPending.pucBytes + oWal->sPending.ulLength;
+   ulSize = CHECKSUM_SIZE;
+   pucRecord[ulSize++] = (unsigned char) iOp;
+   ulSize += Wal_putVarint(pucRecord + ulSize, ulFirst);
+   ulSize += Wal_putVarint(pucRecord + ulSize, ulSecond);
+   if(psRecord->eOp == WAL_WRITE)
+      ulSize += Wal_putVarint(pucRecord + ulSize, psRecord->ulOffset);
+   memcpy(pucRecord + ulSize, psRecord->pcPath, ulFirst);
+   ulSize += ulFirst;
+   if(ulSecondBytes > 0)
+      memcpy(pucRecord + ulSize, pcSecond, ulSecondBytes);
+   ulSize += ulSecondBytes;
+   Wal_putFixed(pucRecord, Wal_checksum(pucRecord + CHECKSUM_SIZE,
+                                        ulSize - CHECKSUM_SIZE),
+                CHECKSUM_SIZE);
+
+   oWal->sPending.ulLength += ulSize;
+   oWal->ulAppended += ulSize;
+   oWal->ulSize += ulSize;
+   (void) pthread_mutex_unlock(&oWal->sMutex);
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Wal_sync(Wal_T oWal) {
+   struct walBuffer sOut;
+   unsigned long ulTarget, ulEnd;
+   int iFd;
+   int iStatus;
+
+   assert(oWal != NULL);
+
+   (void) pthread_mutex_lock(&oWal->sMutex);
+   ulTarget = oWal->ulAppended;
+   while(oWal->iStatus == SUCCESS && oWal->ulDurable < ulTarget) {
+      /* the thread flushing now may not have taken these records, but
+         the next flush will take them along with any others */
+      if(oWal->bFlushing) {
+         (void) pthread_cond_wait(&oWal->sFlushed, &oWal->sMutex);
+         continue;
+      }
+      oWal->bFlushing = TRUE;
+      sOut = oWal->sPending;
+      oWal->sPending = oWal->sSpare;
+      oWal->sPending.ulLength = 0;
+      ulEnd = oWal->ulAppended;
+      iFd = oWal->iFd;
+      (void) pthread_mutex_unlock(&oWal->sMutex);
+
+      iStatus = Wal_writeAll(iFd, sOut.pucBytes, sOut.ulLength);
+      if(iStatus == SUCCESS && fdatasync(iFd) != 0)
+         iStatus = IO_ERROR;
+
+      (void) pthread_mutex_lock(&oWal->sMutex);
+      oWal->sSpare = sOut;
+      oWal->bFlushing = FALSE;
+      if(iStatus == SUCCESS)
+         oWal->ulDurable = ulEnd;
+      else
+         oWal->iStatus = iStatus;
+      (void) pthread_cond_broadcast(&oWal->sFlushed);
+   }
+   iStatus = oWal->iStatus;
+   (void) pthread_mutex_unlock(&oWal->sMutex);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Wal_getStatus(Wal_T oWal) {
+   int iStatus;
+
+   assert(oWal != NULL);
+
+   (void) pthread_mutex_lock(&oWal->sMutex);
+   iStatus = oWal->iStatus;
+   (void) pthread_mutex_unlock(&oWal->sMutex);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+void Wal_fail(Wal_T oWal, int iStatus) {
+   assert(oWal != NULL);
+   assert(iStatus != SUCCESS);
+
+   (void) pthread_mutex_lock(&oWal->sMutex);
+   if(oWal->iStatus == SUCCESS)
+      oWal->iStatus = iStatus;
+   (void) pthread_cond_broadcast(&oWal->sFlushed);
+   (void) pthread_mutex_unlock(&oWal->sMutex);
+}
+
+/*--------------------------------------------------------------------*/
+
+unsigned long Wal_getSize(Wal_T oWal) {
+   unsigned long ulSize;
+
+   assert(oWal != NULL);
+
+   (void) pthread_mutex_lock(&oWal->sMutex);
+   ulSize = oWal->ulSize;
+   (void) pthread_mutex_unlock(&oWal->sMutex);
+   return ulSize;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Wal_rotate(Wal_T oWal, const char *pcPath, unsigned long ulGeneration) {
+   int iFd;
+   int iStatus;
+
+   assert(oWal != NULL);
+   assert(pcPath != NULL);
+
+   iStatus = Wal_sync(oWal);
+   if(iStatus != SUCCESS)
+      return iStatus;
+   iFd = Wal_createFile(pcPath, ulGeneration);
+   if(iFd < 0)
+      return IO_ERROR;
+
+   (void) pthread_mutex_lock(&oWal->sMutex);
+   /* nothing was appended since the sync, but a late syncing thread
+      may still be flushing nothing */
+   while(oWal->bFlushing)
+      (void) pthread_cond_wait(&oWal->sFlushed, &oWal->sMutex);
+   assert(oWal->sPending.ulLength == 0);
+   (void) close(oWal->iFd);
+   oWal->iFd = iFd;
+   oWal->ulSize = HEADER_SIZE;
+   (void) pthread_mutex_unlock(&oWal->sMutex);
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Wal_close(Wal_T oWal) {
+   int iStatus;
+
+   if(oWal == NULL)
+      return SUCCESS;
+
+   iStatus = Wal_sync(oWal);
+   (void) close(oWal->iFd);
+   free(oWal->sPending.pucBytes);
+   free(oWal->sSpare.pucBytes);
+   (void) pthread_cond_destroy(&oWal->sFlushed);
+   (void) pthread_mutex_destroy(&oWal->sMutex);
+   free(oWal);
+   return iStatus;
+}
+
+/*--------------------------------------------------------------------*/
+
+int Wal_rename(const char *pcFrom, const char *pcTo) {
+   assert(pcFrom != NULL);
+   assert(pcTo != NULL);
+
+   if(rename(pcFrom, pcTo) != 0)
+      return IO_ERROR;
+   return Wal_syncDirectory(pcTo);
+}
+
+/*--------------------------------------------------------------------*/
+
+int WalReader_open(const char *pcPath, WalReader_T *poRResult) {
+   WalReader_T oReader;
+   struct stat sStat;
+   void *pvBase;
+   int iFd;
+   int iErrno;
+
+   assert(pcPath != NULL);
+   assert(poRResult != NULL);
+
+   *poRResult = NULL;
+   iFd = open(pcPath, O_RDONLY);
+   if(iFd < 0)
+      return IO_ERROR;
+   if(fstat(iFd, &sStat) != 0) {
+      iErrno = errno;
+      (void) close(iFd);
+      errno = iErrno;
+      return IO_ERROR;
+   }
+   if(sStat.st_size < HEADER_SIZE) {
+      (void) close(iFd);
+      errno = EINVAL;
+      return IO_ERROR;
+   }
+   pvBase = mmap(NULL, (size_t) sStat.st_size, PROT_READ, MAP_PRIVATE,
+                 iFd, 0);
+   iErrno = errno;
+   (void) close(iFd);
+   if(pvBase == MAP_FAILED) {
+      errno = iErrno;
+      return IO_ERROR;
+   }
+   if(memcmp(pvBase, aucMagic, sizeof(aucMagic))) {
+      (void) munmap(pvBase, (size_t) sStat.st_size);
+      errno = EINVAL;
+      return IO_ERROR;
+   }
+
+   oReader = malloc(sizeof(struct walReader));
+   if(oReader == NULL) {
+      (void) munmap(pvBase, (size_t) sStat.st_size);
+      return MEMORY_ERROR;
+   }
+   oReader->pucBase = pvBase;
+   oReader->ulSize = (size_t) sStat.st_size;
+   oReader->ulOffset = HEADER_SIZE;
+   oReader->ulGeneration = Wal_getFixed(oReader->pucBase +
+                                        sizeof(aucMagic),
+                                        HEADER_SIZE - sizeof(aucMagic));
+
+   *poRResult = oReader;
+   return SUCCESS;
+}
+
+/*--------------------------------------------------------------------*/
+
+unsigned long WalReader_getGeneration(WalReader_T oReader) {
+   assert(oReader != NULL);
+
+   return oReader->ulGeneration;
+}
+
+/*--------------------------------------------------------------------*/
+
+boolean WalReader_next(WalReader_T oReader, struct Wal_record *psRecord) {
+   const unsigned char *pucStart;
+   const unsigned char *pucNext;
+   const unsigned char *pucEnd;
+   size_t ulFirst, ulSecond, ulSecondBytes;
+   size_t ulOffset = 0;
+   int iOp;
+
+   assert(oReader != NULL);
+   assert(psRecord != NULL);
+
+   pucStart = oReader->pucBase + oReader->ulOffset;
+   pucEnd = oReader->pucBase + oReader->ulSize;
+   if((size_t) (pucEnd - pucStart) < CHECKSUM_SIZE + OP_SIZE)
+      return FALSE;
+   pucNext = pucStart + CHECKSUM_SIZE;
+   iOp = *pucNext++;
+   if(!Wal_getVarint(&pucNext, pucEnd, &ulFirst) ||
+      !Wal_getVarint(&pucNext, pucEnd, &ulSecond))
+      return FALSE;
+   ulSecondBytes = (iOp & NO_CONTENTS) ? 0 : ulSecond;
+   iOp &= ~NO_CONTENTS;
+   if(iOp == (int) WAL_WRITE &&
+      !Wal_getVarint(&pucNext, pucEnd, &ulOffset))
+      return FALSE;
+   if(ulFirst == 0 || ulFirst > (size_t) (pucEnd - pucNext) ||
+      ulSecondBytes > (size_t) (pucEnd - pucNext) - ulFirst ||
+      iOp > (int) WAL_WRITE)
+      return FALSE;
+   if(Wal_checksum(pucStart + CHECKSUM_SIZE,
+                   (size_t) (pucNext - pucStart) - CHECKSUM_SIZE +
+                   ulFirst + ulSecondBytes) !=
+      Wal_getFixed(pucStart, CHECKSUM_SIZE))
+      return FALSE;
+
+   psRecord->eOp = (enum Wal_op) iOp;
+   psRecord->pcPath = (const char *) pucNext;
+   psRecord->pcOther = NULL;
+   psRecord->pvContents = NULL;
+   psRecord->ulLength = 0;
+   psRecord->ulOffset = ulOffset;
+   if(pucNext[ulFirst - 1] != '\0')
+      return FALSE;
+   if(psRecord->eOp == WAL_MOVE || psRecord->eOp == WAL_COPY) {
+      if(ulSecond == 0 || pucNext[ulFirst + ulSecond - 1] != '\0')
+         return FALSE;
+      psRecord->pcOther = (const char *) pucNext + ulFirst;
+   }
+   else if(psRecord->eOp == WAL_INSERTFILE ||
+           psRecord->eOp == WAL_REPLACE || psRecord->eOp == WAL_WRITE) {
+      /* the mapping is read-only, whatever the type says */
+      if(ulSecondBytes == ulSecond)
+         psRecord->pvContents = (void *) (pucNext + ulFirst);
+      psRecord->ulLength = ulSecond;
+   }
+
+   oReader->ulOffset = (size_t) (pucNext - oReader->pucBase) + ulFirst +
+                       ulSecondBytes;
+   return TRUE;
+}
+
+/*--------------------------------------------------------------------*/
+
+unsigned long WalReader_getValidLength(WalReader_T oReader) {
+   assert(oReader != NULL);
+
+   return oReader->ulOffset;
+}
+
+/*--------------------------------------------------------------------*/
+
+void WalReader_close(WalReader_T oReader) {
+   if(oReader == NULL)
+      return;
+
+   (void) munmap(oReader->pucBase, oReader->ulSize);
+   free(oReader);
+}
@@ -0,0 +1,160 @@
+/*--------------------------------------------------------------------*/
+/* wal.h                                                              */
+/* Author: Isaac Gyamfi and Ndongo Njie                               */
+/*--------------------------------------------------------------------*/
+
+#ifndef WAL_INCLUDED
+#define WAL_INCLUDED
+
+#include <stddef.h>
+#include "a4def.h"
+
+/*
+  A write-ahead log is a file of records of changes to a File Tree,
+  appended in the order the changes were made. It starts with a
+  header holding its generation, the number of the checkpoint image
+  its records apply on top of. Each record holds a checksum, its kind,
+  and one or two strings of bytes, with the offset of a write between
+  the lengths and the strings; paths are stored with their
+  terminating '\0', so that they can be used where they lie in a
+  mapping of the log. A crash may leave the last records torn, and
+  reading stops at the first one whose checksum is wrong.
+
+  Numbers are written least significant byte first, and lengths in
+  as few bytes as they need, so a log reads the same on any machine.
+*/
+
+/* The kinds of records */
+enum Wal_op { WAL_INSERTDIR, WAL_INSERTFILE, WAL_RMDIR, WAL_RMFILE,
+              WAL_REPLACE, WAL_MOVE, WAL_COPY, WAL_WRITE };
+
+/* A record of a change */
+struct Wal_record {
+   /* the kind of change */
+   enum Wal_op eOp;
+   /* the path of the node changed, or the source of a move or copy */
+   const char *pcPath;
+   /* the destination of a move or copy; NULL otherwise */
+   const char *pcOther;
+   /* for WAL_INSERTFILE and WAL_REPLACE, the file's new contents,
+      which may be NULL, of ulLength bytes; for WAL_WRITE, the ulLength
+      bytes written, which are not NULL */
+   void *pvContents;
+   size_t ulLength;
+   /* for WAL_WRITE, where in the file the bytes were written */
+   size_t ulOffset;
+};
+
+/*--------------------------------------------------------------------*/
+
+/*
+  A Wal_T appends records to a log. Any number of threads may append
+  at once; Wal_sync makes what has been appended durable with one
+  fdatasync for however many records from however many threads are
+  waiting, so that concurrent writers share the cost of a sync.
+*/
+typedef struct wal *Wal_T;
+
+/*
+  Creates the log pcPath, replacing any file there, with generation
+  ulGeneration and no records, and makes it durable. Returns SUCCESS
+  and sets *poWResult to a Wal_T appending to it if successful.
+  Otherwise, sets *poWResult to NULL and returns IO_ERROR (from ft.h),
+  in which case errno tells why, or MEMORY_ERROR.
+*/
+int Wal_create(const char *pcPath, unsigned long ulGeneration,
+               Wal_T *poWResult);
+
+/*
+  As Wal_create, but appends to the existing log pcPath, after its
+  first ulLength bytes, as found by WalReader_getValidLength; anything
+  after them, such as a torn record, is cut off.
+*/
+int Wal_openAt(const char *pcPath, unsigned long ulLength,
+               Wal_T *poWResult);
+
+/*
+  Appends the record psRecord to oWal, to be written out by the next
+  Wal_sync. Returns SUCCESS, or MEMORY_ERROR or IO_ERROR if oWal has
+  failed, now or before, in which case the record was dropped.
+*/
+int Wal_append(Wal_T oWal, const struct Wal_record *psRecord);
+
+/*
+  Writes out every record appended to oWal so far, by any thread, and
+  waits until they are durable. Returns SUCCESS, or the status with
+  which oWal failed, now or before. Once failed, a Wal_T appends and
+  syncs nothing more.
+*/
+int Wal_sync(Wal_T oWal);
+
+/* Returns SUCCESS, or the status with which oWal failed. */
+int Wal_getStatus(Wal_T oWal);
+
+/*
+  Records the failure iStatus in oWal, unless it has failed already,
+  so that nothing more is appended or synced.
+*/
+void Wal_fail(Wal_T oWal, int iStatus);
+
+/* Returns the size of the log oWal appends to, counting the records
+   not written out yet. */
+unsigned long Wal_getSize(Wal_T oWal);
+
+/*
+  Makes everything appended to oWal so far durable, then starts
+  appending to a new log pcPath with generation ulGeneration instead,
+  created as by Wal_create. The caller must keep other threads from
+  appending meanwhile. Returns SUCCESS, or IO_ERROR or MEMORY_ERROR,
+  in which case oWal appends to the same log as before, unless it has
+  failed.
+*/
+int Wal_rotate(Wal_T oWal, const char *pcPath, unsigned long ulGeneration);
+
+/*
+  Makes everything appended to oWal durable, closes its log and frees
+  it. Returns SUCCESS, or the status with which oWal failed. Does
+  nothing and returns SUCCESS if oWal is NULL.
+*/
+int Wal_close(Wal_T oWal);
+
+/*
+  Renames the file pcFrom to pcTo, replacing any file there, and makes
+  the change durable. Returns SUCCESS, or IO_ERROR, in which case
+  errno tells why.
+*/
+int Wal_rename(const char *pcFrom, const char *pcTo);
+
+/*--------------------------------------------------------------------*/
+
+/* A WalReader_T reads the records of a log, mapped into memory */
+typedef struct walReader *WalReader_T;
+
+/*
+  Maps the log pcPath. Returns SUCCESS and sets *poRResult to a reader
+  positioned at its first record if successful. Otherwise, sets
+  *poRResult to NULL and returns IO_ERROR, in which case errno tells
+  why (EINVAL if pcPath has no whole header), or MEMORY_ERROR.
+*/
+int WalReader_open(const char *pcPath, WalReader_T *poRResult);
+
+/* Returns the generation of the log oReader reads. */
+unsigned long WalReader_getGeneration(WalReader_T oReader);
+
+/*
+  Stores the next whole record of oReader's log in *psRecord and
+  returns TRUE, or returns FALSE at the end of the log or of its
+  intact records. The record's strings lie in the mapping and remain
+  valid until WalReader_close.
+*/
+boolean WalReader_next(WalReader_T oReader, struct Wal_record *psRecord);
+
+/* Returns the length of the part of oReader's log read so far that
+   holds its header and whole records. */
+unsigned long WalReader_getValidLength(WalReader_T oReader);
+
+/* Unmaps oReader's log and frees it. Does nothing if oReader is
+   NULL. */
+void WalReader_close(WalReader_T oReader);
+
+#endif